@@ -0,0 +1,563 @@
+#include "FarmClient.h"
+#include "../winsock_server/FrameCompressor.h"
+#include "../winsock_server/json_util.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+// JSON字符串字面量（转义引号、反斜杠和控制字符）
+static std::string quote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string cellJson(int row, int col) {
+    return "{\"row\":" + std::to_string(row) + ",\"col\":" + std::to_string(col) + "}";
+}
+
+// 设置接收超时（0表示一直等待）
+static void setReceiveTimeout(socket_t sock, int seconds) {
+#ifdef _WIN32
+    DWORD timeout = static_cast<DWORD>(seconds) * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+#else
+    timeval timeout;
+    timeout.tv_sec = seconds;
+    timeout.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+#endif
+}
+
+FarmClient::FarmClient()
+    : m_socket(INVALID_SOCKET), m_state(ClientState::DISCONNECTED),
+      m_maxInFlight(0), m_compressed(false), m_shouldStop(false),
+      m_nextRequestId(1), m_flushing(false) {
+}
+
+FarmClient::~FarmClient() {
+    disconnect();
+}
+
+// ========== 连接控制 ==========
+
+bool FarmClient::connect(const ClientConfig& config) {
+    disconnect();
+    m_config = config;
+    m_shouldStop = false;
+
+    if (!initializeNetwork()) {
+        setError("Network initialization failed");
+        m_state = ClientState::ERROR;
+        return false;
+    }
+    if (!connectInternal()) {
+        cleanupNetwork();
+        m_state = ClientState::ERROR;
+        return false;
+    }
+    m_receiveThread = std::thread(&FarmClient::receiveLoop, this);
+    if (m_connectCallback) {
+        m_connectCallback(true);
+    }
+    return true;
+}
+
+void FarmClient::disconnect() {
+    if (!m_receiveThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_stopMutex);
+        m_shouldStop = true;
+    }
+    m_stopCv.notify_all();
+
+    // 通知服务器后关闭发送方向，接收线程读到连接结束后退出
+    if (m_state == ClientState::CONNECTED) {
+        sendFrame(Packet(Command::DISCONNECT, "{}"));
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        if (isValidSocket(m_socket)) {
+            shutdown(m_socket, SD_BOTH);
+        }
+    }
+    m_receiveThread.join();
+    cleanupNetwork();
+}
+
+std::string FarmClient::getLastError() const {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    return m_lastError;
+}
+
+// 建立连接并完成握手（阻塞，最长receiveTimeout秒）
+bool FarmClient::connectInternal() {
+    m_state = ClientState::CONNECTING;
+
+    socket_t sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!isValidSocket(sock)) {
+        setError(std::string("Socket creation failed: ") + getSocketError());
+        return false;
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_config.serverPort);
+    if (inet_pton(AF_INET, m_config.serverIP.c_str(), &addr.sin_addr) != 1) {
+        CLOSE_SOCKET(sock);
+        setError("Invalid server address: " + m_config.serverIP);
+        return false;
+    }
+    if (::connect(sock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        setError(std::string("Connect failed: ") + getSocketError());
+        CLOSE_SOCKET(sock);
+        return false;
+    }
+    // 请求很小，关闭Nagle由写合并自己决定批次
+    setTcpNoDelay(sock, true);
+    setReceiveTimeout(sock, m_config.receiveTimeout);
+
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_socket = sock;
+        m_outgoing.clear();
+    }
+    m_input.clear();
+    m_fragments.clear();
+
+    if (!handshake()) {
+        cleanup();
+        return false;
+    }
+    setReceiveTimeout(sock, 0);
+    m_state = ClientState::CONNECTED;
+    return true;
+}
+
+// CONNECT以v1帧发送，服务器在回复后把连接切换到v2
+bool FarmClient::handshake() {
+    std::ostringstream oss;
+    oss << "{\"client_name\":" << quote(m_config.clientName)
+        << ",\"version\":\"1.0\",\"protocol_version\":" << PROTOCOL_VERSION_2
+        << ",\"compression\":\"" << (m_config.compression ? "lz4" : "none") << "\"}";
+    if (!sendAll(m_socket, Packet(Command::CONNECT, oss.str()).serialize(PROTOCOL_VERSION_1))) {
+        setError("Failed to send CONNECT");
+        return false;
+    }
+
+    const size_t headerSize = packetHeaderSize(PROTOCOL_VERSION_1);
+    char buffer[4096];
+    while (true) {
+        // 回复之前可能夹着其他推送，跳过非SUCCESS/ERROR的帧
+        if (m_input.size() >= headerSize) {
+            PacketHeader header;
+            std::memcpy(&header, m_input.data(), sizeof(header));
+            if (header.magic != PROTOCOL_MAGIC || header.length > MAX_PACKET_SIZE) {
+                setError("Invalid handshake reply");
+                return false;
+            }
+            if (m_input.size() >= headerSize + header.length) {
+                std::string data = m_input.substr(headerSize, header.length);
+                m_input.erase(0, headerSize + header.length);
+                if (header.command == Response::ERROR) {
+                    JsonValue json;
+                    JsonValue::parse(data, json);
+                    setError("Connect rejected: " + json.getString("error_message", data));
+                    return false;
+                }
+                if (header.command != Response::SUCCESS) {
+                    continue;
+                }
+                JsonValue json;
+                JsonValue::parse(data, json);
+                if (json.getInt("protocol_version", PROTOCOL_VERSION_1) < PROTOCOL_VERSION_2) {
+                    setError("Server does not support protocol v2");
+                    return false;
+                }
+                m_maxInFlight = static_cast<uint32_t>(json.getInt("max_in_flight", 0));
+                m_compressed = json.getString("compression", "none") == "lz4";
+                return true;
+            }
+        }
+        int received = recv(m_socket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            setError("No reply to CONNECT");
+            return false;
+        }
+        m_input.append(buffer, static_cast<size_t>(received));
+    }
+}
+
+// 接收线程：读到连接断开，再按配置重连
+void FarmClient::receiveLoop() {
+    while (true) {
+        readFrames();
+
+        // 先改状态再关闭socket：之后的请求要么立即失败，要么发送失败后自己移除
+        bool stopping = m_shouldStop;
+        m_state = ClientState::DISCONNECTED;
+        cleanup();
+        failPending(stopping ? "Disconnected" : "Connection lost");
+        if (stopping) {
+            return;
+        }
+        if (m_disconnectCallback) {
+            m_disconnectCallback();
+        }
+        if (!m_config.autoReconnect) {
+            return;
+        }
+
+        bool reconnected = false;
+        while (!reconnected) {
+            {
+                std::unique_lock<std::mutex> lock(m_stopMutex);
+                m_stopCv.wait_for(lock, std::chrono::seconds(m_config.reconnectInterval),
+                                  [this]() { return m_shouldStop.load(); });
+            }
+            if (m_shouldStop) {
+                return;
+            }
+            reconnected = connectInternal();
+            if (!reconnected) {
+                m_state = ClientState::ERROR;
+            }
+        }
+        resubscribe();
+        if (m_connectCallback) {
+            m_connectCallback(true);
+        }
+    }
+}
+
+// 读取并分发v2帧，连接断开或出错时返回false
+bool FarmClient::readFrames() {
+    const size_t headerSize = packetHeaderSize(PROTOCOL_VERSION_2);
+    std::vector<char> buffer(65536);
+    size_t offset = 0;
+    while (true) {
+        // 先处理缓冲区中的完整帧（包括握手时多读到的数据）
+        while (m_input.size() - offset >= headerSize) {
+            Packet packet;
+            std::memcpy(&packet.header, m_input.data() + offset, sizeof(PacketHeader));
+            std::memcpy(&packet.ext, m_input.data() + offset + sizeof(PacketHeader), sizeof(PacketHeaderExt));
+            if (!packet.isValid()) {
+                setError("Invalid frame from server");
+                return false;
+            }
+            if (m_input.size() - offset < headerSize + packet.header.length) {
+                break;
+            }
+            const char* data = m_input.data() + offset + headerSize;
+            size_t length = packet.header.length;
+            offset += headerSize + length;
+
+            if (packet.ext.flags & PacketFlag::COMPRESSED) {
+                std::string raw;
+                if (!FrameCompressor::decompress(data, length, raw, MAX_MESSAGE_SIZE)) {
+                    setError("Corrupt compressed frame");
+                    return false;
+                }
+                m_fragments += raw;
+            } else {
+                m_fragments.append(data, length);
+            }
+            if (packet.ext.flags & PacketFlag::MORE) {
+                continue;   // 分片连续到达，拼到最后一片再分发
+            }
+            packet.ext.flags &= ~PacketFlag::COMPRESSED;
+            packet.data.swap(m_fragments);
+            m_fragments.clear();
+            packet.header.length = static_cast<uint32_t>(packet.data.size());
+            dispatch(packet);
+        }
+        m_input.erase(0, offset);
+        offset = 0;
+
+        int received = recv(m_socket, buffer.data(), static_cast<int>(buffer.size()), 0);
+        if (received <= 0) {
+            return false;
+        }
+        m_input.append(buffer.data(), static_cast<size_t>(received));
+    }
+}
+
+void FarmClient::dispatch(const Packet& packet) {
+    if (!(packet.ext.flags & PacketFlag::RESPONSE)) {
+        // 服务器推送
+        if (packet.header.command == Response::STATE_UPDATE && m_stateUpdateCallback) {
+            m_stateUpdateCallback(packet.data);
+        } else if (packet.header.command == Response::LOG_MESSAGE && m_logMessageCallback) {
+            m_logMessageCallback(packet.data);
+        } else if (m_pushCallback) {
+            m_pushCallback(packet);
+        }
+        return;
+    }
+
+    ReplyCallback callback;
+    FarmReply reply;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        auto it = m_pending.find(packet.ext.requestId);
+        if (it == m_pending.end()) {
+            return;
+        }
+        if (!(packet.ext.flags & PacketFlag::FINAL)) {
+            it->second.parts.push_back(packet);
+            return;
+        }
+        callback.swap(it->second.callback);
+        reply.parts.swap(it->second.parts);
+        m_pending.erase(it);
+    }
+
+    reply.command = packet.header.command;
+    reply.data = packet.data;
+    reply.ok = packet.header.command != Response::ERROR;
+    if (!reply.ok) {
+        JsonValue json;
+        JsonValue::parse(packet.data, json);
+        reply.errorCode = static_cast<uint32_t>(json.getInt("error_code", 0));
+        reply.error = json.getString("error_message", "");
+    }
+    if (callback) {
+        callback(reply);
+    }
+}
+
+void FarmClient::failPending(const std::string& reason) {
+    std::map<uint32_t, PendingRequest> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        pending.swap(m_pending);
+    }
+    FarmReply reply;
+    reply.error = reason;
+    for (auto& pair : pending) {
+        if (pair.second.callback) {
+            pair.second.callback(reply);
+        }
+    }
+}
+
+void FarmClient::resubscribe() {
+    std::vector<std::pair<uint32_t, std::string>> subscriptions;
+    {
+        std::lock_guard<std::mutex> lock(m_subscriptionMutex);
+        subscriptions = m_subscriptions;
+    }
+    for (const auto& subscription : subscriptions) {
+        request(subscription.first, subscription.second, nullptr);
+    }
+}
+
+// ========== 请求 ==========
+
+void FarmClient::request(uint32_t command, const std::string& json, ReplyCallback callback) {
+    if (m_state != ClientState::CONNECTED) {
+        if (callback) {
+            FarmReply reply;
+            reply.error = "Not connected";
+            callback(reply);
+        }
+        return;
+    }
+
+    Packet packet(command, json);
+    {
+        // 先登记再发送，回复可能在send返回前就到达
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        packet.ext.requestId = m_nextRequestId++;
+        if (m_nextRequestId == 0) {
+            m_nextRequestId = 1;    // 0留给服务器推送
+        }
+        m_pending[packet.ext.requestId].callback = std::move(callback);
+    }
+    if (sendFrame(packet)) {
+        return;
+    }
+    // 连接已断开：接收线程会让其余在途请求失败，这一个可能登记在它清理之后，自己移除
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        if (isValidSocket(m_socket)) {
+            shutdown(m_socket, SD_BOTH);
+        }
+    }
+    ReplyCallback failed;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        auto it = m_pending.find(packet.ext.requestId);
+        if (it != m_pending.end()) {
+            failed.swap(it->second.callback);
+            m_pending.erase(it);
+        }
+    }
+    if (failed) {
+        FarmReply reply;
+        reply.error = "Connection lost";
+        failed(reply);
+    }
+}
+
+std::future<FarmReply> FarmClient::request(uint32_t command, const std::string& json) {
+    auto promise = std::make_shared<std::promise<FarmReply>>();
+    std::future<FarmReply> future = promise->get_future();
+    request(command, json, [promise](const FarmReply& reply) { promise->set_value(reply); });
+    return future;
+}
+
+// 写合并：没有线程在发送时由本线程发送，发送期间到达的帧在下一轮一起发出
+bool FarmClient::sendFrame(const Packet& packet) {
+    std::unique_lock<std::mutex> lock(m_sendMutex);
+    if (!isValidSocket(m_socket)) {
+        return false;
+    }
+    m_outgoing += packet.serialize(PROTOCOL_VERSION_2);
+    if (m_flushing) {
+        return true;
+    }
+    m_flushing = true;
+    bool ok = true;
+    while (ok && !m_outgoing.empty()) {
+        m_sending.swap(m_outgoing);
+        m_outgoing.clear();
+        socket_t sock = m_socket;
+        lock.unlock();
+        ok = sendAll(sock, m_sending);
+        lock.lock();
+    }
+    if (!ok) {
+        m_outgoing.clear();
+    }
+    m_flushing = false;
+    m_flushDone.notify_all();
+    return ok;
+}
+
+bool FarmClient::sendAll(socket_t socket, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        int sent = send(socket, data.data() + offset, static_cast<int>(data.size() - offset), 0);
+        if (sent <= 0) {
+            return false;
+        }
+        offset += static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// ========== 命令 ==========
+
+std::future<FarmReply> FarmClient::sendGetState() {
+    return request(Command::GET_STATE);
+}
+
+std::future<FarmReply> FarmClient::sendGetPlants() {
+    return request(Command::GET_PLANTS);
+}
+
+std::future<FarmReply> FarmClient::sendMoveCart(int cartId, double targetX, double targetZ, double speed) {
+    std::ostringstream oss;
+    oss << "{\"cart_id\":" << cartId << ",\"target_x\":" << targetX << ",\"target_z\":" << targetZ;
+    if (speed > 0.0) {
+        oss << ",\"speed\":" << speed;     // 不给时用服务器的默认速度
+    }
+    oss << "}";
+    return request(Command::MOVE_CART, oss.str());
+}
+
+std::future<FarmReply> FarmClient::sendRotateCart(int cartId, double targetRotation) {
+    std::ostringstream oss;
+    oss << "{\"cart_id\":" << cartId << ",\"target_rotation\":" << targetRotation << "}";
+    return request(Command::ROTATE_CART, oss.str());
+}
+
+std::future<FarmReply> FarmClient::sendPlantSeed(int row, int col, const std::string& seedType) {
+    std::ostringstream oss;
+    oss << "{\"row\":" << row << ",\"col\":" << col << ",\"seed_type\":" << quote(seedType) << "}";
+    return request(Command::PLANT_SEED, oss.str());
+}
+
+std::future<FarmReply> FarmClient::sendWaterPlant(int row, int col) {
+    return request(Command::WATER_PLANT, cellJson(row, col));
+}
+
+std::future<FarmReply> FarmClient::sendHarvest(int row, int col) {
+    return request(Command::HARVEST, cellJson(row, col));
+}
+
+std::future<FarmReply> FarmClient::sendRemoveWeed(int row, int col) {
+    return request(Command::REMOVE_WEED, cellJson(row, col));
+}
+
+std::future<FarmReply> FarmClient::sendAutoFarmStart(int cartId, const std::string& seedType) {
+    std::ostringstream oss;
+    oss << "{\"cart_id\":" << cartId << ",\"seed_type\":" << quote(seedType) << "}";
+    return request(Command::AUTO_FARM_START, oss.str());
+}
+
+std::future<FarmReply> FarmClient::sendAutoFarmStop(int cartId) {
+    return request(Command::AUTO_FARM_STOP, "{\"cart_id\":" + std::to_string(cartId) + "}");
+}
+
+std::future<FarmReply> FarmClient::sendAutoFarmStatus(int cartId) {
+    return request(Command::AUTO_FARM_STATUS, "{\"cart_id\":" + std::to_string(cartId) + "}");
+}
+
+std::future<FarmReply> FarmClient::sendSwitchEquipment(const std::string& equipment) {
+    return request(Command::SWITCH_EQUIPMENT, "{\"equipment\":" + quote(equipment) + "}");
+}
+
+std::future<FarmReply> FarmClient::sendSwitchCamera(const std::string& cameraMode) {
+    return request(Command::SWITCH_CAMERA, "{\"camera_mode\":" + quote(cameraMode) + "}");
+}
+
+// ========== 订阅 ==========
+
+void FarmClient::addSubscription(uint32_t command, const std::string& json) {
+    {
+        std::lock_guard<std::mutex> lock(m_subscriptionMutex);
+        m_subscriptions.push_back(std::make_pair(command, json));
+    }
+    if (m_state == ClientState::CONNECTED) {
+        request(command, json, nullptr);
+    }
+}
+
+void FarmClient::clearSubscriptions() {
+    std::lock_guard<std::mutex> lock(m_subscriptionMutex);
+    m_subscriptions.clear();
+}
+
+// ========== 内部 ==========
+
+void FarmClient::setError(const std::string& error) {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    m_lastError = error;
+}
+
+// 关闭socket；正在发送的线程持有描述符的副本，等它返回后再close，避免描述符被复用
+void FarmClient::cleanup() {
+    std::unique_lock<std::mutex> lock(m_sendMutex);
+    if (isValidSocket(m_socket)) {
+        shutdown(m_socket, SD_BOTH);
+    }
+    m_flushDone.wait(lock, [this]() { return !m_flushing; });
+    safeCloseSocket(m_socket);
+    m_outgoing.clear();
+}
@@ -2,15 +2,37 @@
 #define FARM_CLIENT_H
 
 #include "../winsock_server/protocol.h"
-#include <winsock2.h>
-#include <ws2tcpip.h>
-#include <string>
+#include "../winsock_server/socket_compat.h"  // 跨平台Socket兼容层
+#include <atomic>
+#include <condition_variable>
 #include <functional>
-#include <thread>
+#include <future>
+#include <map>
 #include <mutex>
-#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
-#pragma comment(lib, "ws2_32.lib")
+/**
+ * 农场服务器的异步客户端（跨平台，协议v2）
+ *
+ * 每个请求分配一个请求ID，立即返回future（或登记回调），不等上一个请求的回复；
+ * 一条连接上可以有多个在途请求，回复按请求ID对应，顺序与发出顺序无关。
+ * 服务器对每个连接的在途请求有上限（握手时告知，maxInFlight()），超过时服务器
+ * 暂停读取，发送方被TCP背压阻塞。
+ *
+ * 写合并：请求先编码进发送缓冲区，当时没有线程在发送就由调用线程负责发送，
+ * 发送期间其他线程加入的请求在下一次send中一起发出，多个小请求合成一次系统调用。
+ *
+ * 一个接收线程负责读取：拼接分片（MORE）、解压协商了LZ4的帧，把回复交给对应的
+ * 请求，服务器推送（RESP_STATE_UPDATE、RESP_CART_MOVED等）交给推送回调。
+ * 回复回调和推送回调都在接收线程上执行，不应长时间阻塞。
+ *
+ * 连接断开时所有在途请求以"Connection lost"失败（不自动重发，修改农田的命令
+ * 不一定幂等）；autoReconnect时每隔reconnectInterval重连，重新握手后再次发送
+ * addSubscription登记的请求（例如每辆小车的AUTO_FARM_START），然后触发连接回调。
+ */
 
 // 客户端状态
 enum class ClientState {
@@ -25,99 +47,143 @@ struct ClientConfig {
     std::string serverIP;
     uint16_t serverPort;
     int reconnectInterval;  // 秒
-    int receiveTimeout;     // 秒
+    int receiveTimeout;     // 秒，连接和握手的超时
     bool autoReconnect;
-    
-    ClientConfig() 
-        : serverIP("127.0.0.1"), serverPort(8888), 
-          reconnectInterval(5), receiveTimeout(10), 
-          autoReconnect(true) {}
+    std::string clientName;
+    bool compression;       // 协商LZ4压缩服务器发来的大帧
+
+    ClientConfig()
+        : serverIP("127.0.0.1"), serverPort(8888),
+          reconnectInterval(5), receiveTimeout(10),
+          autoReconnect(true), clientName("FarmClient"), compression(false) {}
+};
+
+// 一个请求的结果
+struct FarmReply {
+    bool ok;                    // 收到非ERROR的最终回复
+    uint32_t command;           // 最终回复的响应类型；本地失败时为0
+    std::string data;           // 最终回复的JSON
+    uint32_t errorCode;         // ERROR回复中的error_code
+    std::string error;          // 错误信息（服务器的error_message或本地原因）
+    std::vector<Packet> parts;  // 最终回复之前的中间回复（分块查询、流式导出）
+
+    FarmReply() : ok(false), command(0), errorCode(0) {}
 };
 
 // 回调函数类型
 using ConnectCallback = std::function<void(bool success)>;
 using DisconnectCallback = std::function<void()>;
 using StateUpdateCallback = std::function<void(const std::string& stateJson)>;
-using PlantDataCallback = std::function<void(const std::string& plantsJson)>;
 using LogMessageCallback = std::function<void(const std::string& message)>;
-using ErrorCallback = std::function<void(uint32_t errorCode, const std::string& message)>;
+using PushCallback = std::function<void(const Packet& packet)>;    // 其他服务器推送
+using ReplyCallback = std::function<void(const FarmReply& reply)>;
 
 class FarmClient {
 public:
     FarmClient();
     ~FarmClient();
-    
-    // 连接控制
+
+    // 连接控制：connect阻塞到握手完成
     bool connect(const ClientConfig& config);
     void disconnect();
     bool isConnected() const { return m_state == ClientState::CONNECTED; }
     ClientState getState() const { return m_state; }
-    
-    // 命令发送（同步）
-    bool sendConnect(const std::string& clientName);
-    bool sendGetState();
-    bool sendGetPlants();
-    bool sendMoveCart(float targetX, float targetZ, float speed = 1.0f);
-    bool sendRotateCart(float targetRotation);
-    bool sendPlantSeed(int row, int col, const std::string& seedType);
-    bool sendWaterPlant(int row, int col);
-    bool sendHarvest(int row, int col);
-    bool sendRemoveWeed(int row, int col);
-    bool sendAutoFarmStart();
-    bool sendAutoFarmStop();
-    bool sendAutoFarmStatus();
-    bool sendSwitchEquipment(const std::string& equipment);
-    bool sendSwitchCamera(const std::string& cameraMode);
-    
+    uint32_t maxInFlight() const { return m_maxInFlight; }
+
+    // 通用请求：json为请求的数据部分；callback为空时丢弃回复
+    std::future<FarmReply> request(uint32_t command, const std::string& json = "{}");
+    void request(uint32_t command, const std::string& json, ReplyCallback callback);
+
+    // 命令
+    std::future<FarmReply> sendGetState();
+    std::future<FarmReply> sendGetPlants();
+    std::future<FarmReply> sendMoveCart(int cartId, double targetX, double targetZ, double speed = 0.0);
+    std::future<FarmReply> sendRotateCart(int cartId, double targetRotation);
+    std::future<FarmReply> sendPlantSeed(int row, int col, const std::string& seedType);
+    std::future<FarmReply> sendWaterPlant(int row, int col);
+    std::future<FarmReply> sendHarvest(int row, int col);
+    std::future<FarmReply> sendRemoveWeed(int row, int col);
+    std::future<FarmReply> sendAutoFarmStart(int cartId, const std::string& seedType = "wheat");
+    std::future<FarmReply> sendAutoFarmStop(int cartId);
+    std::future<FarmReply> sendAutoFarmStatus(int cartId);
+    std::future<FarmReply> sendSwitchEquipment(const std::string& equipment);
+    std::future<FarmReply> sendSwitchCamera(const std::string& cameraMode);
+
+    // 订阅：立即发送，并在每次重连后重新发送
+    void addSubscription(uint32_t command, const std::string& json);
+    void clearSubscriptions();
+
     // 设置回调函数
     void setConnectCallback(ConnectCallback callback) { m_connectCallback = callback; }
     void setDisconnectCallback(DisconnectCallback callback) { m_disconnectCallback = callback; }
     void setStateUpdateCallback(StateUpdateCallback callback) { m_stateUpdateCallback = callback; }
-    void setPlantDataCallback(PlantDataCallback callback) { m_plantDataCallback = callback; }
     void setLogMessageCallback(LogMessageCallback callback) { m_logMessageCallback = callback; }
-    void setErrorCallback(ErrorCallback callback) { m_errorCallback = callback; }
-    
+    void setPushCallback(PushCallback callback) { m_pushCallback = callback; }
+
     // 获取最后的错误信息
-    std::string getLastError() const { return m_lastError; }
-    
+    std::string getLastError() const;
+
 private:
-    SOCKET m_socket;
+    socket_t m_socket;
     ClientConfig m_config;
-    ClientState m_state;
+    std::atomic<ClientState> m_state;
     std::string m_lastError;
-    
+    mutable std::mutex m_errorMutex;
+    uint32_t m_maxInFlight;
+    bool m_compressed;
+
     // 线程管理
     std::thread m_receiveThread;
-    std::thread m_reconnectThread;
-    bool m_shouldStop;
-    mutable std::mutex m_socketMutex;
-    
+    std::atomic<bool> m_shouldStop;
+    std::mutex m_stopMutex;
+    std::condition_variable m_stopCv;   // 打断重连等待
+
+    // 在途请求（受m_pendingMutex保护）
+    struct PendingRequest {
+        ReplyCallback callback;
+        std::vector<Packet> parts;
+    };
+    std::map<uint32_t, PendingRequest> m_pending;
+    uint32_t m_nextRequestId;
+    std::mutex m_pendingMutex;
+
+    // 写合并（受m_sendMutex保护）：m_outgoing积攒待发数据，m_flushing表示有线程在发送
+    std::string m_outgoing;
+    std::string m_sending;      // 只由正在发送的线程使用
+    bool m_flushing;
+    std::mutex m_sendMutex;
+    std::condition_variable m_flushDone;
+
+    // 订阅
+    std::vector<std::pair<uint32_t, std::string>> m_subscriptions;
+    std::mutex m_subscriptionMutex;
+
+    // 接收缓冲区（只由接收线程使用）
+    std::string m_input;
+    std::string m_fragments;    // 尚未收完的分片消息
+
     // 回调函数
     ConnectCallback m_connectCallback;
     DisconnectCallback m_disconnectCallback;
     StateUpdateCallback m_stateUpdateCallback;
-    PlantDataCallback m_plantDataCallback;
     LogMessageCallback m_logMessageCallback;
-    ErrorCallback m_errorCallback;
-    
+    PushCallback m_pushCallback;
+
     // 内部方法
     bool connectInternal();
+    bool handshake();
     void receiveLoop();
-    void reconnectLoop();
-    
-    bool sendPacket(const Packet& packet);
-    bool receivePacket(Packet& packet);
-    
-    void handleResponse(const Packet& packet);
-    void handleSuccess(const std::string& data);
-    void handleError(const std::string& data);
-    void handleStateUpdate(const std::string& data);
-    void handlePlantData(const std::string& data);
-    void handleLogMessage(const std::string& data);
-    
+    bool readFrames();
+    void dispatch(const Packet& packet);
+    void resubscribe();
+
+    bool sendFrame(const Packet& packet);
+    bool sendAll(socket_t socket, const std::string& data);
+    void failPending(const std::string& reason);
+
     void setError(const std::string& error);
     void cleanup();
-    
+
     // 禁止拷贝
     FarmClient(const FarmClient&) = delete;
     FarmClient& operator=(const FarmClient&) = delete;
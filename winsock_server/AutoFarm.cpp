@@ -0,0 +1,595 @@
+#include "AutoFarm.h"
+#include <sstream>
+#include <algorithm>
+
+// 空闲时复查条件索引的间隔
+static const uint64_t IDLE_RECHECK_MS = 1000;
+
+AutoFarmScheduler::AutoFarmScheduler(FarmField& field, ProfiledMutex& farmMutex,
+                                     CartMotionSystem& motion, TimerWheel& timers,
+                                     ResourceLedger& ledger)
+    : m_field(field), m_farmMutex(farmMutex), m_motion(motion), m_timers(timers),
+      m_ledger(ledger), m_assigner(m_planner) {
+}
+
+bool AutoFarmScheduler::start(int cartId, int ownerClientId, const AutoFarmOptions& options) {
+    if (cartId < 0 || options.speed <= 0) {
+        return false;
+    }
+
+    std::vector<StatusUpdate> updates;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Session& session = m_sessions[cartId];
+        if (session.enabled) {
+            m_timers.cancel(session.timer);
+            PROFILED_LOCK(farmLock, m_farmMutex);
+            releaseRoute(session);
+        }
+
+        session.cartId = cartId;
+        session.ownerClientId = ownerClientId;
+        session.enabled = true;
+        session.phase = AutoFarmPhase::IDLE;
+        session.options = options;
+        if (session.options.batchSize < 1) session.options.batchSize = 1;
+        session.stats = AutoFarmStats();
+
+        scheduleTimer(session, 0);
+        queueStatus(session, updates);
+    }
+    publish(updates);
+    return true;
+}
+
+bool AutoFarmScheduler::stop(int cartId) {
+    std::vector<StatusUpdate> updates;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_sessions.find(cartId);
+        if (it == m_sessions.end() || !it->second.enabled) {
+            return false;
+        }
+
+        Session& session = it->second;
+        m_timers.cancel(session.timer);
+        session.timer = INVALID_TIMER;
+        session.token++;
+        if (session.phase == AutoFarmPhase::MOVING) {
+            m_motion.stopCart(cartId);
+        }
+        {
+            PROFILED_LOCK(farmLock, m_farmMutex);
+            releaseRoute(session);
+        }
+        session.enabled = false;
+        session.phase = AutoFarmPhase::IDLE;
+        queueStatus(session, updates);
+    }
+    publish(updates);
+    return true;
+}
+
+void AutoFarmScheduler::stopAll() {
+    std::vector<int> carts;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& pair : m_sessions) {
+            if (pair.second.enabled) {
+                carts.push_back(pair.first);
+            }
+        }
+    }
+    for (int cartId : carts) {
+        stop(cartId);
+    }
+}
+
+std::string AutoFarmScheduler::statusJson(int cartId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(cartId);
+    if (it == m_sessions.end()) {
+        Session empty;
+        empty.cartId = cartId;
+        return buildStatus(empty);
+    }
+    return buildStatus(it->second);
+}
+
+std::string AutoFarmScheduler::fleetStatusJson() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream oss;
+    oss << "{\"carts\":[";
+    bool first = true;
+    for (const auto& pair : m_sessions) {
+        if (!first) oss << ",";
+        first = false;
+        oss << buildStatus(pair.second);
+    }
+    oss << "]}";
+    return oss.str();
+}
+
+size_t AutoFarmScheduler::activeSessions() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (const auto& pair : m_sessions) {
+        if (pair.second.enabled) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void AutoFarmScheduler::scheduleTimer(Session& session, uint64_t delayMs) {
+    m_timers.cancel(session.timer);
+    uint64_t token = ++session.token;
+    int cartId = session.cartId;
+    session.timer = m_timers.schedule(delayMs, [this, cartId, token]() {
+        onTimer(cartId, token);
+    });
+}
+
+void AutoFarmScheduler::onTimer(int cartId, uint64_t token) {
+    std::vector<StatusUpdate> updates;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_sessions.find(cartId);
+        if (it == m_sessions.end()) {
+            return;
+        }
+        Session& session = it->second;
+        if (!session.enabled || session.token != token) {
+            return;  // 已停止或被新的定时器取代
+        }
+        session.timer = INVALID_TIMER;
+
+        if (session.phase == AutoFarmPhase::MOVING) {
+            checkArrival(session, updates);
+        } else {
+            step(session, updates);
+        }
+    }
+    publish(updates);
+}
+
+// 选择下一个任务并下发移动
+void AutoFarmScheduler::step(Session& session, std::vector<StatusUpdate>& updates) {
+    session.stats.cycles++;
+
+    bool found = false;
+    double targetX = 0.0, targetZ = 0.0;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        found = nextTask(session, updates);
+        if (found) {
+            m_field.cellToWorld(session.current.row, session.current.col, targetX, targetZ);
+        }
+    }
+
+    if (!found) {
+        if (session.phase != AutoFarmPhase::IDLE) {
+            session.phase = AutoFarmPhase::IDLE;
+            queueStatus(session, updates);
+        }
+        scheduleTimer(session, IDLE_RECHECK_MS);
+        return;
+    }
+
+    uint32_t moveSeq = 0;
+    if (!m_motion.moveTo(session.cartId, targetX, targetZ, session.options.speed,
+                         DEFAULT_CART_TURN_RATE, &moveSeq)) {
+        // 小车编号超出范围，无法继续
+        session.stats.errors++;
+        {
+            PROFILED_LOCK(lock, m_farmMutex);
+            releaseRoute(session);
+        }
+        session.enabled = false;
+        session.phase = AutoFarmPhase::IDLE;
+        queueStatus(session, updates);
+        return;
+    }
+
+    session.moveSeq = moveSeq;
+    session.phase = AutoFarmPhase::MOVING;
+    queueStatus(session, updates);
+
+    double seconds = m_motion.estimateRemainingSeconds(session.cartId);
+    scheduleTimer(session, static_cast<uint64_t>(seconds * 1000.0) + 1);
+}
+
+// 预计到达时间到期：确认到达后执行操作
+void AutoFarmScheduler::checkArrival(Session& session, std::vector<StatusUpdate>& updates) {
+    CartSnapshot cart;
+    if (!m_motion.getCart(session.cartId, cart) || cart.moveSeq != session.moveSeq) {
+        // 被手动移动命令打断，放弃当前任务重新选择
+        if (session.hasTask) {
+            PROFILED_LOCK(lock, m_farmMutex);
+            release(session.current);
+            session.hasTask = false;
+        }
+        session.phase = AutoFarmPhase::IDLE;
+        step(session, updates);
+        return;
+    }
+
+    if (cart.moving) {
+        double seconds = m_motion.estimateRemainingSeconds(session.cartId);
+        scheduleTimer(session, static_cast<uint64_t>(seconds * 1000.0) + 1);
+        return;
+    }
+
+    uint64_t waitMs = 0;
+    if (!performTask(session, waitMs) && waitMs > 0) {
+        // 资源不足，让出已认领的任务，等待恢复
+        {
+            PROFILED_LOCK(lock, m_farmMutex);
+            releaseRoute(session);
+        }
+        session.phase = AutoFarmPhase::IDLE;
+        queueStatus(session, updates);
+        scheduleTimer(session, waitMs);
+        return;
+    }
+    session.phase = AutoFarmPhase::WORKING;
+    queueStatus(session, updates);
+    scheduleTimer(session, session.options.actionDelayMs);
+}
+
+// 在农田上执行当前任务（条件已变化时跳过）；资源不足时保留任务并在waitMs给出等待时间
+bool AutoFarmScheduler::performTask(Session& session, uint64_t& waitMs) {
+    waitMs = 0;
+    if (!session.hasTask) {
+        return false;
+    }
+
+    AutoFarmTask task = session.current;
+    TaskCharge cost;
+    LedgerResult charge = m_ledger.chargeTask(task.type, session.options.seedType, cost);
+    if (charge != LedgerResult::OK) {
+        double seconds = 0.0;
+        if (charge == LedgerResult::INSUFFICIENT_ENERGY) {
+            seconds = m_ledger.secondsUntil(m_ledger.taskCost(task.type));
+        }
+        waitMs = std::max(IDLE_RECHECK_MS, static_cast<uint64_t>(seconds * 1000.0) + 1);
+        return false;
+    }
+    session.hasTask = false;
+
+    FarmResult result;
+    HarvestResult harvest;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        double now = farmClockNow();
+        switch (task.type) {
+            case TaskType::HARVEST:
+                result = m_field.harvest(task.row, task.col, now, harvest);
+                break;
+            case TaskType::WEED_REMOVAL:
+                result = m_field.removeWeeds(task.row, task.col, now);
+                break;
+            case TaskType::WATERING:
+                result = m_field.water(task.row, task.col, now);
+                break;
+            case TaskType::PLANTING:
+                result = m_field.plantSeed(task.row, task.col, session.options.seedType, now);
+                break;
+            default:
+                result = FarmResult::NO_PLANT;
+                break;
+        }
+        // 成功时任务已随条件消失；失败则放回队列
+        release(task);
+    }
+
+    if (result != FarmResult::OK) {
+        m_ledger.refundTask(cost);
+        if (result == FarmResult::INVALID_POSITION) {
+            session.stats.errors++;
+        } else if (result == FarmResult::READ_ONLY) {
+            waitMs = IDLE_RECHECK_MS;   // 日志写盘失败，农田只读，空闲等待而不是反复重试
+        }
+        return false;
+    }
+
+    session.stats.tasksCompleted++;
+    switch (task.type) {
+        case TaskType::HARVEST:
+            session.stats.plantsHarvested++;
+            session.stats.coinsEarned += harvest.value;
+            m_ledger.addCoins(harvest.value, LedgerChange::HARVEST);
+            break;
+        case TaskType::WEED_REMOVAL:
+            session.stats.weedsRemoved++;
+            break;
+        case TaskType::WATERING:
+            session.stats.plantsWatered++;
+            break;
+        case TaskType::PLANTING:
+            session.stats.plantsPlanted++;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// 取下一个仍然有效的任务；有本车能做的更高优先级任务出现时放弃剩余路线（需持有农田锁）
+bool AutoFarmScheduler::nextTask(Session& session, std::vector<StatusUpdate>& updates) {
+    TaskQueue& queue = m_field.tasks();
+    if (!session.route.empty()) {
+        const QueuedTask* top = queue.top();
+        if (top && canPerform(session, top->type) &&
+            static_cast<int>(top->priority) < static_cast<int>(session.route.front().priority)) {
+            releaseRoute(session);
+        }
+    }
+
+    // 有新任务时先分配给各小车；路线上的任务全部失效时再分配一次
+    int plans = 0;
+    for (;;) {
+        if (plans < 2 && (session.route.empty() || (plans == 0 && queue.readyCount() > 0))) {
+            planFleet(session, updates);
+            plans++;
+        }
+        if (session.route.empty()) {
+            return false;
+        }
+
+        AutoFarmTask task = session.route.front();
+        session.route.pop_front();
+
+        // 条件消失时任务已从队列删除（例如被其他客户端处理）
+        if (queue.find(m_field.cellIndex(task.row, task.col), task.type)) {
+            session.current = task;
+            session.hasTask = true;
+            return true;
+        }
+    }
+}
+
+// 认领新任务并插入所有运行中小车的路线，路线有变化的小车推送状态（需持有农田锁）
+void AutoFarmScheduler::planFleet(Session& requester, std::vector<StatusUpdate>& updates) {
+    TaskQueue& queue = m_field.tasks();
+    if (!queue.top()) {
+        return;
+    }
+
+    if (m_planner.rows() != m_field.rows() || m_planner.cols() != m_field.cols()) {
+        m_planner.resize(m_field.rows(), m_field.cols());
+    }
+
+    // 已有路线上的任务也放进任务表，分配时只做插入
+    std::vector<Session*> sessions;
+    std::vector<AssignCart> carts;
+    std::vector<AssignTask> tasks;
+    std::vector<AutoFarmTask> claimed;
+    double reserved = 0.0;
+    size_t spare = 0;
+    uint32_t fleetMask = 0;
+
+    auto addTask = [&](const AutoFarmTask& task) {
+        AssignTask info;
+        info.pos = GridPos(task.row, task.col);
+        info.type = task.type;
+        info.priority = task.priority;
+        info.energy = m_ledger.taskCost(task.type);
+        tasks.push_back(info);
+        claimed.push_back(task);
+        return static_cast<int>(tasks.size() - 1);
+    };
+
+    for (auto& pair : m_sessions) {
+        Session& session = pair.second;
+        if (!session.enabled) {
+            continue;
+        }
+        AssignCart cart;
+        cart.id = session.cartId;
+        // 正在执行任务的小车从任务格子继续，该任务的能量尚未扣除
+        if (session.hasTask) {
+            cart.start = GridPos(session.current.row, session.current.col);
+            reserved += m_ledger.taskCost(session.current.type);
+        } else {
+            cart.start = cartCell(session.cartId);
+        }
+        cart.taskMask = session.options.taskMask;
+        cart.capacity = static_cast<size_t>(session.options.batchSize);
+        for (const AutoFarmTask& task : session.route) {
+            cart.route.push_back(addTask(task));
+        }
+        if (cart.route.size() < cart.capacity) {
+            spare += cart.capacity - cart.route.size();
+        }
+        fleetMask |= cart.taskMask;
+        sessions.push_back(&session);
+        carts.push_back(cart);
+    }
+    if (spare == 0) {
+        return;
+    }
+
+    // 按优先级认领，没有小车能做的任务跳过（暂时认领，结束后放回）
+    std::vector<int> pending;
+    std::vector<AutoFarmTask> skipped;
+    size_t scanLimit = spare * 4 + 64;
+    while (pending.size() < spare && pending.size() + skipped.size() < scanLimit) {
+        const QueuedTask* top = queue.top();
+        if (!top) {
+            break;
+        }
+        AutoFarmTask task;
+        task.type = top->type;
+        task.priority = top->priority;
+        task.row = top->cell / m_field.cols();
+        task.col = top->cell % m_field.cols();
+        queue.claim(top->cell, top->type);
+
+        if (fleetMask & (1u << static_cast<int>(task.type))) {
+            pending.push_back(addTask(task));
+        } else {
+            skipped.push_back(task);
+        }
+    }
+    for (const AutoFarmTask& task : skipped) {
+        release(task);
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    std::vector<std::vector<int>> before(carts.size());
+    for (size_t c = 0; c < carts.size(); c++) {
+        before[c] = carts[c].route;
+    }
+
+    AssignOptions options;
+    options.cellSize = m_field.cellSize();
+    options.moveEnergyPerMeter = m_ledger.moveCost(1.0);
+    options.energyBudget = m_ledger.energy() - reserved;
+    std::vector<int> unassigned;
+    m_assigner.assign(carts, tasks, pending, options, unassigned);
+    for (int task : unassigned) {
+        release(claimed[task]);
+    }
+
+    for (size_t c = 0; c < carts.size(); c++) {
+        if (carts[c].route == before[c]) {
+            continue;
+        }
+        Session& session = *sessions[c];
+        session.route.clear();
+        for (int task : carts[c].route) {
+            session.route.push_back(claimed[task]);
+        }
+        trimRoute(session, carts[c].start);
+
+        if (&session != &requester) {
+            // 空闲的小车立即开始新路线
+            if (session.phase == AutoFarmPhase::IDLE && !session.hasTask && !session.route.empty()) {
+                scheduleTimer(session, 0);
+            }
+            queueStatus(session, updates);
+        }
+    }
+}
+
+// 按路线估算时间线（能量恢复、种子、金币），截掉资源不够的部分（需持有农田锁）
+void AutoFarmScheduler::trimRoute(Session& session, GridPos from) {
+    std::vector<PlannedTask> plan;
+    plan.reserve(session.route.size());
+    GridPos previous = from;
+    for (const AutoFarmTask& task : session.route) {
+        GridPos target(task.row, task.col);
+        PlannedTask step;
+        step.type = task.type;
+        step.seed = session.options.seedType;
+        step.distance = PathPlanner::distance(previous, target) * m_field.cellSize();
+        step.seconds = step.distance / session.options.speed +
+                       session.options.actionDelayMs / 1000.0;
+        plan.push_back(step);
+        previous = target;
+    }
+
+    size_t affordable = m_ledger.evaluatePlan(plan).affordable;
+    while (session.route.size() > affordable) {
+        release(session.route.back());
+        session.route.pop_back();
+    }
+}
+
+// 释放路线上所有已认领的任务（需持有农田锁）
+void AutoFarmScheduler::releaseRoute(Session& session) {
+    for (const AutoFarmTask& task : session.route) {
+        release(task);
+    }
+    session.route.clear();
+    if (session.hasTask) {
+        release(session.current);
+        session.hasTask = false;
+    }
+}
+
+void AutoFarmScheduler::release(const AutoFarmTask& task) {
+    m_field.tasks().unclaim(m_field.cellIndex(task.row, task.col), task.type);
+}
+
+// 小车当前所在格子（小车尚未创建时视为原点）
+GridPos AutoFarmScheduler::cartCell(int cartId) const {
+    CartSnapshot cart;
+    double x = 0.0, z = 0.0;
+    if (m_motion.getCart(cartId, cart)) {
+        x = cart.x;
+        z = cart.z;
+    }
+    int row = 0, col = 0;
+    m_field.worldToCell(x, z, row, col);
+    row = std::max(0, std::min(row, m_field.rows() - 1));
+    col = std::max(0, std::min(col, m_field.cols() - 1));
+    return GridPos(row, col);
+}
+
+std::string AutoFarmScheduler::buildStatus(const Session& session) const {
+    std::ostringstream oss;
+    oss << "{\"cart_id\":" << session.cartId
+        << ",\"enabled\":" << (session.enabled ? "true" : "false")
+        << ",\"status\":\"" << autoFarmPhaseToString(session.phase) << "\""
+        << ",\"current_task\":";
+    if (session.hasTask) {
+        const AutoFarmTask& task = session.current;
+        oss << "{\"type\":\"" << taskTypeToString(task.type) << "\""
+            << ",\"target\":\"plant_" << task.row << "_" << task.col << "\""
+            << ",\"row\":" << task.row << ",\"col\":" << task.col
+            << ",\"priority\":\"" << taskPriorityToString(task.priority) << "\"}";
+    } else {
+        oss << "null";
+    }
+
+    const AutoFarmStats& stats = session.stats;
+    oss << ",\"queue_length\":" << session.route.size()
+        << ",\"plan\":[";
+    bool first = true;
+    for (const AutoFarmTask& task : session.route) {
+        if (!first) oss << ",";
+        first = false;
+        oss << "{\"type\":\"" << taskTypeToString(task.type) << "\""
+            << ",\"row\":" << task.row << ",\"col\":" << task.col
+            << ",\"priority\":\"" << taskPriorityToString(task.priority) << "\"}";
+    }
+    oss << "]"
+        << ",\"stats\":{\"cycles\":" << stats.cycles
+        << ",\"tasks_completed\":" << stats.tasksCompleted
+        << ",\"weeds_removed\":" << stats.weedsRemoved
+        << ",\"plants_harvested\":" << stats.plantsHarvested
+        << ",\"plants_watered\":" << stats.plantsWatered
+        << ",\"plants_planted\":" << stats.plantsPlanted
+        << ",\"coins_earned\":" << stats.coinsEarned
+        << ",\"errors\":" << stats.errors << "}}";
+    return oss.str();
+}
+
+void AutoFarmScheduler::queueStatus(const Session& session, std::vector<StatusUpdate>& updates) const {
+    if (session.ownerClientId >= 0) {
+        updates.push_back(StatusUpdate(session.ownerClientId, buildStatus(session)));
+    }
+}
+
+// 在调度器锁外推送状态
+void AutoFarmScheduler::publish(const std::vector<StatusUpdate>& updates) {
+    if (!m_statusCallback) {
+        return;
+    }
+    for (const StatusUpdate& update : updates) {
+        m_statusCallback(update.first, update.second);
+    }
+}
+
+std::string autoFarmPhaseToString(AutoFarmPhase phase) {
+    switch (phase) {
+        case AutoFarmPhase::IDLE: return "idle";
+        case AutoFarmPhase::MOVING: return "moving";
+        case AutoFarmPhase::WORKING: return "working";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,155 @@
+#ifndef AUTO_FARM_H
+#define AUTO_FARM_H
+
+#include "protocol.h"
+#include "FarmField.h"
+#include "CartMotion.h"
+#include "PathPlanner.h"
+#include "TimerWheel.h"
+#include "ResourceLedger.h"
+#include "TaskAssigner.h"
+#include "ProfiledMutex.h"
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <string>
+#include <functional>
+
+/**
+ * 自动化农场调度器 - AutoFarmController.run_cycle的C++实现
+ *
+ * 每辆小车一个会话，全部由时间轮驱动，没有独立线程也不轮询：
+ *   选任务 -> 下发移动 -> 预计到达时检查 -> 执行操作 -> 选下一个任务
+ * 任务来自农田的任务队列（与条件索引同步）。有新任务时由TaskAssigner为所有
+ * 运行中的小车一起分配：按绕开障碍的路程、剩余能量和装备拍卖，只把新任务插入
+ * 已有路线，不整体重排；有本车能做的更高优先级任务出现时放弃剩余路线。
+ * 多辆小车共享同一块农田，已被认领的任务不会再分给其他小车。
+ * 每次操作从资源账本扣费，能量不足时放弃路线，等恢复够了再继续。
+ */
+
+// 会话阶段
+enum class AutoFarmPhase {
+    IDLE,       // 没有任务，定期复查
+    MOVING,     // 正在前往目标格子
+    WORKING     // 执行操作后的作业时间
+};
+
+// 自动化任务
+struct AutoFarmTask {
+    TaskType type;
+    TaskPriority priority;
+    int row;
+    int col;
+
+    AutoFarmTask() : type(TaskType::HARVEST), priority(TaskPriority::LOW), row(0), col(0) {}
+};
+
+// 统计
+struct AutoFarmStats {
+    int cycles;
+    int tasksCompleted;
+    int weedsRemoved;
+    int plantsHarvested;
+    int plantsWatered;
+    int plantsPlanted;
+    int coinsEarned;
+    int errors;
+
+    AutoFarmStats()
+        : cycles(0), tasksCompleted(0), weedsRemoved(0), plantsHarvested(0),
+          plantsWatered(0), plantsPlanted(0), coinsEarned(0), errors(0) {}
+};
+
+// 启动参数
+struct AutoFarmOptions {
+    PlantType seedType;
+    double speed;
+    uint64_t actionDelayMs;     // 每次操作的作业时间
+    int batchSize;              // 路线最多容纳的任务数
+    uint32_t taskMask;          // 装备可执行的任务类型，1 << TaskType
+
+    AutoFarmOptions()
+        : seedType(PlantType::WHEAT), speed(DEFAULT_CART_SPEED),
+          actionDelayMs(200), batchSize(16), taskMask(0xFFFFFFFFu) {}
+};
+
+// 状态推送回调 (clientId, AUTO_STATUS JSON)
+using AutoStatusCallback = std::function<void(int clientId, const std::string& statusJson)>;
+
+class AutoFarmScheduler {
+public:
+    AutoFarmScheduler(FarmField& field, ProfiledMutex& farmMutex,
+                      CartMotionSystem& motion, TimerWheel& timers, ResourceLedger& ledger);
+
+    void setStatusCallback(AutoStatusCallback callback) { m_statusCallback = callback; }
+
+    // 启动/停止某辆小车的自动化，ownerClientId接收状态推送
+    bool start(int cartId, int ownerClientId, const AutoFarmOptions& options);
+    bool stop(int cartId);
+    void stopAll();
+
+    std::string statusJson(int cartId) const;
+    // 所有小车的状态和路线
+    std::string fleetStatusJson() const;
+    size_t activeSessions() const;
+
+private:
+    struct Session {
+        int cartId;
+        int ownerClientId;
+        bool enabled;
+        AutoFarmPhase phase;
+        AutoFarmOptions options;
+
+        bool hasTask;
+        AutoFarmTask current;
+        std::deque<AutoFarmTask> route;
+
+        uint32_t moveSeq;
+        uint64_t token;         // 定时器令牌，识别过期回调
+        TimerId timer;
+        AutoFarmStats stats;
+
+        Session() : cartId(0), ownerClientId(-1), enabled(false), phase(AutoFarmPhase::IDLE),
+                    hasTask(false), moveSeq(0), token(0), timer(INVALID_TIMER) {}
+    };
+
+    typedef std::pair<int, std::string> StatusUpdate;
+
+    FarmField& m_field;
+    ProfiledMutex& m_farmMutex;
+    CartMotionSystem& m_motion;
+    TimerWheel& m_timers;
+    ResourceLedger& m_ledger;
+    PathPlanner m_planner;
+    TaskAssigner m_assigner;
+
+    mutable std::mutex m_mutex;
+    std::map<int, Session> m_sessions;
+    AutoStatusCallback m_statusCallback;
+
+    void onTimer(int cartId, uint64_t token);
+    void step(Session& session, std::vector<StatusUpdate>& updates);
+    void checkArrival(Session& session, std::vector<StatusUpdate>& updates);
+    void scheduleTimer(Session& session, uint64_t delayMs);
+
+    bool nextTask(Session& session, std::vector<StatusUpdate>& updates);
+    void planFleet(Session& requester, std::vector<StatusUpdate>& updates);
+    void trimRoute(Session& session, GridPos from);
+    static bool canPerform(const Session& session, TaskType type) {
+        return (session.options.taskMask & (1u << static_cast<int>(type))) != 0;
+    }
+    void releaseRoute(Session& session);
+    void release(const AutoFarmTask& task);
+    bool performTask(Session& session, uint64_t& waitMs);
+    GridPos cartCell(int cartId) const;
+
+    std::string buildStatus(const Session& session) const;
+    void queueStatus(const Session& session, std::vector<StatusUpdate>& updates) const;
+    void publish(const std::vector<StatusUpdate>& updates);
+};
+
+std::string autoFarmPhaseToString(AutoFarmPhase phase);
+
+#endif // AUTO_FARM_H
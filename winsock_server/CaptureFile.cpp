@@ -0,0 +1,182 @@
+#include "CaptureFile.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+static const uint32_t CAPTURE_MAGIC = 0x50414346;     // "FCAP"
+static const uint16_t CAPTURE_VERSION = 2;
+static const size_t FILE_HEADER_SIZE = 64;
+static const size_t RECORD_HEADER_SIZE = 28;
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+template <typename T>
+static inline void putValue(char*& p, T value) {
+    memcpy(p, &value, sizeof(value));
+    p += sizeof(value);
+}
+
+template <typename T>
+static inline T getValue(const char*& p) {
+    T value;
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return value;
+}
+
+std::string captureSnapshotPath(const std::string& capturePath) {
+    return capturePath + ".snapshot";
+}
+
+CaptureWriter::CaptureWriter()
+    : m_file(nullptr), m_open(false), m_records(0) {
+}
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+bool CaptureWriter::open(const std::string& path, int rows, int cols, const CaptureOrigin& origin,
+                         std::string& error) {
+    close();
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        error = "Cannot create " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    // 全缓冲，每个包只是一次内存拷贝
+    std::setvbuf(file, nullptr, _IOFBF, WRITE_BUFFER_SIZE);
+
+    char header[FILE_HEADER_SIZE] = {};
+    char* p = header;
+    putValue<uint32_t>(p, CAPTURE_MAGIC);
+    putValue<uint16_t>(p, CAPTURE_VERSION);
+    putValue<uint16_t>(p, 0);
+    putValue<int32_t>(p, rows);
+    putValue<int32_t>(p, cols);
+    putValue<int64_t>(p, static_cast<int64_t>(time(nullptr)));
+    putValue<double>(p, origin.farmClock);
+    putValue<double>(p, origin.energy);
+    putValue<double>(p, origin.maxEnergy);
+    putValue<double>(p, origin.energyRegen);
+    if (std::fwrite(header, sizeof(header), 1, file) != 1) {
+        error = "Cannot write " + path + ": " + std::strerror(errno);
+        std::fclose(file);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file = file;
+    m_records = 0;
+    m_started = std::chrono::steady_clock::now();
+    m_open.store(true, std::memory_order_release);
+    return true;
+}
+
+void CaptureWriter::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) {
+        return;
+    }
+    m_open.store(false, std::memory_order_release);
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void CaptureWriter::record(int clientId, const Packet& packet) {
+    char header[RECORD_HEADER_SIZE];
+    char* p = header;
+    uint32_t length = static_cast<uint32_t>(packet.data.size());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file) {
+        return;
+    }
+    // 时间戳在锁内取，文件中的记录按时间有序
+    uint64_t offsetUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - m_started).count());
+    putValue<uint64_t>(p, offsetUs);
+    putValue<int32_t>(p, clientId);
+    putValue<uint32_t>(p, packet.header.command);
+    putValue<uint32_t>(p, packet.ext.requestId);
+    putValue<uint32_t>(p, packet.ext.flags);
+    putValue<uint32_t>(p, length);
+    std::fwrite(header, sizeof(header), 1, m_file);
+    if (length > 0) {
+        std::fwrite(packet.data.data(), 1, length, m_file);
+    }
+    m_records.fetch_add(1, std::memory_order_relaxed);
+}
+
+CaptureReader::CaptureReader()
+    : m_file(nullptr), m_rows(0), m_cols(0), m_startTime(0) {
+}
+
+CaptureReader::~CaptureReader() {
+    close();
+}
+
+bool CaptureReader::open(const std::string& path, std::string& error) {
+    close();
+
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "Cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    char header[FILE_HEADER_SIZE];
+    if (std::fread(header, sizeof(header), 1, file) != 1) {
+        error = path + " is truncated";
+        std::fclose(file);
+        return false;
+    }
+    const char* p = header;
+    uint32_t magic = getValue<uint32_t>(p);
+    uint16_t version = getValue<uint16_t>(p);
+    getValue<uint16_t>(p);
+    int32_t rows = getValue<int32_t>(p);
+    int32_t cols = getValue<int32_t>(p);
+    if (magic != CAPTURE_MAGIC || version != CAPTURE_VERSION) {
+        error = path + " is not a capture file (version " + std::to_string(CAPTURE_VERSION) + ")";
+        std::fclose(file);
+        return false;
+    }
+    m_file = file;
+    m_rows = rows;
+    m_cols = cols;
+    m_startTime = getValue<int64_t>(p);
+    m_origin.farmClock = getValue<double>(p);
+    m_origin.energy = getValue<double>(p);
+    m_origin.maxEnergy = getValue<double>(p);
+    m_origin.energyRegen = getValue<double>(p);
+    return true;
+}
+
+void CaptureReader::close() {
+    if (m_file) {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool CaptureReader::next(CaptureRecord& record) {
+    if (!m_file) {
+        return false;
+    }
+    char header[RECORD_HEADER_SIZE];
+    if (std::fread(header, sizeof(header), 1, m_file) != 1) {
+        return false;
+    }
+    const char* p = header;
+    record.offsetUs = getValue<uint64_t>(p);
+    record.clientId = getValue<int32_t>(p);
+    record.command = getValue<uint32_t>(p);
+    record.requestId = getValue<uint32_t>(p);
+    record.flags = getValue<uint32_t>(p);
+    uint32_t length = getValue<uint32_t>(p);
+    if (length > MAX_MESSAGE_SIZE) {
+        return false;   // 损坏的记录，当作文件结束
+    }
+    record.data.resize(length);
+    return length == 0 || std::fread(&record.data[0], 1, length, m_file) == length;
+}
@@ -0,0 +1,107 @@
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include "protocol.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+/**
+ * 收到的请求的抓包文件（二进制，只追加）
+ *
+ * 文件头 [magic "FCAP" u32][版本 u16][保留 u16][行数 i32][列数 i32][开始时间 i64]
+ *        [农田时钟 f64][能量 f64][能量上限 f64][恢复速率 f64][保留 u64]，
+ * 随后每个包一条记录：
+ *   [相对开始的微秒 u64][客户端ID i32][命令 u32][请求ID u32][标志 u32][长度 u32][数据]
+ * 整数均为小端。行列数是录制时的农田尺寸，回放时按它建农田。
+ *
+ * 开始录制时服务器把当时的农田（地块、账本、小车、日志序号）写成快照
+ * captureSnapshotPath(path)，能量不在快照里，放在文件头。回放先恢复快照，
+ * 再把农田时钟从文件头的时钟起按记录的时间戳推进。
+ *
+ * 读线程收到完整的包后立即record（解压、拼帧之后），多个连接共用一个带缓冲的
+ * 文件，写入只在内存中追加；进程崩溃时最后一段缓冲可能丢失，读取时截断的
+ * 末尾记录被忽略。bench/farm_replay读取文件，把包按原来的节奏或尽快重新
+ * 交给服务器处理。
+ */
+
+// 录制开始时的农田时钟和能量
+struct CaptureOrigin {
+    double farmClock;       // farmClockNow()
+    double energy;
+    double maxEnergy;
+    double energyRegen;
+
+    CaptureOrigin() : farmClock(0.0), energy(0.0), maxEnergy(0.0), energyRegen(0.0) {}
+};
+
+// 抓包对应的起始快照
+std::string captureSnapshotPath(const std::string& capturePath);
+
+struct CaptureRecord {
+    uint64_t offsetUs;      // 相对录制开始
+    int32_t clientId;
+    uint32_t command;
+    uint32_t requestId;
+    uint32_t flags;
+    std::string data;
+
+    CaptureRecord() : offsetUs(0), clientId(0), command(0), requestId(0), flags(0) {}
+};
+
+class CaptureWriter {
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool open(const std::string& path, int rows, int cols, const CaptureOrigin& origin,
+              std::string& error);
+    void close();
+    bool isOpen() const { return m_open.load(std::memory_order_acquire); }
+
+    // 记录一个收到的包（线程安全）
+    void record(int clientId, const Packet& packet);
+    uint64_t recordCount() const { return m_records.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex m_mutex;
+    FILE* m_file;
+    std::atomic<bool> m_open;
+    std::atomic<uint64_t> m_records;
+    std::chrono::steady_clock::time_point m_started;
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+};
+
+class CaptureReader {
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+    int64_t startTime() const { return m_startTime; }   // 录制开始的Unix时间（秒）
+    const CaptureOrigin& origin() const { return m_origin; }
+
+    // 读下一条记录；文件结束或末尾记录不完整时返回false
+    bool next(CaptureRecord& record);
+
+private:
+    FILE* m_file;
+    int m_rows;
+    int m_cols;
+    int64_t m_startTime;
+    CaptureOrigin m_origin;
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+};
+
+#endif // CAPTURE_FILE_H
@@ -0,0 +1,390 @@
+#include "CartMotion.h"
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// 到达判定阈值
+static const double POSITION_EPSILON = 1e-4;
+static const double ANGLE_EPSILON = 1e-3;
+
+// 将角度标准化到 [-180, 180] 范围
+double normalizeAngle(double angle) {
+    angle = std::fmod(angle, 360.0);
+    if (angle > 180.0) angle -= 360.0;
+    if (angle < -180.0) angle += 360.0;
+    return angle;
+}
+
+// 计算从点1到点2的角度（度数）
+double angleTo(double fromX, double fromZ, double toX, double toZ) {
+    return std::atan2(toZ - fromZ, toX - fromX) * 180.0 / M_PI;
+}
+
+CartMotionSystem::CartMotionSystem()
+    : m_tickSeconds(1.0 / 60.0), m_maxCarts(4096) {
+}
+
+void CartMotionSystem::configure(double tickSeconds, int maxCarts) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tickSeconds = tickSeconds > 0 ? tickSeconds : 1.0 / 60.0;
+    m_maxCarts = maxCarts > 0 ? maxCarts : 1;
+}
+
+CartState* CartMotionSystem::ensureCart(int cartId) {
+    if (cartId < 0 || cartId >= m_maxCarts) {
+        return nullptr;
+    }
+    if ((size_t)cartId >= m_carts.size()) {
+        m_carts.resize(cartId + 1);
+    }
+    CartState& cart = m_carts[cartId];
+    if (!cart.exists) {
+        cart.exists = true;
+        cart.cartId = cartId;
+    }
+    return &cart;
+}
+
+void CartMotionSystem::activate(CartState& cart) {
+    if (!cart.active) {
+        cart.active = true;
+        m_active.push_back(cart.cartId);
+    }
+}
+
+void CartMotionSystem::markDirty(CartState& cart) {
+    if (!cart.dirty) {
+        cart.dirty = true;
+        m_dirty.push_back(cart.cartId);
+    }
+}
+
+bool CartMotionSystem::moveTo(int cartId, double targetX, double targetZ,
+                              double maxSpeed, double turnRate, uint32_t* moveSeq) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CartState* cart = ensureCart(cartId);
+    if (!cart || maxSpeed <= 0 || turnRate <= 0) {
+        return false;
+    }
+
+    cart->path.clear();
+    cart->pathNext = 0;
+    cart->maxSpeed = maxSpeed;
+    cart->turnRate = turnRate;
+    setMoveTarget(*cart, targetX, targetZ);
+
+    activate(*cart);
+    cart->moveSeq++;
+    if (moveSeq) *moveSeq = cart->moveSeq;
+    return true;
+}
+
+bool CartMotionSystem::followPath(int cartId, const std::vector<std::pair<double, double>>& points,
+                                  double maxSpeed, double turnRate, uint32_t* moveSeq) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CartState* cart = ensureCart(cartId);
+    if (!cart || points.empty() || maxSpeed <= 0 || turnRate <= 0) {
+        return false;
+    }
+
+    cart->path = points;
+    cart->pathNext = 1;
+    cart->maxSpeed = maxSpeed;
+    cart->turnRate = turnRate;
+    setMoveTarget(*cart, points[0].first, points[0].second);
+
+    activate(*cart);
+    cart->moveSeq++;
+    if (moveSeq) *moveSeq = cart->moveSeq;
+    return true;
+}
+
+// 设置直线移动目标并进入转向阶段
+void CartMotionSystem::setMoveTarget(CartState& cart, double targetX, double targetZ) {
+    cart.targetX = targetX;
+    cart.targetZ = targetZ;
+    cart.hasMoveTarget = true;
+
+    double dx = targetX - cart.x;
+    double dz = targetZ - cart.z;
+    if (std::sqrt(dx * dx + dz * dz) > POSITION_EPSILON) {
+        cart.targetRotation = normalizeAngle(angleTo(cart.x, cart.z, targetX, targetZ));
+    } else {
+        cart.targetRotation = cart.rotation;
+    }
+    cart.phase = CartPhase::ROTATING;
+}
+
+bool CartMotionSystem::rotateTo(int cartId, double targetRotation, double turnRate,
+                                uint32_t* moveSeq) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CartState* cart = ensureCart(cartId);
+    if (!cart || turnRate <= 0) {
+        return false;
+    }
+
+    cart->targetRotation = normalizeAngle(targetRotation);
+    cart->hasMoveTarget = false;
+    cart->path.clear();
+    cart->turnRate = turnRate;
+    cart->speed = 0.0;
+
+    activate(*cart);
+    cart->phase = CartPhase::ROTATING;
+    cart->moveSeq++;
+    if (moveSeq) *moveSeq = cart->moveSeq;
+    return true;
+}
+
+bool CartMotionSystem::stopCart(int cartId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (cartId < 0 || (size_t)cartId >= m_carts.size() || !m_carts[cartId].exists) {
+        return false;
+    }
+
+    CartState& cart = m_carts[cartId];
+    if (cart.phase != CartPhase::IDLE) {
+        // 从活动列表中移除由tick负责（phase为IDLE的会被剔除）
+        cart.phase = CartPhase::IDLE;
+        cart.hasMoveTarget = false;
+        cart.path.clear();
+        cart.speed = 0.0;
+        cart.moveSeq++;
+        markDirty(cart);
+    }
+    return true;
+}
+
+double CartMotionSystem::estimateRemainingSeconds(int cartId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (cartId < 0 || (size_t)cartId >= m_carts.size() || !m_carts[cartId].exists) {
+        return 0.0;
+    }
+
+    const CartState& cart = m_carts[cartId];
+    double seconds = 0.0;
+    if (cart.phase == CartPhase::ROTATING) {
+        seconds += std::fabs(normalizeAngle(cart.targetRotation - cart.rotation)) / cart.turnRate;
+    }
+    if (cart.hasMoveTarget) {
+        double dx = cart.targetX - cart.x;
+        double dz = cart.targetZ - cart.z;
+        seconds += std::sqrt(dx * dx + dz * dz) / cart.maxSpeed;
+    }
+    // 剩余路径段：直线时间加每个转折点的转向时间
+    double x = cart.targetX, z = cart.targetZ;
+    double heading = cart.targetRotation;
+    for (size_t i = cart.pathNext; i < cart.path.size(); i++) {
+        double dx = cart.path[i].first - x;
+        double dz = cart.path[i].second - z;
+        double length = std::sqrt(dx * dx + dz * dz);
+        if (length > POSITION_EPSILON) {
+            double next = angleTo(x, z, cart.path[i].first, cart.path[i].second);
+            seconds += std::fabs(normalizeAngle(next - heading)) / cart.turnRate + length / cart.maxSpeed;
+            heading = next;
+        }
+        x = cart.path[i].first;
+        z = cart.path[i].second;
+    }
+    // 积分按整tick推进，再加一个tick的余量
+    return seconds + m_tickSeconds;
+}
+
+bool CartMotionSystem::integrate(CartState& cart, double dt) {
+    if (cart.phase == CartPhase::ROTATING) {
+        double diff = normalizeAngle(cart.targetRotation - cart.rotation);
+        double step = cart.turnRate * dt;
+        if (std::fabs(diff) <= step + ANGLE_EPSILON) {
+            cart.rotation = cart.targetRotation;
+            cart.phase = cart.hasMoveTarget ? CartPhase::MOVING : CartPhase::IDLE;
+        } else {
+            cart.rotation = normalizeAngle(cart.rotation + (diff > 0 ? step : -step));
+        }
+        return cart.phase != CartPhase::IDLE;
+    }
+
+    if (cart.phase == CartPhase::MOVING) {
+        double dx = cart.targetX - cart.x;
+        double dz = cart.targetZ - cart.z;
+        double distance = std::sqrt(dx * dx + dz * dz);
+        double step = cart.maxSpeed * dt;
+
+        if (distance <= step + POSITION_EPSILON) {
+            // 到达精确位置
+            cart.x = cart.targetX;
+            cart.z = cart.targetZ;
+            if (cart.pathNext < cart.path.size()) {
+                // 前往下一个路径点
+                const std::pair<double, double>& next = cart.path[cart.pathNext++];
+                setMoveTarget(cart, next.first, next.second);
+                return true;
+            }
+            cart.path.clear();
+            cart.speed = 0.0;
+            cart.hasMoveTarget = false;
+            cart.phase = CartPhase::IDLE;
+            return false;
+        }
+
+        cart.x += dx / distance * step;
+        cart.z += dz / distance * step;
+        cart.speed = cart.maxSpeed;
+        return true;
+    }
+
+    return false;
+}
+
+void CartMotionSystem::tick() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // 只遍历运动中的小车，静止小车不消耗时间
+    size_t i = 0;
+    while (i < m_active.size()) {
+        CartState& cart = m_carts[m_active[i]];
+
+        cart.prevX = cart.x;
+        cart.prevZ = cart.z;
+        cart.prevRotation = cart.rotation;
+
+        bool stillActive = cart.phase != CartPhase::IDLE && integrate(cart, m_tickSeconds);
+        markDirty(cart);
+
+        if (stillActive) {
+            i++;
+        } else {
+            // 交换删除
+            cart.active = false;
+            m_active[i] = m_active.back();
+            m_active.pop_back();
+        }
+    }
+}
+
+bool CartMotionSystem::getCart(int cartId, CartSnapshot& snapshot) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (cartId < 0 || (size_t)cartId >= m_carts.size() || !m_carts[cartId].exists) {
+        return false;
+    }
+
+    const CartState& cart = m_carts[cartId];
+    snapshot.cartId = cart.cartId;
+    snapshot.x = cart.x;
+    snapshot.z = cart.z;
+    snapshot.rotation = cart.rotation;
+    snapshot.speed = cart.speed;
+    snapshot.moving = cart.phase != CartPhase::IDLE;
+    snapshot.moveSeq = cart.moveSeq;
+    return true;
+}
+
+void CartMotionSystem::listCarts(std::vector<CartSnapshot>& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out.clear();
+    for (const CartState& cart : m_carts) {
+        if (!cart.exists) {
+            continue;
+        }
+        CartSnapshot snapshot;
+        snapshot.cartId = cart.cartId;
+        snapshot.x = cart.x;
+        snapshot.z = cart.z;
+        snapshot.rotation = cart.rotation;
+        snapshot.speed = cart.speed;
+        snapshot.moving = cart.phase != CartPhase::IDLE;
+        snapshot.moveSeq = cart.moveSeq;
+        out.push_back(snapshot);
+    }
+}
+
+bool CartMotionSystem::placeCart(int cartId, double x, double z, double rotation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CartState* cart = ensureCart(cartId);
+    if (!cart) {
+        return false;
+    }
+    cart->x = cart->prevX = x;
+    cart->z = cart->prevZ = z;
+    cart->rotation = cart->prevRotation = rotation;
+    cart->speed = 0.0;
+    cart->phase = CartPhase::IDLE;
+    cart->hasMoveTarget = false;
+    cart->path.clear();
+    markDirty(*cart);
+    return true;
+}
+
+size_t CartMotionSystem::activeCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_active.size();
+}
+
+size_t CartMotionSystem::collectUpdates(double alpha, size_t maxBytes,
+                                        std::vector<std::string>& payloads) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_dirty.empty()) {
+        return 0;
+    }
+
+    if (alpha < 0.0) alpha = 0.0;
+    if (alpha > 1.0) alpha = 1.0;
+
+    std::string head = "{\"timestamp\":" + std::to_string(time(nullptr)) + ",\"carts\":[";
+    const char tail[] = "]}";
+    size_t count = 0;
+    size_t carts = 0;   // 当前推送中的小车数
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3);
+    for (int cartId : m_dirty) {
+        CartState& cart = m_carts[cartId];
+        cart.dirty = false;
+
+        bool moving = cart.phase != CartPhase::IDLE;
+
+        // 运动中的小车在上一tick与当前tick之间插值，静止小车直接使用最终位置
+        double x = cart.x;
+        double z = cart.z;
+        double rotation = cart.rotation;
+        if (moving) {
+            x = cart.prevX + (cart.x - cart.prevX) * alpha;
+            z = cart.prevZ + (cart.z - cart.prevZ) * alpha;
+            rotation = normalizeAngle(cart.prevRotation +
+                                      normalizeAngle(cart.rotation - cart.prevRotation) * alpha);
+        }
+
+        oss.str("");
+        oss << "{\"cart_id\":" << cart.cartId
+            << ",\"x\":" << x
+            << ",\"z\":" << z
+            << ",\"rotation\":" << rotation
+            << ",\"speed\":" << cart.speed
+            << ",\"moving\":" << (moving ? "true" : "false") << "}";
+        std::string entry = oss.str();
+
+        // 放不下时结束当前推送，另起一个
+        if (carts > 0 && payloads[count - 1].size() + 1 + entry.size() + sizeof(tail) - 1 > maxBytes) {
+            payloads[count - 1] += tail;
+            carts = 0;
+        }
+        if (carts == 0) {
+            if (payloads.size() <= count) {
+                payloads.push_back(std::string());
+            }
+            payloads[count++] = head;
+        } else {
+            payloads[count - 1] += ",";
+        }
+        payloads[count - 1] += entry;
+        carts++;
+    }
+    payloads[count - 1] += tail;
+
+    m_dirty.clear();
+    return count;
+}
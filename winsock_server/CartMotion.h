@@ -0,0 +1,139 @@
+#ifndef CART_MOTION_H
+#define CART_MOTION_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstdint>
+#include <utility>
+
+/**
+ * 小车运动子系统
+ *
+ * 以固定步长积分所有小车的位置和朝向，取代每次移动一个sleep线程的做法。
+ * 推送频率与积分频率无关：推送时在上一tick与当前tick之间插值。
+ */
+
+// 默认运动参数（与cart_movement_api.py保持一致）
+#define DEFAULT_CART_SPEED      3.0     // 米/秒
+#define DEFAULT_CART_TURN_RATE  180.0   // 度/秒
+
+// 小车运动阶段
+enum class CartPhase {
+    IDLE,
+    ROTATING,
+    MOVING
+};
+
+// 小车运动状态
+struct CartState {
+    int cartId;
+    bool exists;
+
+    // 当前tick状态
+    double x;
+    double z;
+    double rotation;    // 度，[-180, 180]
+    double speed;       // 当前线速度
+
+    // 上一tick状态（用于插值）
+    double prevX;
+    double prevZ;
+    double prevRotation;
+
+    // 运动目标
+    double targetX;
+    double targetZ;
+    double targetRotation;
+    bool hasMoveTarget;
+
+    // 路径跟随：到达当前目标后依次前往后续路径点
+    std::vector<std::pair<double, double>> path;
+    size_t pathNext;
+
+    // 速度限制（来自命令）
+    double maxSpeed;
+    double turnRate;
+
+    CartPhase phase;
+    uint32_t moveSeq;   // 每次新命令递增，用于识别完成事件
+    bool active;        // 是否在活动列表中
+    bool dirty;         // 自上次推送后有变化
+
+    CartState()
+        : cartId(-1), exists(false), x(0), z(0), rotation(0), speed(0),
+          prevX(0), prevZ(0), prevRotation(0),
+          targetX(0), targetZ(0), targetRotation(0), hasMoveTarget(false),
+          pathNext(0), maxSpeed(DEFAULT_CART_SPEED), turnRate(DEFAULT_CART_TURN_RATE),
+          phase(CartPhase::IDLE), moveSeq(0), active(false), dirty(false) {}
+};
+
+// 小车状态快照（对外）
+struct CartSnapshot {
+    int cartId;
+    double x;
+    double z;
+    double rotation;
+    double speed;
+    bool moving;
+    uint32_t moveSeq;
+
+    CartSnapshot() : cartId(-1), x(0), z(0), rotation(0), speed(0), moving(false), moveSeq(0) {}
+};
+
+class CartMotionSystem {
+public:
+    CartMotionSystem();
+
+    // 配置固定步长和小车数量上限
+    void configure(double tickSeconds, int maxCarts);
+    double tickSeconds() const { return m_tickSeconds; }
+
+    // 运动命令（先转向目标方向，再直线移动），成功时返回命令序号
+    bool moveTo(int cartId, double targetX, double targetZ, double maxSpeed, double turnRate,
+                uint32_t* moveSeq = nullptr);
+    // 依次经过points中的每个点（世界坐标），每段同样先转向再直线移动
+    bool followPath(int cartId, const std::vector<std::pair<double, double>>& points,
+                    double maxSpeed, double turnRate, uint32_t* moveSeq = nullptr);
+    bool rotateTo(int cartId, double targetRotation, double turnRate, uint32_t* moveSeq = nullptr);
+    bool stopCart(int cartId);
+
+    // 按速度限制估算完成当前命令还需的秒数（用于调度完成事件）
+    double estimateRemainingSeconds(int cartId) const;
+
+    // 推进一个固定步长
+    void tick();
+
+    // 查询小车状态
+    bool getCart(int cartId, CartSnapshot& snapshot) const;
+    size_t activeCount() const;
+
+    // 所有小车的当前状态（写入农田快照），以及从快照放回静止的小车
+    void listCarts(std::vector<CartSnapshot>& out) const;
+    bool placeCart(int cartId, double x, double z, double rotation);
+
+    // 收集有变化的小车，alpha为上一tick到当前tick的插值系数
+    // 每个推送的JSON不超过maxBytes，小车多时分成多个写入payloads（复用其中的字符串），
+    // 返回推送个数；没有变化时返回0
+    size_t collectUpdates(double alpha, size_t maxBytes, std::vector<std::string>& payloads);
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<CartState> m_carts;     // 按cartId索引
+    std::vector<int> m_active;          // 正在运动的小车
+    std::vector<int> m_dirty;           // 待推送的小车
+    double m_tickSeconds;
+    int m_maxCarts;
+
+    CartState* ensureCart(int cartId);
+    void activate(CartState& cart);
+    void markDirty(CartState& cart);
+    bool integrate(CartState& cart, double dt);  // 返回是否仍在运动
+    void setMoveTarget(CartState& cart, double targetX, double targetZ);
+};
+
+// 角度工具
+double normalizeAngle(double angle);
+double angleTo(double fromX, double fromZ, double toX, double toZ);
+
+#endif // CART_MOTION_H
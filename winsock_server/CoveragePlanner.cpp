@@ -0,0 +1,403 @@
+#include "CoveragePlanner.h"
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+
+CoveragePlanner::CoveragePlanner(const PathPlanner& planner)
+    : m_planner(planner), m_alongRows(true) {
+}
+
+// 八方向距离，作为区域入口远近的估计
+static double octileDistance(GridPos a, GridPos b) {
+    int dr = std::abs(a.row - b.row);
+    int dc = std::abs(a.col - b.col);
+    return (std::sqrt(2.0) - 1.0) * std::min(dr, dc) + std::max(dr, dc);
+}
+
+size_t CoveragePlanner::countRuns(bool alongRows) {
+    m_alongRows = alongRows;
+    size_t count = 0;
+    for (int lane = 0; lane < laneCount(); lane++) {
+        bool inRun = false;
+        for (int pos = 0; pos < laneLength(); pos++) {
+            bool free = isFree(lane, pos);
+            if (free && !inRun) {
+                count++;
+            }
+            inRun = free;
+        }
+    }
+    return count;
+}
+
+void CoveragePlanner::decompose() {
+    m_runs.clear();
+    m_regions.clear();
+
+    int lanes = laneCount();
+    int length = laneLength();
+    std::vector<size_t> laneStart(static_cast<size_t>(lanes) + 1, 0);
+    for (int lane = 0; lane < lanes; lane++) {
+        laneStart[lane] = m_runs.size();
+        int pos = 0;
+        while (pos < length) {
+            if (!isFree(lane, pos)) {
+                pos++;
+                continue;
+            }
+            Run run;
+            run.lane = lane;
+            run.begin = pos;
+            while (pos < length && isFree(lane, pos)) {
+                pos++;
+            }
+            run.end = pos - 1;
+            run.region = -1;
+            m_runs.push_back(run);
+        }
+    }
+    laneStart[lanes] = m_runs.size();
+
+    // 相邻扫描线上互相重叠的段对，以及每段向上/向下的重叠数
+    std::vector<int> upCount(m_runs.size(), 0);
+    std::vector<int> downCount(m_runs.size(), 0);
+    std::vector<int> upRun(m_runs.size(), -1);
+    std::vector<std::pair<int, int>> links;
+    for (int lane = 1; lane < lanes; lane++) {
+        size_t i = laneStart[lane - 1];
+        size_t j = laneStart[lane];
+        while (i < laneStart[lane] && j < laneStart[lane + 1]) {
+            const Run& upper = m_runs[i];
+            const Run& lower = m_runs[j];
+            if (upper.begin <= lower.end && lower.begin <= upper.end) {
+                downCount[i]++;
+                upCount[j]++;
+                upRun[j] = static_cast<int>(i);
+                links.push_back(std::make_pair(static_cast<int>(i), static_cast<int>(j)));
+            }
+            if (upper.end < lower.end) {
+                i++;
+            } else {
+                j++;
+            }
+        }
+    }
+
+    // 一一相连的段延续上一条扫描线的区域，分叉/合并处开始新区域
+    for (size_t r = 0; r < m_runs.size(); r++) {
+        Run& run = m_runs[r];
+        int above = upRun[r];
+        if (upCount[r] == 1 && downCount[above] == 1) {
+            run.region = m_runs[above].region;
+        } else {
+            run.region = static_cast<int>(m_regions.size());
+            m_regions.push_back(Region());
+        }
+        Region& region = m_regions[run.region];
+        region.runs.push_back(static_cast<int>(r));
+        region.cellCount += static_cast<size_t>(run.end - run.begin + 1);
+    }
+
+    for (const auto& link : links) {
+        int a = m_runs[link.first].region;
+        int b = m_runs[link.second].region;
+        if (a != b) {
+            m_regions[a].neighbors.push_back(b);
+            m_regions[b].neighbors.push_back(a);
+        }
+    }
+    for (Region& region : m_regions) {
+        std::sort(region.neighbors.begin(), region.neighbors.end());
+        region.neighbors.erase(std::unique(region.neighbors.begin(), region.neighbors.end()),
+                               region.neighbors.end());
+    }
+}
+
+void CoveragePlanner::regionEnds(const Region& region, bool fromFirst, bool fromLow,
+                                 GridPos& entry, GridPos& exit) const {
+    const Run& first = m_runs[fromFirst ? region.runs.front() : region.runs.back()];
+    const Run& last = m_runs[fromFirst ? region.runs.back() : region.runs.front()];
+    entry = toGrid(first.lane, fromLow ? first.begin : first.end);
+    // 每条扫描线换一次方向
+    bool exitHigh = (region.runs.size() % 2 == 1) == fromLow;
+    exit = toGrid(last.lane, exitHigh ? last.end : last.begin);
+}
+
+// 区域内Z字形往返；调用前小车已在入口
+void CoveragePlanner::sweepRegion(const Region& region, bool fromFirst, bool fromLow,
+                                  std::vector<CoverageWaypoint>& out) const {
+    size_t n = region.runs.size();
+    bool low = fromLow;
+    const Run* previous = nullptr;
+    int position = 0;
+    for (size_t k = 0; k < n; k++) {
+        const Run& run = m_runs[region.runs[fromFirst ? k : n - 1 - k]];
+        int startPos = low ? run.begin : run.end;
+        int endPos = low ? run.end : run.begin;
+
+        if (previous) {
+            // 换线：新段的起点在上一段范围内时先沿上一段走过去，否则先换线再沿新段走
+            if (startPos >= previous->begin && startPos <= previous->end) {
+                appendPoint(out, toGrid(previous->lane, startPos), true);
+            } else {
+                appendPoint(out, toGrid(run.lane, position), true);
+            }
+        }
+        appendPoint(out, toGrid(run.lane, startPos), true);
+        appendPoint(out, toGrid(run.lane, endPos), true);
+
+        previous = &run;
+        position = endPos;
+        low = !low;
+    }
+
+    // 只有一个格子的区域：到达后原地作业一次（零长度的作业段）
+    if (!out.back().sweep) {
+        out.push_back(CoverageWaypoint(out.back().row, out.back().col, true));
+    }
+}
+
+// 与起点八连通（和A*的走法一致）的空闲格子
+void CoveragePlanner::markReachable(GridPos start, std::vector<uint8_t>& reached) const {
+    int rows = m_planner.rows();
+    int cols = m_planner.cols();
+    reached.assign(static_cast<size_t>(rows) * cols, 0);
+    std::vector<int> stack;
+    stack.push_back(start.row * cols + start.col);
+    reached[stack.back()] = 1;
+    while (!stack.empty()) {
+        int cell = stack.back();
+        stack.pop_back();
+        int row = cell / cols;
+        int col = cell % cols;
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                int nr = row + dr;
+                int nc = col + dc;
+                if (!m_planner.isValidPosition(nr, nc) || reached[nr * cols + nc]) {
+                    continue;
+                }
+                reached[nr * cols + nc] = 1;
+                stack.push_back(nr * cols + nc);
+            }
+        }
+    }
+}
+
+// 区域的四个可选入口放入空间索引
+void CoveragePlanner::addEntries(int region) {
+    for (int variant = 0; variant < 4; variant++) {
+        GridPos entry, exit;
+        regionEnds(m_regions[region], (variant & 1) == 0, (variant & 2) == 0, entry, exit);
+        int cell = entry.row * m_planner.cols() + entry.col;
+        m_entryRegion[cell] = region;
+        m_entries.insert(cell);
+    }
+}
+
+void CoveragePlanner::removeEntries(int region) {
+    for (int variant = 0; variant < 4; variant++) {
+        GridPos entry, exit;
+        regionEnds(m_regions[region], (variant & 1) == 0, (variant & 2) == 0, entry, exit);
+        int cell = entry.row * m_planner.cols() + entry.col;
+        if (m_entries.contains(cell)) {
+            m_entries.remove(cell);
+        }
+    }
+}
+
+// 空驶：直线可通行时直接前往，否则沿A*路径
+bool CoveragePlanner::appendTransit(GridPos from, GridPos to,
+                                    std::vector<CoverageWaypoint>& out) {
+    if (from == to) {
+        return true;
+    }
+    if (lineIsFree(from, to)) {
+        appendPoint(out, to, false);
+        return true;
+    }
+
+    std::vector<GridPos> route;
+    if (!m_planner.calculatePath(from, to, route, m_workspace)) {
+        return false;
+    }
+    for (size_t i = 1; i < route.size(); i++) {
+        appendPoint(out, route[i], false);
+    }
+    return true;
+}
+
+// 按半格步长采样直线经过的格子
+bool CoveragePlanner::lineIsFree(GridPos from, GridPos to) const {
+    int dr = to.row - from.row;
+    int dc = to.col - from.col;
+    int steps = 2 * std::max(std::abs(dr), std::abs(dc));
+    for (int s = 1; s < steps; s++) {
+        double t = static_cast<double>(s) / steps;
+        int row = static_cast<int>(std::floor(from.row + dr * t + 0.5));
+        int col = static_cast<int>(std::floor(from.col + dc * t + 0.5));
+        if (!m_planner.isValidPosition(row, col)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 追加路径点，与前两点同向共线时合并
+void CoveragePlanner::appendPoint(std::vector<CoverageWaypoint>& out, GridPos pos, bool sweep) {
+    if (!out.empty()) {
+        const CoverageWaypoint& last = out.back();
+        if (last.row == pos.row && last.col == pos.col) {
+            return;
+        }
+        if (out.size() >= 2 && last.sweep == sweep) {
+            const CoverageWaypoint& before = out[out.size() - 2];
+            int ar = last.row - before.row, ac = last.col - before.col;
+            int br = pos.row - last.row, bc = pos.col - last.col;
+            if (ar * bc - ac * br == 0 && ar * br + ac * bc > 0) {
+                out.back() = CoverageWaypoint(pos.row, pos.col, sweep);
+                return;
+            }
+        }
+    }
+    out.push_back(CoverageWaypoint(pos.row, pos.col, sweep));
+}
+
+void CoveragePlanner::computeStats(CoveragePath& path) {
+    const std::vector<CoverageWaypoint>& points = path.waypoints;
+    CoverageStats& stats = path.stats;
+    stats.turns = 0;
+    stats.sweepLength = 0.0;
+    stats.transitLength = 0.0;
+    for (size_t i = 1; i < points.size(); i++) {
+        double length = PathPlanner::distance(GridPos(points[i - 1].row, points[i - 1].col),
+                                              GridPos(points[i].row, points[i].col));
+        (points[i].sweep ? stats.sweepLength : stats.transitLength) += length;
+
+        if (i + 1 < points.size()) {
+            int ar = points[i].row - points[i - 1].row, ac = points[i].col - points[i - 1].col;
+            int br = points[i + 1].row - points[i].row, bc = points[i + 1].col - points[i].col;
+            if (ar * bc - ac * br != 0 || ar * br + ac * bc < 0) {
+                stats.turns++;
+            }
+        }
+    }
+}
+
+bool CoveragePlanner::plan(GridPos start, CoveragePath& path, SweepDirection direction) {
+    path.waypoints.clear();
+    path.stats = CoverageStats();
+    if (!m_planner.isValidPosition(start.row, start.col)) {
+        return false;
+    }
+
+    if (direction == SweepDirection::AUTO) {
+        // 段数少意味着换线少、转弯少
+        size_t rowRuns = countRuns(true);
+        size_t colRuns = countRuns(false);
+        m_alongRows = rowRuns <= colRuns;
+    } else {
+        m_alongRows = direction == SweepDirection::ROWS;
+    }
+    path.alongRows = m_alongRows;
+
+    decompose();
+    path.stats.regions = m_regions.size();
+
+    // 不连通的区域直接记为不可达
+    std::vector<uint8_t> reached;
+    markReachable(start, reached);
+    m_entries.reset(m_planner.rows(), m_planner.cols());
+    m_entryRegion.assign(reached.size(), -1);
+    size_t remaining = 0;
+    for (size_t r = 0; r < m_regions.size(); r++) {
+        Region& region = m_regions[r];
+        const Run& run = m_runs[region.runs.front()];
+        GridPos cell = toGrid(run.lane, run.begin);
+        if (!reached[cell.row * m_planner.cols() + cell.col]) {
+            region.done = true;
+            path.stats.unreachableCells += region.cellCount;
+            continue;
+        }
+        addEntries(static_cast<int>(r));
+        remaining++;
+    }
+
+    appendPoint(path.waypoints, start, false);
+    GridPos current = start;
+    int currentRegion = -1;
+
+    while (remaining > 0) {
+        // 优先去相邻的未覆盖区域，没有时取入口离当前位置最近的区域
+        int best = -1;
+        bool bestFirst = true, bestLow = true;
+        double bestCost = std::numeric_limits<double>::infinity();
+        auto consider = [&](int r) {
+            const Region& region = m_regions[r];
+            if (region.done) {
+                return;
+            }
+            for (int variant = 0; variant < 4; variant++) {
+                bool fromFirst = (variant & 1) == 0;
+                bool fromLow = (variant & 2) == 0;
+                GridPos entry, exit;
+                regionEnds(region, fromFirst, fromLow, entry, exit);
+                double cost = octileDistance(current, entry);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    best = r;
+                    bestFirst = fromFirst;
+                    bestLow = fromLow;
+                }
+            }
+        };
+        if (currentRegion >= 0) {
+            for (int neighbor : m_regions[currentRegion].neighbors) {
+                consider(neighbor);
+            }
+        }
+        if (best < 0) {
+            int cell = m_entries.nearest(current.row, current.col);
+            if (cell < 0) {
+                break;
+            }
+            consider(m_entryRegion[cell]);
+        }
+
+        Region& region = m_regions[best];
+        region.done = true;
+        removeEntries(best);
+        remaining--;
+
+        GridPos entry, exit;
+        regionEnds(region, bestFirst, bestLow, entry, exit);
+        if (!appendTransit(current, entry, path.waypoints)) {
+            path.stats.unreachableCells += region.cellCount;
+            continue;
+        }
+        sweepRegion(region, bestFirst, bestLow, path.waypoints);
+        path.stats.coveredCells += region.cellCount;
+        current = exit;
+        currentRegion = best;
+    }
+
+    computeStats(path);
+    return true;
+}
+
+const char* sweepDirectionToString(SweepDirection direction) {
+    switch (direction) {
+        case SweepDirection::ROWS: return "rows";
+        case SweepDirection::COLUMNS: return "columns";
+        default: return "auto";
+    }
+}
+
+bool stringToSweepDirection(const std::string& str, SweepDirection& direction) {
+    if (str == "auto") direction = SweepDirection::AUTO;
+    else if (str == "rows") direction = SweepDirection::ROWS;
+    else if (str == "columns") direction = SweepDirection::COLUMNS;
+    else return false;
+    return true;
+}
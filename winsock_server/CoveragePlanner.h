@@ -0,0 +1,130 @@
+#ifndef COVERAGE_PLANNER_H
+#define COVERAGE_PLANNER_H
+
+#include "PathPlanner.h"
+#include "SpatialIndex.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * 覆盖路径规划 - path_planner.py中plan_coverage_path的C++实现（牛耕式分解）
+ *
+ * 每条扫描线（一行或一列）上的连续空闲格子是一段；相邻扫描线上的段一一重叠时
+ * 属于同一区域，遇到障碍物分叉或合并时开始新区域。每个区域内按Z字形往返扫描，
+ * 区域之间优先去相邻的未覆盖区域，没有时用空间索引找入口最近的区域；
+ * 区域间空驶沿直线，直线被挡时用A*绕行（复用同一个工作区）。
+ * 与起点不连通的区域先用一次洪水填充排除，不做无用的搜索。
+ *
+ * 扫描方向默认自动选择段数较少（转弯较少）的一个。
+ * 输出只保留转折点，相邻共线的点合并，小车按顺序直线行驶即可。
+ */
+
+// 扫描方向
+enum class SweepDirection {
+    AUTO,
+    ROWS,       // 沿行扫描，逐行换线
+    COLUMNS     // 沿列扫描，逐列换线
+};
+
+// 路径点
+struct CoverageWaypoint {
+    int row;
+    int col;
+    bool sweep;     // 到达该点的这一段是否为覆盖作业（否则为空驶）
+
+    CoverageWaypoint() : row(0), col(0), sweep(false) {}
+    CoverageWaypoint(int r, int c, bool s) : row(r), col(c), sweep(s) {}
+};
+
+struct CoverageStats {
+    size_t regions;             // 分解出的区域数
+    size_t coveredCells;
+    size_t unreachableCells;    // 与起点不连通的格子
+    int turns;
+    double sweepLength;         // 格
+    double transitLength;       // 格
+
+    CoverageStats()
+        : regions(0), coveredCells(0), unreachableCells(0), turns(0),
+          sweepLength(0.0), transitLength(0.0) {}
+};
+
+struct CoveragePath {
+    std::vector<CoverageWaypoint> waypoints;    // 第一个点是起点
+    bool alongRows;
+    CoverageStats stats;
+
+    CoveragePath() : alongRows(true) {}
+};
+
+class CoveragePlanner {
+public:
+    explicit CoveragePlanner(const PathPlanner& planner);
+
+    // 从start出发覆盖所有可达的空闲格子，起点无效返回false
+    bool plan(GridPos start, CoveragePath& path,
+              SweepDirection direction = SweepDirection::AUTO);
+
+private:
+    // 扫描线上的一段连续空闲格子 [begin, end]
+    struct Run {
+        int lane;
+        int begin;
+        int end;
+        int region;
+    };
+
+    // 区域：连续扫描线上一一相连的段
+    struct Region {
+        std::vector<int> runs;          // 按扫描线顺序
+        std::vector<int> neighbors;
+        size_t cellCount;
+        bool done;
+
+        Region() : cellCount(0), done(false) {}
+    };
+
+    const PathPlanner& m_planner;
+    bool m_alongRows;
+    std::vector<Run> m_runs;
+    std::vector<Region> m_regions;
+
+    SpatialIndex m_entries;             // 未覆盖区域的入口格子
+    std::vector<int> m_entryRegion;     // 入口格子 -> 区域
+    PathWorkspace m_workspace;
+
+    int laneCount() const { return m_alongRows ? m_planner.rows() : m_planner.cols(); }
+    int laneLength() const { return m_alongRows ? m_planner.cols() : m_planner.rows(); }
+    GridPos toGrid(int lane, int pos) const {
+        return m_alongRows ? GridPos(lane, pos) : GridPos(pos, lane);
+    }
+    bool isFree(int lane, int pos) const {
+        GridPos p = toGrid(lane, pos);
+        return m_planner.isValidPosition(p.row, p.col);
+    }
+
+    size_t countRuns(bool alongRows);
+    void decompose();
+
+    // 区域的入口/出口：fromFirst表示从第一条扫描线开始，fromLow表示从段的低端开始
+    void regionEnds(const Region& region, bool fromFirst, bool fromLow,
+                    GridPos& entry, GridPos& exit) const;
+    void sweepRegion(const Region& region, bool fromFirst, bool fromLow,
+                     std::vector<CoverageWaypoint>& out) const;
+
+    void markReachable(GridPos start, std::vector<uint8_t>& reached) const;
+    void addEntries(int region);
+    void removeEntries(int region);
+
+    bool appendTransit(GridPos from, GridPos to, std::vector<CoverageWaypoint>& out);
+    bool lineIsFree(GridPos from, GridPos to) const;
+
+    static void appendPoint(std::vector<CoverageWaypoint>& out, GridPos pos, bool sweep);
+    static void computeStats(CoveragePath& path);
+};
+
+const char* sweepDirectionToString(SweepDirection direction);
+bool stringToSweepDirection(const std::string& str, SweepDirection& direction);
+
+#endif // COVERAGE_PLANNER_H
@@ -0,0 +1,788 @@
+#include "FarmField.h"
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <chrono>
+#include <atomic>
+
+// 植物配置表（顺序与PlantType一致）
+static const PlantConfig PLANT_CONFIGS[] = {
+    { "wheat",  4,  60.0, 30.0, 15, 1 },
+    { "corn",   4,  90.0, 45.0, 12, 2 },
+    { "carrot", 3,  45.0, 25.0, 20, 1 },
+    { "tomato", 5, 120.0, 40.0, 10, 3 }
+};
+
+// 条件对应的任务（与auto_farm_controller.py的优先级一致）
+struct ConditionTask {
+    TaskType type;
+    TaskPriority priority;
+};
+
+static const ConditionTask CONDITION_TASKS[CONDITION_COUNT] = {
+    { TaskType::WATERING,     TaskPriority::MEDIUM },   // NEEDS_WATER
+    { TaskType::WEED_REMOVAL, TaskPriority::HIGH },     // NEEDS_WEEDING
+    { TaskType::HARVEST,      TaskPriority::HIGH },     // RIPE
+    { TaskType::PLANTING,     TaskPriority::LOW }       // EMPTY
+};
+
+static const double NO_EVENT = std::numeric_limits<double>::infinity();
+
+// 缺水后健康值下降速度为 DRY_DECAY * 超时秒数（每秒），
+// 对应plant_manager.py每秒一次更新的累计效果
+static const double DRY_DECAY = 0.1;
+
+// 杂草
+static const double WEED_GROWTH_RATE = 0.02;   // 每秒期望出现次数
+static const int MAX_WEEDS = 5;
+static const double WEED_DAMAGE = 2.0;
+
+// 操作效果
+static const double WATER_HEALTH_BONUS = 10.0;
+static const double WEED_HEALTH_BONUS = 5.0;
+static const double MAX_HEALTH = 100.0;
+
+// splitmix64，用于可复现的随机数
+static uint64_t mixBits(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// 由 (单元格, 种植时间, 序号) 确定的 [0, 1) 均匀随机数
+static double hashUniform(int index, double plantedTime, uint32_t seq, uint64_t salt) {
+    uint64_t timeBits = 0;
+    std::memcpy(&timeBits, &plantedTime, sizeof(timeBits));
+    uint64_t h = mixBits(static_cast<uint64_t>(index) ^ mixBits(timeBits ^ salt) ^
+                         (static_cast<uint64_t>(seq) << 32));
+    return static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+FarmField::FarmField()
+    : m_rows(0), m_cols(0), m_cellSize(0.5), m_scheduled(0) {
+    for (int c = 0; c < CONDITION_COUNT; c++) {
+        m_conditionHead[c] = m_conditionTail[c] = -1;
+        m_conditionSize[c] = 0;
+    }
+}
+
+const PlantConfig& FarmField::config(PlantType type) {
+    int index = static_cast<int>(type);
+    if (index < 0 || index >= static_cast<int>(PlantType::COUNT)) {
+        index = 0;
+    }
+    return PLANT_CONFIGS[index];
+}
+
+void FarmField::reset(int rows, int cols, double cellSize) {
+    for (PlantCell& cell : m_cells) {
+        cancelEvent(cell);
+    }
+
+    m_rows = rows > 0 ? rows : 1;
+    m_cols = cols > 0 ? cols : 1;
+    m_cellSize = cellSize > 0 ? cellSize : 0.5;
+
+    PlantCell empty;
+    std::memset(&empty, 0, sizeof(empty));
+    empty.state = PlantState::EMPTY;
+    empty.eventTimer = INVALID_TIMER;
+    m_cells.assign(static_cast<size_t>(m_rows) * m_cols, empty);
+    m_scheduled = 0;
+
+    rebuildIndexes(0.0);
+}
+
+void FarmField::rebuildIndexes(double now) {
+    ConditionLinks unlinked;
+    for (int c = 0; c < CONDITION_COUNT; c++) {
+        unlinked.prev[c] = unlinked.next[c] = -1;
+        m_conditionHead[c] = m_conditionTail[c] = -1;
+        m_conditionSize[c] = 0;
+        m_spatial[c].reset(m_rows, m_cols);
+    }
+    unlinked.mask = 0;
+    m_links.assign(m_cells.size(), unlinked);
+
+    std::vector<QueuedTask> tasks;
+    for (size_t i = 0; i < m_cells.size(); i++) {
+        int index = static_cast<int>(i);
+        const PlantCell& cell = m_cells[i];
+        uint8_t mask = conditionMask(cell, now);
+        for (int c = 0; c < CONDITION_COUNT; c++) {
+            if (!(mask & (1u << c))) {
+                continue;
+            }
+            linkCondition(index, c);
+
+            QueuedTask task;
+            task.cell = index;
+            task.type = CONDITION_TASKS[c].type;
+            task.priority = CONDITION_TASKS[c].priority;
+            task.urgency = conditionUrgency(cell, c);
+            task.seq = 0;
+            task.claimed = false;
+            tasks.push_back(task);
+        }
+    }
+
+    m_tasks.reset(static_cast<int>(m_cells.size()));
+    m_tasks.bulkLoad(tasks);
+}
+
+void FarmField::setTimerHooks(PlantTimerSchedule schedule, PlantTimerCancel cancel) {
+    m_schedule = std::move(schedule);
+    m_cancel = std::move(cancel);
+}
+
+void FarmField::copyCells(std::vector<PlantCell>& out) const {
+    out.assign(m_cells.begin(), m_cells.end());
+}
+
+bool FarmField::restoreCells(int rows, int cols, double cellSize, const PlantCell* cells, double now) {
+    if (rows <= 0 || cols <= 0 || !cells) {
+        return false;
+    }
+    for (PlantCell& cell : m_cells) {
+        cancelEvent(cell);
+    }
+    m_rows = rows;
+    m_cols = cols;
+    m_cellSize = cellSize > 0 ? cellSize : 0.5;
+    m_cells.assign(cells, cells + static_cast<size_t>(rows) * cols);
+    for (PlantCell& cell : m_cells) {
+        cell.eventTimer = INVALID_TIMER;
+    }
+    m_scheduled = 0;
+
+    rebuildIndexes(now);
+    return true;
+}
+
+void FarmField::setOperationHook(FarmOperationHook hook) {
+    m_operationHook = std::move(hook);
+}
+
+void FarmField::setMutationGate(FarmMutationGate gate) {
+    m_mutationGate = std::move(gate);
+}
+
+void FarmField::resync(double now) {
+    for (size_t i = 0; i < m_cells.size(); i++) {
+        PlantCell& cell = m_cells[i];
+        if (cell.state == PlantState::EMPTY) {
+            continue;
+        }
+        evaluate(cell, static_cast<int>(i), now);
+        afterTransition(cell, static_cast<int>(i), now);
+    }
+}
+
+void FarmField::cellToWorld(int row, int col, double& x, double& z) const {
+    // 与path_planner.py一致：8x8、0.5米时偏移为 -2.0
+    double offsetX = -m_cols * m_cellSize / 2.0;
+    double offsetZ = -m_rows * m_cellSize / 2.0;
+    x = offsetX + col * m_cellSize + m_cellSize / 2.0;
+    z = offsetZ + row * m_cellSize + m_cellSize / 2.0;
+}
+
+bool FarmField::worldToCell(double x, double z, int& row, int& col) const {
+    double offsetX = -m_cols * m_cellSize / 2.0;
+    double offsetZ = -m_rows * m_cellSize / 2.0;
+    col = static_cast<int>(std::floor((x - offsetX) / m_cellSize));
+    row = static_cast<int>(std::floor((z - offsetZ) / m_cellSize));
+    return inBounds(row, col);
+}
+
+// 下一次杂草出现的间隔（指数分布）
+double FarmField::sampleWeedInterval(const PlantCell& cell, int index) const {
+    double u = hashUniform(index, cell.plantedTime, cell.weedSeq, 0x5EEDu);
+    return -std::log(1.0 - u) / WEED_GROWTH_RATE;
+}
+
+void FarmField::updateStage(PlantCell& cell, double now) {
+    const PlantConfig& cfg = config(cell.type);
+    double age = now - cell.plantedTime;
+    int stage = age > 0 ? static_cast<int>(age / cfg.growthTimePerStage) : 0;
+    if (stage > cfg.growthStages - 1) {
+        stage = cfg.growthStages - 1;
+    }
+    cell.growthStage = static_cast<uint8_t>(stage);
+    if (cell.state == PlantState::SEED && stage > 0) {
+        cell.state = PlantState::GROWING;
+    }
+}
+
+void FarmField::killPlant(PlantCell& cell, double when) {
+    updateStage(cell, when);
+    cell.health = 0.0;
+    cell.state = PlantState::DEAD;
+    cell.evaluatedTime = when;
+}
+
+// 把缺水造成的连续损失从from推进到to，期间枯死返回false
+// 超时o秒时损失速率为 DRY_DECAY*o，累计损失为 DRY_DECAY/2 * o^2
+bool FarmField::advanceHealth(PlantCell& cell, double from, double to) {
+    double dryAt = cell.lastWatered + config(cell.type).waterFrequency;
+    double o1 = from > dryAt ? from - dryAt : 0.0;
+    double o2 = to > dryAt ? to - dryAt : 0.0;
+    double loss = DRY_DECAY / 2.0 * (o2 * o2 - o1 * o1);
+
+    if (loss >= cell.health) {
+        double deathOverdue = std::sqrt(cell.health * 2.0 / DRY_DECAY + o1 * o1);
+        killPlant(cell, dryAt + deathOverdue);
+        return false;
+    }
+    cell.health -= loss;
+    return true;
+}
+
+// 惰性求值：按时间顺序应用杂草事件和缺水损失，把状态推进到now
+void FarmField::evaluate(PlantCell& cell, int index, double now) {
+    if (cell.state != PlantState::SEED && cell.state != PlantState::GROWING) {
+        return;
+    }
+    if (now <= cell.evaluatedTime) {
+        return;
+    }
+
+    double t = cell.evaluatedTime;
+    while (cell.weedCount < MAX_WEEDS && cell.nextWeedTime <= now) {
+        double weedTime = cell.nextWeedTime;
+        if (!advanceHealth(cell, t, weedTime)) {
+            return;
+        }
+        t = weedTime;
+
+        cell.weedCount++;
+        cell.weedSeq++;
+        cell.health -= WEED_DAMAGE;
+        if (cell.health <= 0.0) {
+            killPlant(cell, weedTime);
+            return;
+        }
+        cell.nextWeedTime = weedTime + sampleWeedInterval(cell, index);
+    }
+
+    if (!advanceHealth(cell, t, now)) {
+        return;
+    }
+    updateStage(cell, now);
+    cell.evaluatedTime = now;
+}
+
+// 计算下一次状态变化的时间：阶段推进、开始缺水、枯死、杂草出现
+double FarmField::nextEventTime(const PlantCell& cell, double now) const {
+    if (cell.state != PlantState::SEED && cell.state != PlantState::GROWING) {
+        return NO_EVENT;
+    }
+
+    const PlantConfig& cfg = config(cell.type);
+    double next = NO_EVENT;
+
+    if (cell.growthStage < cfg.growthStages - 1) {
+        next = std::min(next, cell.plantedTime + (cell.growthStage + 1) * cfg.growthTimePerStage);
+    }
+
+    double dryAt = cell.lastWatered + cfg.waterFrequency;
+    if (dryAt > now) {
+        next = std::min(next, dryAt);
+    } else {
+        double overdue = now - dryAt;
+        next = std::min(next, dryAt + std::sqrt(cell.health * 2.0 / DRY_DECAY + overdue * overdue));
+    }
+
+    if (cell.weedCount < MAX_WEEDS) {
+        next = std::min(next, cell.nextWeedTime);
+    }
+    return next;
+}
+
+void FarmField::cancelEvent(PlantCell& cell) {
+    if (cell.eventTimer != INVALID_TIMER) {
+        if (m_cancel) {
+            m_cancel(cell.eventTimer);
+        }
+        cell.eventTimer = INVALID_TIMER;
+        m_scheduled--;
+    }
+}
+
+// 取消旧定时器并挂上下一次事件
+void FarmField::reschedule(PlantCell& cell, int index, double now) {
+    cancelEvent(cell);
+    cell.eventSeq++;
+
+    double next = nextEventTime(cell, now);
+    if (next == NO_EVENT || !m_schedule) {
+        return;
+    }
+    double delay = next > now ? next - now : 0.0;
+    cell.eventTimer = m_schedule(index, cell.eventSeq, delay);
+    if (cell.eventTimer != INVALID_TIMER) {
+        m_scheduled++;
+    }
+}
+
+// 状态变化后更新条件索引并挂上下一次事件
+void FarmField::afterTransition(PlantCell& cell, int index, double now) {
+    refreshConditions(index, now);
+    reschedule(cell, index, now);
+}
+
+uint8_t FarmField::conditionMask(const PlantCell& cell, double now) const {
+    if (cell.state != PlantState::SEED && cell.state != PlantState::GROWING) {
+        return 1u << static_cast<int>(PlantCondition::EMPTY);
+    }
+
+    const PlantConfig& cfg = config(cell.type);
+    uint8_t mask = 0;
+    if (now - cell.lastWatered >= cfg.waterFrequency) {
+        mask |= 1u << static_cast<int>(PlantCondition::NEEDS_WATER);
+    }
+    if (cell.weedCount > 0) {
+        mask |= 1u << static_cast<int>(PlantCondition::NEEDS_WEEDING);
+    }
+    if (cell.growthStage >= cfg.growthStages - 1) {
+        mask |= 1u << static_cast<int>(PlantCondition::RIPE);
+    }
+    return mask;
+}
+
+void FarmField::refreshConditions(int index, double now) {
+    const PlantCell& cell = m_cells[index];
+    uint8_t mask = conditionMask(cell, now);
+    uint8_t changed = mask ^ m_links[index].mask;
+    for (int c = 0; c < CONDITION_COUNT; c++) {
+        uint8_t bit = static_cast<uint8_t>(1u << c);
+        if (mask & bit) {
+            if (changed & bit) {
+                linkCondition(index, c);
+            }
+            // 已在队列中时只在紧急度变化时调整堆
+            m_tasks.upsert(index, CONDITION_TASKS[c].type, CONDITION_TASKS[c].priority,
+                           conditionUrgency(cell, c));
+        } else if (changed & bit) {
+            unlinkCondition(index, c);
+            m_tasks.remove(index, CONDITION_TASKS[c].type);
+        }
+    }
+}
+
+// 同优先级内的紧急度：
+//   浇水按上次浇水时间（越早越急，对应get_plants_needing_water的排序）
+//   除草按杂草数，收获按健康损失（越虚弱越该先收），播种为0（先进先出）
+double FarmField::conditionUrgency(const PlantCell& cell, int condition) const {
+    switch (static_cast<PlantCondition>(condition)) {
+        case PlantCondition::NEEDS_WATER: return -cell.lastWatered;
+        case PlantCondition::NEEDS_WEEDING: return cell.weedCount;
+        case PlantCondition::RIPE: return MAX_HEALTH - cell.health;
+        default: return 0.0;
+    }
+}
+
+TaskType FarmField::conditionTask(PlantCondition condition) {
+    int c = static_cast<int>(condition);
+    return (c >= 0 && c < CONDITION_COUNT) ? CONDITION_TASKS[c].type : TaskType::PLANTING;
+}
+
+TaskPriority FarmField::conditionPriority(PlantCondition condition) {
+    int c = static_cast<int>(condition);
+    return (c >= 0 && c < CONDITION_COUNT) ? CONDITION_TASKS[c].priority : TaskPriority::LOW;
+}
+
+// 追加到链表尾部，链表因此按进入条件的时间排序
+void FarmField::linkCondition(int index, int condition) {
+    ConditionLinks& links = m_links[index];
+    links.prev[condition] = m_conditionTail[condition];
+    links.next[condition] = -1;
+    if (m_conditionTail[condition] >= 0) {
+        m_links[m_conditionTail[condition]].next[condition] = index;
+    } else {
+        m_conditionHead[condition] = index;
+    }
+    m_conditionTail[condition] = index;
+    links.mask |= static_cast<uint8_t>(1u << condition);
+    m_conditionSize[condition]++;
+    m_spatial[condition].insert(index);
+}
+
+void FarmField::unlinkCondition(int index, int condition) {
+    ConditionLinks& links = m_links[index];
+    int32_t prev = links.prev[condition];
+    int32_t next = links.next[condition];
+    if (prev >= 0) {
+        m_links[prev].next[condition] = next;
+    } else {
+        m_conditionHead[condition] = next;
+    }
+    if (next >= 0) {
+        m_links[next].prev[condition] = prev;
+    } else {
+        m_conditionTail[condition] = prev;
+    }
+    links.prev[condition] = links.next[condition] = -1;
+    links.mask &= static_cast<uint8_t>(~(1u << condition));
+    m_conditionSize[condition]--;
+    m_spatial[condition].remove(index);
+}
+
+size_t FarmField::queryCondition(PlantCondition condition, std::vector<int>& cells,
+                                 size_t limit) const {
+    int c = static_cast<int>(condition);
+    if (c < 0 || c >= CONDITION_COUNT) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (int32_t index = m_conditionHead[c]; index >= 0; index = m_links[index].next[c]) {
+        if (limit > 0 && count >= limit) {
+            break;
+        }
+        cells.push_back(index);
+        count++;
+    }
+    return count;
+}
+
+size_t FarmField::conditionCount(PlantCondition condition) const {
+    int c = static_cast<int>(condition);
+    return (c >= 0 && c < CONDITION_COUNT) ? m_conditionSize[c] : 0;
+}
+
+bool FarmField::hasCondition(int cellIndex, PlantCondition condition) const {
+    if (cellIndex < 0 || static_cast<size_t>(cellIndex) >= m_links.size()) {
+        return false;
+    }
+    return (m_links[cellIndex].mask & (1u << static_cast<int>(condition))) != 0;
+}
+
+size_t FarmField::findNearest(PlantCondition condition, int row, int col, size_t k,
+                              std::vector<int>& cells, bool skipClaimed) const {
+    int c = static_cast<int>(condition);
+    if (c < 0 || c >= CONDITION_COUNT) {
+        cells.clear();
+        return 0;
+    }
+    if (!skipClaimed) {
+        return m_spatial[c].nearest(row, col, k, cells);
+    }
+    TaskType type = CONDITION_TASKS[c].type;
+    return m_spatial[c].nearest(row, col, k, cells, [this, type](int cell) {
+        const QueuedTask* task = m_tasks.find(cell, type);
+        return !task || !task->claimed;
+    });
+}
+
+void FarmField::processEvent(int cellIndex, uint32_t eventSeq, double now) {
+    if (cellIndex < 0 || static_cast<size_t>(cellIndex) >= m_cells.size()) {
+        return;
+    }
+    PlantCell& cell = m_cells[cellIndex];
+    if (cell.eventSeq != eventSeq) {
+        return;  // 已被后续操作取代
+    }
+    if (cell.eventTimer != INVALID_TIMER) {
+        cell.eventTimer = INVALID_TIMER;
+        m_scheduled--;
+    }
+
+    evaluate(cell, cellIndex, now);
+    afterTransition(cell, cellIndex, now);
+}
+
+FarmResult FarmField::plantSeed(int row, int col, PlantType type, double now) {
+    if (!inBounds(row, col)) {
+        return FarmResult::INVALID_POSITION;
+    }
+    if (m_mutationGate && !m_mutationGate()) {
+        return FarmResult::READ_ONLY;
+    }
+    int index = cellIndex(row, col);
+    PlantCell& cell = m_cells[index];
+    evaluate(cell, index, now);
+
+    // 已收获或枯死的位置可以直接重新播种
+    if (cell.state == PlantState::SEED || cell.state == PlantState::GROWING) {
+        return FarmResult::OCCUPIED;
+    }
+
+    cell.state = PlantState::SEED;
+    cell.type = type < PlantType::COUNT ? type : PlantType::WHEAT;
+    cell.growthStage = 0;
+    cell.weedCount = 0;
+    cell.weedSeq = 0;
+    cell.plantedTime = now;
+    cell.lastWatered = now;
+    cell.health = MAX_HEALTH;
+    cell.evaluatedTime = now;
+    cell.nextWeedTime = now + sampleWeedInterval(cell, index);
+
+    afterTransition(cell, index, now);
+    if (m_operationHook) {
+        m_operationHook(FarmOperation::PLANT_SEED, row, col, cell.type, 0, now);
+    }
+    return FarmResult::OK;
+}
+
+FarmResult FarmField::water(int row, int col, double now) {
+    if (!inBounds(row, col)) {
+        return FarmResult::INVALID_POSITION;
+    }
+    if (m_mutationGate && !m_mutationGate()) {
+        return FarmResult::READ_ONLY;
+    }
+    int index = cellIndex(row, col);
+    PlantCell& cell = m_cells[index];
+    evaluate(cell, index, now);
+    if (cell.state != PlantState::SEED && cell.state != PlantState::GROWING) {
+        return FarmResult::NO_PLANT;
+    }
+
+    cell.lastWatered = now;
+    cell.health = std::min(MAX_HEALTH, cell.health + WATER_HEALTH_BONUS);
+
+    afterTransition(cell, index, now);
+    if (m_operationHook) {
+        m_operationHook(FarmOperation::WATER, row, col, cell.type, 0, now);
+    }
+    return FarmResult::OK;
+}
+
+FarmResult FarmField::removeWeeds(int row, int col, double now) {
+    if (!inBounds(row, col)) {
+        return FarmResult::INVALID_POSITION;
+    }
+    if (m_mutationGate && !m_mutationGate()) {
+        return FarmResult::READ_ONLY;
+    }
+    int index = cellIndex(row, col);
+    PlantCell& cell = m_cells[index];
+    evaluate(cell, index, now);
+    if (cell.state != PlantState::SEED && cell.state != PlantState::GROWING) {
+        return FarmResult::NO_PLANT;
+    }
+
+    if (cell.weedCount > 0) {
+        // 满5株时杂草过程暂停，清除后从现在重新开始
+        if (cell.weedCount >= MAX_WEEDS) {
+            cell.nextWeedTime = now + sampleWeedInterval(cell, index);
+        }
+        cell.weedCount = 0;
+        cell.health = std::min(MAX_HEALTH, cell.health + WEED_HEALTH_BONUS);
+    }
+
+    afterTransition(cell, index, now);
+    if (m_operationHook) {
+        m_operationHook(FarmOperation::REMOVE_WEEDS, row, col, cell.type, 0, now);
+    }
+    return FarmResult::OK;
+}
+
+FarmResult FarmField::harvest(int row, int col, double now, HarvestResult& result) {
+    if (!inBounds(row, col)) {
+        return FarmResult::INVALID_POSITION;
+    }
+    if (m_mutationGate && !m_mutationGate()) {
+        return FarmResult::READ_ONLY;
+    }
+    int index = cellIndex(row, col);
+    PlantCell& cell = m_cells[index];
+    evaluate(cell, index, now);
+    if (cell.state != PlantState::SEED && cell.state != PlantState::GROWING) {
+        return FarmResult::NO_PLANT;
+    }
+
+    const PlantConfig& cfg = config(cell.type);
+    if (cell.growthStage < cfg.growthStages - 1) {
+        return FarmResult::NOT_RIPE;
+    }
+
+    // 产量计算与plant_manager.py一致，随机因子改为可复现的哈希
+    double baseYield = cfg.maxYield * 0.5;
+    double healthFactor = cell.health / 100.0;
+    double weedFactor = std::max(0.5, 1.0 - cell.weedCount * 0.1);
+    double jitter = 0.9 + hashUniform(index, cell.plantedTime, cell.weedSeq, 0x4A4Eu) * 0.2;
+
+    result.type = cell.type;
+    result.yieldAmount = static_cast<int>(baseYield * healthFactor * weedFactor * jitter);
+    result.value = result.yieldAmount * cfg.baseValue;
+
+    cell.state = PlantState::HARVESTED;
+    cell.evaluatedTime = now;
+    afterTransition(cell, index, now);
+    if (m_operationHook) {
+        m_operationHook(FarmOperation::HARVEST, row, col, cell.type, result.value, now);
+    }
+    return FarmResult::OK;
+}
+
+void FarmField::fillInfo(const PlantCell& cell, int index, double now, PlantInfo& info) const {
+    const PlantConfig& cfg = config(cell.type);
+    bool alive = cell.state == PlantState::SEED || cell.state == PlantState::GROWING;
+
+    info.row = index / m_cols;
+    info.col = index % m_cols;
+    info.type = cell.type;
+    info.state = cell.state;
+    info.growthStage = cell.growthStage;
+    info.weedCount = cell.weedCount;
+    info.health = cell.health;
+    info.timeSinceWatered = now - cell.lastWatered;
+    info.needsWater = alive && info.timeSinceWatered >= cfg.waterFrequency;
+    info.ripe = alive && cell.growthStage >= cfg.growthStages - 1;
+}
+
+bool FarmField::getPlant(int row, int col, double now, PlantInfo& info) {
+    if (!inBounds(row, col)) {
+        return false;
+    }
+    int index = cellIndex(row, col);
+    PlantCell& cell = m_cells[index];
+    if (cell.state == PlantState::EMPTY) {
+        return false;
+    }
+    evaluate(cell, index, now);
+    refreshConditions(index, now);
+    fillInfo(cell, index, now, info);
+    return true;
+}
+
+std::string FarmField::buildPlantsJson(double now) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    oss << "{\"timestamp\":" << time(nullptr)
+        << ",\"grid_size\":[" << m_rows << "," << m_cols << "],\"plants\":[";
+
+    bool first = true;
+    for (size_t i = 0; i < m_cells.size(); i++) {
+        if (m_cells[i].state == PlantState::EMPTY) {
+            continue;
+        }
+        if (!first) oss << ",";
+        first = false;
+        writePlantJson(oss, static_cast<int>(i), now);
+    }
+    oss << "]}";
+    return oss.str();
+}
+
+size_t FarmField::appendPlantLines(size_t& cursor, double now, std::string& out, size_t maxBytes) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    size_t count = 0;
+    size_t bytes = out.size();
+    for (; cursor < m_cells.size() && bytes < maxBytes; cursor++) {
+        if (m_cells[cursor].state == PlantState::EMPTY) {
+            continue;
+        }
+        std::streampos before = oss.tellp();
+        writePlantJson(oss, static_cast<int>(cursor), now);
+        oss << "\n";
+        bytes += static_cast<size_t>(oss.tellp() - before);
+        count++;
+    }
+    out += oss.str();
+    return count;
+}
+
+void FarmField::writePlantJson(std::ostream& out, int index, double now) {
+    PlantCell& cell = m_cells[index];
+    evaluate(cell, index, now);
+    refreshConditions(index, now);
+
+    PlantInfo info;
+    fillInfo(cell, index, now, info);
+    out << "{\"id\":\"plant_" << info.row << "_" << info.col << "\""
+        << ",\"row\":" << info.row << ",\"col\":" << info.col
+        << ",\"type\":\"" << plantTypeToString(info.type) << "\""
+        << ",\"state\":\"" << plantStateToString(info.state) << "\""
+        << ",\"growth_stage\":" << info.growthStage
+        << ",\"health\":" << info.health
+        << ",\"weed_count\":" << info.weedCount
+        << ",\"time_since_watered\":" << info.timeSinceWatered
+        << ",\"needs_water\":" << (info.needsWater ? "true" : "false")
+        << ",\"ripe\":" << (info.ripe ? "true" : "false") << "}";
+}
+
+namespace {
+// 0 表示跟随系统时钟
+std::atomic<double> g_fixedFarmClock(0.0);
+}
+
+double farmClockNow() {
+    double fixed = g_fixedFarmClock.load(std::memory_order_acquire);
+    if (fixed > 0.0) {
+        return fixed;
+    }
+    return std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void advanceFarmClock(double seconds) {
+    double current = g_fixedFarmClock.load(std::memory_order_relaxed);
+    while (seconds > current &&
+           !g_fixedFarmClock.compare_exchange_weak(current, seconds, std::memory_order_release)) {
+    }
+}
+
+void resetFarmClock() {
+    g_fixedFarmClock.store(0.0, std::memory_order_release);
+}
+
+bool farmClockFixed() {
+    return g_fixedFarmClock.load(std::memory_order_acquire) > 0.0;
+}
+
+std::string plantTypeToString(PlantType type) {
+    if (type >= PlantType::COUNT) {
+        return "unknown";
+    }
+    return FarmField::config(type).name;
+}
+
+std::string plantStateToString(PlantState state) {
+    switch (state) {
+        case PlantState::EMPTY: return "empty";
+        case PlantState::SEED: return "seed";
+        case PlantState::GROWING: return "growing";
+        case PlantState::HARVESTED: return "harvested";
+        case PlantState::DEAD: return "dead";
+        default: return "unknown";
+    }
+}
+
+std::string conditionToString(PlantCondition condition) {
+    switch (condition) {
+        case PlantCondition::NEEDS_WATER: return "needs_water";
+        case PlantCondition::NEEDS_WEEDING: return "needs_weeding";
+        case PlantCondition::RIPE: return "ripe";
+        case PlantCondition::EMPTY: return "empty";
+        default: return "unknown";
+    }
+}
+
+bool stringToCondition(const std::string& str, PlantCondition& condition) {
+    for (int c = 0; c < CONDITION_COUNT; c++) {
+        if (str == conditionToString(static_cast<PlantCondition>(c))) {
+            condition = static_cast<PlantCondition>(c);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool stringToPlantType(const std::string& str, PlantType& type) {
+    for (int i = 0; i < static_cast<int>(PlantType::COUNT); i++) {
+        if (str == PLANT_CONFIGS[i].name) {
+            type = static_cast<PlantType>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,263 @@
+#ifndef FARM_FIELD_H
+#define FARM_FIELD_H
+
+#include "TimerWheel.h"
+#include "TaskQueue.h"
+#include "SpatialIndex.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <iosfwd>
+
+/**
+ * 农田状态 - 事件驱动的植物生命周期
+ *
+ * 生长阶段、缺水、枯死和杂草出现的时间都可以由种植时间、浇水时间
+ * 解析地算出。每株植物只挂一个定时器指向它的下一个状态变化，
+ * 读取时再惰性求值，因此模拟开销与事件数成正比，而不是与农田面积成正比。
+ *
+ * 规则与plant_manager.py一致：
+ *  - 阶段 = min(年龄 / growth_time_per_stage, growth_stages - 1)
+ *  - 超过water_frequency未浇水后，健康值每秒下降 0.1 * 超时秒数
+ *  - 杂草按 weed_growth_rate 的泊松过程出现，每株 -2 健康，最多5株
+ */
+
+// 植物类型
+enum class PlantType : uint8_t {
+    WHEAT,
+    CORN,
+    CARROT,
+    TOMATO,
+    COUNT
+};
+
+constexpr int PLANT_TYPE_COUNT = static_cast<int>(PlantType::COUNT);
+
+// 植物状态
+enum class PlantState : uint8_t {
+    EMPTY,
+    SEED,
+    GROWING,
+    HARVESTED,
+    DEAD
+};
+
+// 条件索引（对应get_plants_needing_water等查询）
+enum class PlantCondition : uint8_t {
+    NEEDS_WATER,
+    NEEDS_WEEDING,
+    RIPE,
+    EMPTY,          // 可播种：空地、已收获或已枯死
+    COUNT
+};
+
+constexpr int CONDITION_COUNT = static_cast<int>(PlantCondition::COUNT);
+
+// 植物配置（对应PlantManager.PLANT_CONFIGS）
+struct PlantConfig {
+    const char* name;
+    int growthStages;
+    double growthTimePerStage;  // 秒
+    double waterFrequency;      // 秒
+    int maxYield;
+    int baseValue;              // 金币
+};
+
+// 单元格数据（POD，便于整体拷贝）
+struct PlantCell {
+    PlantState state;
+    PlantType type;
+    uint8_t growthStage;
+    uint8_t weedCount;
+    uint32_t weedSeq;       // 已发生的杂草事件数（用于确定性随机数）
+    uint32_t eventSeq;      // 事件序号，用于识别过期定时器
+    double plantedTime;
+    double lastWatered;
+    double health;          // evaluatedTime时刻的健康值
+    double evaluatedTime;
+    double nextWeedTime;
+    TimerId eventTimer;
+};
+
+// 植物信息（对外）
+struct PlantInfo {
+    int row;
+    int col;
+    PlantType type;
+    PlantState state;
+    int growthStage;
+    int weedCount;
+    double health;
+    double timeSinceWatered;
+    bool needsWater;
+    bool ripe;
+};
+
+// 收获结果
+struct HarvestResult {
+    PlantType type;
+    int yieldAmount;
+    int value;
+};
+
+// 操作结果
+enum class FarmResult {
+    OK,
+    INVALID_POSITION,
+    OCCUPIED,
+    NO_PLANT,
+    NOT_RIPE,
+    READ_ONLY           // 修改闸门关闭（预写日志写盘失败）
+};
+
+// 定时器钩子：在delaySeconds后以(cellIndex, eventSeq)回调processEvent
+using PlantTimerSchedule = std::function<TimerId(int cellIndex, uint32_t eventSeq, double delaySeconds)>;
+using PlantTimerCancel = std::function<void(TimerId timer)>;
+
+// 成功修改农田的操作（用于预写日志）
+enum class FarmOperation : uint8_t {
+    PLANT_SEED,
+    WATER,
+    REMOVE_WEEDS,
+    HARVEST
+};
+
+// 操作钩子：每次操作成功后调用（调用方持有农田锁），type为该格的植物类型，
+// value为收获的金币（其余操作为0）
+using FarmOperationHook = std::function<void(FarmOperation op, int row, int col, PlantType type,
+                                             int value, double now)>;
+
+// 修改闸门：每次操作前调用，返回false时操作不做任何修改并返回READ_ONLY
+using FarmMutationGate = std::function<bool()>;
+
+class FarmField {
+public:
+    FarmField();
+
+    // 重置为rows x cols的空农田
+    void reset(int rows, int cols, double cellSize);
+    void setTimerHooks(PlantTimerSchedule schedule, PlantTimerCancel cancel);
+    void setOperationHook(FarmOperationHook hook);
+    void setMutationGate(FarmMutationGate gate);
+
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+    double cellSize() const { return m_cellSize; }
+    bool inBounds(int row, int col) const {
+        return row >= 0 && row < m_rows && col >= 0 && col < m_cols;
+    }
+    int cellIndex(int row, int col) const { return row * m_cols + col; }
+
+    // 网格坐标转世界坐标（农田中心位于原点）
+    void cellToWorld(int row, int col, double& x, double& z) const;
+    bool worldToCell(double x, double z, int& row, int& col) const;
+
+    // 农场操作
+    FarmResult plantSeed(int row, int col, PlantType type, double now);
+    FarmResult water(int row, int col, double now);
+    FarmResult removeWeeds(int row, int col, double now);
+    FarmResult harvest(int row, int col, double now, HarvestResult& result);
+
+    // 定时器到期
+    void processEvent(int cellIndex, uint32_t eventSeq, double now);
+
+    // 读取（惰性求值）
+    bool getPlant(int row, int col, double now, PlantInfo& info);
+    std::string buildPlantsJson(double now);
+    // 分块导出：从cursor格开始，每株植物一行JSON追加到out，out达到maxBytes或遍历完时返回；
+    // cursor推进到下一次开始的位置（等于格子总数表示结束），返回本次导出的株数
+    size_t appendPlantLines(size_t& cursor, double now, std::string& out, size_t maxBytes);
+    size_t cellCount() const { return m_cells.size(); }
+
+    // 条件查询，按进入条件的先后顺序返回单元格索引，O(结果数)
+    size_t queryCondition(PlantCondition condition, std::vector<int>& cells,
+                          size_t limit = 0) const;
+    size_t conditionCount(PlantCondition condition) const;
+    bool hasCondition(int cellIndex, PlantCondition condition) const;
+
+    // 距(row, col)最近的k个满足条件的格子，按距离升序；
+    // skipClaimed为true时跳过对应任务已被认领的格子
+    size_t findNearest(PlantCondition condition, int row, int col, size_t k,
+                       std::vector<int>& cells, bool skipClaimed = true) const;
+
+    // 任务队列，与条件索引同步更新（每个条件对应一种任务）
+    TaskQueue& tasks() { return m_tasks; }
+    const TaskQueue& tasks() const { return m_tasks; }
+    static TaskType conditionTask(PlantCondition condition);
+    static TaskPriority conditionPriority(PlantCondition condition);
+
+    // 全场扫描后批量重建条件索引和任务队列
+    void rebuildIndexes(double now);
+    // 按当前时间重新求值所有植物并重新挂事件（用历史时间回放操作之后调用）
+    void resync(double now);
+
+    // 快照：整体拷贝单元格数组；恢复时丢弃其中的定时器并按now重建索引，之后由resync挂事件
+    void copyCells(std::vector<PlantCell>& out) const;
+    bool restoreCells(int rows, int cols, double cellSize, const PlantCell* cells, double now);
+
+    // 已排程的植物事件数
+    size_t scheduledCount() const { return m_scheduled; }
+
+    static const PlantConfig& config(PlantType type);
+
+private:
+    int m_rows;
+    int m_cols;
+    double m_cellSize;
+    std::vector<PlantCell> m_cells;
+    size_t m_scheduled;
+
+    PlantTimerSchedule m_schedule;
+    PlantTimerCancel m_cancel;
+    FarmOperationHook m_operationHook;
+    FarmMutationGate m_mutationGate;
+
+    // 每个条件一条侵入式双向链表，mask记录单元格所在的链表
+    struct ConditionLinks {
+        int32_t prev[CONDITION_COUNT];
+        int32_t next[CONDITION_COUNT];
+        uint8_t mask;
+    };
+    std::vector<ConditionLinks> m_links;
+    int32_t m_conditionHead[CONDITION_COUNT];
+    int32_t m_conditionTail[CONDITION_COUNT];
+    size_t m_conditionSize[CONDITION_COUNT];
+    SpatialIndex m_spatial[CONDITION_COUNT];    // 每个条件的格子位置
+
+    TaskQueue m_tasks;
+
+    void evaluate(PlantCell& cell, int index, double now);
+    bool advanceHealth(PlantCell& cell, double from, double to);
+    void updateStage(PlantCell& cell, double now);
+    void killPlant(PlantCell& cell, double when);
+    double nextEventTime(const PlantCell& cell, double now) const;
+    void reschedule(PlantCell& cell, int index, double now);
+    void afterTransition(PlantCell& cell, int index, double now);
+    uint8_t conditionMask(const PlantCell& cell, double now) const;
+    void refreshConditions(int index, double now);
+    void linkCondition(int index, int condition);
+    void unlinkCondition(int index, int condition);
+    double conditionUrgency(const PlantCell& cell, int condition) const;
+    void cancelEvent(PlantCell& cell);
+    void fillInfo(const PlantCell& cell, int index, double now, PlantInfo& info) const;
+    void writePlantJson(std::ostream& out, int index, double now);
+    double sampleWeedInterval(const PlantCell& cell, int index) const;
+};
+
+// 农田时间（Unix秒，带小数）
+double farmClockNow();
+
+// 回放时把农田时间钉在录制的时间上：只向前推进，直到 resetFarmClock 恢复系统时钟
+void advanceFarmClock(double seconds);
+void resetFarmClock();
+bool farmClockFixed();
+
+// 辅助函数
+std::string plantTypeToString(PlantType type);
+std::string plantStateToString(PlantState state);
+std::string conditionToString(PlantCondition condition);
+bool stringToCondition(const std::string& str, PlantCondition& condition);
+bool stringToPlantType(const std::string& str, PlantType& type);
+
+#endif // FARM_FIELD_H
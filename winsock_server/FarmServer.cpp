@@ -1,16 +1,457 @@
 #include "FarmServer.h"
+#include "json_util.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <chrono>
 #include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+
+// 当前线程正在处理的客户端请求。回复请求方前先等本请求记下的日志落盘（SYNC模式）；
+// 协议v2的回复还带上请求ID，最后一个包暂缓发送，处理结束后标记FINAL
+namespace {
+struct RequestContext {
+    const FarmServer* server;
+    int clientId;
+    uint32_t requestId;
+    bool tagged;                // v2请求：回复带请求ID和FINAL
+    bool hasHeld;
+    Packet held;
+    uint64_t journalSeq;        // 本请求最后追加的日志序号，0表示没有
+    std::chrono::steady_clock::duration replyTime;     // 处理中等日志落盘和发送回复的时间
+    
+    RequestContext(const FarmServer* owner, int id, uint32_t request, bool tagReplies)
+        : server(owner), clientId(id), requestId(request), tagged(tagReplies), hasHeld(false),
+          journalSeq(0), replyTime(0) {}
+};
+
+// 定时器线程、运动线程上没有请求上下文，它们的操作不等待落盘
+thread_local RequestContext* t_request = nullptr;
+
+// 把刚追加的日志序号记到本线程正在处理的请求上
+void noteJournalSeq(const FarmServer* server, uint64_t seq) {
+    RequestContext* request = t_request;
+    if (seq == 0 || !request || request->server != server) {
+        return;
+    }
+    request->journalSeq = seq;     // 日志失败后不再恢复，最后一条落盘说明之前的都落盘了
+}
+
+// 当前线程正在处理的包的追踪上下文（traceId为0时不记录span，也不读时钟）
+thread_local TraceContext t_trace;
+
+// span的开始时刻；未采样时返回0
+uint64_t spanStart(const SpanTracer& tracer) {
+    return t_trace.traceId != 0 ? tracer.nowNs() : 0;
+}
+
+void spanEnd(SpanTracer& tracer, const char* name, uint64_t startNs) {
+    if (t_trace.traceId != 0) {
+        tracer.record(name, t_trace, startNs, tracer.nowNs());
+    }
+}
+
+// 批量操作单次最多的条数（请求包本身也受MAX_PACKET_SIZE限制）
+const size_t MAX_BATCH_OPS = 4096;
+const size_t MAX_BATCH_ERRORS = MAX_BATCH_OPS;
+
+// batch流每攒够这么多条执行一次；整个流最多的条数（限制结果位图的大小）
+const size_t STREAM_BATCH_BLOCK = 256;
+const size_t MAX_STREAM_OPS = 1u << 20;
+
+// 批量操作中的一条
+struct BatchOp {
+    TaskType type;
+    int row;
+    int col;
+    PlantType seed;
+};
+
+void describeFarmResult(FarmResult result, uint32_t& code, const char*& message) {
+    switch (result) {
+        case FarmResult::INVALID_POSITION:
+            code = ErrorCode::INVALID_POSITION;
+            message = "Position out of field";
+            break;
+        case FarmResult::OCCUPIED:
+            code = ErrorCode::INVALID_POSITION;
+            message = "Position already planted";
+            break;
+        case FarmResult::NO_PLANT:
+            code = ErrorCode::PLANT_NOT_FOUND;
+            message = "No living plant at position";
+            break;
+        case FarmResult::NOT_RIPE:
+            code = ErrorCode::OPERATION_FAILED;
+            message = "Plant is not ripe";
+            break;
+        case FarmResult::READ_ONLY:
+            code = ErrorCode::OPERATION_FAILED;
+            message = "Farm is read-only after a journal write failure";
+            break;
+        default:
+            code = ErrorCode::OPERATION_FAILED;
+            message = "Operation failed";
+            break;
+    }
+}
+
+// 解析一条批量操作：[type, row, col, seed?] 或 {"type","row","col","seed_type"}
+bool parseBatchOp(const JsonValue& item, BatchOp& op, std::string& error) {
+    std::string type;
+    std::string seed = "wheat";
+    if (item.isArray()) {
+        const std::vector<JsonValue>& fields = item.items();
+        if (fields.size() < 3 || !fields[0].isString()) {
+            error = "expected [type, row, col]";
+            return false;
+        }
+        type = fields[0].asString();
+        op.row = static_cast<int>(fields[1].asNumber());
+        op.col = static_cast<int>(fields[2].asNumber());
+        if (fields.size() > 3 && fields[3].isString()) {
+            seed = fields[3].asString();
+        }
+    } else if (item.isObject() && item.has("row") && item.has("col")) {
+        type = item.getString("type", "");
+        op.row = item.getInt("row", -1);
+        op.col = item.getInt("col", -1);
+        seed = item.getString("seed_type", seed);
+    } else {
+        error = "expected [type, row, col]";
+        return false;
+    }
+    
+    if (!stringToTaskType(type, op.type) ||
+        (op.type != TaskType::PLANTING && op.type != TaskType::WATERING &&
+         op.type != TaskType::HARVEST && op.type != TaskType::WEED_REMOVAL)) {
+        error = "unsupported type '" + type + "'";
+        return false;
+    }
+    op.seed = PlantType::WHEAT;
+    if (op.type == TaskType::PLANTING && !stringToPlantType(seed, op.seed)) {
+        error = "unknown seed type '" + seed + "'";
+        return false;
+    }
+    return true;
+}
+
+// 批量操作的累计结果
+struct BatchTally {
+    size_t count;
+    size_t failed;
+    int64_t coins;
+    int yield;
+    std::vector<uint8_t> bitmap;                        // 第i条成功则第i位为1
+    std::vector<std::pair<size_t, uint32_t>> errors;    // [下标, 错误代码]，最多MAX_BATCH_ERRORS条
+    
+    BatchTally() : count(0), failed(0), coins(0), yield(0) {}
+    
+    void record(bool ok, uint32_t code) {
+        size_t index = count++;
+        if (index / 8 >= bitmap.size()) {
+            bitmap.push_back(0);
+        }
+        if (ok) {
+            bitmap[index / 8] |= static_cast<uint8_t>(1u << (index % 8));
+            return;
+        }
+        failed++;
+        if (errors.size() < MAX_BATCH_ERRORS) {
+            errors.push_back(std::make_pair(index, code));
+        }
+    }
+    
+    std::string fields() const {
+        static const char HEX[] = "0123456789abcdef";
+        std::ostringstream oss;
+        oss << "\"count\":" << count
+            << ",\"succeeded\":" << (count - failed)
+            << ",\"failed\":" << failed
+            << ",\"results\":\"";
+        for (uint8_t byte : bitmap) {
+            oss << HEX[byte >> 4] << HEX[byte & 0x0F];
+        }
+        oss << "\",\"errors\":[";
+        for (size_t i = 0; i < errors.size(); i++) {
+            if (i > 0) oss << ",";
+            oss << "[" << errors[i].first << "," << errors[i].second << "]";
+        }
+        oss << "]";
+        if (failed > errors.size()) {
+            oss << ",\"errors_truncated\":true";
+        }
+        oss << ",\"coins_earned\":" << coins
+            << ",\"yield\":" << yield;
+        return oss.str();
+    }
+};
+
+// 在一次农田锁内按顺序执行一组操作；单条失败时退回该条已扣的资源
+void executeBatch(FarmField& field, ProfiledMutex& farmMutex, ResourceLedger& ledger,
+                  const std::vector<BatchOp>& ops, BatchTally& tally) {
+    int64_t coins = 0;
+    {
+        PROFILED_LOCK(lock, farmMutex);
+        double now = farmClockNow();
+        for (const BatchOp& op : ops) {
+            TaskCharge cost;
+            LedgerResult charged = ledger.chargeTask(op.type, op.seed, cost);
+            if (charged != LedgerResult::OK) {
+                tally.record(false, charged == LedgerResult::INSUFFICIENT_ENERGY
+                                        ? ErrorCode::INSUFFICIENT_ENERGY
+                                        : ErrorCode::OPERATION_FAILED);
+                continue;
+            }
+            
+            FarmResult result = FarmResult::OK;
+            HarvestResult harvest;
+            switch (op.type) {
+                case TaskType::PLANTING:
+                    result = field.plantSeed(op.row, op.col, op.seed, now);
+                    break;
+                case TaskType::WATERING:
+                    result = field.water(op.row, op.col, now);
+                    break;
+                case TaskType::HARVEST:
+                    result = field.harvest(op.row, op.col, now, harvest);
+                    if (result == FarmResult::OK) {
+                        coins += harvest.value;
+                        tally.yield += harvest.yieldAmount;
+                    }
+                    break;
+                default:
+                    result = field.removeWeeds(op.row, op.col, now);
+                    break;
+            }
+            if (result != FarmResult::OK) {
+                ledger.refundTask(cost);
+                uint32_t code = ErrorCode::OPERATION_FAILED;
+                const char* message = nullptr;
+                describeFarmResult(result, code, message);
+                tally.record(false, code);
+                continue;
+            }
+            tally.record(true, 0);
+        }
+    }
+    if (coins > 0) {
+        ledger.addCoins(coins, LedgerChange::HARVEST);
+        tally.coins += coins;
+    }
+}
+
+// 解析计划中的一步（EVALUATE_PLAN的tasks元素，或plan流中的一行）
+bool parsePlannedTask(const JsonValue& item, double speed, PlannedTask& step, std::string& error) {
+    std::string typeName = item.getString("task_type", "");
+    if (typeName == "move") {
+        step.hasAction = false;
+    } else if (!stringToTaskType(typeName, step.type)) {
+        error = "Unknown task_type: " + typeName;
+        return false;
+    }
+    std::string seedName = item.getString("plant_type", "wheat");
+    if (!stringToPlantType(seedName, step.seed)) {
+        error = "Unknown plant_type: " + seedName;
+        return false;
+    }
+    step.distance = item.getNumber("distance", 0.0);
+    // 未给出耗时按移动时间估算；收获默认按满产量估算收入
+    step.seconds = item.getNumber("duration", step.distance / speed);
+    int64_t defaultCoins = 0;
+    if (step.hasAction && step.type == TaskType::HARVEST) {
+        const PlantConfig& cfg = FarmField::config(step.seed);
+        defaultCoins = static_cast<int64_t>(cfg.maxYield) * cfg.baseValue;
+    }
+    step.coins = static_cast<int64_t>(item.getNumber("coins", static_cast<double>(defaultCoins)));
+    return true;
+}
+
+std::string planResultJson(size_t total, const PlanEvaluation& result) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3)
+        << "{\"total\":" << total
+        << ",\"affordable\":" << result.affordable
+        << ",\"binding\":\"" << planConstraintToString(result.binding) << "\""
+        << ",\"wait_seconds\":" << result.waitSeconds
+        << ",\"elapsed_seconds\":" << result.elapsedSeconds
+        << ",\"energy_used\":" << result.energyUsed
+        << ",\"final_energy\":" << result.finalEnergy
+        << ",\"coins_earned\":" << result.coinsEarned
+        << ",\"final_coins\":" << result.finalCoins
+        << ",\"final_seeds\":{";
+    for (int i = 0; i < PLANT_TYPE_COUNT; i++) {
+        if (i > 0) oss << ",";
+        oss << "\"" << plantTypeToString(static_cast<PlantType>(i)) << "\":" << result.finalSeeds[i];
+    }
+    oss << "}}";
+    return oss.str();
+}
+
+// batch流：每行一条操作，攒满一块就执行，已执行的块不再缓存
+class BatchStreamSink : public LineStreamSink {
+public:
+    BatchStreamSink(FarmField& field, ProfiledMutex& farmMutex, ResourceLedger& ledger)
+        : m_field(field), m_farmMutex(farmMutex), m_ledger(ledger) {
+        m_block.reserve(STREAM_BATCH_BLOCK);
+    }
+    
+    const char* kind() const override { return "batch"; }
+    
+protected:
+    bool onLine(const std::string& line, std::string& error) override {
+        size_t index = m_tally.count + m_block.size();
+        if (index >= MAX_STREAM_OPS) {
+            error = "Too many ops (max " + std::to_string(MAX_STREAM_OPS) + ")";
+            return false;
+        }
+        JsonValue item;
+        BatchOp op;
+        std::string reason = "invalid JSON";
+        if (!JsonValue::parse(line, item) || !parseBatchOp(item, op, reason)) {
+            flush();
+            error = "Invalid op " + std::to_string(index) + ": " + reason + " (" +
+                    std::to_string(m_tally.count) + " ops already executed)";
+            return false;
+        }
+        m_block.push_back(op);
+        if (m_block.size() >= STREAM_BATCH_BLOCK) {
+            flush();
+        }
+        return true;
+    }
+    
+    bool onFinish(Packet& reply, std::string& error) override {
+        flush();
+        if (m_tally.count == 0) {
+            error = "Missing ops: the batch stream was empty";    // 与BATCH_OPERATION的空ops一致
+            return false;
+        }
+        reply = Packet(Response::SUCCESS,
+                       "{\"status\":\"success\",\"message\":\"Batch executed\",\"stream\":\"batch\"," +
+                       m_tally.fields() + "}");
+        return true;
+    }
+    
+private:
+    FarmField& m_field;
+    ProfiledMutex& m_farmMutex;
+    ResourceLedger& m_ledger;
+    std::vector<BatchOp> m_block;
+    BatchTally m_tally;
+    
+    void flush() {
+        if (!m_block.empty()) {
+            executeBatch(m_field, m_farmMutex, m_ledger, m_block, m_tally);
+            m_block.clear();
+        }
+    }
+};
+
+// plan流：每行一步，到达即评估，回复与EVALUATE_PLAN相同
+class PlanStreamSink : public LineStreamSink {
+public:
+    PlanStreamSink(const ResourceLedger& ledger, double speed)
+        : m_ledger(ledger), m_speed(speed), m_total(0) {
+        m_ledger.beginPlan(m_cursor);
+    }
+    
+    const char* kind() const override { return "plan"; }
+    
+protected:
+    bool onLine(const std::string& line, std::string& error) override {
+        JsonValue item;
+        PlannedTask step;
+        if (!JsonValue::parse(line, item)) {
+            error = "Invalid JSON in task " + std::to_string(m_total);
+            return false;
+        }
+        if (!parsePlannedTask(item, m_speed, step, error)) {
+            return false;
+        }
+        m_total++;
+        m_ledger.stepPlan(m_cursor, step);
+        return true;
+    }
+    
+    bool onFinish(Packet& reply, std::string& error) override {
+        if (m_total == 0) {
+            error = "Missing tasks: the plan stream was empty";
+            return false;
+        }
+        reply = Packet(Response::PLAN_RESULT, planResultJson(m_total, m_ledger.finishPlan(m_cursor)));
+        return true;
+    }
+    
+private:
+    const ResourceLedger& m_ledger;
+    double m_speed;
+    size_t m_total;
+    PlanCursor m_cursor;
+};
+
+bool isStreamCommand(uint32_t command) {
+    return command == Command::STREAM_BEGIN || command == Command::STREAM_CHUNK ||
+           command == Command::STREAM_END;
+}
+}
 
 // 构造函数
 FarmServer::FarmServer() 
     : m_listenSocket(INVALID_SOCKET),
-      m_nextClientId(1),
+      m_logMutex("log"),
       m_shouldStop(false),
+      m_pushMutex("push"),
+      m_statePushPending(false),
+      m_cartPushPending(false),
+      m_cartPushAlpha(0.0),
+      m_timers(10),
+      m_heartbeatTimer(INVALID_TIMER),
+      m_farmMutex("farm"),
+      m_journaledLedger(),
+      m_snapshotBusy(false),
+      m_snapshotTimer(INVALID_TIMER),
+      m_autoFarm(m_field, m_farmMutex, m_motion, m_timers, m_ledger),
       m_pythonInitialized(false) {
+    registerMetrics();
+    
+    // 植物事件挂在服务器时间轮上，回调时再取农田锁
+    m_field.setTimerHooks(
+        [this](int cellIndex, uint32_t eventSeq, double delaySeconds) {
+            uint64_t delayMs = static_cast<uint64_t>(std::ceil(delaySeconds * 1000.0));
+            return m_timers.schedule(delayMs, [this, cellIndex, eventSeq]() {
+                onPlantEvent(cellIndex, eventSeq);
+            });
+        },
+        [this](TimerId timer) { m_timers.cancel(timer); });
+    
+    // 成功的农田操作写入日志（日志未启动时append不做事），并维护与日志一致的余额
+    m_field.setOperationHook([this](FarmOperation op, int row, int col, PlantType type, int value,
+                                    double now) {
+        static const JournalRecordType types[] = {
+            JournalRecordType::PLANT_SEED, JournalRecordType::WATER,
+            JournalRecordType::REMOVE_WEEDS, JournalRecordType::HARVEST
+        };
+        if (op == FarmOperation::PLANT_SEED) {
+            int32_t& seeds = m_journaledLedger.seeds[static_cast<int>(type)];
+            if (seeds > 0) {
+                seeds--;
+            }
+        } else if (op == FarmOperation::HARVEST) {
+            m_journaledLedger.coins += value;
+        }
+        noteJournalSeq(this, m_journal.append(JournalRecord(types[static_cast<int>(op)],
+                                                            static_cast<uint8_t>(type), row, col, now)));
+    });
+    // 日志写盘失败后停止修改农田（fail-stop），内存状态不再偏离日志更多
+    m_field.setMutationGate([this]() { return m_journal.healthy(); });
+    
+    // 自动化在定时器线程上运行，状态推送交给推送线程
+    m_autoFarm.setStatusCallback([this](int clientId, const std::string& statusJson) {
+        queuePush(clientId, Packet(Response::AUTO_STATUS, statusJson));
+    });
 }
 
 // 析构函数
@@ -82,13 +523,71 @@ bool FarmServer::start(const ServerConfig& config) {
     // 更新状态
     m_status.isRunning = true;
     m_status.startTime = time(nullptr);
-    m_status.connectedClients = 0;
-    m_status.totalConnections = 0;
-    m_status.totalCommandsProcessed = 0;
+    
+    // 配置运动子系统
+    if (m_config.motionTickRate <= 0) m_config.motionTickRate = 60;
+    if (m_config.cartUpdateRate <= 0) m_config.cartUpdateRate = 10;
+    m_motion.configure(1.0 / m_config.motionTickRate, m_config.maxCarts);
+    
+    // 初始化农田
+    if (m_config.gridSize <= 0) m_config.gridSize = 8;
+    if (m_config.cellSize <= 0) m_config.cellSize = 0.5;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        m_field.reset(m_config.gridSize, m_config.gridSize, m_config.cellSize);
+    }
+    // 账本按配置重置，快照和日志再恢复金币、种子和工具等级
+    m_ledger.reset(m_config.initialEnergy, m_config.initialCoins, m_config.maxEnergy,
+                   m_config.energyRegen, m_config.initialSeeds);
+    restoreFarm();
+    
+    // 录制收到的请求，供bench/farm_replay回放
+    if (!m_config.capturePath.empty()) {
+        startCapture();
+    }
+    
+    // 协议v2请求的工作线程
+    if (m_config.workerThreads <= 0) m_config.workerThreads = 4;
+    if (m_config.maxInFlight <= 0) m_config.maxInFlight = 32;
+    m_workers.start(static_cast<size_t>(m_config.workerThreads));
+    
+    // 请求追踪
+    if (m_config.traceSampleEvery > 0) {
+        m_tracer.configure(static_cast<uint32_t>(m_config.traceSampleEvery),
+                           static_cast<size_t>(std::max(1, m_config.traceBufferSpans)));
+        log(LogLevel::INFO, "Tracing 1 of every " + std::to_string(m_config.traceSampleEvery) +
+            " packets per connection");
+    }
     
     // 启动线程
     m_acceptThread = std::thread(&FarmServer::acceptLoop, this);
-    m_heartbeatThread = std::thread(&FarmServer::heartbeatLoop, this);
+    m_timerThread = std::thread(&FarmServer::timerLoop, this);
+    m_motionThread = std::thread(&FarmServer::motionLoop, this);
+    m_pushThread = std::thread(&FarmServer::pushLoop, this);
+    
+    // 状态心跳
+    if (m_config.heartbeatInterval > 0) {
+        uint64_t intervalMs = static_cast<uint64_t>(m_config.heartbeatInterval) * 1000;
+        m_heartbeatTimer = m_timers.schedule(intervalMs, [this]() { onHeartbeat(); }, intervalMs);
+    }
+    
+    // 定期快照
+    if (!m_config.snapshotPath.empty() && m_config.snapshotInterval > 0) {
+        uint64_t intervalMs = static_cast<uint64_t>(m_config.snapshotInterval) * 1000;
+        m_snapshotTimer = m_timers.schedule(intervalMs, [this]() { saveSnapshot(); }, intervalMs);
+    }
+    
+    // 本地指标导出
+    if (m_config.metricsPort > 0) {
+        std::string error;
+        if (m_metricsHttp.start(static_cast<uint16_t>(m_config.metricsPort),
+                                [this]() { return exportMetrics(); }, error)) {
+            log(LogLevel::INFO, "Metrics on http://127.0.0.1:" + std::to_string(m_config.metricsPort) +
+                "/metrics");
+        } else {
+            log(LogLevel::WARNING, "Metrics endpoint disabled: " + error);
+        }
+    }
     
     log(LogLevel::INFO, "Server started on port " + std::to_string(m_config.port));
     
@@ -106,32 +605,76 @@ void FarmServer::stop() {
     m_shouldStop = true;
     m_status.isRunning = false;
     
-    // 关闭监听socket
+    // 关闭监听socket（Linux上只close不会唤醒阻塞在accept的线程，先shutdown）
+    shutdown(m_listenSocket, SD_BOTH);
     safeCloseSocket(m_listenSocket);
+    m_metricsHttp.stop();
     
-    // 断开所有客户端
-    {
-        std::lock_guard<std::mutex> lock(m_clientsMutex);
-        for (auto& pair : m_clientSockets) {
-            CLOSE_SOCKET(pair.second);
+    // 停止自动化会话
+    m_autoFarm.stopAll();
+    
+    // 断开所有客户端（socket由各自的读线程退出时关闭）
+    for (uint32_t index = 0; index < m_clientSlots.size(); index++) {
+        ClientSlot& client = *m_clientSlots.get(index);
+        PROFILED_LOCK(lock, client.stateMutex);
+        if (client.clientId.load(std::memory_order_relaxed) == 0) {
+            continue;
         }
-        m_clientSockets.clear();
-        m_clientInfos.clear();
+        shutdown(client.socket, SD_BOTH);
+        m_timers.cancel(client.timeoutTimer);
+        client.timeoutTimer = INVALID_TIMER;
+        client.clientId.store(0, std::memory_order_release);
+        m_connectedClients->add(-1);
+    }
+    m_timers.cancel(m_heartbeatTimer);
+    m_heartbeatTimer = INVALID_TIMER;
+    m_timers.cancel(m_snapshotTimer);
+    m_snapshotTimer = INVALID_TIMER;
+    m_timers.wakeUp();
+    {
+        PROFILED_LOCK(lock, m_pushMutex);
+        m_statePushPending = false;
+        m_cartPushPending = false;
+        m_pushQueue.clear();
     }
+    m_pushCv.notify_all();
     
     // 等待线程结束
     if (m_acceptThread.joinable()) {
         m_acceptThread.join();
     }
-    if (m_heartbeatThread.joinable()) {
-        m_heartbeatThread.join();
+    if (m_timerThread.joinable()) {
+        m_timerThread.join();
     }
-    for (auto& pair : m_clientThreads) {
-        if (pair.second.joinable()) {
-            pair.second.join();
+    if (m_motionThread.joinable()) {
+        m_motionThread.join();
+    }
+    if (m_pushThread.joinable()) {
+        m_pushThread.join();
+    }
+    for (uint32_t index = 0; index < m_clientSlots.size(); index++) {
+        ClientSlot& client = *m_clientSlots.get(index);
+        if (client.thread.joinable()) {
+            client.thread.join();
         }
     }
-    m_clientThreads.clear();
+    
+    if (m_capture.isOpen()) {
+        log(LogLevel::INFO, "Captured " + std::to_string(m_capture.recordCount()) + " requests to " +
+            m_config.capturePath);
+        m_capture.close();
+    }
+    
+    // 客户端线程退出前已等待各自的在途请求，这里只剩空队列
+    m_workers.stop();
+    
+    // 等后台快照写完，再写一个最终快照，下次启动不需要回放日志；
+    // 快照之前的日志记录在关闭时压缩掉
+    if (m_snapshotThread.joinable()) {
+        m_snapshotThread.join();
+    }
+    saveSnapshot(false);
+    m_journal.close();
     
     // 关闭日志文件
     if (m_logFile.is_open()) {
@@ -144,6 +687,201 @@ void FarmServer::stop() {
     log(LogLevel::INFO, "Server stopped");
 }
 
+// 启动时恢复农田：映射最新的快照，再回放日志中快照之后的记录
+void FarmServer::restoreFarm() {
+    uint64_t snapshotSeq = loadSnapshot();
+    openJournal(snapshotSeq);
+    
+    PROFILED_LOCK(lock, m_farmMutex);
+    // 快照和回放用的是记录时的时间，按现在重新求值并挂定时器
+    m_field.resync(farmClockNow());
+    m_ledger.captureState(m_journaledLedger);
+}
+
+// 返回快照包含的最后一条日志序号，没有可用的快照时返回0
+uint64_t FarmServer::loadSnapshot() {
+    if (m_config.snapshotPath.empty()) {
+        return 0;
+    }
+    
+    auto started = std::chrono::steady_clock::now();
+    FarmSnapshot snapshot;
+    std::string error;
+    if (!snapshot.open(m_config.snapshotPath, error)) {
+        if (!error.empty()) {
+            log(LogLevel::WARNING, "Snapshot ignored: " + error);
+        }
+        return 0;
+    }
+    if (snapshot.rows() != m_config.gridSize || snapshot.cols() != m_config.gridSize) {
+        log(LogLevel::WARNING, "Snapshot ignored: it was written for a " + std::to_string(snapshot.rows()) +
+            "x" + std::to_string(snapshot.cols()) + " field");
+        return 0;
+    }
+    
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        m_field.restoreCells(snapshot.rows(), snapshot.cols(), m_config.cellSize,
+                             snapshot.cells(), snapshot.savedAt());
+    }
+    m_ledger.restoreState(snapshot.ledger());
+    for (size_t i = 0; i < snapshot.cartCount(); i++) {
+        CartSnapshot cart;
+        snapshot.cart(i, cart);
+        m_motion.placeCart(cart.cartId, cart.x, cart.z, cart.rotation);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    
+    std::ostringstream oss;
+    oss << "Snapshot " << m_config.snapshotPath << ": " << snapshot.rows() * snapshot.cols()
+        << " cells, " << snapshot.cartCount() << " carts, journal seq " << snapshot.journalSeq()
+        << ", loaded in " << std::fixed << std::setprecision(1) << ms << " ms";
+    log(LogLevel::INFO, oss.str());
+    return snapshot.journalSeq();
+}
+
+// 打开预写日志并回放快照之后的操作；之后的操作经农田钩子追加
+void FarmServer::openJournal(uint64_t snapshotSeq) {
+    if (m_config.journalPath.empty()) {
+        log(LogLevel::INFO, "Journal disabled, changes after the last snapshot will not survive a restart");
+        return;
+    }
+    
+    std::string error;
+    if (!m_journal.open(m_config.journalPath, m_config.gridSize, m_config.gridSize, error)) {
+        log(LogLevel::ERROR, "Journal disabled: " + error);
+        return;
+    }
+    
+    size_t replayed = 0;
+    auto started = std::chrono::steady_clock::now();
+    {
+        // 日志尚未start，回放经过钩子时append不会把操作再写一遍
+        PROFILED_LOCK(lock, m_farmMutex);
+        replayed = m_journal.replay([this](const JournalRecord& record) {
+            HarvestResult harvest;
+            switch (record.type) {
+                case JournalRecordType::PLANT_SEED:
+                    if (m_field.plantSeed(record.row, record.col, static_cast<PlantType>(record.arg),
+                                          record.time) == FarmResult::OK) {
+                        m_ledger.consumeSeeds(static_cast<PlantType>(record.arg), 1);
+                    }
+                    break;
+                case JournalRecordType::WATER:
+                    m_field.water(record.row, record.col, record.time);
+                    break;
+                case JournalRecordType::REMOVE_WEEDS:
+                    m_field.removeWeeds(record.row, record.col, record.time);
+                    break;
+                case JournalRecordType::HARVEST:
+                    if (m_field.harvest(record.row, record.col, record.time, harvest) == FarmResult::OK) {
+                        m_ledger.addCoins(harvest.value, LedgerChange::HARVEST);
+                    }
+                    break;
+                case JournalRecordType::UPGRADE_TOOL:
+                    m_ledger.upgradeTool(static_cast<ResourceTool>(record.arg));
+                    break;
+            }
+        }, snapshotSeq);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    
+    m_journal.start(m_config.journalDurability, m_config.journalIntervalMs);
+    
+    std::ostringstream oss;
+    oss << "Journal " << m_config.journalPath << ": replayed " << replayed << " records in "
+        << std::fixed << std::setprecision(1) << ms << " ms, durability "
+        << journalDurabilityToString(m_config.journalDurability);
+    log(LogLevel::INFO, oss.str());
+}
+
+void FarmServer::copyFarm(FarmSnapshotData& data) {
+    PROFILED_LOCK(lock, m_farmMutex);
+    data.rows = m_field.rows();
+    data.cols = m_field.cols();
+    data.cellSize = m_field.cellSize();
+    m_field.copyCells(data.cells);
+    data.ledger = m_journaledLedger;
+    data.journalSeq = m_journal.lastSeq();
+    data.savedAt = farmClockNow();
+}
+
+// 录制从当前农田开始：先把它写成起始快照，回放恢复快照后再重放请求，
+// 能量和农田时钟的起点写在抓包文件头
+void FarmServer::startCapture() {
+    std::string snapshotPath = captureSnapshotPath(m_config.capturePath);
+    FarmSnapshotData start;
+    copyFarm(start);
+    m_motion.listCarts(start.carts);
+    std::string error;
+    if (!FarmSnapshot::write(snapshotPath, start, error)) {
+        log(LogLevel::WARNING, "Capture disabled: " + error);
+        return;
+    }
+    
+    CaptureOrigin origin;
+    origin.farmClock = farmClockNow();
+    origin.energy = m_ledger.energy();
+    origin.maxEnergy = m_ledger.maxEnergy();
+    origin.energyRegen = m_ledger.regenRate();
+    if (m_capture.open(m_config.capturePath, m_config.gridSize, m_config.gridSize, origin, error)) {
+        log(LogLevel::INFO, "Capturing requests to " + m_config.capturePath + ", start state in " + snapshotPath);
+    } else {
+        log(LogLevel::WARNING, "Capture disabled: " + error);
+    }
+}
+
+bool FarmServer::saveSnapshot(bool background) {
+    if (m_config.snapshotPath.empty()) {
+        return false;
+    }
+    if (!m_journal.healthy()) {
+        // 内存中有没落盘的操作，写快照会把它们持久化，与已经回复的错误矛盾
+        log(LogLevel::ERROR, "Journal write failed, snapshot skipped until restart");
+        return false;
+    }
+    bool idle = false;
+    if (!m_snapshotBusy.compare_exchange_strong(idle, true)) {
+        return false;   // 上一个快照还在写
+    }
+    if (m_snapshotThread.joinable()) {
+        m_snapshotThread.join();
+    }
+    
+    // 只在拷贝单元格数组时持有农田锁，命令处理只暂停这一次内存拷贝
+    auto started = std::chrono::steady_clock::now();
+    copyFarm(m_snapshotData);
+    double pauseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    m_motion.listCarts(m_snapshotData.carts);
+    
+    auto write = [this, pauseMs]() {
+        auto writeStarted = std::chrono::steady_clock::now();
+        std::string error;
+        if (!m_journal.healthy()) {
+            error = "journal write failed while capturing";
+        } else if (FarmSnapshot::write(m_config.snapshotPath, m_snapshotData, error)) {
+            // 快照已落盘，它包含的日志记录可以丢弃了
+            m_journal.compact(m_snapshotData.journalSeq);
+            double writeMs = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - writeStarted).count();
+            std::ostringstream oss;
+            oss << "Snapshot saved: journal seq " << m_snapshotData.journalSeq << ", paused "
+                << std::fixed << std::setprecision(2) << pauseMs << " ms, wrote "
+                << std::setprecision(1) << writeMs << " ms";
+            log(LogLevel::INFO, oss.str());
+        } else {
+            log(LogLevel::ERROR, "Snapshot failed: " + error);
+        }
+        m_snapshotBusy = false;
+    };
+    if (background) {
+        m_snapshotThread = std::thread(write);
+    } else {
+        write();
+    }
+    return true;
+}
+
 // 接受连接循环
 void FarmServer::acceptLoop() {
     while (!m_shouldStop) {
@@ -159,14 +897,11 @@ void FarmServer::acceptLoop() {
             continue;
         }
         
-        // 检查客户端数量限制
-        {
-            std::lock_guard<std::mutex> lock(m_clientsMutex);
-            if (m_clientSockets.size() >= (size_t)m_config.maxClients) {
-                log(LogLevel::WARNING, "Max clients reached, rejecting connection");
-                CLOSE_SOCKET(clientSocket);
-                continue;
-            }
+        // 检查客户端数量限制（只有本线程增加连接数）
+        if (m_connectedClients->value() >= m_config.maxClients) {
+            log(LogLevel::WARNING, "Max clients reached, rejecting connection");
+            CLOSE_SOCKET(clientSocket);
+            continue;
         }
         
         // 获取客户端信息
@@ -174,26 +909,16 @@ void FarmServer::acceptLoop() {
         inet_ntop(AF_INET, &clientAddr.sin_addr, ipStr, INET_ADDRSTRLEN);
         uint16_t clientPort = ntohs(clientAddr.sin_port);
         
-        // 分配客户端ID
-        int clientId = m_nextClientId++;
-        
-        // 保存客户端信息
-        {
-            std::lock_guard<std::mutex> lock(m_clientsMutex);
-            m_clientSockets[clientId] = clientSocket;
-            
-            ClientInfo info;
-            info.clientId = clientId;
-            info.ipAddress = ipStr;
-            info.port = clientPort;
-            info.connectTime = time(nullptr);
-            info.lastActivityTime = time(nullptr);
-            info.isAuthorized = false;
-            m_clientInfos[clientId] = info;
-            
-            m_status.connectedClients++;
-            m_status.totalConnections++;
+        // 分配槽位和客户端ID
+        int clientId = registerClient(clientSocket, clientAddr);
+        if (clientId == 0) {
+            log(LogLevel::WARNING, "Client table full, rejecting connection");
+            CLOSE_SOCKET(clientSocket);
+            continue;
         }
+        m_connectionsTotal->add();
+        m_connectedClients->add(1);
+        armClientTimeout(clientId, static_cast<uint64_t>(m_config.clientTimeout) * 1000);
         
         log(LogLevel::INFO, "Client connected: " + std::string(ipStr) + ":" + 
             std::to_string(clientPort), clientId);
@@ -204,67 +929,414 @@ void FarmServer::acceptLoop() {
         }
         
         // 启动客户端处理线程
-        m_clientThreads[clientId] = std::thread(&FarmServer::clientLoop, this, clientId, clientSocket);
+        m_clientSlots.get(clientId & CLIENT_SLOT_MASK)->thread =
+            std::thread(&FarmServer::clientLoop, this, clientId, clientSocket);
+    }
+}
+
+// 为新连接分配槽位，返回客户端ID；表满时返回0
+int FarmServer::registerClient(socket_t socket, const sockaddr_in& addr) {
+    int index = m_clientSlots.acquire();
+    if (index < 0) {
+        return 0;
+    }
+    ClientSlot& client = *m_clientSlots.get(static_cast<uint32_t>(index));
+    if (client.thread.joinable()) {
+        client.thread.join();   // 上一个读线程放回槽位后正在退出
+    }
+    client.generation = static_cast<uint16_t>(client.generation % MAX_CLIENT_GENERATION + 1);
+    int clientId = (static_cast<int>(client.generation) << CLIENT_SLOT_BITS) | index;
+    {
+        PROFILED_LOCK(lock, client.mutex);
+        PROFILED_LOCK(stateLock, client.stateMutex);
+        client.socket = socket;
+        client.codec.reset();
+        client.connectTime = time(nullptr);
+        client.isAuthorized = false;
+        client.timeoutTimer = INVALID_TIMER;
+    }
+    client.protocolVersion.store(PROTOCOL_VERSION_1, std::memory_order_relaxed);
+    client.address.store(addr.sin_addr.s_addr, std::memory_order_relaxed);
+    client.port.store(ntohs(addr.sin_port), std::memory_order_relaxed);
+    client.lastActivityTime.store(static_cast<int64_t>(time(nullptr)), std::memory_order_relaxed);
+    client.lastActivityMs.store(m_timers.nowMs(), std::memory_order_relaxed);
+    client.clientId.store(clientId, std::memory_order_release);   // 发布，此后可以查到
+    return clientId;
+}
+
+// 读线程退出时调用：关闭socket，释放压缩上下文，槽位放回空闲链表
+void FarmServer::releaseClientSlot(int clientId) {
+    uint32_t index = static_cast<uint32_t>(clientId & CLIENT_SLOT_MASK);
+    ClientSlot& client = *m_clientSlots.get(index);
+    {
+        PROFILED_LOCK(lock, client.mutex);
+        PROFILED_LOCK(stateLock, client.stateMutex);
+        safeCloseSocket(client.socket);
+        client.codec.reset();
+    }
+    m_clientSlots.release(static_cast<int>(index));
+}
+
+// 按ID查找槽位，不加锁；ID已失效时返回nullptr
+FarmServer::ClientSlot* FarmServer::findClient(int clientId) const {
+    if (clientId <= 0) {
+        return nullptr;
     }
+    ClientSlot* client = m_clientSlots.get(static_cast<uint32_t>(clientId & CLIENT_SLOT_MASK));
+    if (!client || client->clientId.load(std::memory_order_acquire) != clientId) {
+        return nullptr;
+    }
+    return client;
+}
+
+ClientInfo FarmServer::describeClient(const ClientSlot& client) const {
+    ClientInfo info;
+    char ipStr[INET_ADDRSTRLEN];
+    in_addr address;
+    address.s_addr = client.address.load(std::memory_order_relaxed);
+    inet_ntop(AF_INET, &address, ipStr, INET_ADDRSTRLEN);
+    info.clientId = client.clientId.load(std::memory_order_relaxed);
+    info.ipAddress = ipStr;
+    info.port = client.port.load(std::memory_order_relaxed);
+    info.connectTime = client.connectTime;
+    info.lastActivityTime = static_cast<time_t>(client.lastActivityTime.load(std::memory_order_relaxed));
+    info.isAuthorized = client.isAuthorized;
+    info.protocolVersion = client.protocolVersion.load(std::memory_order_relaxed);
+    return info;
 }
 
 // 客户端处理循环
 void FarmServer::clientLoop(int clientId, socket_t clientSocket) {
     log(LogLevel::DEBUG, "Client thread started", clientId);
     
+    // 槽位在本线程退出前不会被复用，逐包的记账直接写它的原子变量
+    ClientSlot& self = *m_clientSlots.get(static_cast<uint32_t>(clientId & CLIENT_SLOT_MASK));
+    auto pipeline = std::make_shared<RequestPipeline>();
+    uint32_t version = PROTOCOL_VERSION_1;
+    std::unique_ptr<StreamSink> upload;     // 该连接上打开的上传流
+    
     while (!m_shouldStop) {
+        // 读之前决定是否追踪这个包，采样的包在包头到达时开始计时
+        t_trace = TraceContext();
+        t_trace.traceId = m_tracer.sample();
+        
         Packet packet;
-        if (!receivePacket(clientSocket, packet)) {
+        if (!receivePacket(clientSocket, packet, version)) {
             break;  // 连接断开或错误
         }
+        auto received = std::chrono::steady_clock::now();
+        if (t_trace.traceId != 0) {
+            t_trace.clientId = clientId;
+            t_trace.requestId = packet.ext.requestId;
+            t_trace.command = packet.header.command;
+            spanEnd(m_tracer, "recv", t_trace.startNs);
+        }
+        if (m_capture.isOpen()) {
+            m_capture.record(clientId, packet);
+        }
         
-        // 更新最后活动时间
-        {
-            std::lock_guard<std::mutex> lock(m_clientsMutex);
-            auto it = m_clientInfos.find(clientId);
-            if (it != m_clientInfos.end()) {
-                it->second.lastActivityTime = time(nullptr);
-            }
+        // 更新最后活动时间（只记录时间戳，超时定时器到期时再惰性检查）
+        self.lastActivityTime.store(static_cast<int64_t>(time(nullptr)), std::memory_order_relaxed);
+        self.lastActivityMs.store(m_timers.nowMs(), std::memory_order_relaxed);
+        
+        // 上传流的各块必须按到达顺序处理，直接在读线程上执行
+        if (isStreamCommand(packet.header.command)) {
+            auto handlerTime = runRequest(clientId, packet.ext.requestId, version >= PROTOCOL_VERSION_2,
+                                          [&]() { handleStreamCommand(clientId, packet, upload); });
+            recordRequest(packet.header.command, received, handlerTime);
+            spanEnd(m_tracer, "request", t_trace.startNs);
+            continue;
+        }
+        
+        // 协议v2：交给工作线程，继续读取下一个请求
+        if (version >= PROTOCOL_VERSION_2 && packet.header.command != Command::DISCONNECT) {
+            dispatchRequest(clientId, packet, pipeline, received);
+            continue;
         }
         
-        // 处理命令
-        handleCommand(clientId, packet);
+        // 协议v1按顺序处理；v2的DISCONNECT等在途请求都回复后再处理
+        waitForDrain(pipeline);
+        auto handlerTime = runRequest(clientId, packet.ext.requestId, false,
+                                      [&]() { handleCommand(clientId, packet); });
+        recordRequest(packet.header.command, received, handlerTime);
+        spanEnd(m_tracer, "request", t_trace.startNs);
         
-        m_status.totalCommandsProcessed++;
+        // CONNECT可能把连接升级到v2
+        version = self.protocolVersion.load(std::memory_order_acquire);
     }
     
+    t_trace = TraceContext();
+    waitForDrain(pipeline);
+    
     // 清理客户端
     cleanupClient(clientId);
     
     log(LogLevel::DEBUG, "Client thread ended", clientId);
+    releaseClientSlot(clientId);
 }
 
-// 心跳检测循环
-void FarmServer::heartbeatLoop() {
-    while (!m_shouldStop) {
-        std::this_thread::sleep_for(std::chrono::seconds(m_config.heartbeatInterval));
-        
-        if (m_shouldStop) break;
+// 回放一个录制的请求，按读线程上的路径处理（带请求ID的按v2请求回复）
+void FarmServer::replayPacket(int clientId, const Packet& packet, std::unique_ptr<StreamSink>& upload) {
+    auto started = std::chrono::steady_clock::now();
+    auto handler = [&]() {
+        if (isStreamCommand(packet.header.command)) {
+            handleStreamCommand(clientId, packet, upload);
+        } else {
+            handleCommand(clientId, packet);
+        }
+    };
+    auto handlerTime = runRequest(clientId, packet.ext.requestId, packet.ext.requestId != 0, handler);
+    recordRequest(packet.header.command, started, handlerTime);
+}
+
+// 在工作线程上处理一个v2请求；在途请求达到上限时阻塞读线程
+void FarmServer::dispatchRequest(int clientId, const Packet& packet,
+                                 const std::shared_ptr<RequestPipeline>& pipeline,
+                                 std::chrono::steady_clock::time_point received) {
+    {
+        uint64_t waitStart = spanStart(m_tracer);
+        std::unique_lock<std::mutex> lock(pipeline->mutex);
+        pipeline->drained.wait(lock, [&]() { return pipeline->inFlight < m_config.maxInFlight; });
+        pipeline->inFlight++;
+        spanEnd(m_tracer, "in_flight_wait", waitStart);
+    }
+    m_requestsInFlight->add(1);
+    
+    TraceContext trace = t_trace;
+    uint64_t queuedNs = spanStart(m_tracer);
+    WorkerJob job = [this, clientId, packet, pipeline, received, trace, queuedNs]() {
+        t_trace = trace;
+        spanEnd(m_tracer, "queue", queuedNs);
+        auto handlerTime = runRequest(clientId, packet.ext.requestId, true,
+                                      [&]() { handleCommand(clientId, packet); });
+        recordRequest(packet.header.command, received, handlerTime);
+        spanEnd(m_tracer, "request", t_trace.startNs);
+        t_trace = TraceContext();
+        m_requestsInFlight->add(-1);
         
-        checkClientTimeouts();
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            pipeline->inFlight--;
+        }
+        pipeline->drained.notify_all();
+    };
+    if (!m_workers.submit(job)) {
+        job();  // 线程池已停止（服务器关闭中）
     }
 }
 
-// 接收数据包
-bool FarmServer::receivePacket(socket_t socket, Packet& packet) {
-    // 接收头部
-    char headerBuffer[sizeof(PacketHeader)];
-    int received = recv(socket, headerBuffer, sizeof(PacketHeader), MSG_WAITALL);
+// 在当前线程上处理一个请求；tagReplies（v2）时回复带上请求ID，最后一个回复标记FINAL。
+// 返回处理函数本身的耗时，不含等日志落盘和发送回复
+std::chrono::steady_clock::duration FarmServer::runRequest(int clientId, uint32_t requestId, bool tagReplies,
+                                                           const std::function<void()>& handler) {
+    RequestContext request(this, clientId, requestId, tagReplies);
+    t_request = &request;
+    uint64_t handlerStart = spanStart(m_tracer);
+    auto started = std::chrono::steady_clock::now();
+    handler();
+    auto handlerTime = std::chrono::steady_clock::now() - started - request.replyTime;
+    spanEnd(m_tracer, "handler", handlerStart);
+    t_request = nullptr;
     
-    if (received != sizeof(PacketHeader)) {
-        return false;  // 连接断开或错误
+    if (request.hasHeld) {
+        request.held.ext.flags |= PacketFlag::FINAL;
+        ClientSlot* client = findClient(clientId);
+        if (client) {
+            uint64_t waitStart = spanStart(m_tracer);
+            PROFILED_LOCK(lock, client->mutex);
+            spanEnd(m_tracer, "client_lock_wait", waitStart);
+            if (client->clientId.load(std::memory_order_relaxed) == clientId) {
+                uint64_t sendStart = spanStart(m_tracer);
+                sendLocked(*client, request.held);
+                spanEnd(m_tracer, "send", sendStart);
+            }
+        }
+    }
+    return handlerTime;
+}
+
+void FarmServer::waitForDrain(const std::shared_ptr<RequestPipeline>& pipeline) {
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    pipeline->drained.wait(lock, [&]() { return pipeline->inFlight == 0; });
+}
+
+// 定时调度循环
+// 没有到期事件时一直睡眠，有更早的定时器加入时被唤醒
+void FarmServer::timerLoop() {
+    while (!m_shouldStop) {
+        m_timers.advanceTo(m_timers.nowMs());
+        m_timers.waitForNext(1000);
     }
+}
+
+// 运动积分循环
+// 固定步长推进所有小车，推送按独立频率进行，推送时在两个tick之间插值
+void FarmServer::motionLoop() {
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration tickDuration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / m_config.motionTickRate));
+    const Clock::duration emitDuration = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / m_config.cartUpdateRate));
+    const int maxCatchUpTicks = 5;  // 防止落后时无限追赶
     
-    // 解析头部
-    memcpy(&packet.header, headerBuffer, sizeof(PacketHeader));
+    Clock::time_point lastTick = Clock::now();
+    Clock::time_point nextTick = lastTick + tickDuration;
+    Clock::time_point nextEmit = lastTick + emitDuration;
     
-    // 验证魔数
-    if (packet.header.magic != PROTOCOL_MAGIC) {
+    while (!m_shouldStop) {
+        std::this_thread::sleep_until(std::min(nextTick, nextEmit));
+        Clock::time_point now = Clock::now();
+        
+        // 推进固定步长
+        int steps = 0;
+        while (now >= nextTick && steps < maxCatchUpTicks) {
+            m_motion.tick();
+            lastTick = nextTick;
+            nextTick += tickDuration;
+            steps++;
+        }
+        if (now >= nextTick) {
+            // 落后太多，丢弃积压的时间
+            lastTick = now;
+            nextTick = now + tickDuration;
+        }
+        
+        // 推送小车位置：只登记，由推送线程收集和发送，积分不受慢连接影响
+        if (now >= nextEmit) {
+            double alpha = std::chrono::duration<double>(now - lastTick).count() /
+                           std::chrono::duration<double>(tickDuration).count();
+            {
+                PROFILED_LOCK(lock, m_pushMutex);
+                m_cartPushPending = true;
+                m_cartPushAlpha = alpha;
+            }
+            m_pushCv.notify_one();
+            nextEmit += emitDuration;
+            if (nextEmit <= now) {
+                nextEmit = now + emitDuration;
+            }
+        }
+    }
+}
+
+// 推送循环
+// 执行定时器线程和运动线程登记的推送；每个CART_MOVED不超过MAX_PACKET_SIZE，v1连接也能接收
+void FarmServer::pushLoop() {
+    std::vector<std::string> payloads;
+    std::deque<std::pair<int, Packet>> queued;
+    std::unique_lock<ProfiledMutex> lock(m_pushMutex);   // 推送线程大部分时间在这里等待，不计入剖析
+    while (true) {
+        m_pushCv.wait(lock, [&]() {
+            return m_shouldStop || m_statePushPending || m_cartPushPending || !m_pushQueue.empty();
+        });
+        if (m_shouldStop) {
+            break;
+        }
+        bool pushState = m_statePushPending;
+        bool pushCarts = m_cartPushPending;
+        double alpha = m_cartPushAlpha;
+        m_statePushPending = false;
+        m_cartPushPending = false;
+        queued.swap(m_pushQueue);
+        lock.unlock();
+        
+        if (pushCarts) {
+            size_t count = m_motion.collectUpdates(alpha, MAX_PACKET_SIZE, payloads);
+            for (size_t i = 0; i < count; i++) {
+                broadcastCartUpdate(payloads[i]);
+            }
+        }
+        for (const std::pair<int, Packet>& push : queued) {
+            sendToSlot(push.first, push.second);
+        }
+        queued.clear();
+        if (pushState) {
+            broadcastStateUpdate(buildStateJson());
+        }
+        lock.lock();
+    }
+}
+
+// 登记一个发给单个客户端的推送
+void FarmServer::queuePush(int clientId, const Packet& packet) {
+    {
+        PROFILED_LOCK(lock, m_pushMutex);
+        if (m_shouldStop) {
+            return;
+        }
+        if (m_pushQueue.size() >= MAX_QUEUED_PUSHES) {
+            m_pushesDropped->add();
+            return;
+        }
+        m_pushQueue.push_back(std::make_pair(clientId, packet));
+    }
+    m_pushCv.notify_one();
+}
+
+// 接收数据包；协议v2的压缩帧在这里解压，分片在这里重组
+bool FarmServer::receivePacket(socket_t socket, Packet& packet, uint32_t version) {
+    t_trace.startNs = 0;
+    if (!receiveFrame(socket, packet, version)) {
+        return false;
+    }
+    if (version < PROTOCOL_VERSION_2 ||
+        !(packet.ext.flags & (PacketFlag::COMPRESSED | PacketFlag::MORE))) {
+        return true;
+    }
+    
+    std::string message;
+    std::string decoded;
+    Packet frame = packet;
+    while (true) {
+        if (frame.ext.flags & PacketFlag::COMPRESSED) {
+            if (!FrameCompressor::decompress(frame.data.data(), frame.data.size(), decoded,
+                                             MAX_MESSAGE_SIZE - message.size())) {
+                return false;
+            }
+            message += decoded;
+        } else {
+            message += frame.data;
+        }
+        if (!(frame.ext.flags & PacketFlag::MORE)) {
+            break;
+        }
+        if (message.size() >= MAX_MESSAGE_SIZE ||
+            !receiveFrame(socket, frame, version) ||
+            frame.header.command != packet.header.command ||
+            frame.ext.requestId != packet.ext.requestId) {
+            return false;   // 分片之间不能穿插其他消息
+        }
+    }
+    
+    packet.data.swap(message);
+    packet.header.length = static_cast<uint32_t>(packet.data.size());
+    packet.ext.flags = frame.ext.flags & ~(PacketFlag::COMPRESSED | PacketFlag::MORE);
+    return true;
+}
+
+// 接收一帧
+bool FarmServer::receiveFrame(socket_t socket, Packet& packet, uint32_t version) {
+    // 接收头部（v2头部多出请求ID和标志位）
+    char headerBuffer[sizeof(PacketHeader) + sizeof(PacketHeaderExt)];
+    int headerSize = static_cast<int>(packetHeaderSize(version));
+    int received = recv(socket, headerBuffer, headerSize, MSG_WAITALL);
+    
+    if (received != headerSize) {
+        return false;  // 连接断开或错误
+    }
+    // 采样的包从第一帧的包头到达开始计时（之前是在等客户端发送）
+    if (t_trace.traceId != 0 && t_trace.startNs == 0) {
+        t_trace.startNs = m_tracer.nowNs();
+    }
+    
+    // 解析头部
+    memcpy(&packet.header, headerBuffer, sizeof(PacketHeader));
+    if (version >= PROTOCOL_VERSION_2) {
+        memcpy(&packet.ext, headerBuffer + sizeof(PacketHeader), sizeof(PacketHeaderExt));
+    }
+    
+    // 验证魔数
+    if (packet.header.magic != PROTOCOL_MAGIC) {
         return false;
     }
     
@@ -284,22 +1356,109 @@ bool FarmServer::receivePacket(socket_t socket, Packet& packet) {
         packet.data.assign(dataBuffer.begin(), dataBuffer.end());
     }
     
+    m_bytesReceived->add(static_cast<uint64_t>(headerSize) + packet.header.length);
     return true;
 }
 
 // 发送数据包
-bool FarmServer::sendPacket(socket_t socket, const Packet& packet) {
-    std::string buffer = packet.serialize();
-    
-    int sent = send(socket, buffer.c_str(), (int)buffer.length(), 0);
+bool FarmServer::sendPacket(socket_t socket, const Packet& packet, uint32_t version) {
+    return sendBytes(socket, packet.serialize(version));
+}
+
+// 一次发送已编码的字节
+bool FarmServer::sendBytes(socket_t socket, const std::string& bytes) {
+    int sent = send(socket, bytes.data(), static_cast<int>(bytes.size()), 0);
+    if (sent > 0) {
+        m_bytesSent->add(static_cast<uint64_t>(sent));
+    }
+    return sent == static_cast<int>(bytes.size());
+}
+
+// 按客户端协商的版本发送（需持有槽位的锁）
+bool FarmServer::sendLocked(ClientSlot& client, const Packet& packet) {
+    uint32_t version = client.protocolVersion.load(std::memory_order_relaxed);
+    if (version >= PROTOCOL_VERSION_2) {
+        ClientCodec* codec = client.codec.get();
+        if (codec || packet.data.size() > MAX_PACKET_SIZE) {
+            std::string local;
+            return encodeFrames(packet, codec ? &codec->compressor : nullptr, codec ? codec->frame : local,
+                                [&](const std::string& frame) { return sendBytes(client.socket, frame); });
+        }
+    } else if (packet.data.size() > MAX_PACKET_SIZE) {
+        // v1没有分片，接收方会拒绝超长的包，改为回复错误
+        std::ostringstream oss;
+        oss << "{\"status\":\"error\",\"error_code\":" << ErrorCode::OPERATION_FAILED
+            << ",\"error_message\":\"Response of " << packet.data.size()
+            << " bytes exceeds the protocol v1 packet limit, use protocol v2 or a stream request\"}";
+        sendPacket(client.socket, Packet(Response::ERROR, oss.str()), version);
+        return false;
+    }
+    return sendPacket(client.socket, packet, version);
+}
+
+// 协议v2按帧编码：超过阈值的部分压缩（compressor为空时不压缩），超过MAX_PACKET_SIZE的消息分片，
+// 除最后一片外都带MORE标志，FINAL只留在最后一片上。每编好一帧交给emit，emit返回false时停止
+bool FarmServer::encodeFrames(const Packet& packet, FrameCompressor* compressor, std::string& frame,
+                              const std::function<bool(const std::string&)>& emit) {
+    // 一帧最多压缩的原文长度；压缩结果放不进一个包时减半重试
+    const size_t maxCompressInput = static_cast<size_t>(MAX_PACKET_SIZE) * 16;
+    const size_t headerSize = packetHeaderSize(PROTOCOL_VERSION_2);
+    const size_t threshold = static_cast<size_t>(std::max(0, m_config.compressThreshold));
     
-    return sent == (int)buffer.length();
+    const std::string& data = packet.data;
+    size_t offset = 0;
+    do {
+        size_t remaining = data.size() - offset;
+        size_t take = std::min(remaining, static_cast<size_t>(MAX_PACKET_SIZE));
+        uint32_t flags = packet.ext.flags;
+        frame.assign(headerSize, '\0');
+        
+        if (compressor && remaining >= threshold) {
+            size_t chunk = std::min(remaining, maxCompressInput);
+            while (compressor->compress(data.data() + offset, chunk, frame)) {
+                if (frame.size() - headerSize <= MAX_PACKET_SIZE) {
+                    flags |= PacketFlag::COMPRESSED;
+                    take = chunk;
+                    break;
+                }
+                frame.resize(headerSize);
+                if (chunk <= MAX_PACKET_SIZE) {
+                    break;
+                }
+                chunk /= 2;
+            }
+        }
+        if (!(flags & PacketFlag::COMPRESSED)) {
+            frame.append(data, offset, take);
+        }
+        offset += take;
+        if (offset < data.size()) {
+            flags = (flags & ~PacketFlag::FINAL) | PacketFlag::MORE;
+        }
+        
+        PacketHeader header;
+        header.command = packet.header.command;
+        header.length = static_cast<uint32_t>(frame.size() - headerSize);
+        PacketHeaderExt ext;
+        ext.requestId = packet.ext.requestId;
+        ext.flags = flags;
+        memcpy(&frame[0], &header, sizeof(header));
+        memcpy(&frame[sizeof(header)], &ext, sizeof(ext));
+        
+        if (!emit(frame)) {
+            return false;
+        }
+    } while (offset < data.size());
+    return true;
 }
 
 // 处理命令
 void FarmServer::handleCommand(int clientId, const Packet& packet) {
-    log(LogLevel::DEBUG, "Received command: 0x" + 
-        std::to_string(packet.header.command), clientId);
+    // 每个请求都经过这里，关闭DEBUG日志时连消息也不拼
+    if (m_config.debugLogging) {
+        log(LogLevel::DEBUG, "Received command: 0x" +
+            std::to_string(packet.header.command), clientId);
+    }
     
     switch (packet.header.command) {
         case Command::CONNECT:
@@ -309,10 +1468,25 @@ void FarmServer::handleCommand(int clientId, const Packet& packet) {
             cleanupClient(clientId);
             break;
         case Command::GET_STATE:
-            handleGetState(clientId);
+            handleGetState(clientId, packet.data);
             break;
         case Command::GET_PLANTS:
-            handleGetPlants(clientId);
+            handleGetPlants(clientId, packet.data);
+            break;
+        case Command::QUERY_CONDITION:
+            handleQueryCondition(clientId, packet.data);
+            break;
+        case Command::FIND_NEAREST:
+            handleFindNearest(clientId, packet.data);
+            break;
+        case Command::EVALUATE_PLAN:
+            handleEvaluatePlan(clientId, packet.data);
+            break;
+        case Command::PLAN_COVERAGE:
+            handlePlanCoverage(clientId, packet.data);
+            break;
+        case Command::GET_METRICS:
+            handleGetMetrics(clientId, packet.data);
             break;
         case Command::MOVE_CART:
             handleMoveCart(clientId, packet.data);
@@ -332,14 +1506,17 @@ void FarmServer::handleCommand(int clientId, const Packet& packet) {
         case Command::REMOVE_WEED:
             handleRemoveWeed(clientId, packet.data);
             break;
+        case Command::BATCH_OPERATION:
+            handleBatchOperation(clientId, packet.data);
+            break;
         case Command::AUTO_FARM_START:
-            handleAutoFarmStart(clientId);
+            handleAutoFarmStart(clientId, packet.data);
             break;
         case Command::AUTO_FARM_STOP:
-            handleAutoFarmStop(clientId);
+            handleAutoFarmStop(clientId, packet.data);
             break;
         case Command::AUTO_FARM_STATUS:
-            handleAutoFarmStatus(clientId);
+            handleAutoFarmStatus(clientId, packet.data);
             break;
         case Command::SWITCH_EQUIPMENT:
             handleSwitchEquipment(clientId, packet.data);
@@ -347,6 +1524,9 @@ void FarmServer::handleCommand(int clientId, const Packet& packet) {
         case Command::SWITCH_CAMERA:
             handleSwitchCamera(clientId, packet.data);
             break;
+        case Command::UPGRADE_TOOL:
+            handleUpgradeTool(clientId, packet.data);
+            break;
         default:
             sendError(clientId, ErrorCode::INVALID_COMMAND, "Unknown command");
             break;
@@ -354,20 +1534,18 @@ void FarmServer::handleCommand(int clientId, const Packet& packet) {
 }
 
 // 发送成功响应
-void FarmServer::sendSuccess(int clientId, const std::string& message) {
+void FarmServer::sendSuccess(int clientId, const std::string& message,
+                             const std::string& extraFields) {
     std::string jsonData = "{\"status\":\"success\"";
     if (!message.empty()) {
         jsonData += ",\"message\":\"" + message + "\"";
     }
+    if (!extraFields.empty()) {
+        jsonData += "," + extraFields;
+    }
     jsonData += "}";
     
-    Packet response(Response::SUCCESS, jsonData);
-    
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    auto it = m_clientSockets.find(clientId);
-    if (it != m_clientSockets.end()) {
-        sendPacket(it->second, response);
-    }
+    sendToClient(clientId, Packet(Response::SUCCESS, jsonData));
 }
 
 // 发送错误响应
@@ -376,33 +1554,36 @@ void FarmServer::sendError(int clientId, uint32_t errorCode, const std::string&
     oss << "{\"status\":\"error\",\"error_code\":" << errorCode 
         << ",\"error_message\":\"" << message << "\"}";
     
-    Packet response(Response::ERROR, oss.str());
-    
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    auto it = m_clientSockets.find(clientId);
-    if (it != m_clientSockets.end()) {
-        sendPacket(it->second, response);
-    }
+    sendToClient(clientId, Packet(Response::ERROR, oss.str()));
 }
 
 // 记录日志
 void FarmServer::log(LogLevel level, const std::string& message, int clientId) {
+    if (level == LogLevel::DEBUG && !m_config.debugLogging) {
+        return;
+    }
     LogEntry entry;
     entry.timestamp = time(nullptr);
     entry.level = level;
     entry.message = message;
     
-    if (clientId >= 0) {
-        std::lock_guard<std::mutex> lock(m_clientsMutex);
-        auto it = m_clientInfos.find(clientId);
-        if (it != m_clientInfos.end()) {
-            entry.clientInfo = it->second.ipAddress + ":" + std::to_string(it->second.port);
+    // 地址是槽位里的原子变量，不加锁读取；读完再确认槽位没有换给新连接
+    ClientSlot* client = findClient(clientId);
+    if (client) {
+        in_addr address;
+        address.s_addr = client->address.load(std::memory_order_relaxed);
+        uint16_t port = client->port.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (client->clientId.load(std::memory_order_relaxed) == clientId) {
+            char ipStr[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &address, ipStr, INET_ADDRSTRLEN);
+            entry.clientInfo = std::string(ipStr) + ":" + std::to_string(port);
         }
     }
     
     // 添加到日志队列
     {
-        std::lock_guard<std::mutex> lock(m_logMutex);
+        PROFILED_LOCK(lock, m_logMutex);
         m_logQueue.push(entry);
         if (m_logQueue.size() > 1000) {  // 限制队列大小
             m_logQueue.pop();
@@ -462,18 +1643,24 @@ void FarmServer::writeLogToFile(const LogEntry& entry) {
 void FarmServer::cleanupClient(int clientId) {
     log(LogLevel::INFO, "Disconnecting client", clientId);
     
-    {
-        std::lock_guard<std::mutex> lock(m_clientsMutex);
-        
-        auto socketIt = m_clientSockets.find(clientId);
-        if (socketIt != m_clientSockets.end()) {
-            CLOSE_SOCKET(socketIt->second);
-            m_clientSockets.erase(socketIt);
+    bool removed = false;
+    ClientSlot* client = findClient(clientId);
+    if (client) {
+        PROFILED_LOCK(lock, client->stateMutex);
+        if (client->clientId.load(std::memory_order_relaxed) == clientId) {
+            // 唤醒阻塞在recv上的读线程和阻塞在send上的发送方；socket由读线程退出时关闭，
+            // 之前fd不会被新连接复用
+            shutdown(client->socket, SD_BOTH);
+            m_timers.cancel(client->timeoutTimer);
+            client->timeoutTimer = INVALID_TIMER;
+            client->clientId.store(0, std::memory_order_release);
+            removed = true;
         }
-        
-        m_clientInfos.erase(clientId);
-        m_status.connectedClients--;
     }
+    if (!removed) {
+        return;     // 已被超时或停止清理过
+    }
+    m_connectedClients->add(-1);
     
     // 触发回调
     if (m_disconnectCallback) {
@@ -481,44 +1668,179 @@ void FarmServer::cleanupClient(int clientId) {
     }
 }
 
-// 检查客户端超时
-void FarmServer::checkClientTimeouts() {
-    time_t now = time(nullptr);
-    std::vector<int> timeoutClients;
+// 设置客户端超时定时器
+void FarmServer::armClientTimeout(int clientId, uint64_t delayMs) {
+    TimerId timer = m_timers.schedule(delayMs, [this, clientId]() {
+        onClientTimeoutTimer(clientId);
+    });
     
+    ClientSlot* client = findClient(clientId);
+    if (client) {
+        PROFILED_LOCK(lock, client->stateMutex);
+        if (client->clientId.load(std::memory_order_relaxed) == clientId) {
+            client->timeoutTimer = timer;
+            return;
+        }
+    }
+    m_timers.cancel(timer);  // 客户端已断开
+}
+
+// 客户端超时定时器到期
+// 期间有活动则按剩余时间重新设置，否则断开
+void FarmServer::onClientTimeoutTimer(int clientId) {
+    uint64_t timeoutMs = static_cast<uint64_t>(m_config.clientTimeout) * 1000;
+    uint64_t idleMs = 0;
     {
-        std::lock_guard<std::mutex> lock(m_clientsMutex);
-        for (const auto& pair : m_clientInfos) {
-            if (now - pair.second.lastActivityTime > m_config.clientTimeout) {
-                timeoutClients.push_back(pair.first);
-            }
+        ClientSlot* client = findClient(clientId);
+        if (!client) {
+            return;
+        }
+        PROFILED_LOCK(lock, client->stateMutex);
+        if (client->clientId.load(std::memory_order_relaxed) != clientId) {
+            return;
         }
+        client->timeoutTimer = INVALID_TIMER;
+        uint64_t now = m_timers.nowMs();
+        uint64_t lastActivityMs = client->lastActivityMs.load(std::memory_order_relaxed);
+        idleMs = now > lastActivityMs ? now - lastActivityMs : 0;
     }
     
-    for (int clientId : timeoutClients) {
-        log(LogLevel::WARNING, "Client timeout", clientId);
-        cleanupClient(clientId);
+    if (idleMs < timeoutMs) {
+        armClientTimeout(clientId, timeoutMs - idleMs);
+        return;
     }
+    
+    log(LogLevel::WARNING, "Client timeout", clientId);
+    cleanupClient(clientId);
+}
+
+// 状态心跳，周期性推送当前状态（由推送线程构建和发送，定时器线程不阻塞）
+void FarmServer::onHeartbeat() {
+    if (m_connectedClients->value() == 0) {
+        return;
+    }
+    {
+        PROFILED_LOCK(lock, m_pushMutex);
+        m_statePushPending = true;
+    }
+    m_pushCv.notify_one();
+}
+
+// 按预计到达时间调度运动完成事件
+void FarmServer::scheduleMoveCompletion(int clientId, int cartId, uint32_t moveSeq) {
+    double seconds = m_motion.estimateRemainingSeconds(cartId);
+    uint64_t delayMs = static_cast<uint64_t>(seconds * 1000.0) + 1;
+    m_timers.schedule(delayMs, [this, clientId, cartId, moveSeq]() {
+        onMoveCompletionTimer(clientId, cartId, moveSeq);
+    });
+}
+
+// 运动完成事件到期
+void FarmServer::onMoveCompletionTimer(int clientId, int cartId, uint32_t moveSeq) {
+    CartSnapshot cart;
+    if (!m_motion.getCart(cartId, cart) || cart.moveSeq != moveSeq) {
+        return;  // 已被新命令取代或停止
+    }
+    if (cart.moving) {
+        // 积分略有滞后，再等一会儿
+        scheduleMoveCompletion(clientId, cartId, moveSeq);
+        return;
+    }
+    
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3)
+        << "{\"action\":\"move\",\"cart_id\":" << cartId
+        << ",\"x\":" << cart.x << ",\"z\":" << cart.z
+        << ",\"rotation\":" << cart.rotation << "}";
+    queuePush(clientId, Packet(Response::ACTION_COMPLETE, oss.str()));
 }
 
 // 获取服务器状态
 ServerStatus FarmServer::getStatus() const {
-    return m_status;
+    ServerStatus status = m_status;
+    status.connectedClients = static_cast<int>(m_connectedClients->value());
+    status.totalConnections = m_connectionsTotal->value();
+    uint64_t commands = 0;
+    for (const ShardedCounter* counter : m_requestCounters) {
+        commands += counter->value();
+    }
+    status.totalCommandsProcessed = commands;
+    return status;
+}
+
+// 登记所有指标，热路径之后只通过这里保存的指针更新
+void FarmServer::registerMetrics() {
+    m_bytesReceived = m_metrics.counter("farm_received_bytes_total",
+                                        "Bytes read from client connections, frame headers included.");
+    m_bytesSent = m_metrics.counter("farm_sent_bytes_total",
+                                    "Bytes written to client connections, frame headers included.");
+    m_connectionsTotal = m_metrics.counter("farm_connections_total", "Accepted client connections.");
+    m_connectedClients = m_metrics.gauge("farm_connected_clients", "Currently connected clients.");
+    m_requestsInFlight = m_metrics.gauge("farm_requests_in_flight",
+                                         "Protocol v2 requests dispatched but not yet answered.");
+    m_workerQueueDepth = m_metrics.gauge("farm_worker_queue_depth",
+                                         "Protocol v2 requests waiting for a worker thread.");
+    m_uptimeSeconds = m_metrics.gauge("farm_uptime_seconds", "Seconds since the server started.");
+    m_pushesDropped = m_metrics.counter("farm_push_dropped_total",
+                                        "Pushes to single clients dropped because the push queue was full.");
+    
+    auto add = [this](const std::string& name) {
+        std::string labels = "command=\"" + name + "\"";
+        CommandMetrics metrics;
+        metrics.requests = m_metrics.counter("farm_requests_total", "Requests handled, by command.", labels);
+        metrics.latency = m_metrics.histogram("farm_request_duration_seconds",
+            "Time from reading a request to sending its final reply, queueing included.", labels);
+        metrics.handler = m_metrics.histogram("farm_handler_duration_seconds",
+            "Time spent in the command handler, journal waits and reply sends excluded.", labels);
+        m_requestCounters.push_back(metrics.requests);
+        return metrics;
+    };
+    CommandMetrics unknown = add("unknown");
+    for (size_t command = 0; command < COMMAND_METRIC_SLOTS; command++) {
+        std::string name = commandToString(static_cast<uint32_t>(command));
+        m_commandMetrics[command] = name != "unknown" ? add(name) : unknown;
+    }
+}
+
+void FarmServer::recordRequest(uint32_t command, std::chrono::steady_clock::time_point received,
+                               std::chrono::steady_clock::duration handlerTime) {
+    auto done = std::chrono::steady_clock::now();
+    const CommandMetrics& metrics = m_commandMetrics[command < COMMAND_METRIC_SLOTS ? command : 0];
+    metrics.requests->add();
+    metrics.latency->record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(done - received).count()));
+    metrics.handler->record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(handlerTime).count()));
+}
+
+std::string FarmServer::exportMetrics() {
+    m_workerQueueDepth->set(static_cast<int64_t>(m_workers.pending()));
+    m_uptimeSeconds->set(m_status.isRunning ? static_cast<int64_t>(time(nullptr) - m_status.startTime) : 0);
+    return m_metrics.exportText() + exportLockProfileText();
 }
 
 // 获取连接的客户端列表
 std::vector<ClientInfo> FarmServer::getConnectedClients() const {
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
     std::vector<ClientInfo> clients;
-    for (const auto& pair : m_clientInfos) {
-        clients.push_back(pair.second);
+    for (uint32_t index = 0; index < m_clientSlots.size(); index++) {
+        ClientSlot& client = *m_clientSlots.get(index);
+        if (client.clientId.load(std::memory_order_acquire) == 0) {
+            continue;
+        }
+        PROFILED_LOCK(lock, client.stateMutex);
+        if (client.clientId.load(std::memory_order_relaxed) != 0) {
+            clients.push_back(describeClient(client));
+        }
     }
+    std::sort(clients.begin(), clients.end(), [](const ClientInfo& a, const ClientInfo& b) {
+        return a.clientId < b.clientId;
+    });
     return clients;
 }
 
 // 获取最近的日志
 std::vector<LogEntry> FarmServer::getRecentLogs(int count) const {
-    std::lock_guard<std::mutex> lock(m_logMutex);
+    PROFILED_LOCK(lock, m_logMutex);
     std::vector<LogEntry> logs;
     
     std::queue<LogEntry> tempQueue = m_logQueue;
@@ -531,76 +1853,861 @@ std::vector<LogEntry> FarmServer::getRecentLogs(int count) const {
 }
 
 // 命令处理函数（占位符实现）
+// protocol_version为2时升级连接：本条回复仍按v1发送，之后双向都使用v2头部
 void FarmServer::handleConnect(int clientId, const std::string& data) {
     // TODO: 验证客户端身份
+    JsonValue json;
+    JsonValue::parse(data, json);
+    uint32_t requested = json.getInt("protocol_version", PROTOCOL_VERSION_1) >= PROTOCOL_VERSION_2
+                             ? PROTOCOL_VERSION_2 : PROTOCOL_VERSION_1;
+    std::string compression = json.getString("compression", "none");
+    
+    ClientSlot* slot = findClient(clientId);
+    if (!slot) {
+        return;
+    }
+    ClientSlot& client = *slot;
+    PROFILED_LOCK(lock, client.mutex);
+    if (client.clientId.load(std::memory_order_relaxed) != clientId) {
+        return;
+    }
     {
-        std::lock_guard<std::mutex> lock(m_clientsMutex);
-        auto it = m_clientInfos.find(clientId);
-        if (it != m_clientInfos.end()) {
-            it->second.isAuthorized = true;
+        PROFILED_LOCK(stateLock, client.stateMutex);
+        client.isAuthorized = true;
+    }
+    // 已升级的连接不降级
+    uint32_t version = std::max(client.protocolVersion.load(std::memory_order_relaxed), requested);
+    
+    std::ostringstream oss;
+    oss << "{\"status\":\"success\",\"message\":\"Connected successfully\""
+        << ",\"protocol_version\":" << version;
+    // 压缩只在v2连接上可用（标志位在v2头部里）
+    bool compress = version >= PROTOCOL_VERSION_2 && compression == "lz4";
+    if (version >= PROTOCOL_VERSION_2) {
+        oss << ",\"max_in_flight\":" << m_config.maxInFlight
+            << ",\"compression\":\"" << (compress ? "lz4" : "none") << "\"";
+        if (compress) {
+            oss << ",\"compress_threshold\":" << m_config.compressThreshold;
         }
     }
-    sendSuccess(clientId, "Connected successfully");
+    oss << "}";
+    
+    Packet response(Response::SUCCESS, oss.str());
+    RequestContext* request = t_request;
+    if (request && request->server == this && request->clientId == clientId && request->tagged) {
+        // 已是v2连接上的请求
+        response.ext.requestId = request->requestId;
+        response.ext.flags = PacketFlag::RESPONSE | PacketFlag::FINAL;
+    }
+    // 回复与版本切换在同一次加锁内完成，其他线程的推送不会夹在中间
+    sendLocked(client, response);
+    client.protocolVersion.store(version, std::memory_order_release);
+    if (compress) {
+        if (!client.codec) {
+            client.codec.reset(new ClientCodec());  // 创建该连接的压缩上下文
+        }
+    } else if (version >= PROTOCOL_VERSION_2 && json.has("compression")) {
+        client.codec.reset();
+    }
 }
 
-void FarmServer::handleGetState(int clientId) {
-    // TODO: 调用Python获取状态
-    std::string stateJson = "{\"cart\":{\"x\":0,\"z\":0,\"rotation\":0},\"energy\":100,\"coins\":100}";
-    Packet response(Response::STATE_UPDATE, stateJson);
-    sendToClient(clientId, response);
+// 构建状态JSON
+std::string FarmServer::buildStateJson() const {
+    CartSnapshot cart;
+    m_motion.getCart(0, cart);
+    
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3)
+        << "{\"cart\":{\"x\":" << cart.x << ",\"z\":" << cart.z
+        << ",\"rotation\":" << cart.rotation << ",\"speed\":" << cart.speed
+        << "}," << m_ledger.buildJsonFields() << "}";
+    return oss.str();
 }
 
-void FarmServer::handleGetPlants(int clientId) {
-    // TODO: 调用Python获取植物信息
-    std::string plantsJson = "{\"plants\":[]}";
+// history > 0 时附带最近的资源变化记录
+void FarmServer::handleGetState(int clientId, const std::string& data) {
+    JsonValue json;
+    int history = 0;
+    if (JsonValue::parse(data, json)) {
+        history = std::max(0, std::min(json.getInt("history", 0), ResourceLedger::LOG_CAPACITY));
+    }
+    
+    std::string state = buildStateJson();
+    if (history > 0) {
+        std::vector<LedgerEntry> entries;
+        m_ledger.recentChanges(static_cast<size_t>(history), entries);
+        
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(3) << ",\"resource_log\":[";
+        for (size_t i = 0; i < entries.size(); i++) {
+            const LedgerEntry& entry = entries[i];
+            std::string type = ledgerResourceToString(entry.resource);
+            if (entry.resource == LedgerResource::SEED) {
+                type += "_" + plantTypeToString(static_cast<PlantType>(entry.detail));
+            } else if (entry.resource == LedgerResource::TOOL) {
+                type += std::string("_") + resourceToolToString(static_cast<ResourceTool>(entry.detail));
+            }
+            if (i > 0) oss << ",";
+            oss << "{\"timestamp\":" << entry.timestamp
+                << ",\"resource_type\":\"" << type << "\""
+                << ",\"amount\":" << entry.amount
+                << ",\"change_type\":\"" << ledgerChangeToString(entry.change) << "\"}";
+        }
+        oss << "]";
+        state.insert(state.size() - 1, oss.str());
+    }
+    sendToClient(clientId, Packet(Response::STATE_UPDATE, state));
+}
+
+void FarmServer::handleGetPlants(int clientId, const std::string& data) {
+    JsonValue json;
+    if (JsonValue::parse(data, json) && json.getBool("stream", false)) {
+        streamPlants(clientId);
+        return;
+    }
+    
+    std::string plantsJson;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        plantsJson = m_field.buildPlantsJson(farmClockNow());
+    }
     Packet response(Response::PLANT_DATA, plantsJson);
     sendToClient(clientId, response);
 }
 
+// 分块导出所有植物：STREAM_BEGIN、若干STREAM_CHUNK（每株一行JSON）、STREAM_END；
+// 每块单独加锁，导出期间不长时间占用农田锁，内存占用与农田大小无关
+void FarmServer::streamPlants(int clientId) {
+    const size_t chunkBytes = MAX_PACKET_SIZE / 2;     // 最后一行可能略超出
+    int rows = 0, cols = 0;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        rows = m_field.rows();
+        cols = m_field.cols();
+    }
+    std::ostringstream begin;
+    begin << "{\"kind\":\"plants\",\"timestamp\":" << time(nullptr)
+          << ",\"grid_size\":[" << rows << "," << cols << "]}";
+    if (!sendToClient(clientId, Packet(Response::STREAM_BEGIN, begin.str()))) {
+        return;
+    }
+    
+    size_t cursor = 0;
+    size_t plants = 0;
+    size_t chunks = 0;
+    size_t bytes = 0;
+    std::string chunk;
+    bool done = false;
+    while (!done) {
+        chunk.clear();
+        {
+            PROFILED_LOCK(lock, m_farmMutex);
+            plants += m_field.appendPlantLines(cursor, farmClockNow(), chunk, chunkBytes);
+            done = cursor >= m_field.cellCount();
+        }
+        if (chunk.empty()) {
+            continue;
+        }
+        if (!sendToClient(clientId, Packet(Response::STREAM_CHUNK, chunk))) {
+            return;
+        }
+        chunks++;
+        bytes += chunk.size();
+    }
+    
+    std::ostringstream end;
+    end << "{\"kind\":\"plants\",\"count\":" << plants
+        << ",\"chunks\":" << chunks << ",\"bytes\":" << bytes << "}";
+    sendToClient(clientId, Packet(Response::STREAM_END, end.str()));
+}
+
+// 按条件查询植物，结果分块推送，最后一块final为true
+void FarmServer::handleQueryCondition(int clientId, const std::string& data) {
+    JsonValue json;
+    PlantCondition condition;
+    if (!JsonValue::parse(data, json) ||
+        !stringToCondition(json.getString("condition", ""), condition)) {
+        sendError(clientId, ErrorCode::INVALID_DATA,
+                  "condition must be needs_water, needs_weeding, ripe or empty");
+        return;
+    }
+    
+    int chunkSize = json.getInt("chunk_size", 512);
+    if (chunkSize < 1) chunkSize = 1;
+    if (chunkSize > 4096) chunkSize = 4096;
+    int limit = json.getInt("limit", 0);
+    
+    std::vector<int> cells;
+    int cols = 1;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        m_field.queryCondition(condition, cells, limit > 0 ? static_cast<size_t>(limit) : 0);
+        cols = m_field.cols();
+    }
+    
+    std::string name = conditionToString(condition);
+    size_t total = cells.size();
+    size_t offset = 0;
+    int seq = 0;
+    do {
+        size_t end = std::min(total, offset + static_cast<size_t>(chunkSize));
+        std::ostringstream oss;
+        oss << "{\"condition\":\"" << name << "\",\"seq\":" << seq
+            << ",\"total\":" << total << ",\"cells\":[";
+        for (size_t i = offset; i < end; i++) {
+            if (i > offset) oss << ",";
+            oss << "[" << cells[i] / cols << "," << cells[i] % cols << "]";
+        }
+        oss << "],\"final\":" << (end >= total ? "true" : "false") << "}";
+        
+        if (!sendToClient(clientId, Packet(Response::CONDITION_DATA, oss.str()))) {
+            return;
+        }
+        offset = end;
+        seq++;
+    } while (offset < total);
+}
+
+void FarmServer::handleFindNearest(int clientId, const std::string& data) {
+    JsonValue json;
+    if (!JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    PlantCondition condition;
+    if (!stringToCondition(json.getString("condition", "ripe"), condition)) {
+        sendError(clientId, ErrorCode::INVALID_DATA,
+                  "condition must be needs_water, needs_weeding, ripe or empty");
+        return;
+    }
+    
+    int count = json.getInt("count", 1);
+    if (count < 1) count = 1;
+    if (count > 64) count = 64;
+    bool skipClaimed = json.getBool("skip_claimed", true);
+    
+    // 起点：显式的row/col，否则取小车当前位置
+    CartSnapshot cart;
+    bool fromCart = !json.has("row") || !json.has("col");
+    if (fromCart && !m_motion.getCart(json.getInt("cart_id", 0), cart)) {
+        cart.x = cart.z = 0.0;
+    }
+    
+    std::vector<int> cells;
+    int row = json.getInt("row", 0);
+    int col = json.getInt("col", 0);
+    int cols = 1;
+    double cellSize = 0.0;
+    bool valid = true;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        if (fromCart) {
+            m_field.worldToCell(cart.x, cart.z, row, col);
+            row = std::max(0, std::min(row, m_field.rows() - 1));
+            col = std::max(0, std::min(col, m_field.cols() - 1));
+        }
+        valid = m_field.inBounds(row, col);
+        if (valid) {
+            m_field.findNearest(condition, row, col, static_cast<size_t>(count), cells, skipClaimed);
+        }
+        cols = m_field.cols();
+        cellSize = m_field.cellSize();
+    }
+    if (!valid) {
+        sendError(clientId, ErrorCode::INVALID_POSITION, "Position out of range");
+        return;
+    }
+    
+    std::ostringstream oss;
+    oss << "{\"condition\":\"" << conditionToString(condition) << "\""
+        << ",\"origin\":[" << row << "," << col << "],\"targets\":[";
+    for (size_t i = 0; i < cells.size(); i++) {
+        int r = cells[i] / cols;
+        int c = cells[i] % cols;
+        double distance = std::sqrt(static_cast<double>((r - row) * (r - row) + (c - col) * (c - col)));
+        if (i > 0) oss << ",";
+        oss << "{\"id\":\"plant_" << r << "_" << c << "\",\"row\":" << r << ",\"col\":" << c
+            << ",\"distance\":" << distance * cellSize << "}";
+    }
+    oss << "]}";
+    sendToClient(clientId, Packet(Response::NEAREST_DATA, oss.str()));
+}
+
+// 评估任务计划的资源可行性（对应simulate_resource_usage）
+void FarmServer::handleEvaluatePlan(int clientId, const std::string& data) {
+    JsonValue json;
+    const JsonValue* tasks = nullptr;
+    if (!JsonValue::parse(data, json) || !(tasks = json.find("tasks")) || !tasks->isArray()) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Missing tasks array");
+        return;
+    }
+    double speed = json.getNumber("speed", DEFAULT_CART_SPEED);
+    if (speed <= 0.0) speed = DEFAULT_CART_SPEED;
+    
+    std::vector<PlannedTask> plan;
+    plan.reserve(tasks->items().size());
+    for (const JsonValue& item : tasks->items()) {
+        PlannedTask step;
+        std::string error;
+        if (!parsePlannedTask(item, speed, step, error)) {
+            sendError(clientId, ErrorCode::INVALID_DATA, error);
+            return;
+        }
+        plan.push_back(step);
+    }
+    
+    PlanEvaluation result = m_ledger.evaluatePlan(plan);
+    sendToClient(clientId, Packet(Response::PLAN_RESULT, planResultJson(plan.size(), result)));
+}
+
+void FarmServer::handlePlanCoverage(int clientId, const std::string& data) {
+    JsonValue json;
+    if (!data.empty() && !JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    SweepDirection direction;
+    if (!stringToSweepDirection(json.getString("direction", "auto"), direction)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "direction must be auto, rows or columns");
+        return;
+    }
+    int cartId = json.getInt("cart_id", 0);
+    bool follow = json.getBool("follow", false);
+    double speed = json.getNumber("speed", DEFAULT_CART_SPEED);
+    if (follow && (cartId < 0 || cartId >= m_config.maxCarts || speed <= 0.0)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid cart id or speed");
+        return;
+    }
+    
+    // 起点：显式的row/col，否则取小车当前位置
+    CartSnapshot cart;
+    bool fromCart = !json.has("row") || !json.has("col");
+    if (fromCart && !m_motion.getCart(cartId, cart)) {
+        cart.x = cart.z = 0.0;
+    }
+    
+    int row = json.getInt("row", 0);
+    int col = json.getInt("col", 0);
+    PathPlanner planner;
+    double cellSize = 0.0;
+    std::vector<std::pair<double, double>> points;
+    CoveragePath path;
+    bool planned = false;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        if (fromCart) {
+            m_field.worldToCell(cart.x, cart.z, row, col);
+            row = std::max(0, std::min(row, m_field.rows() - 1));
+            col = std::max(0, std::min(col, m_field.cols() - 1));
+        }
+        planner.resize(m_field.rows(), m_field.cols());
+        cellSize = m_field.cellSize();
+        
+        const JsonValue* obstacles = json.find("obstacles");
+        if (obstacles && obstacles->isArray()) {
+            for (const JsonValue& item : obstacles->items()) {
+                if (item.isArray() && item.items().size() >= 2) {
+                    planner.addObstacle(static_cast<int>(item.items()[0].asNumber()),
+                                        static_cast<int>(item.items()[1].asNumber()));
+                }
+            }
+        }
+        
+        CoveragePlanner coverage(planner);
+        planned = coverage.plan(GridPos(row, col), path, direction);
+        if (planned && follow) {
+            points.reserve(path.waypoints.size());
+            for (const CoverageWaypoint& point : path.waypoints) {
+                double x = 0.0, z = 0.0;
+                m_field.cellToWorld(point.row, point.col, x, z);
+                points.push_back(std::make_pair(x, z));
+            }
+        }
+    }
+    if (!planned) {
+        sendError(clientId, ErrorCode::INVALID_POSITION, "Start position is out of range or blocked");
+        return;
+    }
+    
+    // 跟随路径时按整条路径长度扣除移动能耗（先从小车位置到起点）
+    uint32_t moveSeq = 0;
+    if (follow) {
+        CartSnapshot current;
+        m_motion.getCart(cartId, current);
+        double distance = std::sqrt((points[0].first - current.x) * (points[0].first - current.x) +
+                                    (points[0].second - current.z) * (points[0].second - current.z)) +
+                          (path.stats.sweepLength + path.stats.transitLength) * cellSize;
+        if (m_ledger.chargeMove(distance) != LedgerResult::OK) {
+            sendError(clientId, ErrorCode::INSUFFICIENT_ENERGY, "Not enough energy to cover the field");
+            return;
+        }
+        if (!m_motion.followPath(cartId, points, speed, DEFAULT_CART_TURN_RATE, &moveSeq)) {
+            m_ledger.addEnergy(m_ledger.moveCost(distance));
+            sendError(clientId, ErrorCode::OPERATION_FAILED, "Cart cannot follow the path");
+            return;
+        }
+    }
+    
+    const CoverageStats& stats = path.stats;
+    std::ostringstream oss;
+    oss << "{\"origin\":[" << row << "," << col << "]"
+        << ",\"direction\":\"" << (path.alongRows ? "rows" : "columns") << "\""
+        << ",\"regions\":" << stats.regions
+        << ",\"covered_cells\":" << stats.coveredCells
+        << ",\"unreachable_cells\":" << stats.unreachableCells
+        << ",\"turns\":" << stats.turns
+        << ",\"sweep_length\":" << stats.sweepLength * cellSize
+        << ",\"transit_length\":" << stats.transitLength * cellSize
+        << ",\"following\":" << (follow ? "true" : "false");
+    if (follow) {
+        oss << ",\"move_seq\":" << moveSeq;
+    }
+    oss << ",\"waypoint_count\":" << path.waypoints.size() << ",\"waypoints\":[";
+    // 每个点为 [row, col, 1作业/0空驶]；超出单包上限时截断
+    size_t sent = 0;
+    for (const CoverageWaypoint& point : path.waypoints) {
+        if (static_cast<size_t>(oss.tellp()) > MAX_PACKET_SIZE - 256) {
+            break;
+        }
+        if (sent > 0) oss << ",";
+        oss << "[" << point.row << "," << point.col << "," << (point.sweep ? 1 : 0) << "]";
+        sent++;
+    }
+    oss << "],\"truncated\":" << (sent < path.waypoints.size() ? "true" : "false") << "}";
+    sendToClient(clientId, Packet(Response::COVERAGE_DATA, oss.str()));
+    if (follow) {
+        scheduleMoveCompletion(clientId, cartId, moveSeq);
+    }
+}
+
 void FarmServer::handleMoveCart(int clientId, const std::string& data) {
-    // TODO: 调用Python移动小车
+    JsonValue json;
+    if (!JsonValue::parse(data, json) || !json.has("target_x") || !json.has("target_z")) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Missing target_x/target_z");
+        return;
+    }
+    
+    int cartId = json.getInt("cart_id", 0);
+    double targetX = json.getNumber("target_x", 0.0);
+    double targetZ = json.getNumber("target_z", 0.0);
+    double speed = json.getNumber("speed", DEFAULT_CART_SPEED);
+    double turnRate = json.getNumber("turn_rate", DEFAULT_CART_TURN_RATE);
+    
+    // 移动能耗按直线距离计（小车尚未创建时从原点出发）
+    CartSnapshot cart;
+    m_motion.getCart(cartId, cart);
+    double distance = std::sqrt((targetX - cart.x) * (targetX - cart.x) +
+                                (targetZ - cart.z) * (targetZ - cart.z));
+    if (m_ledger.chargeMove(distance) != LedgerResult::OK) {
+        sendError(clientId, ErrorCode::INSUFFICIENT_ENERGY, "Not enough energy to move");
+        return;
+    }
+    
+    uint32_t moveSeq = 0;
+    if (!m_motion.moveTo(cartId, targetX, targetZ, speed, turnRate, &moveSeq)) {
+        m_ledger.addEnergy(m_ledger.moveCost(distance));
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid cart id or speed");
+        return;
+    }
     sendSuccess(clientId, "Cart movement initiated");
+    scheduleMoveCompletion(clientId, cartId, moveSeq);
 }
 
 void FarmServer::handleRotateCart(int clientId, const std::string& data) {
-    // TODO: 调用Python旋转小车
+    JsonValue json;
+    if (!JsonValue::parse(data, json) || !json.has("target_rotation")) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Missing target_rotation");
+        return;
+    }
+    
+    int cartId = json.getInt("cart_id", 0);
+    double targetRotation = json.getNumber("target_rotation", 0.0);
+    double turnRate = json.getNumber("turn_rate", DEFAULT_CART_TURN_RATE);
+    
+    uint32_t moveSeq = 0;
+    if (!m_motion.rotateTo(cartId, targetRotation, turnRate, &moveSeq)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid cart id or turn rate");
+        return;
+    }
     sendSuccess(clientId, "Cart rotation initiated");
+    scheduleMoveCompletion(clientId, cartId, moveSeq);
 }
 
 void FarmServer::handlePlantSeed(int clientId, const std::string& data) {
-    // TODO: 调用Python播种
+    JsonValue json;
+    int row = 0, col = 0;
+    if (!JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    if (!parseCellPosition(clientId, json, row, col)) {
+        return;
+    }
+    
+    PlantType type = PlantType::WHEAT;
+    std::string seedType = json.getString("seed_type", "wheat");
+    if (!stringToPlantType(seedType, type)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Unknown seed type: " + seedType);
+        return;
+    }
+    
+    TaskCharge cost;
+    if (!chargeTask(clientId, cost, TaskType::PLANTING, type)) {
+        return;
+    }
+    FarmResult result;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        result = m_field.plantSeed(row, col, type, farmClockNow());
+    }
+    if (result != FarmResult::OK) {
+        m_ledger.refundTask(cost);
+        sendFarmError(clientId, result);
+        return;
+    }
     sendSuccess(clientId, "Seed planted");
 }
 
 void FarmServer::handleWaterPlant(int clientId, const std::string& data) {
-    // TODO: 调用Python浇水
+    JsonValue json;
+    int row = 0, col = 0;
+    if (!JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    if (!parseCellPosition(clientId, json, row, col)) {
+        return;
+    }
+    
+    TaskCharge cost;
+    if (!chargeTask(clientId, cost, TaskType::WATERING)) {
+        return;
+    }
+    FarmResult result;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        result = m_field.water(row, col, farmClockNow());
+    }
+    if (result != FarmResult::OK) {
+        m_ledger.refundTask(cost);
+        sendFarmError(clientId, result);
+        return;
+    }
     sendSuccess(clientId, "Plant watered");
 }
 
 void FarmServer::handleHarvest(int clientId, const std::string& data) {
-    // TODO: 调用Python收获
-    sendSuccess(clientId, "Plant harvested");
+    JsonValue json;
+    int row = 0, col = 0;
+    if (!JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    if (!parseCellPosition(clientId, json, row, col)) {
+        return;
+    }
+    
+    TaskCharge cost;
+    if (!chargeTask(clientId, cost, TaskType::HARVEST)) {
+        return;
+    }
+    FarmResult result;
+    HarvestResult harvest;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        result = m_field.harvest(row, col, farmClockNow(), harvest);
+    }
+    if (result != FarmResult::OK) {
+        m_ledger.refundTask(cost);
+        sendFarmError(clientId, result);
+        return;
+    }
+    m_ledger.addCoins(harvest.value, LedgerChange::HARVEST);
+    
+    std::ostringstream fields;
+    fields << "\"plant_type\":\"" << plantTypeToString(harvest.type) << "\""
+           << ",\"yield\":" << harvest.yieldAmount
+           << ",\"value\":" << harvest.value;
+    sendSuccess(clientId, "Plant harvested", fields.str());
 }
 
 void FarmServer::handleRemoveWeed(int clientId, const std::string& data) {
-    // TODO: 调用Python除草
+    JsonValue json;
+    int row = 0, col = 0;
+    if (!JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    if (!parseCellPosition(clientId, json, row, col)) {
+        return;
+    }
+    
+    TaskCharge cost;
+    if (!chargeTask(clientId, cost, TaskType::WEED_REMOVAL)) {
+        return;
+    }
+    FarmResult result;
+    {
+        PROFILED_LOCK(lock, m_farmMutex);
+        result = m_field.removeWeeds(row, col, farmClockNow());
+    }
+    if (result != FarmResult::OK) {
+        m_ledger.refundTask(cost);
+        sendFarmError(clientId, result);
+        return;
+    }
     sendSuccess(clientId, "Weed removed");
 }
 
-void FarmServer::handleAutoFarmStart(int clientId) {
-    // TODO: 调用Python启动自动化
+// 批量农田操作：先整体校验，再在一次农田锁内逐条执行
+// 单条失败不影响其他条目，结果按位返回（第i条成功则第i位为1）
+// 超过单包大小的批量操作用batch流（STREAM_BEGIN）上传
+void FarmServer::handleBatchOperation(int clientId, const std::string& data) {
+    JsonValue json;
+    if (!JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    const JsonValue* items = json.find("ops");
+    if (!items || !items->isArray() || items->items().empty()) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Missing ops array");
+        return;
+    }
+    if (items->items().size() > MAX_BATCH_OPS) {
+        sendError(clientId, ErrorCode::INVALID_DATA,
+                  "Too many ops (max " + std::to_string(MAX_BATCH_OPS) + ")");
+        return;
+    }
+    
+    std::vector<BatchOp> ops(items->items().size());
+    for (size_t i = 0; i < ops.size(); i++) {
+        std::string error;
+        if (!parseBatchOp(items->items()[i], ops[i], error)) {
+            sendError(clientId, ErrorCode::INVALID_DATA,
+                      "Invalid op " + std::to_string(i) + ": " + error);
+            return;
+        }
+    }
+    
+    BatchTally tally;
+    executeBatch(m_field, m_farmMutex, m_ledger, ops, tally);
+    sendSuccess(clientId, "Batch executed", tally.fields());
+}
+
+// 上传流：STREAM_BEGIN打开（每个连接同时只有一个），STREAM_CHUNK成功时不回复，
+// STREAM_END时由接收端生成回复；出错时回复错误并关闭流
+void FarmServer::handleStreamCommand(int clientId, const Packet& packet,
+                                     std::unique_ptr<StreamSink>& upload) {
+    if (packet.header.command == Command::STREAM_BEGIN) {
+        if (upload) {
+            sendError(clientId, ErrorCode::RESOURCE_BUSY,
+                      std::string("A ") + upload->kind() + " stream is already open");
+            return;
+        }
+        JsonValue json;
+        JsonValue::parse(packet.data, json);
+        std::string kind = json.getString("kind", "");
+        if (kind == "batch") {
+            upload.reset(new BatchStreamSink(m_field, m_farmMutex, m_ledger));
+        } else if (kind == "plan") {
+            double speed = json.getNumber("speed", DEFAULT_CART_SPEED);
+            if (speed <= 0.0) speed = DEFAULT_CART_SPEED;
+            upload.reset(new PlanStreamSink(m_ledger, speed));
+        } else {
+            sendError(clientId, ErrorCode::INVALID_DATA, "kind must be batch or plan");
+            return;
+        }
+        sendSuccess(clientId, "Stream opened",
+                    "\"stream\":\"" + kind + "\",\"max_line\":" + std::to_string(MAX_PACKET_SIZE));
+        return;
+    }
+    
+    if (!upload) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "No open stream");
+        return;
+    }
+    std::string error;
+    if (packet.header.command == Command::STREAM_CHUNK) {
+        if (!upload->consume(packet.data.data(), packet.data.size(), error)) {
+            upload.reset();
+            sendError(clientId, ErrorCode::INVALID_DATA, error);
+            return;
+        }
+        // 成功的块不回复，这一块执行的操作在这里等落盘，写盘失败时关闭流
+        if (!waitRequestJournal()) {
+            upload.reset();
+            sendError(clientId, ErrorCode::OPERATION_FAILED,
+                      "Journal write failed, the change is lost on restart and the farm is read-only");
+        }
+        return;
+    }
+    
+    Packet reply;
+    bool finished = upload->finish(reply, error);
+    upload.reset();
+    if (!finished) {
+        sendError(clientId, ErrorCode::INVALID_DATA, error);
+        return;
+    }
+    sendToClient(clientId, reply);
+}
+
+// 解析操作位置：优先使用row/col，其次解析plant_id（"plant_<row>_<col>"）
+bool FarmServer::parseCellPosition(int clientId, const JsonValue& json, int& row, int& col) {
+    if (json.has("row") && json.has("col")) {
+        row = json.getInt("row", -1);
+        col = json.getInt("col", -1);
+        return true;
+    }
+    
+    std::string plantId = json.getString("plant_id", "");
+    if (sscanf(plantId.c_str(), "plant_%d_%d", &row, &col) == 2) {
+        return true;
+    }
+    
+    sendError(clientId, ErrorCode::INVALID_DATA, "Missing row/col or plant_id");
+    return false;
+}
+
+// 农田操作结果转错误响应
+void FarmServer::sendFarmError(int clientId, FarmResult result) {
+    uint32_t code = ErrorCode::OPERATION_FAILED;
+    const char* message = "Operation failed";
+    describeFarmResult(result, code, message);
+    sendError(clientId, code, message);
+}
+
+// 扣除操作所需资源，不足时发送错误；charged记下实际扣除的量，失败时按它退回
+bool FarmServer::chargeTask(int clientId, TaskCharge& charged, TaskType type, PlantType seed) {
+    switch (m_ledger.chargeTask(type, seed, charged)) {
+        case LedgerResult::OK:
+            return true;
+        case LedgerResult::INSUFFICIENT_ENERGY:
+            sendError(clientId, ErrorCode::INSUFFICIENT_ENERGY, "Not enough energy");
+            return false;
+        case LedgerResult::INSUFFICIENT_SEEDS:
+            sendError(clientId, ErrorCode::OPERATION_FAILED,
+                      "Not enough " + plantTypeToString(seed) + " seeds");
+            return false;
+        default:
+            sendError(clientId, ErrorCode::OPERATION_FAILED, "Operation failed");
+            return false;
+    }
+}
+
+void FarmServer::handleUpgradeTool(int clientId, const std::string& data) {
+    JsonValue json;
+    ResourceTool tool;
+    if (!JsonValue::parse(data, json) || !stringToResourceTool(json.getString("tool", ""), tool)) {
+        sendError(clientId, ErrorCode::INVALID_DATA,
+                  "tool must be watering_can, weeder, harvester or scanner");
+        return;
+    }
+    
+    LedgerResult result;
+    {
+        // 升级和记日志在农田锁内完成，快照捕获的余额与日志序号保持一致
+        PROFILED_LOCK(lock, m_farmMutex);
+        if (!m_journal.healthy()) {
+            sendError(clientId, ErrorCode::OPERATION_FAILED, "Farm is read-only after a journal write failure");
+            return;
+        }
+        result = m_ledger.upgradeTool(tool);
+        if (result == LedgerResult::OK) {
+            int level = m_ledger.toolLevel(tool);
+            m_journaledLedger.coins -= ResourceLedger::upgradeCost(level - 1);
+            m_journaledLedger.toolLevels[static_cast<int>(tool)] = level;
+            noteJournalSeq(this, m_journal.append(JournalRecord(JournalRecordType::UPGRADE_TOOL,
+                                                                static_cast<uint8_t>(tool), 0, 0, farmClockNow())));
+        }
+    }
+    if (result == LedgerResult::INSUFFICIENT_COINS) {
+        sendError(clientId, ErrorCode::INSUFFICIENT_COINS, "Not enough coins");
+        return;
+    }
+    if (result != LedgerResult::OK) {
+        sendError(clientId, ErrorCode::OPERATION_FAILED, "Tool is at max level");
+        return;
+    }
+    
+    std::ostringstream fields;
+    fields << "\"tool\":\"" << resourceToolToString(tool) << "\""
+           << ",\"level\":" << m_ledger.toolLevel(tool)
+           << ",\"coins\":" << m_ledger.coins();
+    sendSuccess(clientId, "Tool upgraded", fields.str());
+}
+
+// 指标以Prometheus文本格式放在text字段中
+void FarmServer::handleGetMetrics(int clientId, const std::string& data) {
+    std::string text = exportMetrics();
+    sendToClient(clientId, Packet(Response::METRICS_DATA,
+                                  "{\"format\":\"prometheus\",\"text\":\"" + jsonEscape(text) + "\"}"));
+}
+
+// 植物事件到期
+void FarmServer::onPlantEvent(int cellIndex, uint32_t eventSeq) {
+    PROFILED_LOCK(lock, m_farmMutex);
+    m_field.processEvent(cellIndex, eventSeq, farmClockNow());
+}
+
+void FarmServer::handleAutoFarmStart(int clientId, const std::string& data) {
+    JsonValue json;
+    if (!data.empty() && !JsonValue::parse(data, json)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid JSON");
+        return;
+    }
+    
+    int cartId = json.getInt("cart_id", 0);
+    AutoFarmOptions options;
+    std::string seedType = json.getString("seed_type", "wheat");
+    if (!stringToPlantType(seedType, options.seedType)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Unknown seed type: " + seedType);
+        return;
+    }
+    options.speed = json.getNumber("speed", DEFAULT_CART_SPEED);
+    options.actionDelayMs = static_cast<uint64_t>(std::max(0, json.getInt("action_delay_ms", 200)));
+    options.batchSize = json.getInt("batch_size", 16);
+    // 装备：可执行的任务类型，缺省全部
+    const JsonValue* taskTypes = json.find("tasks");
+    if (taskTypes && taskTypes->isArray()) {
+        options.taskMask = 0;
+        for (const JsonValue& item : taskTypes->items()) {
+            TaskType type;
+            if (!item.isString() || !stringToTaskType(item.asString(), type)) {
+                sendError(clientId, ErrorCode::INVALID_DATA, "Unknown task type in tasks");
+                return;
+            }
+            options.taskMask |= 1u << static_cast<int>(type);
+        }
+    }
+    
+    if (cartId < 0 || cartId >= m_config.maxCarts || !m_autoFarm.start(cartId, clientId, options)) {
+        sendError(clientId, ErrorCode::INVALID_DATA, "Invalid cart id or speed");
+        return;
+    }
     sendSuccess(clientId, "Auto farm started");
 }
 
-void FarmServer::handleAutoFarmStop(int clientId) {
-    // TODO: 调用Python停止自动化
+void FarmServer::handleAutoFarmStop(int clientId, const std::string& data) {
+    JsonValue json;
+    JsonValue::parse(data, json);
+    int cartId = json.getInt("cart_id", 0);
+    
+    if (!m_autoFarm.stop(cartId)) {
+        sendError(clientId, ErrorCode::OPERATION_FAILED, "Auto farm is not running");
+        return;
+    }
     sendSuccess(clientId, "Auto farm stopped");
 }
 
-void FarmServer::handleAutoFarmStatus(int clientId) {
-    // TODO: 调用Python获取自动化状态
-    std::string statusJson = "{\"enabled\":false,\"current_task\":null}";
-    Packet response(Response::AUTO_STATUS, statusJson);
+void FarmServer::handleAutoFarmStatus(int clientId, const std::string& data) {
+    JsonValue json;
+    JsonValue::parse(data, json);
+    int cartId = json.getInt("cart_id", 0);
+    
+    std::string status = json.getBool("all", false) ? m_autoFarm.fleetStatusJson()
+                                                    : m_autoFarm.statusJson(cartId);
+    Packet response(Response::AUTO_STATUS, status);
     sendToClient(clientId, response);
 }
 
@@ -615,34 +2722,126 @@ void FarmServer::handleSwitchCamera(int clientId, const std::string& data) {
 }
 
 // 发送消息给特定客户端
+// 在处理该客户端v2请求的线程上调用时作为回复发送
 bool FarmServer::sendToClient(int clientId, const Packet& packet) {
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    auto it = m_clientSockets.find(clientId);
-    if (it != m_clientSockets.end()) {
-        return sendPacket(it->second, packet);
+    RequestContext* request = t_request;
+    if (request && request->server == this && request->clientId == clientId) {
+        // 先落盘再回复：写盘失败时改为回复错误
+        auto replyStart = std::chrono::steady_clock::now();
+        Packet reply = packet;
+        if (!waitRequestJournal()) {
+            reply = Packet(Response::ERROR, "{\"status\":\"error\",\"error_code\":" +
+                           std::to_string(ErrorCode::OPERATION_FAILED) +
+                           ",\"error_message\":\"Journal write failed, the change is lost on restart and the farm is read-only\"}");
+        }
+        bool sent = true;
+        if (!request->tagged) {
+            sent = sendToSlot(clientId, reply);
+        } else {
+            reply.ext.requestId = request->requestId;
+            reply.ext.flags |= PacketFlag::RESPONSE;
+            if (request->hasHeld) {
+                sent = sendToSlot(clientId, request->held);
+            }
+            request->held = reply;
+            request->hasHeld = true;
+        }
+        request->replyTime += std::chrono::steady_clock::now() - replyStart;
+        return sent;
+    }
+    
+    return sendToSlot(clientId, packet);
+}
+
+// 等当前请求追加的日志同步完成（SYNC模式），只在回复请求方时调用；有记录所在批次写盘失败时返回false
+bool FarmServer::waitRequestJournal() {
+    RequestContext* request = t_request;
+    if (!request || request->server != this || request->journalSeq == 0) {
+        return true;
+    }
+    uint64_t seq = request->journalSeq;
+    request->journalSeq = 0;
+    uint64_t waitStart = spanStart(m_tracer);
+    bool durable = m_journal.waitDurable(seq);
+    spanEnd(m_tracer, "journal_wait", waitStart);
+    return durable;
+}
+
+// 不加锁地找到槽位，在槽位锁下确认连接仍在后发送
+bool FarmServer::sendToSlot(int clientId, const Packet& packet) {
+    ClientSlot* client = findClient(clientId);
+    if (!client) {
+        return false;
+    }
+    uint64_t waitStart = spanStart(m_tracer);
+    PROFILED_LOCK(lock, client->mutex);
+    spanEnd(m_tracer, "client_lock_wait", waitStart);
+    if (client->clientId.load(std::memory_order_relaxed) != clientId) {
+        return false;
+    }
+    uint64_t sendStart = spanStart(m_tracer);
+    bool sent = sendLocked(*client, packet);
+    spanEnd(m_tracer, "send", sendStart);
+    return sent;
+}
+
+// 发给所有客户端，每次只持有一个连接的锁。
+// 每种编码（v1、v2、v2压缩）在第一个用到它的连接上编码一次，之后的连接直接发送同样的字节；
+// 压缩借用该连接的压缩上下文（帧之间互不引用，结果与连接无关）
+void FarmServer::broadcastPacket(const Packet& packet) {
+    enum { PLAIN_V1, PLAIN_V2, COMPRESSED_V2, ENCODING_COUNT };
+    std::string encoded[ENCODING_COUNT];
+    bool ready[ENCODING_COUNT] = { false, false, false };
+    std::string frame;
+    
+    for (uint32_t index = 0; index < m_clientSlots.size(); index++) {
+        ClientSlot& client = *m_clientSlots.get(index);
+        if (client.clientId.load(std::memory_order_acquire) == 0) {
+            continue;
+        }
+        PROFILED_LOCK(lock, client.mutex);
+        if (client.clientId.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        int encoding = PLAIN_V1;
+        if (client.protocolVersion.load(std::memory_order_relaxed) >= PROTOCOL_VERSION_2) {
+            encoding = client.codec ? COMPRESSED_V2 : PLAIN_V2;
+        } else if (packet.data.size() > MAX_PACKET_SIZE) {
+            continue;   // v1没有分片，超长的推送不发给它
+        }
+        if (!ready[encoding]) {
+            if (encoding == PLAIN_V1) {
+                encoded[encoding] = packet.serialize(PROTOCOL_VERSION_1);
+            } else {
+                FrameCompressor* compressor = encoding == COMPRESSED_V2 ? &client.codec->compressor : nullptr;
+                encodeFrames(packet, compressor, frame, [&](const std::string& bytes) {
+                    encoded[encoding] += bytes;
+                    return true;
+                });
+            }
+            ready[encoding] = true;
+        }
+        sendBytes(client.socket, encoded[encoding]);
     }
-    return false;
 }
 
 // 广播状态更新
 void FarmServer::broadcastStateUpdate(const std::string& stateJson) {
     Packet packet(Response::STATE_UPDATE, stateJson);
-    
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    for (const auto& pair : m_clientSockets) {
-        sendPacket(pair.second, packet);
-    }
+    broadcastPacket(packet);
+}
+
+// 广播小车位置
+void FarmServer::broadcastCartUpdate(const std::string& cartsJson) {
+    Packet packet(Response::CART_MOVED, cartsJson);
+    broadcastPacket(packet);
 }
 
 // 广播日志消息
 void FarmServer::broadcastLogMessage(const std::string& message) {
     std::string jsonData = "{\"message\":\"" + message + "\"}";
     Packet packet(Response::LOG_MESSAGE, jsonData);
-    
-    std::lock_guard<std::mutex> lock(m_clientsMutex);
-    for (const auto& pair : m_clientSockets) {
-        sendPacket(pair.second, packet);
-    }
+    broadcastPacket(packet);
 }
 
 // Python集成（占位符）
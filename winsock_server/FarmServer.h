@@ -3,15 +3,37 @@
 
 #include "protocol.h"
 #include "socket_compat.h"  // 跨平台Socket兼容层
+#include "CartMotion.h"
+#include "TimerWheel.h"
+#include "FarmField.h"
+#include "ResourceLedger.h"
+#include "AutoFarm.h"
+#include "CoveragePlanner.h"
+#include "json_util.h"
+#include "WorkerPool.h"
+#include "FrameCompressor.h"
+#include "StreamSink.h"
+#include "Journal.h"
+#include "FarmSnapshot.h"
+#include "CaptureFile.h"
+#include "Metrics.h"
+#include "SpanTracer.h"
+#include "ProfiledMutex.h"
+#include "SlotTable.h"
 #include <map>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <queue>
+#include <deque>
 #include <fstream>
 #include <string>
 #include <ctime>
+#include <chrono>
 
 // 日志级别
 enum class LogLevel {
@@ -33,23 +55,54 @@ struct LogEntry {
 struct ServerConfig {
     uint16_t port;
     int maxClients;
-    int heartbeatInterval;  // 秒
+    int heartbeatInterval;  // 秒，状态心跳推送间隔
     int clientTimeout;      // 秒
     bool enableLogging;
+    bool debugLogging;      // 记录DEBUG日志（每个请求一条）；关闭时log在加锁、拼接之前返回
     std::string logFilePath;
+    int motionTickRate;     // 运动积分频率（Hz）
+    int cartUpdateRate;     // CART_MOVED推送频率（Hz）
+    int maxCarts;           // 小车数量上限
+    int gridSize;           // 农田边长（格）
+    double cellSize;        // 格子边长（米）
+    int workerThreads;      // 处理协议v2请求的工作线程数
+    int maxInFlight;        // 协议v2每个连接的在途请求上限
+    int compressThreshold;  // 协议v2压缩连接上，小于该长度（字节）的帧不压缩
+    std::string journalPath;        // 预写日志文件，为空时不记录（重启后农田清空）
+    JournalDurability journalDurability;
+    int journalIntervalMs;          // INTERVAL模式的同步间隔（毫秒）
+    std::string snapshotPath;       // 农田快照文件，为空时不写快照
+    int snapshotInterval;           // 秒，定期快照的间隔（0只在停止时写）
+    std::string capturePath;        // 录制收到的请求的抓包文件，为空时不录制
+    int metricsPort;                // 本地HTTP指标端口（只监听127.0.0.1），0为不开启
+    int traceSampleEvery;           // 每个读线程每N个包追踪一个，0为不追踪
+    int traceBufferSpans;           // 每个线程保留的最近span数
+    double initialEnergy;           // 启动时的能量（快照不记录能量）
+    double maxEnergy;
+    double energyRegen;             // 每秒恢复的能量
+    int64_t initialCoins;           // 没有快照时的初始金币
+    int initialSeeds;               // 没有快照时每种种子的数量，0为默认库存
     
     ServerConfig() 
         : port(8888), maxClients(10), heartbeatInterval(5), 
-          clientTimeout(30), enableLogging(true), 
-          logFilePath("server.log") {}
+          clientTimeout(30), enableLogging(true), debugLogging(false),
+          logFilePath("server.log"), motionTickRate(60),
+          cartUpdateRate(10), maxCarts(4096), gridSize(8), cellSize(0.5),
+          workerThreads(4), maxInFlight(32), compressThreshold(1024),
+          journalPath("farm.journal"), journalDurability(JournalDurability::INTERVAL),
+          journalIntervalMs(10), snapshotPath("farm.snapshot"), snapshotInterval(300),
+          capturePath(""), metricsPort(0),
+          traceSampleEvery(0), traceBufferSpans(4096),
+          initialEnergy(100.0), maxEnergy(100.0), energyRegen(0.02),
+          initialCoins(100), initialSeeds(0) {}
 };
 
-// 服务器状态
+// 服务器状态（连接数和命令数由getStatus从指标读取）
 struct ServerStatus {
     bool isRunning;
     int connectedClients;
-    int totalConnections;
-    int totalCommandsProcessed;
+    uint64_t totalConnections;          // 累计计数，长时间运行会超过int
+    uint64_t totalCommandsProcessed;
     time_t startTime;
     std::string pythonStatus;
     
@@ -77,12 +130,20 @@ public:
     
     // 获取状态
     ServerStatus getStatus() const;
+    // 所有指标，Prometheus文本格式
+    std::string exportMetrics();
+    // 各加锁处的等待和持有时间，按等待时间从多到少
+    std::vector<LockSiteStats> getLockProfile() const { return lockProfile(); }
+    // 各线程缓冲中最近的span，Chrome trace-event JSON；未开启追踪时没有事件
+    std::string exportTrace() const { return m_tracer.dumpChromeTrace(); }
+    bool tracingEnabled() const { return m_tracer.enabled(); }
     std::vector<ClientInfo> getConnectedClients() const;
     std::vector<LogEntry> getRecentLogs(int count = 100) const;
     
     // 广播消息
     void broadcastStateUpdate(const std::string& stateJson);
     void broadcastLogMessage(const std::string& message);
+    void broadcastCartUpdate(const std::string& cartsJson);
     
     // 发送消息给特定客户端
     bool sendToClient(int clientId, const Packet& packet);
@@ -90,6 +151,13 @@ public:
     // 断开客户端
     void disconnectClient(int clientId);
     
+    // 写农田快照（捕获时短暂持有农田锁，写文件在后台进行）；上一个快照还在写时返回false
+    bool saveSnapshot(bool background = true);
+    
+    // 回放抓包中的一个请求：与读线程收到它时一样处理，回复发往不存在的连接时被丢弃。
+    // 同一个客户端的包须按顺序在同一线程上回放，upload是该客户端打开的上传流
+    void replayPacket(int clientId, const Packet& packet, std::unique_ptr<StreamSink>& upload);
+    
     // 设置回调函数
     void setLogCallback(LogCallback callback) { m_logCallback = callback; }
     void setClientConnectCallback(ClientConnectCallback callback) { m_connectCallback = callback; }
@@ -103,28 +171,147 @@ public:
                                    const std::string& args);
     
 private:
+    // 微基准测试（bench/farm_bench.cpp）直接测量私有的收发、回复和日志路径
+    friend class FarmServerBench;
+    
     // 网络相关
     socket_t m_listenSocket;  // 使用跨平台socket类型
     ServerConfig m_config;
     ServerStatus m_status;
     
-    // 客户端管理
-    std::map<int, socket_t> m_clientSockets;  // 使用跨平台socket类型
-    std::map<int, ClientInfo> m_clientInfos;
-    int m_nextClientId;
-    mutable std::mutex m_clientsMutex;
+    // 协商了压缩的连接：压缩上下文和发送缓冲区逐连接复用
+    struct ClientCodec {
+        FrameCompressor compressor;
+        std::string frame;
+    };
+    
+    // 客户端表：每个连接一个缓存行对齐的槽位，客户端ID = 代数 << CLIENT_SLOT_BITS | 槽位号，
+    // 槽位每次复用代数加一，旧ID随之失效。
+    //   - 查找不加锁：按ID取槽位，比较clientId；发送等在槽位自己的锁下再确认一次
+    //   - 逐包更新的活动时间、协议版本、地址是原子变量，读线程和日志不加锁
+    //   - 槽位归读线程所有：断开时只shutdown，读线程退出时关闭socket并放回空闲链表，
+    //     所以读线程运行期间它的槽位不会被复用
+    //   - 两把锁，先mutex后stateMutex：发送可能阻塞，只持有mutex；超时和断开只取
+    //     stateMutex，慢客户端不会拖住定时器线程。关闭socket同时持有两把锁
+    struct alignas(64) ClientSlot {
+        std::atomic<int> clientId;              // 当前连接的ID，空闲或已断开时为0
+        std::atomic<uint32_t> protocolVersion;
+        std::atomic<uint32_t> address;          // IPv4，网络字节序
+        std::atomic<uint16_t> port;
+        std::atomic<int64_t> lastActivityTime;  // time_t
+        std::atomic<uint64_t> lastActivityMs;   // 时间轮毫秒，超时定时器到期时惰性检查
+        
+        ProfiledMutex mutex;                    // 串行化对该连接的发送，保护codec
+        socket_t socket;  // 使用跨平台socket类型
+        std::unique_ptr<ClientCodec> codec;
+        
+        ProfiledMutex stateMutex;               // 持有时不做阻塞操作，保护以下字段
+        time_t connectTime;
+        bool isAuthorized;
+        TimerId timeoutTimer;
+        
+        uint16_t generation;                    // 只由分配到该槽位的线程修改
+        std::thread thread;                     // 读线程（只由accept线程和stop访问）
+        
+        ClientSlot()
+            : clientId(0), protocolVersion(PROTOCOL_VERSION_1), address(0), port(0),
+              lastActivityTime(0), lastActivityMs(0), mutex("client"), socket(INVALID_SOCKET),
+              stateMutex("client_state"), connectTime(0), isAuthorized(false),
+              timeoutTimer(INVALID_TIMER), generation(0) {}
+    };
+    static const int CLIENT_SLOT_BITS = 16;
+    static const int CLIENT_SLOT_MASK = (1 << CLIENT_SLOT_BITS) - 1;
+    static const int MAX_CLIENT_GENERATION = 0x7FFF;   // ID保持为正数
+    SlotTable<ClientSlot> m_clientSlots;
+    
+    // 协议v2连接的在途请求计数；达到上限时读线程停止读取，由TCP向客户端施加背压
+    struct RequestPipeline {
+        std::mutex mutex;
+        std::condition_variable drained;
+        int inFlight;
+        
+        RequestPipeline() : inFlight(0) {}
+    };
     
     // 日志管理
     std::queue<LogEntry> m_logQueue;
-    mutable std::mutex m_logMutex;
+    mutable ProfiledMutex m_logMutex;
     std::ofstream m_logFile;
     
     // 线程管理
     std::thread m_acceptThread;
-    std::map<int, std::thread> m_clientThreads;
-    std::thread m_heartbeatThread;
+    std::thread m_timerThread;
+    std::thread m_motionThread;
+    std::thread m_pushThread;
     bool m_shouldStop;
     
+    // 主动推送：定时器线程和运动线程只登记，阻塞的发送由推送线程完成。
+    // 推送线程忙时，状态心跳和小车位置的多次登记合并为一次（小车取最新的插值系数，
+    // 有变化的小车不会漏掉）；发给单个客户端的推送按登记顺序排队
+    ProfiledMutex m_pushMutex;
+    std::condition_variable_any m_pushCv;
+    bool m_statePushPending;
+    bool m_cartPushPending;
+    double m_cartPushAlpha;
+    std::deque<std::pair<int, Packet>> m_pushQueue;     // [客户端ID, 包]
+    static const size_t MAX_QUEUED_PUSHES = 4096;       // 队列满时丢弃新的推送并计数
+    
+    // 协议v2请求的工作线程池，回复按处理完成的顺序发出
+    WorkerPool m_workers;
+    
+    // 定时调度（客户端超时、心跳、运动完成、植物事件）
+    TimerWheel m_timers;
+    TimerId m_heartbeatTimer;
+    
+    // 小车运动子系统
+    CartMotionSystem m_motion;
+    
+    // 农田（植物生命周期由定时器驱动）
+    FarmField m_field;
+    ProfiledMutex m_farmMutex;
+    
+    // 资源账本（能量、金币、种子、工具，无锁）
+    ResourceLedger m_ledger;
+    
+    // 修改农田的命令的预写日志，启动时回放恢复状态
+    Journal m_journal;
+    
+    // 农田快照：定期在后台写出，启动时映射最新的快照再回放其后的日志
+    LedgerState m_journaledLedger;      // 与日志序号一致的金币/种子/工具（受m_farmMutex保护）
+    FarmSnapshotData m_snapshotData;    // 复用的捕获缓冲区，写出期间归快照线程
+    std::atomic<bool> m_snapshotBusy;
+    std::thread m_snapshotThread;
+    TimerId m_snapshotTimer;
+    
+    // 抓包（capturePath非空时录制每个收到的请求）
+    CaptureWriter m_capture;
+    
+    // 指标：热路径只做分片计数器和直方图的relaxed加法
+    struct CommandMetrics {
+        ShardedCounter* requests;
+        LatencyHistogram* latency;      // 读到请求到最后一个回复发出（含排队）
+        LatencyHistogram* handler;      // 处理函数本身
+    };
+    static const size_t COMMAND_METRIC_SLOTS = 0x100;   // 命令代码都小于0x100，其余计入unknown
+    MetricsRegistry m_metrics;
+    CommandMetrics m_commandMetrics[COMMAND_METRIC_SLOTS];
+    std::vector<ShardedCounter*> m_requestCounters;     // 各命令的计数器（不重复）
+    ShardedCounter* m_bytesReceived;
+    ShardedCounter* m_bytesSent;
+    ShardedCounter* m_connectionsTotal;
+    Gauge* m_connectedClients;
+    Gauge* m_requestsInFlight;
+    Gauge* m_workerQueueDepth;
+    Gauge* m_uptimeSeconds;
+    ShardedCounter* m_pushesDropped;
+    MetricsHttpServer m_metricsHttp;
+    
+    // 请求生命周期追踪（采样的包记录各阶段的span）
+    SpanTracer m_tracer;
+    
+    // 自动化调度（每辆小车一个会话）
+    AutoFarmScheduler m_autoFarm;
+    
     // 回调函数
     LogCallback m_logCallback;
     ClientConnectCallback m_connectCallback;
@@ -137,35 +324,84 @@ private:
     // 内部方法
     void acceptLoop();
     void clientLoop(int clientId, socket_t clientSocket);  // 使用跨平台socket类型
-    void heartbeatLoop();
+    void timerLoop();
+    void motionLoop();
+    void pushLoop();
+    void restoreFarm();
+    uint64_t loadSnapshot();
+    void openJournal(uint64_t snapshotSeq);
+    void copyFarm(FarmSnapshotData& data);     // 持有农田锁拷贝地块、账本和日志序号
+    void startCapture();
     
-    bool receivePacket(socket_t socket, Packet& packet);  // 使用跨平台socket类型
-    bool sendPacket(socket_t socket, const Packet& packet);  // 使用跨平台socket类型
+    bool receivePacket(socket_t socket, Packet& packet, uint32_t version);  // 使用跨平台socket类型
+    bool sendPacket(socket_t socket, const Packet& packet, uint32_t version);  // 使用跨平台socket类型
+    bool sendLocked(ClientSlot& client, const Packet& packet);     // 需持有槽位的锁
+    bool sendToSlot(int clientId, const Packet& packet);
+    void broadcastPacket(const Packet& packet);
+    void queuePush(int clientId, const Packet& packet);   // 不阻塞，由推送线程发送
+    bool sendBytes(socket_t socket, const std::string& bytes);
+    bool encodeFrames(const Packet& packet, FrameCompressor* compressor, std::string& frame,
+                      const std::function<bool(const std::string&)>& emit);
+    bool receiveFrame(socket_t socket, Packet& packet, uint32_t version);
+    ClientSlot* findClient(int clientId) const;     // 加槽位锁后须再比较clientId
+    int registerClient(socket_t socket, const sockaddr_in& addr);
+    void releaseClientSlot(int clientId);
+    ClientInfo describeClient(const ClientSlot& client) const;  // 需持有槽位的stateMutex
     
+    void dispatchRequest(int clientId, const Packet& packet,
+                         const std::shared_ptr<RequestPipeline>& pipeline,
+                         std::chrono::steady_clock::time_point received);
+    void waitForDrain(const std::shared_ptr<RequestPipeline>& pipeline);
+    std::chrono::steady_clock::duration runRequest(int clientId, uint32_t requestId, bool tagReplies,
+                                                   const std::function<void()>& handler);
+    bool waitRequestJournal();
+    void handleStreamCommand(int clientId, const Packet& packet, std::unique_ptr<StreamSink>& upload);
     void handleCommand(int clientId, const Packet& packet);
     void handleConnect(int clientId, const std::string& data);
-    void handleGetState(int clientId);
-    void handleGetPlants(int clientId);
+    void handleGetState(int clientId, const std::string& data);
+    void handleGetPlants(int clientId, const std::string& data);
+    void streamPlants(int clientId);
+    void handleQueryCondition(int clientId, const std::string& data);
+    void handleFindNearest(int clientId, const std::string& data);
+    void handleEvaluatePlan(int clientId, const std::string& data);
+    void handlePlanCoverage(int clientId, const std::string& data);
     void handleMoveCart(int clientId, const std::string& data);
     void handleRotateCart(int clientId, const std::string& data);
     void handlePlantSeed(int clientId, const std::string& data);
     void handleWaterPlant(int clientId, const std::string& data);
     void handleHarvest(int clientId, const std::string& data);
     void handleRemoveWeed(int clientId, const std::string& data);
-    void handleAutoFarmStart(int clientId);
-    void handleAutoFarmStop(int clientId);
-    void handleAutoFarmStatus(int clientId);
+    void handleBatchOperation(int clientId, const std::string& data);
+    void handleAutoFarmStart(int clientId, const std::string& data);
+    void handleAutoFarmStop(int clientId, const std::string& data);
+    void handleAutoFarmStatus(int clientId, const std::string& data);
     void handleSwitchEquipment(int clientId, const std::string& data);
     void handleSwitchCamera(int clientId, const std::string& data);
+    void handleUpgradeTool(int clientId, const std::string& data);
+    void handleGetMetrics(int clientId, const std::string& data);
     
-    void sendSuccess(int clientId, const std::string& message = "");
+    void sendSuccess(int clientId, const std::string& message = "",
+                     const std::string& extraFields = "");
     void sendError(int clientId, uint32_t errorCode, const std::string& message);
     
     void log(LogLevel level, const std::string& message, int clientId = -1);
     void writeLogToFile(const LogEntry& entry);
     
+    void registerMetrics();
+    void recordRequest(uint32_t command, std::chrono::steady_clock::time_point received,
+                       std::chrono::steady_clock::duration handlerTime);
+    
     void cleanupClient(int clientId);
-    void checkClientTimeouts();
+    void armClientTimeout(int clientId, uint64_t delayMs);
+    void onClientTimeoutTimer(int clientId);
+    void onHeartbeat();
+    void scheduleMoveCompletion(int clientId, int cartId, uint32_t moveSeq);
+    void onMoveCompletionTimer(int clientId, int cartId, uint32_t moveSeq);
+    std::string buildStateJson() const;
+    void onPlantEvent(int cellIndex, uint32_t eventSeq);
+    bool parseCellPosition(int clientId, const JsonValue& json, int& row, int& col);
+    void sendFarmError(int clientId, FarmResult result);
+    bool chargeTask(int clientId, TaskCharge& charged, TaskType type, PlantType seed = PlantType::WHEAT);
     
     // 禁止拷贝
     FarmServer(const FarmServer&) = delete;
@@ -0,0 +1,292 @@
+#include "FarmSnapshot.h"
+#include "Journal.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>
+    #define snapshot_sync(file) _commit(_fileno(file))
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define snapshot_sync(file) ::fsync(fileno(file))
+#endif
+
+static const uint32_t SNAPSHOT_MAGIC = 0x504E5346;    // "FSNP"
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const size_t SECTION_ALIGN = 64;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t cellRecordSize;    // sizeof(PlantCell)
+    int32_t rows;
+    int32_t cols;
+    double cellSize;
+    uint64_t journalSeq;
+    double savedAt;
+    uint64_t fileSize;
+    uint64_t cellsOffset;
+    uint64_t cartsOffset;
+    uint32_t cartCount;
+    uint32_t checksum;          // 整个文件的crc32（计算时本字段按0处理）
+    LedgerState ledger;
+};
+
+struct SnapshotCart {
+    int32_t cartId;
+    int32_t reserved;
+    double x;
+    double z;
+    double rotation;
+};
+
+static size_t alignUp(size_t value) {
+    return (value + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+static uint32_t fileChecksum(const SnapshotHeader& header, const char* body, size_t bodySize) {
+    SnapshotHeader copy = header;
+    copy.checksum = 0;
+    return crc32(body, bodySize, crc32(&copy, sizeof(copy)));
+}
+
+bool FarmSnapshot::write(const std::string& path, const FarmSnapshotData& data, std::string& error) {
+    size_t cellCount = static_cast<size_t>(data.rows) * data.cols;
+    if (data.rows <= 0 || data.cols <= 0 || data.cells.size() != cellCount) {
+        error = "Snapshot data does not match the field size";
+        return false;
+    }
+
+    // 单元格和小车段都按64字节对齐，映射后可以直接按数组访问
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = static_cast<uint32_t>(sizeof(SnapshotHeader));
+    header.cellRecordSize = static_cast<uint32_t>(sizeof(PlantCell));
+    header.rows = data.rows;
+    header.cols = data.cols;
+    header.cellSize = data.cellSize;
+    header.journalSeq = data.journalSeq;
+    header.savedAt = data.savedAt;
+    header.cellsOffset = alignUp(sizeof(SnapshotHeader));
+    header.cartsOffset = alignUp(header.cellsOffset + cellCount * sizeof(PlantCell));
+    header.cartCount = static_cast<uint32_t>(data.carts.size());
+    header.fileSize = header.cartsOffset + data.carts.size() * sizeof(SnapshotCart);
+    header.ledger = data.ledger;
+
+    std::vector<SnapshotCart> carts(data.carts.size());
+    for (size_t i = 0; i < data.carts.size(); i++) {
+        std::memset(&carts[i], 0, sizeof(SnapshotCart));
+        carts[i].cartId = data.carts[i].cartId;
+        carts[i].x = data.carts[i].x;
+        carts[i].z = data.carts[i].z;
+        carts[i].rotation = data.carts[i].rotation;
+    }
+
+    // 文件按段写出：[头][填充][单元格][填充][小车]，校验和按同样的顺序计算，不再拼一份拷贝
+    const char zeros[SECTION_ALIGN] = {};
+    size_t cellBytes = cellCount * sizeof(PlantCell);
+    size_t headPad = static_cast<size_t>(header.cellsOffset) - sizeof(SnapshotHeader);
+    size_t cellPad = static_cast<size_t>(header.cartsOffset - header.cellsOffset) - cellBytes;
+    size_t cartBytes = carts.size() * sizeof(SnapshotCart);
+
+    uint32_t crc = crc32(&header, sizeof(header));     // 此时checksum字段为0
+    crc = crc32(zeros, headPad, crc);
+    crc = crc32(data.cells.data(), cellBytes, crc);
+    crc = crc32(zeros, cellPad, crc);
+    crc = crc32(carts.data(), cartBytes, crc);
+    header.checksum = crc;
+
+    std::string tmpPath = path + ".tmp";
+    FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        error = "Cannot create " + tmpPath + ": " + std::strerror(errno);
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(zeros, 1, headPad, file) == headPad &&
+              std::fwrite(data.cells.data(), 1, cellBytes, file) == cellBytes &&
+              std::fwrite(zeros, 1, cellPad, file) == cellPad &&
+              std::fwrite(carts.data(), 1, cartBytes, file) == cartBytes &&
+              std::fflush(file) == 0 && snapshot_sync(file) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        error = "Cannot write " + tmpPath + ": " + std::strerror(errno);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());      // Windows的rename不能覆盖已有文件
+#endif
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        error = "Cannot rename " + tmpPath + " to " + path + ": " + std::strerror(errno);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+FarmSnapshot::FarmSnapshot()
+    : m_data(nullptr), m_size(0)
+#ifdef _WIN32
+    , m_file(nullptr), m_mapping(nullptr)
+#endif
+{
+}
+
+FarmSnapshot::~FarmSnapshot() {
+    close();
+}
+
+bool FarmSnapshot::open(const std::string& path, std::string& error) {
+    close();
+    error.clear();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        if (GetLastError() != ERROR_FILE_NOT_FOUND) {
+            error = "Cannot open snapshot " + path;
+        }
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(SnapshotHeader))) {
+        CloseHandle(file);
+        error = "Snapshot " + path + " is truncated";
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        error = "Cannot map snapshot " + path;
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            error = "Cannot open snapshot " + path + ": " + std::strerror(errno);
+        }
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+        ::close(fd);
+        error = "Snapshot " + path + " is truncated";
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // 映射建立后不再需要文件描述符
+    if (view == MAP_FAILED) {
+        error = "Cannot map snapshot " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+
+    const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(m_data);
+    size_t cellCount = header->rows > 0 && header->cols > 0
+        ? static_cast<size_t>(header->rows) * header->cols : 0;
+    if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+        header->headerSize != sizeof(SnapshotHeader)) {
+        error = path + " is not a farm snapshot (version " + std::to_string(SNAPSHOT_VERSION) + ")";
+    } else if (header->cellRecordSize != sizeof(PlantCell)) {
+        error = "Snapshot " + path + " was written by a build with a different cell layout";
+    } else if (header->fileSize != m_size || cellCount == 0 ||
+               header->cellsOffset + cellCount * sizeof(PlantCell) > header->cartsOffset ||
+               header->cartsOffset + header->cartCount * sizeof(SnapshotCart) > m_size) {
+        error = "Snapshot " + path + " is truncated";
+    } else if (fileChecksum(*header, m_data + sizeof(SnapshotHeader),
+                            m_size - sizeof(SnapshotHeader)) != header->checksum) {
+        error = "Snapshot " + path + " failed its checksum";
+    }
+    if (!error.empty()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void FarmSnapshot::close() {
+    if (!m_data) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(static_cast<HANDLE>(m_mapping));
+    CloseHandle(static_cast<HANDLE>(m_file));
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+static const SnapshotHeader& headerOf(const char* data) {
+    return *reinterpret_cast<const SnapshotHeader*>(data);
+}
+
+int FarmSnapshot::rows() const {
+    return m_data ? headerOf(m_data).rows : 0;
+}
+
+int FarmSnapshot::cols() const {
+    return m_data ? headerOf(m_data).cols : 0;
+}
+
+double FarmSnapshot::cellSize() const {
+    return m_data ? headerOf(m_data).cellSize : 0.0;
+}
+
+uint64_t FarmSnapshot::journalSeq() const {
+    return m_data ? headerOf(m_data).journalSeq : 0;
+}
+
+double FarmSnapshot::savedAt() const {
+    return m_data ? headerOf(m_data).savedAt : 0.0;
+}
+
+const PlantCell* FarmSnapshot::cells() const {
+    return m_data ? reinterpret_cast<const PlantCell*>(m_data + headerOf(m_data).cellsOffset) : nullptr;
+}
+
+const LedgerState& FarmSnapshot::ledger() const {
+    return headerOf(m_data).ledger;
+}
+
+size_t FarmSnapshot::cartCount() const {
+    return m_data ? headerOf(m_data).cartCount : 0;
+}
+
+bool FarmSnapshot::cart(size_t index, CartSnapshot& out) const {
+    if (index >= cartCount()) {
+        return false;
+    }
+    const SnapshotCart* carts =
+        reinterpret_cast<const SnapshotCart*>(m_data + headerOf(m_data).cartsOffset);
+    out = CartSnapshot();
+    out.cartId = carts[index].cartId;
+    out.x = carts[index].x;
+    out.z = carts[index].z;
+    out.rotation = carts[index].rotation;
+    return true;
+}
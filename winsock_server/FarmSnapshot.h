@@ -0,0 +1,79 @@
+#ifndef FARM_SNAPSHOT_H
+#define FARM_SNAPSHOT_H
+
+#include "FarmField.h"
+#include "ResourceLedger.h"
+#include "CartMotion.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * 农田快照（二进制，可直接内存映射）
+ *
+ * 文件布局：
+ *   [文件头 SnapshotHeader，64字节对齐]
+ *   [PlantCell数组 rows*cols，与内存中的布局相同]
+ *   [小车数组 SnapshotCart]
+ * 文件头记录版本、PlantCell的大小（布局变了就拒绝加载）、农田尺寸、快照对应的
+ * 日志序号、金币/种子/工具等级，以及覆盖整个文件的crc32。
+ *
+ * 启动时open把文件映射为只读内存，cells()直接指向映射中的单元格数组，
+ * 由FarmField一次整体拷贝恢复；之后只回放日志中序号大于journalSeq()的记录。
+ * 写快照时先写临时文件并同步，再重命名覆盖，任何时刻磁盘上都有一个完整的快照。
+ */
+
+// 捕获的农田状态（写快照用的缓冲区，可复用）
+struct FarmSnapshotData {
+    int rows;
+    int cols;
+    double cellSize;
+    uint64_t journalSeq;        // 快照包含的最后一条日志记录
+    double savedAt;             // 捕获时的农田时钟
+    std::vector<PlantCell> cells;
+    LedgerState ledger;
+    std::vector<CartSnapshot> carts;
+
+    FarmSnapshotData() : rows(0), cols(0), cellSize(0.0), journalSeq(0), savedAt(0.0), ledger() {}
+};
+
+class FarmSnapshot {
+public:
+    FarmSnapshot();
+    ~FarmSnapshot();
+
+    // 写出快照（临时文件 + 同步 + 重命名）
+    static bool write(const std::string& path, const FarmSnapshotData& data, std::string& error);
+
+    // 映射并校验快照；文件不存在时返回false且error为空
+    bool open(const std::string& path, std::string& error);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    int rows() const;
+    int cols() const;
+    double cellSize() const;
+    uint64_t journalSeq() const;
+    double savedAt() const;
+    size_t fileSize() const { return m_size; }
+
+    // 指向映射内存，close之后失效
+    const PlantCell* cells() const;
+    const LedgerState& ledger() const;
+    size_t cartCount() const;
+    bool cart(size_t index, CartSnapshot& out) const;
+
+private:
+    const char* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_file;
+    void* m_mapping;
+#endif
+
+    FarmSnapshot(const FarmSnapshot&) = delete;
+    FarmSnapshot& operator=(const FarmSnapshot&) = delete;
+};
+
+#endif // FARM_SNAPSHOT_H
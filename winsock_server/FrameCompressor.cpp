@@ -0,0 +1,206 @@
+#include "FrameCompressor.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+static const size_t MIN_MATCH = 4;
+static const size_t LAST_LITERALS = 5;     // 块末尾至少5个字节是字面量
+static const size_t MF_LIMIT = 12;         // 最后一个匹配必须在末尾12字节之前开始
+static const size_t MAX_OFFSET = 65535;
+static const int SKIP_TRIGGER = 6;         // 连续未命中时加大步长
+
+static inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// 长度超过15的部分：若干个255再跟一个余数
+static inline uint8_t* writeLength(uint8_t* op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+static inline uint8_t* writeLiterals(uint8_t* op, uint8_t* token, const uint8_t* literals,
+                                     size_t count) {
+    if (count >= 15) {
+        *token = 15 << 4;
+        op = writeLength(op, count - 15);
+    } else {
+        *token = static_cast<uint8_t>(count << 4);
+    }
+    memcpy(op, literals, count);
+    return op + count;
+}
+
+FrameCompressor::FrameCompressor()
+    : m_table(static_cast<size_t>(1) << HASH_LOG, 0), m_base(1) {
+}
+
+size_t FrameCompressor::maxCompressedSize(size_t size) {
+    return RAW_SIZE_BYTES + size + size / 255 + 16;
+}
+
+bool FrameCompressor::compress(const char* src, size_t size, std::string& out) {
+    if (size > std::numeric_limits<uint32_t>::max() / 2) {
+        return false;
+    }
+    // 基址将要溢出时清表重来
+    if (m_base > std::numeric_limits<uint32_t>::max() - static_cast<uint32_t>(size) - 1) {
+        std::fill(m_table.begin(), m_table.end(), 0);
+        m_base = 1;
+    }
+
+    size_t start = out.size();
+    out.resize(start + maxCompressedSize(size));
+    uint8_t* const dst = reinterpret_cast<uint8_t*>(&out[start]);
+    uint8_t* op = dst;
+
+    uint32_t rawSize = static_cast<uint32_t>(size);
+    for (size_t i = 0; i < RAW_SIZE_BYTES; i++) {
+        *op++ = static_cast<uint8_t>(rawSize >> (8 * i));
+    }
+
+    const uint8_t* const base = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* const end = base + size;
+    const uint8_t* anchor = base;
+
+    if (size >= MF_LIMIT + 1) {
+        const uint8_t* const matchLimit = end - LAST_LITERALS;
+        const uint8_t* const mfLimit = end - MF_LIMIT;
+        const uint8_t* ip = base;
+        int misses = 1 << SKIP_TRIGGER;
+
+        while (ip < mfLimit) {
+            uint32_t sequence = read32(ip);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_LOG);
+            uint32_t entry = m_table[hash];
+            uint32_t position = static_cast<uint32_t>(ip - base);
+            m_table[hash] = position + m_base;
+
+            if (entry < m_base || position - (entry - m_base) > MAX_OFFSET ||
+                read32(base + (entry - m_base)) != sequence) {
+                ip += misses++ >> SKIP_TRIGGER;
+                continue;
+            }
+            misses = 1 << SKIP_TRIGGER;
+
+            const uint8_t* match = base + (entry - m_base);
+            // 向前扩展
+            while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                ip--;
+                match--;
+            }
+            // 向后扩展，匹配不能进入末尾的字面量区
+            size_t length = MIN_MATCH;
+            while (ip + length < matchLimit && ip[length] == match[length]) {
+                length++;
+            }
+
+            uint8_t* token = op++;
+            op = writeLiterals(op, token, anchor, static_cast<size_t>(ip - anchor));
+            size_t offset = static_cast<size_t>(ip - match);
+            *op++ = static_cast<uint8_t>(offset);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+            if (length - MIN_MATCH >= 15) {
+                *token |= 15;
+                op = writeLength(op, length - MIN_MATCH - 15);
+            } else {
+                *token |= static_cast<uint8_t>(length - MIN_MATCH);
+            }
+
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    // 最后一段全是字面量
+    uint8_t* token = op++;
+    op = writeLiterals(op, token, anchor, static_cast<size_t>(end - anchor));
+
+    m_base += rawSize + 1;
+
+    size_t written = static_cast<size_t>(op - dst);
+    if (written >= size + RAW_SIZE_BYTES) {
+        out.resize(start);
+        return false;
+    }
+    out.resize(start + written);
+    return true;
+}
+
+bool FrameCompressor::decompress(const char* src, size_t size, std::string& out, size_t maxSize) {
+    if (size < RAW_SIZE_BYTES + 1) {
+        return false;
+    }
+    const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t* const end = ip + size;
+    size_t rawSize = 0;
+    for (size_t i = 0; i < RAW_SIZE_BYTES; i++) {
+        rawSize |= static_cast<size_t>(*ip++) << (8 * i);
+    }
+    if (rawSize > maxSize) {
+        return false;
+    }
+
+    out.resize(rawSize);
+    uint8_t* const dst = reinterpret_cast<uint8_t*>(&out[0]);
+    size_t produced = 0;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t byte;
+            do {
+                if (ip >= end) return false;
+                byte = *ip++;
+                literals += byte;
+            } while (byte == 255);
+        }
+        if (literals > static_cast<size_t>(end - ip) || literals > rawSize - produced) {
+            return false;
+        }
+        memcpy(dst + produced, ip, literals);
+        ip += literals;
+        produced += literals;
+        if (ip == end) {
+            break;  // 最后一段没有匹配
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > produced) {
+            return false;
+        }
+
+        size_t length = token & 15;
+        if (length == 15) {
+            uint8_t byte;
+            do {
+                if (ip >= end) return false;
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+        }
+        length += MIN_MATCH;
+        if (length > rawSize - produced) {
+            return false;
+        }
+        // 匹配可能与输出重叠，逐字节复制
+        const uint8_t* match = dst + produced - offset;
+        for (size_t i = 0; i < length; i++) {
+            dst[produced + i] = match[i];
+        }
+        produced += length;
+    }
+    return produced == rawSize;
+}
@@ -0,0 +1,42 @@
+#ifndef FRAME_COMPRESSOR_H
+#define FRAME_COMPRESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * 协议v2的逐帧压缩（LZ4块格式）
+ *
+ * 压缩帧的数据部分为 [原始长度 uint32 小端][LZ4块]，块格式与liblz4的
+ * LZ4_compress_default / LZ4_decompress_safe兼容，客户端可以直接用标准库解压。
+ * 这里是树内实现（贪心哈希匹配，无外部依赖），压缩率与LZ4默认级别相当。
+ *
+ * 每个连接一个FrameCompressor：哈希表只分配一次，各帧之间用递增的基址区分，
+ * 不需要逐帧清表；输出写入调用方复用的缓冲区，预热后不再分配内存。
+ */
+
+class FrameCompressor {
+public:
+    static const size_t RAW_SIZE_BYTES = 4;
+
+    FrameCompressor();
+
+    // 把src压缩后追加到out末尾（含原始长度前缀）；压缩后不比原文小时返回false，out不变
+    bool compress(const char* src, size_t size, std::string& out);
+
+    // 解压一个压缩帧的数据部分，maxSize限制原始长度；格式错误返回false
+    static bool decompress(const char* src, size_t size, std::string& out, size_t maxSize);
+
+    // 压缩结果的最大长度（含原始长度前缀）
+    static size_t maxCompressedSize(size_t size);
+
+private:
+    static const int HASH_LOG = 12;
+
+    std::vector<uint32_t> m_table;  // 哈希 -> 位置 + m_base
+    uint32_t m_base;                // 本帧位置的基址，小于它的表项属于之前的帧
+};
+
+#endif // FRAME_COMPRESSOR_H
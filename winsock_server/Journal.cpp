@@ -0,0 +1,513 @@
+#include "Journal.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #define journal_open(path) _open(path, _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE)
+    #define journal_close _close
+    #define journal_read(fd, buf, n) _read(fd, buf, static_cast<unsigned>(n))
+    #define journal_write(fd, buf, n) _write(fd, buf, static_cast<unsigned>(n))
+    #define journal_seek _lseeki64
+    #define journal_truncate _chsize_s
+    #define journal_sync _commit
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #define journal_open(path) ::open(path, O_RDWR | O_CREAT, 0644)
+    #define journal_close ::close
+    #define journal_read ::read
+    #define journal_write ::write
+    #define journal_seek ::lseek
+    #define journal_truncate ::ftruncate
+    #if defined(__APPLE__)
+        #define journal_sync ::fsync      // macOS没有fdatasync
+    #else
+        #define journal_sync ::fdatasync
+    #endif
+#endif
+
+static const uint32_t JOURNAL_MAGIC = 0x4C415746;     // "FWAL"
+static const uint16_t JOURNAL_VERSION = 1;
+static const size_t FILE_HEADER_SIZE = 16;
+static const size_t RECORD_PREFIX_SIZE = 8;            // crc32 + 长度
+static const size_t RECORD_BODY_SIZE = 28;
+static const size_t RECORD_SIZE = RECORD_PREFIX_SIZE + RECORD_BODY_SIZE;
+static const size_t REPLAY_BLOCK = 64 * 1024;
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc ^= 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+static inline void putValue(char*& p, T value) {
+    memcpy(p, &value, sizeof(value));
+    p += sizeof(value);
+}
+
+template <typename T>
+static inline T getValue(const char*& p) {
+    T value;
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return value;
+}
+
+static void encodeRecord(const JournalRecord& record, char* out) {
+    char* p = out + RECORD_PREFIX_SIZE;
+    putValue<uint64_t>(p, record.seq);
+    putValue<double>(p, record.time);
+    putValue<uint8_t>(p, static_cast<uint8_t>(record.type));
+    putValue<uint8_t>(p, record.arg);
+    putValue<uint16_t>(p, 0);
+    putValue<int32_t>(p, record.row);
+    putValue<int32_t>(p, record.col);
+
+    // crc覆盖长度字段和记录体
+    p = out + 4;
+    putValue<uint32_t>(p, static_cast<uint32_t>(RECORD_BODY_SIZE));
+    p = out;
+    putValue<uint32_t>(p, crc32(out + 4, RECORD_SIZE - 4));
+}
+
+static void encodeHeader(char* header, int rows, int cols) {
+    char* p = header;
+    putValue<uint32_t>(p, JOURNAL_MAGIC);
+    putValue<uint16_t>(p, JOURNAL_VERSION);
+    putValue<uint16_t>(p, 0);
+    putValue<int32_t>(p, rows);
+    putValue<int32_t>(p, cols);
+}
+
+Journal::Journal()
+    : m_fd(-1), m_rows(0), m_cols(0), m_validLength(0), m_scanned(false),
+      m_durability(JournalDurability::INTERVAL), m_intervalMs(10),
+      m_running(false), m_stopping(false),
+      m_nextSeq(1), m_appendedSeq(0), m_durableSeq(0), m_compactThrough(0),
+      m_failedFromSeq(0), m_failed(false) {
+}
+
+Journal::~Journal() {
+    close();
+}
+
+bool Journal::open(const std::string& path, int rows, int cols, std::string& error) {
+    close();
+
+    int fd = journal_open(path.c_str());
+    if (fd < 0) {
+        error = "Cannot open journal " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    char header[FILE_HEADER_SIZE];
+    long long size = journal_seek(fd, 0, SEEK_END);
+    journal_seek(fd, 0, SEEK_SET);
+    if (size < static_cast<long long>(FILE_HEADER_SIZE)) {
+        // 新文件（或连文件头都没写完）
+        encodeHeader(header, rows, cols);
+        if (journal_truncate(fd, 0) != 0 ||
+            journal_write(fd, header, FILE_HEADER_SIZE) != static_cast<long>(FILE_HEADER_SIZE) ||
+            journal_sync(fd) != 0) {
+            error = "Cannot initialize journal " + path + ": " + strerror(errno);
+            journal_close(fd);
+            return false;
+        }
+    } else {
+        if (journal_read(fd, header, FILE_HEADER_SIZE) != static_cast<long>(FILE_HEADER_SIZE)) {
+            error = "Cannot read journal header " + path;
+            journal_close(fd);
+            return false;
+        }
+        const char* p = header;
+        uint32_t magic = getValue<uint32_t>(p);
+        uint16_t version = getValue<uint16_t>(p);
+        getValue<uint16_t>(p);
+        int32_t fileRows = getValue<int32_t>(p);
+        int32_t fileCols = getValue<int32_t>(p);
+        if (magic != JOURNAL_MAGIC || version != JOURNAL_VERSION) {
+            error = path + " is not a farm journal (version " + std::to_string(JOURNAL_VERSION) + ")";
+            journal_close(fd);
+            return false;
+        }
+        if (fileRows != rows || fileCols != cols) {
+            error = "Journal " + path + " was written for a " + std::to_string(fileRows) + "x" +
+                    std::to_string(fileCols) + " field, current field is " +
+                    std::to_string(rows) + "x" + std::to_string(cols);
+            journal_close(fd);
+            return false;
+        }
+    }
+
+    m_fd = fd;
+    m_path = path;
+    m_rows = rows;
+    m_cols = cols;
+    m_validLength = FILE_HEADER_SIZE;
+    m_scanned = false;
+    m_nextSeq = 1;
+    m_appendedSeq = 0;
+    m_durableSeq = 0;
+    m_compactThrough = 0;
+    m_failedFromSeq = 0;
+    m_failed.store(false, std::memory_order_release);
+    m_stats = JournalStats();
+    return true;
+}
+
+bool Journal::isOpen() const {
+    return m_fd >= 0;
+}
+
+size_t Journal::replay(const JournalReplayCallback& apply, uint64_t afterSeq) {
+    if (m_fd < 0 || m_running) {
+        return 0;
+    }
+
+    journal_seek(m_fd, static_cast<long long>(FILE_HEADER_SIZE), SEEK_SET);
+    std::string buffer;
+    size_t consumed = 0;
+    size_t applied = 0;
+    uint64_t offset = FILE_HEADER_SIZE;
+    bool corrupt = false;
+    std::vector<char> block(REPLAY_BLOCK);
+
+    while (!corrupt) {
+        long n = static_cast<long>(journal_read(m_fd, block.data(), block.size()));
+        if (n <= 0) {
+            break;
+        }
+        buffer.erase(0, consumed);
+        consumed = 0;
+        buffer.append(block.data(), static_cast<size_t>(n));
+
+        while (buffer.size() - consumed >= RECORD_PREFIX_SIZE) {
+            const char* p = buffer.data() + consumed;
+            uint32_t crc = getValue<uint32_t>(p);
+            uint32_t length = getValue<uint32_t>(p);
+            if (length != RECORD_BODY_SIZE) {
+                corrupt = true;
+                break;
+            }
+            if (buffer.size() - consumed < RECORD_SIZE) {
+                break;      // 记录不完整，读下一块
+            }
+            if (crc32(buffer.data() + consumed + 4, RECORD_SIZE - 4) != crc) {
+                corrupt = true;
+                break;
+            }
+
+            JournalRecord record;
+            record.seq = getValue<uint64_t>(p);
+            record.time = getValue<double>(p);
+            record.type = static_cast<JournalRecordType>(getValue<uint8_t>(p));
+            record.arg = getValue<uint8_t>(p);
+            getValue<uint16_t>(p);
+            record.row = getValue<int32_t>(p);
+            record.col = getValue<int32_t>(p);
+
+            // 快照已包含的记录只用来推进序号
+            if (record.seq > afterSeq) {
+                if (apply) {
+                    apply(record);
+                }
+                applied++;
+            }
+            if (record.seq >= m_nextSeq) {
+                m_nextSeq = record.seq + 1;
+            }
+            consumed += RECORD_SIZE;
+            offset += RECORD_SIZE;
+        }
+    }
+
+    // 日志被压缩过时可能比快照还短，新记录的序号必须排在快照之后
+    if (m_nextSeq <= afterSeq) {
+        m_nextSeq = afterSeq + 1;
+    }
+
+    // 截掉损坏或不完整的尾部，后续记录从这里接着写
+    m_validLength = offset;
+    journal_truncate(m_fd, static_cast<long long>(m_validLength));
+    journal_seek(m_fd, static_cast<long long>(m_validLength), SEEK_SET);
+    m_appendedSeq = m_nextSeq - 1;
+    m_durableSeq = m_appendedSeq;
+    m_scanned = true;
+    return applied;
+}
+
+void Journal::start(JournalDurability durability, int intervalMs) {
+    if (m_fd < 0 || m_running) {
+        return;
+    }
+    if (!m_scanned) {
+        replay(JournalReplayCallback());
+    }
+    m_durability = durability;
+    m_intervalMs = intervalMs > 0 ? intervalMs : 1;
+    m_stopping = false;
+    m_running = true;
+    m_writer = std::thread(&Journal::writerLoop, this);
+}
+
+void Journal::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            m_stopping = true;
+        }
+    }
+    m_writerCv.notify_all();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_stopping = false;
+    }
+    if (m_fd >= 0) {
+        syncFile();
+        journal_close(m_fd);
+        m_fd = -1;
+    }
+}
+
+uint64_t Journal::append(const JournalRecord& record) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running || m_stopping) {
+        return 0;
+    }
+    JournalRecord stamped = record;
+    stamped.seq = m_nextSeq++;
+
+    size_t start = m_pending.size();
+    m_pending.resize(start + RECORD_SIZE);
+    encodeRecord(stamped, &m_pending[start]);
+    m_appendedSeq = stamped.seq;
+    m_stats.records++;
+
+    // INTERVAL模式由写线程按时醒来，不必每条唤醒
+    if (m_durability != JournalDurability::INTERVAL) {
+        m_writerCv.notify_one();
+    }
+    return stamped.seq;
+}
+
+uint64_t Journal::lastSeq() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_appendedSeq;
+}
+
+void Journal::compact(uint64_t throughSeq) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running || throughSeq == 0) {
+            return;
+        }
+        m_compactThrough = std::max(m_compactThrough, throughSeq);
+    }
+    m_writerCv.notify_one();
+}
+
+bool Journal::waitDurable(uint64_t seq) {
+    if (seq == 0 || m_durability != JournalDurability::SYNC) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_durableCv.wait(lock, [&] { return m_durableSeq >= seq || !m_running; });
+    return m_durableSeq >= seq && (m_failedFromSeq == 0 || seq < m_failedFromSeq);
+}
+
+JournalStats Journal::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Journal::writerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        if (m_durability == JournalDurability::INTERVAL) {
+            m_writerCv.wait_for(lock, std::chrono::milliseconds(m_intervalMs),
+                                [&] { return m_stopping || m_compactThrough != 0; });
+        } else {
+            m_writerCv.wait(lock, [&] {
+                return m_stopping || !m_pending.empty() || m_compactThrough != 0;
+            });
+        }
+
+        if (!m_pending.empty()) {
+            // 交换出当前批次，写盘期间新的append继续进入m_pending，组成下一批
+            m_writing.swap(m_pending);
+            uint64_t firstSeq = m_durableSeq + 1;      // 批次按序号顺序写，上一批之后的都属于这一批
+            uint64_t batchSeq = m_appendedSeq;
+            bool ok = m_failedFromSeq == 0;     // 失败之后的批次接不上已写的记录，直接丢弃
+            lock.unlock();
+
+            ok = ok && writeAll(m_writing.data(), m_writing.size());
+            bool synced = false;
+            if (ok && m_durability != JournalDurability::NONE) {
+                ok = syncFile();
+                synced = true;
+            }
+            size_t written = m_writing.size();
+            m_writing.clear();
+            if (!ok) {
+                // 截掉写了一半或没同步成功的部分，文件停在最后一个完整批次
+                journal_truncate(m_fd, static_cast<long long>(m_validLength));
+                journal_seek(m_fd, static_cast<long long>(m_validLength), SEEK_SET);
+            }
+
+            lock.lock();
+            m_stats.batches++;
+            if (synced) {
+                m_stats.syncs++;
+            }
+            if (ok) {
+                m_stats.bytes += written;
+                m_validLength += written;
+            } else {
+                m_stats.writeErrors++;
+                if (m_failedFromSeq == 0) {
+                    m_failedFromSeq = firstSeq;
+                    m_failed.store(true, std::memory_order_release);
+                }
+            }
+            // 失败的批次也推进，等待者醒来后按m_failedFromSeq判断结果
+            m_durableSeq = batchSeq;
+            m_durableCv.notify_all();
+        }
+
+        // 文件只由写线程写，压缩放在两批之间做，append不受影响
+        if (m_compactThrough != 0) {
+            uint64_t through = m_compactThrough;
+            m_compactThrough = 0;
+            lock.unlock();
+            bool ok = compactFile(through);
+            lock.lock();
+            if (ok) {
+                m_stats.compactions++;
+            } else {
+                m_stats.writeErrors++;
+            }
+        }
+
+        if (m_stopping && m_pending.empty()) {
+            break;
+        }
+    }
+    m_durableCv.notify_all();
+}
+
+// 把序号大于throughSeq的记录复制到新文件，再原子地替换旧文件
+bool Journal::compactFile(uint64_t throughSeq) {
+    std::string tmpPath = m_path + ".compact";
+    int out = journal_open(tmpPath.c_str());
+    if (out < 0) {
+        return false;
+    }
+    char header[FILE_HEADER_SIZE];
+    encodeHeader(header, m_rows, m_cols);
+    std::string kept(header, FILE_HEADER_SIZE);
+
+    // 写线程写进去的记录都是完整的，按定长步进即可
+    std::vector<char> block(REPLAY_BLOCK - REPLAY_BLOCK % RECORD_SIZE);
+    uint64_t offset = FILE_HEADER_SIZE;
+    bool ok = journal_truncate(out, 0) == 0;
+    while (ok && offset < m_validLength) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(block.size(), m_validLength - offset));
+        journal_seek(m_fd, static_cast<long long>(offset), SEEK_SET);
+        long n = static_cast<long>(journal_read(m_fd, block.data(), want));
+        if (n <= 0 || n % RECORD_SIZE != 0) {
+            ok = false;
+            break;
+        }
+        for (long i = 0; i < n; i += RECORD_SIZE) {
+            const char* p = block.data() + i + RECORD_PREFIX_SIZE;
+            if (getValue<uint64_t>(p) > throughSeq) {
+                kept.append(block.data() + i, RECORD_SIZE);
+            }
+        }
+        offset += static_cast<uint64_t>(n);
+    }
+    ok = ok && writeAllTo(out, kept.data(), kept.size()) && journal_sync(out) == 0;
+    journal_close(out);
+
+    if (ok) {
+        journal_close(m_fd);
+#ifdef _WIN32
+        std::remove(m_path.c_str());    // Windows的rename不能覆盖已有文件
+#endif
+        ok = std::rename(tmpPath.c_str(), m_path.c_str()) == 0;
+        m_fd = journal_open(m_path.c_str());
+    }
+    if (!ok) {
+        std::remove(tmpPath.c_str());
+    }
+    if (m_fd >= 0) {
+        long long size = journal_seek(m_fd, 0, SEEK_END);
+        m_validLength = size > 0 ? static_cast<uint64_t>(size) : FILE_HEADER_SIZE;
+    }
+    return ok && m_fd >= 0;
+}
+
+bool Journal::writeAll(const char* data, size_t size) {
+    return writeAllTo(m_fd, data, size);
+}
+
+bool Journal::writeAllTo(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        long n = static_cast<long>(journal_write(fd, data, size));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool Journal::syncFile() {
+    return journal_sync(m_fd) == 0;
+}
+
+const char* journalDurabilityToString(JournalDurability durability) {
+    switch (durability) {
+        case JournalDurability::NONE: return "none";
+        case JournalDurability::SYNC: return "sync";
+        default: return "interval";
+    }
+}
+
+bool stringToJournalDurability(const std::string& str, JournalDurability& durability) {
+    if (str == "none") durability = JournalDurability::NONE;
+    else if (str == "interval") durability = JournalDurability::INTERVAL;
+    else if (str == "sync") durability = JournalDurability::SYNC;
+    else return false;
+    return true;
+}
@@ -0,0 +1,153 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+ * 修改农田状态的命令的预写日志（二进制，只追加）
+ *
+ * 文件头 [magic "FWAL" u32][版本 u16][保留 u16][行数 i32][列数 i32]，随后是记录：
+ *   [crc32 u32][长度 u32][序号 u64][时间 double][类型 u8][参数 u8][保留 u16][行 i32][列 i32]
+ * crc32覆盖长度字段和记录体。整数均为小端。
+ *
+ * 组提交：append只把记录编码进内存缓冲区并分配序号，由一个写线程把攒下的
+ * 记录一次write、一次fdatasync写盘，多个并发命令分摊一次同步的开销。
+ * 持久性三档：
+ *   NONE     - 只write到内核，不主动同步（进程崩溃不丢，掉电可能丢）
+ *   INTERVAL - 每隔intervalMs同步一次，回复不等待（最多丢一个间隔）
+ *   SYNC     - 回复前等待记录同步到磁盘（waitDurable阻塞到所在批次同步完成）
+ *
+ * 某批write或fdatasync失败时，文件截回到上一批的末尾，日志进入失败状态（fail-stop）：
+ * 该批及之后的记录都不再写盘，等待它们的waitDurable返回false。内存中的状态已经
+ * 多出了没有落盘的操作，调用方应拒绝后续修改并停止写快照，重启后从快照和日志恢复。
+ *
+ * 启动时replay按顺序回放完整的记录；末尾被截断或校验失败的部分（写到一半
+ * 时崩溃）会被截掉，之后从截断处继续追加。快照写好后用compact丢弃快照已
+ * 包含的记录，回放时间只取决于上一个快照之后的操作数。
+ */
+
+enum class JournalDurability : uint8_t {
+    NONE,
+    INTERVAL,
+    SYNC
+};
+
+enum class JournalRecordType : uint8_t {
+    PLANT_SEED = 1,     // arg = PlantType
+    WATER = 2,
+    REMOVE_WEEDS = 3,
+    HARVEST = 4,
+    UPGRADE_TOOL = 5    // arg = ResourceTool，row/col不用
+};
+
+struct JournalRecord {
+    uint64_t seq;
+    double time;            // 操作发生的农田时钟
+    JournalRecordType type;
+    uint8_t arg;
+    int32_t row;
+    int32_t col;
+
+    JournalRecord()
+        : seq(0), time(0.0), type(JournalRecordType::WATER), arg(0), row(0), col(0) {}
+    JournalRecord(JournalRecordType t, uint8_t a, int32_t r, int32_t c, double when)
+        : seq(0), time(when), type(t), arg(a), row(r), col(c) {}
+};
+
+struct JournalStats {
+    uint64_t records;       // 本次启动追加的记录数
+    uint64_t batches;       // 写盘批次数
+    uint64_t syncs;         // fdatasync次数
+    uint64_t bytes;         // 本次启动写入的字节数
+    uint64_t compactions;
+    uint64_t writeErrors;
+
+    JournalStats() : records(0), batches(0), syncs(0), bytes(0), compactions(0), writeErrors(0) {}
+};
+
+using JournalReplayCallback = std::function<void(const JournalRecord&)>;
+
+class Journal {
+public:
+    Journal();
+    ~Journal();
+
+    // 打开（不存在则创建）日志文件；已有文件的农田尺寸不一致时失败
+    bool open(const std::string& path, int rows, int cols, std::string& error);
+    bool isOpen() const;
+    const std::string& path() const { return m_path; }
+
+    // 按顺序回放序号大于afterSeq的完整记录，返回回放条数；截掉损坏的尾部。须在start之前调用
+    size_t replay(const JournalReplayCallback& apply, uint64_t afterSeq = 0);
+
+    // 启动写线程；之后才能append
+    void start(JournalDurability durability, int intervalMs);
+    // 写出剩余记录、同步并关闭文件
+    void close();
+
+    // 追加一条记录，返回它的序号；日志未启动时返回0
+    uint64_t append(const JournalRecord& record);
+    // SYNC模式下阻塞到seq所在批次同步完成，该批写盘失败时返回false；其余模式立即返回true
+    bool waitDurable(uint64_t seq);
+    // 还没有批次写盘失败（可在任意线程调用，不加锁）
+    bool healthy() const { return !m_failed.load(std::memory_order_acquire); }
+    // 最后分配的序号
+    uint64_t lastSeq() const;
+    // 请求丢弃序号不大于throughSeq的记录（由写线程在两批之间重写文件）
+    void compact(uint64_t throughSeq);
+
+    JournalDurability durability() const { return m_durability; }
+    JournalStats stats() const;
+
+private:
+    int m_fd;
+    std::string m_path;
+    int m_rows;
+    int m_cols;
+    uint64_t m_validLength;     // 文件中完整记录的末尾
+    bool m_scanned;             // 已回放/校验过已有记录
+
+    JournalDurability m_durability;
+    int m_intervalMs;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_writerCv;     // 有新记录 / 停止
+    std::condition_variable m_durableCv;    // 有批次写完
+    std::thread m_writer;
+    bool m_running;
+    bool m_stopping;
+
+    std::string m_pending;      // 待写的已编码记录
+    std::string m_writing;      // 写线程正在写的批次（与m_pending交换，复用容量）
+    uint64_t m_nextSeq;
+    uint64_t m_appendedSeq;     // 已进入m_pending的最大序号
+    uint64_t m_durableSeq;      // 已写完（按模式同步）的最大序号
+    uint64_t m_compactThrough;  // 待执行的压缩，0表示没有
+    uint64_t m_failedFromSeq;   // 第一个没能写盘的序号，0表示没有失败
+    std::atomic<bool> m_failed;
+    JournalStats m_stats;
+
+    void writerLoop();
+    bool writeAll(const char* data, size_t size);
+    bool compactFile(uint64_t throughSeq);
+    static bool writeAllTo(int fd, const char* data, size_t size);
+    bool syncFile();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+};
+
+// IEEE CRC-32（与zlib相同），crc传入上一段的结果可分段计算；日志和快照共用
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+const char* journalDurabilityToString(JournalDurability durability);
+bool stringToJournalDurability(const std::string& str, JournalDurability& durability);
+
+#endif // JOURNAL_H
@@ -0,0 +1,323 @@
+#include "Metrics.h"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+size_t metricShard() {
+    static std::atomic<size_t> nextShard(0);
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+// 最高位的位置，v > 0
+static int highestBit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static std::string formatDouble(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+// ========== ShardedCounter ==========
+
+ShardedCounter::ShardedCounter() {
+    for (Shard& shard : m_shards) {
+        shard.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t ShardedCounter::value() const {
+    uint64_t total = 0;
+    for (const Shard& shard : m_shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// ========== LatencyHistogram ==========
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto& shard : m_shards) {
+        shard.reset(new Shard());   // 值初始化，所有桶为0
+    }
+}
+
+int LatencyHistogram::bucketIndex(uint64_t micros) {
+    if (micros < SUB_BUCKETS) {
+        return static_cast<int>(micros);
+    }
+    int exponent = highestBit(micros);
+    if (exponent >= MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    int sub = static_cast<int>((micros >> (exponent - 2)) & (SUB_BUCKETS - 1));
+    return SUB_BUCKETS + (exponent - 2) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int index) {
+    if (index < SUB_BUCKETS) {
+        return static_cast<uint64_t>(index) + 1;
+    }
+    int exponent = (index - SUB_BUCKETS) / SUB_BUCKETS + 2;
+    int sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    return static_cast<uint64_t>(SUB_BUCKETS + sub + 1) << (exponent - 2);
+}
+
+void LatencyHistogram::snapshot(HistogramSnapshot& out) const {
+    out.buckets.assign(BUCKET_COUNT, 0);
+    out.count = 0;
+    out.sumMicros = 0;
+    for (const auto& shard : m_shards) {
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            uint64_t n = shard->buckets[i].load(std::memory_order_relaxed);
+            out.buckets[i] += n;
+            out.count += n;
+        }
+        out.sumMicros += shard->sumMicros.load(std::memory_order_relaxed);
+    }
+}
+
+uint64_t HistogramSnapshot::quantileMicros(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * count + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return LatencyHistogram::bucketUpperBound(static_cast<int>(i));
+        }
+    }
+    return LatencyHistogram::bucketUpperBound(static_cast<int>(buckets.size()) - 1);
+}
+
+// ========== MetricsRegistry ==========
+
+MetricsRegistry::MetricsRegistry() {
+}
+
+MetricsRegistry::Series& MetricsRegistry::findOrAdd(const std::string& name, const std::string& help,
+                                                    MetricType type, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Family* family = nullptr;
+    for (auto& existing : m_families) {
+        if (existing->name == name) {
+            family = existing.get();
+            break;
+        }
+    }
+    if (!family) {
+        m_families.emplace_back(new Family());
+        family = m_families.back().get();
+        family->name = name;
+        family->help = help;
+        family->type = type;
+    }
+    for (auto& series : family->series) {
+        if (series->labels == labels) {
+            return *series;
+        }
+    }
+    family->series.emplace_back(new Series());
+    Series& series = *family->series.back();
+    series.labels = labels;
+    switch (family->type) {
+        case MetricType::COUNTER:   series.counter.reset(new ShardedCounter()); break;
+        case MetricType::GAUGE:     series.gauge.reset(new Gauge()); break;
+        case MetricType::HISTOGRAM: series.histogram.reset(new LatencyHistogram()); break;
+    }
+    return series;
+}
+
+ShardedCounter* MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                         const std::string& labels) {
+    return findOrAdd(name, help, MetricType::COUNTER, labels).counter.get();
+}
+
+Gauge* MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    return findOrAdd(name, help, MetricType::GAUGE, labels).gauge.get();
+}
+
+LatencyHistogram* MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                             const std::string& labels) {
+    return findOrAdd(name, help, MetricType::HISTOGRAM, labels).histogram.get();
+}
+
+std::string MetricsRegistry::exportText() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream oss;
+    HistogramSnapshot snapshot;
+    for (const auto& family : m_families) {
+        const char* type = family->type == MetricType::COUNTER ? "counter"
+                         : family->type == MetricType::GAUGE ? "gauge" : "histogram";
+        oss << "# HELP " << family->name << " " << family->help << "\n"
+            << "# TYPE " << family->name << " " << type << "\n";
+
+        for (const auto& series : family->series) {
+            const std::string& labels = series->labels;
+            std::string braced = labels.empty() ? "" : "{" + labels + "}";
+            if (series->counter) {
+                oss << family->name << braced << " " << series->counter->value() << "\n";
+                continue;
+            }
+            if (series->gauge) {
+                oss << family->name << braced << " " << series->gauge->value() << "\n";
+                continue;
+            }
+
+            series->histogram->snapshot(snapshot);
+            if (snapshot.count == 0) {
+                continue;
+            }
+            std::string prefix = family->name + "_bucket{" + (labels.empty() ? "" : labels + ",") + "le=\"";
+            // 每个2的幂一个le，与内部子桶的边界对齐
+            uint64_t cumulative = 0;
+            int bucket = 0;
+            for (int exponent = 0; exponent <= LatencyHistogram::MAX_EXPONENT; exponent++) {
+                uint64_t bound = 1ull << exponent;
+                while (bucket < LatencyHistogram::BUCKET_COUNT &&
+                       LatencyHistogram::bucketUpperBound(bucket) <= bound) {
+                    cumulative += snapshot.buckets[bucket++];
+                }
+                oss << prefix << formatDouble(bound / 1e6) << "\"} " << cumulative << "\n";
+            }
+            oss << prefix << "+Inf\"} " << snapshot.count << "\n"
+                << family->name << "_sum" << braced << " " << formatDouble(snapshot.sumMicros / 1e6) << "\n"
+                << family->name << "_count" << braced << " " << snapshot.count << "\n";
+        }
+    }
+    return oss.str();
+}
+
+// ========== MetricsHttpServer ==========
+
+MetricsHttpServer::MetricsHttpServer() : m_listenSocket(INVALID_SOCKET), m_stop(false) {
+}
+
+MetricsHttpServer::~MetricsHttpServer() {
+    stop();
+}
+
+bool MetricsHttpServer::start(uint16_t port, Render render, std::string& error) {
+    stop();
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!isValidSocket(m_listenSocket)) {
+        error = std::string("socket: ") + getSocketError();
+        return false;
+    }
+    setReuseAddr(m_listenSocket);
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(m_listenSocket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(m_listenSocket, 16) == SOCKET_ERROR) {
+        error = "bind 127.0.0.1:" + std::to_string(port) + ": " + getSocketError();
+        safeCloseSocket(m_listenSocket);
+        return false;
+    }
+
+    m_render = render;
+    m_stop = false;
+    m_thread = std::thread(&MetricsHttpServer::acceptLoop, this);
+    return true;
+}
+
+void MetricsHttpServer::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stop = true;
+    // Linux上只close不会唤醒阻塞在accept的线程，先shutdown
+    shutdown(m_listenSocket, SD_BOTH);
+    safeCloseSocket(m_listenSocket);
+    m_thread.join();
+}
+
+void MetricsHttpServer::acceptLoop() {
+    while (!m_stop) {
+        socket_t client = accept(m_listenSocket, nullptr, nullptr);
+        if (!isValidSocket(client)) {
+            if (m_stop) {
+                break;
+            }
+            continue;
+        }
+        serve(client);
+        safeCloseSocket(client);
+    }
+}
+
+// 读到请求头结束（最多8KB，2秒超时），只看请求行
+void MetricsHttpServer::serve(socket_t client) {
+#ifdef _WIN32
+    DWORD timeout = 2000;
+#else
+    timeval timeout;
+    timeout.tv_sec = 2;
+    timeout.tv_usec = 0;
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        int received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    // 请求行：方法 路径 版本
+    std::istringstream line(request.substr(0, request.find("\r\n")));
+    std::string method;
+    std::string path;
+    line >> method >> path;
+    path = path.substr(0, path.find('?'));
+
+    std::string status;
+    std::string body;
+    std::string contentType = "text/plain; charset=utf-8";
+    if (method == "GET" && path == "/metrics") {
+        status = "200 OK";
+        body = m_render();
+        contentType = "text/plain; version=0.0.4; charset=utf-8";
+    } else if (method == "GET") {
+        status = "404 Not Found";
+        body = "Try /metrics\n";
+    } else {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported\n";
+    }
+
+    std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: " + contentType +
+                           "\r\nContent-Length: " + std::to_string(body.size()) +
+                           "\r\nConnection: close\r\n\r\n" + body;
+    size_t offset = 0;
+    while (offset < response.size()) {
+        int sent = send(client, response.data() + offset, static_cast<int>(response.size() - offset), 0);
+        if (sent <= 0) {
+            return;
+        }
+        offset += static_cast<size_t>(sent);
+    }
+}
@@ -0,0 +1,167 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "socket_compat.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 服务器指标
+ *
+ * 热路径上只有relaxed原子加法，不加锁、不分配内存：
+ *   - 计数器按线程分片：每个线程第一次使用时分到一个分片（缓存行对齐），
+ *     各线程加到自己的分片上，读取时把所有分片求和
+ *   - 仪表是一个原子整数，set/add
+ *   - 延迟直方图同样分片，桶是对数线性的（每个2的幂分4个子桶，相对误差不超过25%），
+ *     以微秒记录，覆盖1us到约71分钟
+ * 指标在启动时登记到MetricsRegistry（登记时加锁），之后热路径持有指针直接更新。
+ * exportText按Prometheus文本格式（0.0.4）输出所有指标；MetricsHttpServer在本地端口上
+ * 响应GET /metrics。
+ */
+
+constexpr size_t METRIC_SHARDS = 16;
+
+// 当前线程使用的分片
+size_t metricShard();
+
+class ShardedCounter {
+public:
+    ShardedCounter();
+
+    void add(uint64_t n = 1) {
+        m_shards[metricShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value;
+    };
+    Shard m_shards[METRIC_SHARDS];
+};
+
+class Gauge {
+public:
+    Gauge() : m_value(0) {}
+
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value;
+};
+
+// 直方图的读取结果
+struct HistogramSnapshot {
+    std::vector<uint64_t> buckets;  // 各桶的计数（非累计）
+    uint64_t count;
+    uint64_t sumMicros;
+
+    HistogramSnapshot() : count(0), sumMicros(0) {}
+
+    // 估计分位数（0~1），取所在桶的上界，单位微秒
+    uint64_t quantileMicros(double q) const;
+};
+
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKETS = 4;       // 每个2的幂的子桶数
+    static const int MAX_EXPONENT = 32;     // 最大记录2^32微秒，更大的落入最后一个桶
+    static const int BUCKET_COUNT = SUB_BUCKETS + (MAX_EXPONENT - 2) * SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    void record(uint64_t micros) {
+        Shard& shard = *m_shards[metricShard()];
+        shard.buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+        shard.sumMicros.fetch_add(micros, std::memory_order_relaxed);
+    }
+    void snapshot(HistogramSnapshot& out) const;
+
+    static int bucketIndex(uint64_t micros);
+    // 桶的上界（不含），单位微秒
+    static uint64_t bucketUpperBound(int index);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+        std::atomic<uint64_t> sumMicros;
+    };
+    std::unique_ptr<Shard> m_shards[METRIC_SHARDS];
+};
+
+// 一组同名指标（不同标签），按登记顺序导出
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+
+    // labels为Prometheus标签体，例如 command="MOVE_CART"；同名同标签重复登记返回同一个指标
+    ShardedCounter* counter(const std::string& name, const std::string& help,
+                            const std::string& labels = "");
+    Gauge* gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    LatencyHistogram* histogram(const std::string& name, const std::string& help,
+                                const std::string& labels = "");
+
+    // Prometheus文本格式；直方图按秒导出，le取2的幂微秒，没有样本的直方图省略
+    std::string exportText() const;
+
+private:
+    enum class MetricType { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Series {
+        std::string labels;
+        std::unique_ptr<ShardedCounter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<LatencyHistogram> histogram;
+    };
+    struct Family {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    std::vector<std::unique_ptr<Family>> m_families;
+    mutable std::mutex m_mutex;
+
+    Series& findOrAdd(const std::string& name, const std::string& help, MetricType type,
+                      const std::string& labels);
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+};
+
+// 本地HTTP导出：GET /metrics返回render()的结果，其他路径404；每个连接只处理一个请求
+class MetricsHttpServer {
+public:
+    using Render = std::function<std::string()>;
+
+    MetricsHttpServer();
+    ~MetricsHttpServer();
+
+    // 只监听127.0.0.1
+    bool start(uint16_t port, Render render, std::string& error);
+    void stop();
+    bool running() const { return m_thread.joinable(); }
+
+private:
+    socket_t m_listenSocket;
+    Render m_render;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+
+    void acceptLoop();
+    void serve(socket_t client);
+
+    MetricsHttpServer(const MetricsHttpServer&) = delete;
+    MetricsHttpServer& operator=(const MetricsHttpServer&) = delete;
+};
+
+#endif // METRICS_H
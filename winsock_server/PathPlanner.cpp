@@ -0,0 +1,267 @@
+#include "PathPlanner.h"
+#include <cmath>
+#include <queue>
+#include <limits>
+#include <algorithm>
+
+// 2-opt只对较短的路线执行，避免O(n^2)开销失控
+static const size_t TWO_OPT_MAX_TASKS = 128;
+static const int TWO_OPT_MAX_PASSES = 4;
+
+PathPlanner::PathPlanner(int rows, int cols)
+    : m_rows(0), m_cols(0) {
+    resize(rows, cols);
+}
+
+void PathPlanner::resize(int rows, int cols) {
+    m_rows = rows > 0 ? rows : 1;
+    m_cols = cols > 0 ? cols : 1;
+    m_obstacles.assign(static_cast<size_t>(m_rows) * m_cols, 0);
+}
+
+void PathPlanner::addObstacle(int row, int col) {
+    if (row >= 0 && row < m_rows && col >= 0 && col < m_cols) {
+        m_obstacles[index(row, col)] = 1;
+    }
+}
+
+void PathPlanner::removeObstacle(int row, int col) {
+    if (row >= 0 && row < m_rows && col >= 0 && col < m_cols) {
+        m_obstacles[index(row, col)] = 0;
+    }
+}
+
+bool PathPlanner::isValidPosition(int row, int col) const {
+    return row >= 0 && row < m_rows && col >= 0 && col < m_cols &&
+           !m_obstacles[index(row, col)];
+}
+
+double PathPlanner::distance(GridPos a, GridPos b) {
+    double dr = a.row - b.row;
+    double dc = a.col - b.col;
+    return std::sqrt(dr * dr + dc * dc);
+}
+
+bool PathPlanner::calculatePath(GridPos start, GridPos goal, std::vector<GridPos>& path) const {
+    PathWorkspace workspace;
+    return calculatePath(start, goal, path, workspace);
+}
+
+bool PathPlanner::calculatePath(GridPos start, GridPos goal, std::vector<GridPos>& path,
+                                PathWorkspace& workspace) const {
+    path.clear();
+    if (!isValidPosition(start.row, start.col) || !isValidPosition(goal.row, goal.col)) {
+        return false;
+    }
+    if (start == goal) {
+        path.push_back(start);
+        return true;
+    }
+
+    static const int DR[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+    static const int DC[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+    static const double SQRT2 = std::sqrt(2.0);
+
+    // 八方向距离作启发函数（可采纳，比曼哈顿距离更紧）
+    auto heuristic = [&goal](int row, int col) {
+        int dr = std::abs(row - goal.row);
+        int dc = std::abs(col - goal.col);
+        return (SQRT2 - 1.0) * std::min(dr, dc) + std::max(dr, dc);
+    };
+
+    size_t cellCount = static_cast<size_t>(m_rows) * m_cols;
+    if (workspace.seen.size() != cellCount || ++workspace.stamp == 0) {
+        workspace.gScore.assign(cellCount, 0.0);
+        workspace.cameFrom.assign(cellCount, -1);
+        workspace.seen.assign(cellCount, 0);
+        workspace.closed.assign(cellCount, 0);
+        workspace.stamp = 1;
+    }
+    const uint32_t stamp = workspace.stamp;
+    std::vector<double>& gScore = workspace.gScore;
+    std::vector<int>& cameFrom = workspace.cameFrom;
+    std::vector<uint32_t>& seen = workspace.seen;
+    std::vector<uint32_t>& closed = workspace.closed;
+
+    typedef std::pair<double, int> OpenEntry;   // (f, cell)
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+
+    int startIndex = index(start.row, start.col);
+    int goalIndex = index(goal.row, goal.col);
+    gScore[startIndex] = 0.0;
+    cameFrom[startIndex] = -1;
+    seen[startIndex] = stamp;
+    open.push(OpenEntry(heuristic(start.row, start.col), startIndex));
+
+    while (!open.empty()) {
+        int current = open.top().second;
+        open.pop();
+        if (closed[current] == stamp) {
+            continue;   // 过期条目
+        }
+        closed[current] = stamp;
+
+        if (current == goalIndex) {
+            for (int cell = goalIndex; cell >= 0; cell = cameFrom[cell]) {
+                path.push_back(GridPos(cell / m_cols, cell % m_cols));
+            }
+            std::reverse(path.begin(), path.end());
+            return true;
+        }
+
+        int row = current / m_cols;
+        int col = current % m_cols;
+        for (int d = 0; d < 8; d++) {
+            int nr = row + DR[d];
+            int nc = col + DC[d];
+            if (!isValidPosition(nr, nc)) {
+                continue;
+            }
+            int neighbor = index(nr, nc);
+            double tentative = gScore[current] + (d >= 4 ? SQRT2 : 1.0);
+            if (seen[neighbor] != stamp || tentative < gScore[neighbor]) {
+                seen[neighbor] = stamp;
+                gScore[neighbor] = tentative;
+                cameFrom[neighbor] = current;
+                open.push(OpenEntry(tentative + heuristic(nr, nc), neighbor));
+            }
+        }
+    }
+    return false;
+}
+
+void PathPlanner::distanceField(GridPos source, std::vector<double>& dist) const {
+    size_t cellCount = static_cast<size_t>(m_rows) * m_cols;
+    dist.assign(cellCount, std::numeric_limits<double>::infinity());
+    if (!isValidPosition(source.row, source.col)) {
+        return;
+    }
+
+    static const int DR[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+    static const int DC[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+    static const double SQRT2 = std::sqrt(2.0);
+
+    typedef std::pair<double, int> OpenEntry;   // (g, cell)
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+    int sourceIndex = index(source.row, source.col);
+    dist[sourceIndex] = 0.0;
+    open.push(OpenEntry(0.0, sourceIndex));
+
+    while (!open.empty()) {
+        double g = open.top().first;
+        int current = open.top().second;
+        open.pop();
+        if (g > dist[current]) {
+            continue;   // 过期条目
+        }
+        int row = current / m_cols;
+        int col = current % m_cols;
+        for (int d = 0; d < 8; d++) {
+            int nr = row + DR[d];
+            int nc = col + DC[d];
+            if (!isValidPosition(nr, nc)) {
+                continue;
+            }
+            int neighbor = index(nr, nc);
+            double tentative = g + (d >= 4 ? SQRT2 : 1.0);
+            if (tentative < dist[neighbor]) {
+                dist[neighbor] = tentative;
+                open.push(OpenEntry(tentative, neighbor));
+            }
+        }
+    }
+}
+
+int PathPlanner::findNearestTask(GridPos current, const std::vector<GridPos>& tasks) const {
+    int nearest = -1;
+    double minDistance = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (!isValidPosition(tasks[i].row, tasks[i].col)) {
+            continue;
+        }
+        double d = distance(current, tasks[i]);
+        if (d < minDistance) {
+            minDistance = d;
+            nearest = static_cast<int>(i);
+        }
+    }
+    return nearest;
+}
+
+void PathPlanner::optimizeTaskOrder(GridPos start, std::vector<GridPos>& tasks) const {
+    std::vector<int> order;
+    optimizeTaskOrder(start, tasks, order);
+
+    std::vector<GridPos> ordered;
+    ordered.reserve(order.size());
+    for (int i : order) {
+        ordered.push_back(tasks[i]);
+    }
+    tasks.swap(ordered);
+}
+
+void PathPlanner::optimizeTaskOrder(GridPos start, const std::vector<GridPos>& tasks,
+                                    std::vector<int>& order) const {
+    // 过滤无效位置
+    order.clear();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (isValidPosition(tasks[i].row, tasks[i].col)) {
+            order.push_back(static_cast<int>(i));
+        }
+    }
+
+    // 最近邻贪心（原地选择排序）
+    GridPos current = start;
+    for (size_t i = 0; i < order.size(); i++) {
+        size_t best = i;
+        double bestDistance = distance(current, tasks[order[i]]);
+        for (size_t j = i + 1; j < order.size(); j++) {
+            double d = distance(current, tasks[order[j]]);
+            if (d < bestDistance) {
+                bestDistance = d;
+                best = j;
+            }
+        }
+        std::swap(order[i], order[best]);
+        current = tasks[order[i]];
+    }
+
+    if (order.size() >= 3 && order.size() <= TWO_OPT_MAX_TASKS) {
+        improveTwoOpt(start, tasks, order);
+    }
+}
+
+// 2-opt：翻转区间[i, j]能缩短路线时就翻转（路线起点固定，终点开放）
+void PathPlanner::improveTwoOpt(GridPos start, const std::vector<GridPos>& tasks,
+                                std::vector<int>& order) const {
+    size_t n = order.size();
+    for (int pass = 0; pass < TWO_OPT_MAX_PASSES; pass++) {
+        bool improved = false;
+        for (size_t i = 0; i + 1 < n; i++) {
+            GridPos before = i == 0 ? start : tasks[order[i - 1]];
+            for (size_t j = i + 1; j < n; j++) {
+                double removed = distance(before, tasks[order[i]]);
+                double added = distance(before, tasks[order[j]]);
+                if (j + 1 < n) {
+                    removed += distance(tasks[order[j]], tasks[order[j + 1]]);
+                    added += distance(tasks[order[i]], tasks[order[j + 1]]);
+                }
+                if (added + 1e-9 < removed) {
+                    std::reverse(order.begin() + i, order.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+        if (!improved) {
+            break;
+        }
+    }
+}
+
+double PathPlanner::pathLength(const std::vector<GridPos>& path, double cellSize) {
+    double total = 0.0;
+    for (size_t i = 1; i < path.size(); i++) {
+        total += distance(path[i - 1], path[i]) * cellSize;
+    }
+    return total;
+}
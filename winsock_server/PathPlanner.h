@@ -0,0 +1,83 @@
+#ifndef PATH_PLANNER_H
+#define PATH_PLANNER_H
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * 路径规划器 - path_planner.py的C++实现
+ *
+ * calculatePath 使用A*（8方向，对角代价√2）；
+ * optimizeTaskOrder 先做最近邻贪心，再用2-opt消除交叉。
+ */
+
+// 网格坐标
+struct GridPos {
+    int row;
+    int col;
+
+    GridPos() : row(0), col(0) {}
+    GridPos(int r, int c) : row(r), col(c) {}
+    bool operator==(const GridPos& other) const { return row == other.row && col == other.col; }
+    bool operator!=(const GridPos& other) const { return !(*this == other); }
+};
+
+// A*的工作区：多次搜索时复用，按时间戳区分本次写入的格子，不必每次按网格大小重新分配
+struct PathWorkspace {
+    std::vector<double> gScore;
+    std::vector<int> cameFrom;
+    std::vector<uint32_t> seen;     // == stamp 表示gScore/cameFrom有效
+    std::vector<uint32_t> closed;   // == stamp 表示已关闭
+    uint32_t stamp;
+
+    PathWorkspace() : stamp(0) {}
+};
+
+class PathPlanner {
+public:
+    PathPlanner(int rows = 8, int cols = 8);
+
+    void resize(int rows, int cols);
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+
+    // 障碍物
+    void addObstacle(int row, int col);
+    void removeObstacle(int row, int col);
+    bool isValidPosition(int row, int col) const;
+
+    // A*路径，无法到达返回false
+    bool calculatePath(GridPos start, GridPos goal, std::vector<GridPos>& path) const;
+    bool calculatePath(GridPos start, GridPos goal, std::vector<GridPos>& path,
+                       PathWorkspace& workspace) const;
+
+    // 优化任务执行顺序（原地重排），无效位置的任务被移除
+    void optimizeTaskOrder(GridPos start, std::vector<GridPos>& tasks) const;
+
+    // 同上，但输出执行顺序（tasks的下标），便于调用方携带任务附加信息
+    void optimizeTaskOrder(GridPos start, const std::vector<GridPos>& tasks,
+                           std::vector<int>& order) const;
+
+    // 从source出发到每个格子的最短路径长度（格，8方向，绕开障碍），不可达为无穷大
+    void distanceField(GridPos source, std::vector<double>& dist) const;
+
+    // 最近的任务下标，没有有效任务返回-1
+    int findNearestTask(GridPos current, const std::vector<GridPos>& tasks) const;
+
+    // 路径长度（米）
+    static double pathLength(const std::vector<GridPos>& path, double cellSize);
+
+    // 两点的欧几里得距离（格）
+    static double distance(GridPos a, GridPos b);
+
+private:
+    int m_rows;
+    int m_cols;
+    std::vector<uint8_t> m_obstacles;
+
+    int index(int row, int col) const { return row * m_cols + col; }
+    void improveTwoOpt(GridPos start, const std::vector<GridPos>& tasks,
+                       std::vector<int>& order) const;
+};
+
+#endif // PATH_PLANNER_H
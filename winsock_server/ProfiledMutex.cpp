@@ -0,0 +1,131 @@
+#include "ProfiledMutex.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+// 进程内登记过的加锁处；函数内静态变量，避免与其他静态对象的初始化顺序问题
+std::mutex& sitesMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<const LockSite*>& sites() {
+    static std::vector<const LockSite*> list;
+    return list;
+}
+
+void storeMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+std::string formatSeconds(uint64_t ns) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", ns / 1e9);
+    return buffer;
+}
+
+}  // namespace
+
+LockSite::LockSite(const char* lock, const char* function, int line)
+    : m_lock(lock), m_function(function), m_line(line) {
+    for (Shard& shard : m_shards) {
+        shard.acquisitions.store(0, std::memory_order_relaxed);
+        shard.contended.store(0, std::memory_order_relaxed);
+        shard.waitNs.store(0, std::memory_order_relaxed);
+        shard.holdNs.store(0, std::memory_order_relaxed);
+        shard.maxWaitNs.store(0, std::memory_order_relaxed);
+        shard.maxHoldNs.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lockGuard(sitesMutex());
+    sites().push_back(this);
+}
+
+void LockSite::recordWait(uint64_t waitNs) {
+    Shard& shard = m_shards[metricShard()];
+    shard.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (waitNs > 0) {
+        shard.contended.fetch_add(1, std::memory_order_relaxed);
+        shard.waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+        storeMax(shard.maxWaitNs, waitNs);
+    }
+}
+
+void LockSite::recordHold(uint64_t holdNs) {
+    Shard& shard = m_shards[metricShard()];
+    shard.holdNs.fetch_add(holdNs, std::memory_order_relaxed);
+    storeMax(shard.maxHoldNs, holdNs);
+}
+
+LockSiteStats LockSite::stats() const {
+    LockSiteStats stats;
+    stats.lock = m_lock;
+    stats.site = std::string(m_function) + ":" + std::to_string(m_line);
+    for (const Shard& shard : m_shards) {
+        stats.acquisitions += shard.acquisitions.load(std::memory_order_relaxed);
+        stats.contended += shard.contended.load(std::memory_order_relaxed);
+        stats.waitNs += shard.waitNs.load(std::memory_order_relaxed);
+        stats.holdNs += shard.holdNs.load(std::memory_order_relaxed);
+        stats.maxWaitNs = std::max(stats.maxWaitNs, shard.maxWaitNs.load(std::memory_order_relaxed));
+        stats.maxHoldNs = std::max(stats.maxHoldNs, shard.maxHoldNs.load(std::memory_order_relaxed));
+    }
+    return stats;
+}
+
+std::vector<LockSiteStats> lockProfile() {
+    std::vector<LockSiteStats> result;
+    {
+        std::lock_guard<std::mutex> lock(sitesMutex());
+        for (const LockSite* site : sites()) {
+            LockSiteStats stats = site->stats();
+            if (stats.acquisitions > 0) {
+                result.push_back(stats);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const LockSiteStats& a, const LockSiteStats& b) {
+        return a.waitNs != b.waitNs ? a.waitNs > b.waitNs : a.holdNs > b.holdNs;
+    });
+    return result;
+}
+
+std::string exportLockProfileText() {
+    std::vector<LockSiteStats> profile = lockProfile();
+    struct Family {
+        const char* name;
+        const char* type;
+        const char* help;
+    };
+    static const Family families[] = {
+        {"farm_lock_acquisitions_total", "counter", "Lock acquisitions, by lock and call site."},
+        {"farm_lock_contended_total", "counter", "Acquisitions that had to wait for another holder."},
+        {"farm_lock_wait_seconds_total", "counter", "Time spent waiting to acquire the lock."},
+        {"farm_lock_hold_seconds_total", "counter", "Time the lock was held after acquiring it here."},
+        {"farm_lock_wait_max_seconds", "gauge", "Longest single wait at this call site."},
+        {"farm_lock_hold_max_seconds", "gauge", "Longest single hold at this call site."},
+    };
+
+    std::ostringstream oss;
+    for (size_t i = 0; i < sizeof(families) / sizeof(families[0]); i++) {
+        const Family& family = families[i];
+        oss << "# HELP " << family.name << " " << family.help << "\n"
+            << "# TYPE " << family.name << " " << family.type << "\n";
+        for (const LockSiteStats& stats : profile) {
+            oss << family.name << "{lock=\"" << stats.lock << "\",site=\"" << stats.site << "\"} ";
+            switch (i) {
+                case 0: oss << stats.acquisitions; break;
+                case 1: oss << stats.contended; break;
+                case 2: oss << formatSeconds(stats.waitNs); break;
+                case 3: oss << formatSeconds(stats.holdNs); break;
+                case 4: oss << formatSeconds(stats.maxWaitNs); break;
+                default: oss << formatSeconds(stats.maxHoldNs); break;
+            }
+            oss << "\n";
+        }
+    }
+    return oss.str();
+}
@@ -0,0 +1,132 @@
+#ifndef PROFILED_MUTEX_H
+#define PROFILED_MUTEX_H
+
+#include "Metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * 锁竞争剖析
+ *
+ * ProfiledMutex包装std::mutex；用PROFILED_LOCK加锁时，每个加锁处（函数名+行号）
+ * 登记一个LockSite，分别统计：加锁次数、需要等待的次数、等待时间、持有时间及各自的最大值。
+ *   - 先try_lock，拿到锁时不计等待，只有等待的加锁才多读一次时钟
+ *   - 持有时间在拿到锁和解锁时各读一次时钟
+ *   - 统计按线程分片（与Metrics共用metricShard），热路径只有relaxed原子操作
+ * 加锁处是函数内的静态变量，进程内所有实例共用一组统计。
+ * lockProfile按等待时间从多到少返回所有加锁过的位置，exportLockProfileText输出Prometheus文本。
+ */
+
+// 一个加锁处的累计统计
+struct LockSiteStats {
+    std::string lock;           // 锁名
+    std::string site;           // 函数名:行号
+    uint64_t acquisitions;
+    uint64_t contended;         // 需要等待的次数
+    uint64_t waitNs;
+    uint64_t holdNs;
+    uint64_t maxWaitNs;
+    uint64_t maxHoldNs;
+
+    LockSiteStats()
+        : acquisitions(0), contended(0), waitNs(0), holdNs(0), maxWaitNs(0), maxHoldNs(0) {}
+};
+
+class LockSite {
+public:
+    // 构造时登记到进程内的加锁处列表（只增不删）
+    LockSite(const char* lock, const char* function, int line);
+
+    void recordWait(uint64_t waitNs);
+    void recordHold(uint64_t holdNs);
+    LockSiteStats stats() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> acquisitions;
+        std::atomic<uint64_t> contended;
+        std::atomic<uint64_t> waitNs;
+        std::atomic<uint64_t> holdNs;
+        std::atomic<uint64_t> maxWaitNs;
+        std::atomic<uint64_t> maxHoldNs;
+    };
+
+    const char* m_lock;
+    const char* m_function;
+    int m_line;
+    Shard m_shards[METRIC_SHARDS];
+
+    LockSite(const LockSite&) = delete;
+    LockSite& operator=(const LockSite&) = delete;
+};
+
+class ProfiledMutex {
+public:
+    explicit ProfiledMutex(const char* name) : m_name(name) {}
+
+    const char* name() const { return m_name; }
+
+    // 不统计的加锁（满足BasicLockable，可用于std::lock_guard）
+    void lock() { m_mutex.lock(); }
+    bool try_lock() { return m_mutex.try_lock(); }
+    void unlock() { m_mutex.unlock(); }
+
+private:
+    std::mutex m_mutex;
+    const char* m_name;
+
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+};
+
+// 作用域锁，析构时记录持有时间
+class ProfiledLock {
+public:
+    ProfiledLock(ProfiledMutex& mutex, LockSite& site) : m_mutex(mutex), m_site(site) {
+        if (!m_mutex.try_lock()) {
+            auto waitStart = std::chrono::steady_clock::now();
+            m_mutex.lock();
+            m_acquired = std::chrono::steady_clock::now();
+            m_site.recordWait(elapsedNs(waitStart, m_acquired));
+        } else {
+            m_acquired = std::chrono::steady_clock::now();
+            m_site.recordWait(0);
+        }
+    }
+
+    ~ProfiledLock() {
+        uint64_t holdNs = elapsedNs(m_acquired, std::chrono::steady_clock::now());
+        m_mutex.unlock();
+        m_site.recordHold(holdNs);
+    }
+
+private:
+    ProfiledMutex& m_mutex;
+    LockSite& m_site;
+    std::chrono::steady_clock::time_point m_acquired;
+
+    static uint64_t elapsedNs(std::chrono::steady_clock::time_point from,
+                              std::chrono::steady_clock::time_point to) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+
+    ProfiledLock(const ProfiledLock&) = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+};
+
+// 在当前作用域加锁并按调用位置统计：PROFILED_LOCK(lock, m_logMutex);
+#define PROFILED_LOCK(guard, mutex) \
+    static LockSite guard##Site((mutex).name(), __func__, __LINE__); \
+    ProfiledLock guard((mutex), guard##Site)
+
+// 所有加锁过的位置，按等待时间从多到少
+std::vector<LockSiteStats> lockProfile();
+
+// Prometheus文本格式（farm_lock_*），接在MetricsRegistry::exportText之后
+std::string exportLockProfileText();
+
+#endif // PROFILED_MUTEX_H
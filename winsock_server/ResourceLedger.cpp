@@ -0,0 +1,546 @@
+#include "ResourceLedger.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+// 基础能量消耗（对应calculate_task_cost的base_costs）
+static const double SOW_COST = 2.0;
+static const double WATER_COST = 1.0;
+static const double WEED_COST = 1.5;
+static const double HARVEST_COST = 3.0;
+static const double MIN_TASK_COST = 0.1;
+static const double TOOL_EFFICIENCY_STEP = 1.1;     // 每升一级效率提升10%
+
+// 初始种子库存
+static const int INITIAL_SEEDS[PLANT_TYPE_COUNT] = { 10, 5, 5, 3 };
+
+static const char* const TOOL_NAMES[TOOL_COUNT] = {
+    "watering_can", "weeder", "harvester", "scanner"
+};
+
+ResourceLedger::ResourceLedger(double initialEnergy, int64_t initialCoins,
+                               double maxEnergy, double regenPerSecond)
+    : m_maxEnergy(0.0), m_regenPerSecond(0.0), m_fullSpanUs(0),
+      m_epoch(std::chrono::steady_clock::now()), m_farmClock(false), m_farmEpoch(0.0),
+      m_energyZeroUs(0), m_coins(0), m_logHead(0) {
+    reset(initialEnergy, initialCoins, maxEnergy, regenPerSecond);
+}
+
+void ResourceLedger::reset(double initialEnergy, int64_t initialCoins, double maxEnergy,
+                           double regenPerSecond, int initialSeeds) {
+    m_maxEnergy = maxEnergy > 0.0 ? maxEnergy : 100.0;
+    m_regenPerSecond = regenPerSecond > 0.0 ? regenPerSecond : 0.02;
+    m_fullSpanUs = static_cast<int64_t>(m_maxEnergy / m_regenPerSecond * MICROS);
+    m_farmClock = farmClockFixed();
+    m_farmEpoch = farmClockNow();
+    double energy = std::max(0.0, std::min(initialEnergy, m_maxEnergy));
+    m_energyZeroUs.store(nowUs() - energyToUs(energy));
+    m_coins.store(initialCoins);
+    for (int i = 0; i < PLANT_TYPE_COUNT; i++) {
+        m_seeds[i].store(initialSeeds > 0 ? initialSeeds : INITIAL_SEEDS[i]);
+    }
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        m_toolLevels[i].store(1);
+    }
+    buildCostTable();
+}
+
+int64_t ResourceLedger::nowUs() const {
+    if (m_farmClock) {
+        return static_cast<int64_t>((farmClockNow() - m_farmEpoch) * MICROS);
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+// 能量换算为恢复所需的微秒数
+int64_t ResourceLedger::energyToUs(double energy) const {
+    return static_cast<int64_t>(std::llround(energy / m_regenPerSecond * MICROS));
+}
+
+void ResourceLedger::buildCostTable() {
+    for (int t = 0; t < TASK_TYPE_COUNT; t++) {
+        TaskType type = static_cast<TaskType>(t);
+        double base = 0.0;
+        switch (type) {
+            case TaskType::PLANTING: base = SOW_COST; break;
+            case TaskType::WATERING: base = WATER_COST; break;
+            case TaskType::WEED_REMOVAL: base = WEED_COST; break;
+            case TaskType::HARVEST: base = HARVEST_COST; break;
+            default: break;     // 其他任务没有定义消耗
+        }
+        bool hasTool = false;
+        taskTool(type, hasTool);
+        for (int level = 0; level <= MAX_TOOL_LEVEL; level++) {
+            double cost = base;
+            if (base > 0.0 && hasTool && level > 1) {
+                cost /= std::pow(TOOL_EFFICIENCY_STEP, level - 1);
+            }
+            if (base > 0.0) {
+                cost = std::max(MIN_TASK_COST, cost);
+            }
+            m_costUs[t][level] = energyToUs(cost);
+        }
+    }
+}
+
+ResourceTool ResourceLedger::taskTool(TaskType type, bool& hasTool) {
+    hasTool = true;
+    switch (type) {
+        case TaskType::WATERING: return ResourceTool::WATERING_CAN;
+        case TaskType::WEED_REMOVAL: return ResourceTool::WEEDER;
+        case TaskType::HARVEST: return ResourceTool::HARVESTER;
+        default:
+            hasTool = false;
+            return ResourceTool::SCANNER;
+    }
+}
+
+double ResourceLedger::energy() const {
+    int64_t elapsed = nowUs() - m_energyZeroUs.load(std::memory_order_acquire);
+    elapsed = std::max<int64_t>(0, std::min(elapsed, m_fullSpanUs));
+    return static_cast<double>(elapsed) / MICROS * m_regenPerSecond;
+}
+
+double ResourceLedger::secondsUntil(double amount) const {
+    int64_t needUs = m_energyZeroUs.load(std::memory_order_acquire) + energyToUs(amount) - nowUs();
+    return needUs > 0 ? static_cast<double>(needUs) / MICROS : 0.0;
+}
+
+// 满能量时t0先截到 now - 恢复满所需时间，溢出的恢复不累积
+bool ResourceLedger::consumeUs(int64_t costUs) {
+    int64_t now = nowUs();
+    int64_t zero = m_energyZeroUs.load(std::memory_order_acquire);
+    for (;;) {
+        int64_t effective = std::max(zero, now - m_fullSpanUs);
+        if (now - effective < costUs) {
+            return false;
+        }
+        if (m_energyZeroUs.compare_exchange_weak(zero, effective + costUs,
+                                                 std::memory_order_acq_rel)) {
+            return true;
+        }
+    }
+}
+
+bool ResourceLedger::consumeEnergy(double amount) {
+    if (amount <= 0.0) {
+        return true;
+    }
+    if (!consumeUs(energyToUs(amount))) {
+        return false;
+    }
+    record(LedgerResource::ENERGY, LedgerChange::CONSUMPTION, 0, -amount);
+    return true;
+}
+
+void ResourceLedger::addEnergy(double amount) {
+    if (amount <= 0.0) {
+        return;
+    }
+    addUs(energyToUs(amount));
+    record(LedgerResource::ENERGY, LedgerChange::ADDITION, 0, amount);
+}
+
+void ResourceLedger::addUs(int64_t gainUs) {
+    int64_t now = nowUs();
+    int64_t zero = m_energyZeroUs.load(std::memory_order_acquire);
+    for (;;) {
+        int64_t effective = std::max(zero, now - m_fullSpanUs);
+        if (m_energyZeroUs.compare_exchange_weak(zero, effective - gainUs,
+                                                 std::memory_order_acq_rel)) {
+            break;
+        }
+    }
+}
+
+void ResourceLedger::addCoins(int64_t amount, LedgerChange change) {
+    if (amount <= 0) {
+        return;
+    }
+    m_coins.fetch_add(amount, std::memory_order_acq_rel);
+    record(LedgerResource::COINS, change, 0, static_cast<double>(amount));
+}
+
+bool ResourceLedger::spendCoins(int64_t amount) {
+    if (amount <= 0) {
+        return true;
+    }
+    int64_t current = m_coins.load(std::memory_order_acquire);
+    do {
+        if (current < amount) {
+            return false;
+        }
+    } while (!m_coins.compare_exchange_weak(current, current - amount,
+                                            std::memory_order_acq_rel));
+    record(LedgerResource::COINS, LedgerChange::CONSUMPTION, 0, -static_cast<double>(amount));
+    return true;
+}
+
+int ResourceLedger::seeds(PlantType type) const {
+    int i = static_cast<int>(type);
+    return (i >= 0 && i < PLANT_TYPE_COUNT) ? m_seeds[i].load(std::memory_order_acquire) : 0;
+}
+
+void ResourceLedger::addSeeds(PlantType type, int amount) {
+    int i = static_cast<int>(type);
+    if (i < 0 || i >= PLANT_TYPE_COUNT || amount <= 0) {
+        return;
+    }
+    m_seeds[i].fetch_add(amount, std::memory_order_acq_rel);
+    record(LedgerResource::SEED, LedgerChange::ADDITION, static_cast<uint8_t>(i), amount);
+}
+
+void ResourceLedger::consumeSeeds(PlantType type, int amount) {
+    int i = static_cast<int>(type);
+    if (i < 0 || i >= PLANT_TYPE_COUNT || amount <= 0) {
+        return;
+    }
+    int32_t current = m_seeds[i].load(std::memory_order_acquire);
+    int32_t taken;
+    do {
+        taken = std::min<int32_t>(current, amount);
+        if (taken <= 0) {
+            return;
+        }
+    } while (!m_seeds[i].compare_exchange_weak(current, current - taken, std::memory_order_acq_rel));
+    record(LedgerResource::SEED, LedgerChange::CONSUMPTION, static_cast<uint8_t>(i), -taken);
+}
+
+void ResourceLedger::captureState(LedgerState& state) const {
+    state.coins = m_coins.load(std::memory_order_acquire);
+    for (int i = 0; i < PLANT_TYPE_COUNT; i++) {
+        state.seeds[i] = m_seeds[i].load(std::memory_order_acquire);
+    }
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        state.toolLevels[i] = m_toolLevels[i].load(std::memory_order_acquire);
+    }
+}
+
+void ResourceLedger::restoreState(const LedgerState& state) {
+    m_coins.store(state.coins, std::memory_order_release);
+    for (int i = 0; i < PLANT_TYPE_COUNT; i++) {
+        m_seeds[i].store(std::max<int32_t>(0, state.seeds[i]), std::memory_order_release);
+    }
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        m_toolLevels[i].store(std::min<int32_t>(std::max<int32_t>(1, state.toolLevels[i]), MAX_TOOL_LEVEL),
+                              std::memory_order_release);
+    }
+}
+
+int ResourceLedger::toolLevel(ResourceTool tool) const {
+    int i = static_cast<int>(tool);
+    return (i >= 0 && i < TOOL_COUNT) ? m_toolLevels[i].load(std::memory_order_acquire) : 1;
+}
+
+LedgerResult ResourceLedger::upgradeTool(ResourceTool tool) {
+    int i = static_cast<int>(tool);
+    if (i < 0 || i >= TOOL_COUNT) {
+        return LedgerResult::MAX_LEVEL;
+    }
+    for (;;) {
+        int level = m_toolLevels[i].load(std::memory_order_acquire);
+        if (level >= MAX_TOOL_LEVEL) {
+            return LedgerResult::MAX_LEVEL;
+        }
+        int64_t cost = upgradeCost(level);
+        if (!spendCoins(cost)) {
+            return LedgerResult::INSUFFICIENT_COINS;
+        }
+        if (m_toolLevels[i].compare_exchange_strong(level, level + 1,
+                                                    std::memory_order_acq_rel)) {
+            record(LedgerResource::TOOL, LedgerChange::UPGRADE, static_cast<uint8_t>(i), 1);
+            return LedgerResult::OK;
+        }
+        // 并发升级抢先一步，退款后按新等级重试
+        addCoins(cost);
+    }
+}
+
+int64_t ResourceLedger::taskCostUs(TaskType type) const {
+    int levels[TOOL_COUNT];
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        levels[i] = m_toolLevels[i].load(std::memory_order_acquire);
+    }
+    return taskCostUs(type, levels);
+}
+
+int64_t ResourceLedger::taskCostUs(TaskType type, const int* toolLevels) const {
+    int t = static_cast<int>(type);
+    if (t < 0 || t >= TASK_TYPE_COUNT) {
+        return 0;
+    }
+    bool hasTool = false;
+    ResourceTool tool = taskTool(type, hasTool);
+    int level = hasTool ? toolLevels[static_cast<int>(tool)] : 1;
+    level = std::max(0, std::min(level, MAX_TOOL_LEVEL));
+    return m_costUs[t][level];
+}
+
+double ResourceLedger::taskCost(TaskType type) const {
+    return static_cast<double>(taskCostUs(type)) / MICROS * m_regenPerSecond;
+}
+
+LedgerResult ResourceLedger::chargeTask(TaskType type, PlantType seed, TaskCharge& charged) {
+    charged = TaskCharge();
+    int seedIndex = static_cast<int>(seed);
+    bool useSeed = type == TaskType::PLANTING;
+    if (useSeed) {
+        if (seedIndex < 0 || seedIndex >= PLANT_TYPE_COUNT) {
+            return LedgerResult::INSUFFICIENT_SEEDS;
+        }
+        int32_t current = m_seeds[seedIndex].load(std::memory_order_acquire);
+        do {
+            if (current <= 0) {
+                return LedgerResult::INSUFFICIENT_SEEDS;
+            }
+        } while (!m_seeds[seedIndex].compare_exchange_weak(current, current - 1,
+                                                           std::memory_order_acq_rel));
+    }
+
+    int64_t costUs = taskCostUs(type);
+    if (costUs > 0 && !consumeUs(costUs)) {
+        if (useSeed) {
+            m_seeds[seedIndex].fetch_add(1, std::memory_order_acq_rel);
+        }
+        return LedgerResult::INSUFFICIENT_ENERGY;
+    }
+
+    if (costUs > 0) {
+        record(LedgerResource::ENERGY, LedgerChange::CONSUMPTION, 0,
+               -static_cast<double>(costUs) / MICROS * m_regenPerSecond);
+    }
+    if (useSeed) {
+        record(LedgerResource::SEED, LedgerChange::CONSUMPTION, static_cast<uint8_t>(seedIndex), -1);
+    }
+    charged.energyUs = costUs;
+    charged.seedIndex = useSeed ? seedIndex : -1;
+    return LedgerResult::OK;
+}
+
+void ResourceLedger::refundTask(const TaskCharge& charged) {
+    if (charged.energyUs > 0) {
+        addUs(charged.energyUs);
+        record(LedgerResource::ENERGY, LedgerChange::ADDITION, 0,
+               static_cast<double>(charged.energyUs) / MICROS * m_regenPerSecond);
+    }
+    if (charged.seedIndex >= 0) {
+        addSeeds(static_cast<PlantType>(charged.seedIndex), 1);
+    }
+}
+
+LedgerResult ResourceLedger::chargeMove(double distance) {
+    return consumeEnergy(moveCost(distance)) ? LedgerResult::OK : LedgerResult::INSUFFICIENT_ENERGY;
+}
+
+// 在能量的微秒域里模拟：每步先按耗时恢复（封顶），再扣移动和任务消耗
+PlanEvaluation ResourceLedger::evaluatePlan(const std::vector<PlannedTask>& plan) const {
+    PlanCursor cursor;
+    beginPlan(cursor);
+    for (const PlannedTask& step : plan) {
+        if (!stepPlan(cursor, step)) {
+            break;
+        }
+    }
+    return finishPlan(cursor);
+}
+
+void ResourceLedger::beginPlan(PlanCursor& cursor) const {
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        cursor.toolLevels[i] = m_toolLevels[i].load(std::memory_order_acquire);
+    }
+
+    PlanEvaluation& result = cursor.result;
+    result.affordable = 0;
+    result.binding = PlanConstraint::NONE;
+    result.waitSeconds = 0.0;
+    result.elapsedSeconds = 0.0;
+    result.energyUsed = 0.0;
+    result.finalEnergy = 0.0;
+    result.coinsEarned = 0;
+    result.finalCoins = 0;
+    for (int i = 0; i < PLANT_TYPE_COUNT; i++) {
+        result.finalSeeds[i] = m_seeds[i].load(std::memory_order_acquire);
+    }
+
+    int64_t available = nowUs() - m_energyZeroUs.load(std::memory_order_acquire);
+    cursor.availableUs = std::max<int64_t>(0, std::min(available, m_fullSpanUs));
+    cursor.usedUs = 0;
+    cursor.elapsedUs = 0;
+    cursor.coins = m_coins.load(std::memory_order_acquire);
+    cursor.stopped = false;
+}
+
+bool ResourceLedger::stepPlan(PlanCursor& cursor, const PlannedTask& step) const {
+    if (cursor.stopped) {
+        return false;
+    }
+    PlanEvaluation& result = cursor.result;
+    double moveUsPerMeter = MOVE_COST_PER_METER / m_regenPerSecond * MICROS;
+
+    int64_t stepUs = static_cast<int64_t>(std::max(0.0, step.seconds) * MICROS);
+    int64_t energyAfterWait = std::min(m_fullSpanUs, cursor.availableUs + stepUs);
+
+    int64_t costUs = static_cast<int64_t>(std::max(0.0, step.distance) * moveUsPerMeter);
+    int seedIndex = -1;
+    if (step.hasAction) {
+        costUs += taskCostUs(step.type, cursor.toolLevels);
+        if (step.type == TaskType::PLANTING) {
+            seedIndex = static_cast<int>(step.seed);
+        }
+    }
+
+    if (energyAfterWait < costUs) {
+        result.binding = PlanConstraint::ENERGY;
+        // 从开始等待算起，恢复到足够需要的时间（超过上限的消耗永远无法满足）
+        result.waitSeconds = costUs > m_fullSpanUs
+            ? -1.0 : static_cast<double>(costUs - cursor.availableUs - stepUs) / MICROS;
+        cursor.stopped = true;
+        return false;
+    }
+    if (seedIndex >= 0 && (seedIndex >= PLANT_TYPE_COUNT || result.finalSeeds[seedIndex] <= 0)) {
+        result.binding = PlanConstraint::SEEDS;
+        cursor.stopped = true;
+        return false;
+    }
+    if (cursor.coins + step.coins < 0) {
+        result.binding = PlanConstraint::COINS;
+        cursor.stopped = true;
+        return false;
+    }
+
+    cursor.availableUs = energyAfterWait - costUs;
+    cursor.usedUs += costUs;
+    cursor.elapsedUs += stepUs;
+    cursor.coins += step.coins;
+    if (step.coins > 0) {
+        result.coinsEarned += step.coins;
+    }
+    if (seedIndex >= 0) {
+        result.finalSeeds[seedIndex]--;
+    }
+    result.affordable++;
+    return true;
+}
+
+PlanEvaluation ResourceLedger::finishPlan(const PlanCursor& cursor) const {
+    PlanEvaluation result = cursor.result;
+    result.elapsedSeconds = static_cast<double>(cursor.elapsedUs) / MICROS;
+    result.energyUsed = static_cast<double>(cursor.usedUs) / MICROS * m_regenPerSecond;
+    result.finalEnergy = static_cast<double>(cursor.availableUs) / MICROS * m_regenPerSecond;
+    result.finalCoins = cursor.coins;
+    return result;
+}
+
+void ResourceLedger::record(LedgerResource resource, LedgerChange change, uint8_t detail,
+                            double amount) {
+    uint64_t index = m_logHead.fetch_add(1, std::memory_order_acq_rel);
+    LogSlot& slot = m_log[index % LOG_CAPACITY];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timestampUs.store(static_cast<int64_t>(farmClockNow() * MICROS), std::memory_order_relaxed);
+    slot.kind.store(static_cast<uint32_t>(resource) | static_cast<uint32_t>(change) << 8 |
+                    static_cast<uint32_t>(detail) << 16, std::memory_order_relaxed);
+    slot.amountMicro.store(static_cast<int64_t>(std::llround(amount * MICROS)),
+                           std::memory_order_relaxed);
+    slot.seq.store(index + 1, std::memory_order_release);
+}
+
+size_t ResourceLedger::recentChanges(size_t count, std::vector<LedgerEntry>& entries) const {
+    entries.clear();
+    uint64_t head = m_logHead.load(std::memory_order_acquire);
+    uint64_t window = std::min<uint64_t>(count, LOG_CAPACITY);
+    uint64_t begin = head > window ? head - window : 0;
+    for (uint64_t index = begin; index < head; index++) {
+        const LogSlot& slot = m_log[index % LOG_CAPACITY];
+        if (slot.seq.load(std::memory_order_acquire) != index + 1) {
+            continue;   // 正在写入或已被覆盖
+        }
+        int64_t timestampUs = slot.timestampUs.load(std::memory_order_relaxed);
+        uint32_t kind = slot.kind.load(std::memory_order_relaxed);
+        int64_t amountMicro = slot.amountMicro.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != index + 1) {
+            continue;
+        }
+
+        LedgerEntry entry;
+        entry.seq = index;
+        entry.timestamp = static_cast<double>(timestampUs) / MICROS;
+        entry.resource = static_cast<LedgerResource>(kind & 0xFF);
+        entry.change = static_cast<LedgerChange>((kind >> 8) & 0xFF);
+        entry.detail = static_cast<uint8_t>((kind >> 16) & 0xFF);
+        entry.amount = static_cast<double>(amountMicro) / MICROS;
+        entries.push_back(entry);
+    }
+    return entries.size();
+}
+
+// 状态JSON中的资源字段（不含外层花括号）
+std::string ResourceLedger::buildJsonFields() const {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3)
+        << "\"energy\":" << energy()
+        << ",\"max_energy\":" << m_maxEnergy
+        << ",\"energy_regen_rate\":" << m_regenPerSecond
+        << ",\"coins\":" << coins()
+        << ",\"seeds\":{";
+    for (int i = 0; i < PLANT_TYPE_COUNT; i++) {
+        if (i > 0) oss << ",";
+        oss << "\"" << plantTypeToString(static_cast<PlantType>(i)) << "\":"
+            << m_seeds[i].load(std::memory_order_acquire);
+    }
+    oss << "},\"tools\":{";
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        if (i > 0) oss << ",";
+        oss << "\"" << TOOL_NAMES[i] << "\":" << m_toolLevels[i].load(std::memory_order_acquire);
+    }
+    oss << "}";
+    return oss.str();
+}
+
+const char* resourceToolToString(ResourceTool tool) {
+    int i = static_cast<int>(tool);
+    return (i >= 0 && i < TOOL_COUNT) ? TOOL_NAMES[i] : "unknown";
+}
+
+bool stringToResourceTool(const std::string& name, ResourceTool& tool) {
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        if (name == TOOL_NAMES[i]) {
+            tool = static_cast<ResourceTool>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* ledgerResourceToString(LedgerResource resource) {
+    switch (resource) {
+        case LedgerResource::ENERGY: return "energy";
+        case LedgerResource::COINS: return "coins";
+        case LedgerResource::SEED: return "seed";
+        case LedgerResource::TOOL: return "tool";
+        default: return "unknown";
+    }
+}
+
+const char* ledgerChangeToString(LedgerChange change) {
+    switch (change) {
+        case LedgerChange::CONSUMPTION: return "consumption";
+        case LedgerChange::ADDITION: return "addition";
+        case LedgerChange::HARVEST: return "harvest";
+        case LedgerChange::UPGRADE: return "upgrade";
+        default: return "unknown";
+    }
+}
+
+const char* planConstraintToString(PlanConstraint constraint) {
+    switch (constraint) {
+        case PlanConstraint::NONE: return "none";
+        case PlanConstraint::ENERGY: return "energy";
+        case PlanConstraint::SEEDS: return "seeds";
+        case PlanConstraint::COINS: return "coins";
+        default: return "unknown";
+    }
+}
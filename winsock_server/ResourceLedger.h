@@ -0,0 +1,249 @@
+#ifndef RESOURCE_LEDGER_H
+#define RESOURCE_LEDGER_H
+
+#include "protocol.h"
+#include "FarmField.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * 资源账本 - resource_manager.py中ResourceManager的C++实现
+ *
+ * 所有余额都是原子变量，扣费用CAS循环完成，不需要锁：
+ *   - 能量用定点数存成"能量为0的时刻"t0（微秒），当前能量 = min(上限, (now - t0) * 恢复速率)，
+ *     恢复在读取时按公式计算，没有定期update()；扣除a即t0后移a/速率
+ *   - 金币、种子、工具等级各自是一个原子整数
+ *   - 任务能量消耗在构造时预先算成 [任务类型][工具等级] 的表，查询不分配内存
+ *   - 变化记录写入定长环形缓冲，每个槽位带序号，读者按序号校验，写入不分配内存
+ *   - evaluatePlan一次遍历整个任务计划，给出可负担的最长前缀和卡住它的约束；
+ *     也可以用beginPlan/stepPlan逐步评估，不需要整个计划在内存中
+ */
+
+// 工具（与resource_manager.py的tools一致）
+enum class ResourceTool {
+    WATERING_CAN,
+    WEEDER,
+    HARVESTER,
+    SCANNER,
+    COUNT
+};
+
+constexpr int TOOL_COUNT = static_cast<int>(ResourceTool::COUNT);
+constexpr int MAX_TOOL_LEVEL = 5;
+
+// 记录中的资源种类
+enum class LedgerResource : uint8_t {
+    ENERGY,
+    COINS,
+    SEED,
+    TOOL
+};
+
+// 记录中的变化类型
+enum class LedgerChange : uint8_t {
+    CONSUMPTION,
+    ADDITION,
+    HARVEST,
+    UPGRADE
+};
+
+// 扣费结果
+enum class LedgerResult {
+    OK,
+    INSUFFICIENT_ENERGY,
+    INSUFFICIENT_COINS,
+    INSUFFICIENT_SEEDS,
+    MAX_LEVEL
+};
+
+// 计划中的一步（对应simulate_resource_usage的一个任务）
+struct PlannedTask {
+    bool hasAction;         // false表示只移动
+    TaskType type;
+    PlantType seed;         // 播种使用的种子
+    double distance;        // 执行前的移动距离（米）
+    double seconds;         // 距上一步的预计耗时，期间能量持续恢复
+    int64_t coins;          // 完成后的金币变化（收获为正）
+
+    PlannedTask()
+        : hasAction(true), type(TaskType::HARVEST), seed(PlantType::WHEAT),
+          distance(0.0), seconds(0.0), coins(0) {}
+};
+
+// 计划中断的原因
+enum class PlanConstraint {
+    NONE,
+    ENERGY,
+    SEEDS,
+    COINS
+};
+
+// 计划评估结果
+struct PlanEvaluation {
+    size_t affordable;          // 可负担的最长前缀长度
+    PlanConstraint binding;     // 第affordable步不可负担的原因
+    double waitSeconds;         // 能量约束时该步还需额外等待的秒数，-1表示超过能量上限
+    double elapsedSeconds;      // 前缀的预计耗时
+    double energyUsed;
+    double finalEnergy;
+    int64_t coinsEarned;
+    int64_t finalCoins;
+    int finalSeeds[PLANT_TYPE_COUNT];
+};
+
+// 逐步评估计划的中间状态（beginPlan / stepPlan / finishPlan），计划可以边接收边评估
+struct PlanCursor {
+    PlanEvaluation result;
+    bool stopped;               // 已遇到不可负担的一步，后续步骤只计数不评估
+    int toolLevels[TOOL_COUNT];
+    int64_t availableUs;
+    int64_t usedUs;
+    int64_t elapsedUs;
+    int64_t coins;
+};
+
+// 可持久化的余额（写入快照）；能量按时间恢复，不保存
+struct LedgerState {
+    int64_t coins;
+    int32_t seeds[PLANT_TYPE_COUNT];
+    int32_t toolLevels[TOOL_COUNT];
+};
+
+// chargeTask实际扣除的资源；refundTask按它原样退回，扣费后工具升级也不影响退款
+struct TaskCharge {
+    int64_t energyUs;       // 扣除的能量（微秒域）
+    int seedIndex;          // 扣了一颗种子时为PlantType，否则为-1
+
+    TaskCharge() : energyUs(0), seedIndex(-1) {}
+};
+
+// 一条变化记录
+struct LedgerEntry {
+    uint64_t seq;
+    double timestamp;
+    LedgerResource resource;
+    LedgerChange change;
+    uint8_t detail;         // 种子为PlantType，工具为ResourceTool
+    double amount;
+};
+
+class ResourceLedger {
+public:
+    static constexpr int LOG_CAPACITY = 1024;
+
+    ResourceLedger(double initialEnergy = 100.0, int64_t initialCoins = 100,
+                   double maxEnergy = 100.0, double regenPerSecond = 0.02);
+
+    // 按新的参数重置为初始余额（工具等级回到1）；initialSeeds为每种种子的数量，0取默认库存。
+    // 只能在没有其他线程使用账本时调用（服务器启动时）。
+    // 重置时农田时钟被固定（回放）的话，能量恢复改按农田时钟计时
+    void reset(double initialEnergy, int64_t initialCoins, double maxEnergy, double regenPerSecond,
+               int initialSeeds = 0);
+
+    // 能量（读取时计算恢复）
+    double energy() const;
+    double maxEnergy() const { return m_maxEnergy; }
+    double regenRate() const { return m_regenPerSecond; }
+    bool consumeEnergy(double amount);
+    void addEnergy(double amount);
+    // 恢复到amount还需要的秒数，已足够返回0
+    double secondsUntil(double amount) const;
+
+    // 金币
+    int64_t coins() const { return m_coins.load(std::memory_order_acquire); }
+    void addCoins(int64_t amount, LedgerChange change = LedgerChange::ADDITION);
+    bool spendCoins(int64_t amount);
+
+    // 种子
+    int seeds(PlantType type) const;
+    void addSeeds(PlantType type, int amount);
+    // 直接扣除种子（不扣能量，用于日志回放），不足时扣到0为止
+    void consumeSeeds(PlantType type, int amount);
+
+    // 金币、种子、工具等级的整体读取与恢复
+    void captureState(LedgerState& state) const;
+    void restoreState(const LedgerState& state);
+
+    // 工具
+    int toolLevel(ResourceTool tool) const;
+    LedgerResult upgradeTool(ResourceTool tool);
+    static int64_t upgradeCost(int level) { return 50 * static_cast<int64_t>(level) * level; }
+
+    // 任务能量消耗（移动按距离计），查表
+    double taskCost(TaskType type) const;
+    double moveCost(double distance) const { return MOVE_COST_PER_METER * distance; }
+
+    // 扣除执行任务的能量（播种还扣一颗种子），资源不足时不扣；charged记下实际扣除的量
+    LedgerResult chargeTask(TaskType type, PlantType seed, TaskCharge& charged);
+    // 任务未能执行时退回charged记下的资源
+    void refundTask(const TaskCharge& charged);
+    LedgerResult chargeMove(double distance);
+
+    // 按顺序一次性评估整个计划（能量、种子、金币），不修改余额；
+    // 能量按计划时间线恢复，工具等级取评估开始时的值
+    PlanEvaluation evaluatePlan(const std::vector<PlannedTask>& plan) const;
+    // 同样的评估拆成逐步进行，余额和工具等级在beginPlan时取快照；
+    // stepPlan返回false表示该步不可负担，之后的步骤不再计入
+    void beginPlan(PlanCursor& cursor) const;
+    bool stepPlan(PlanCursor& cursor, const PlannedTask& step) const;
+    PlanEvaluation finishPlan(const PlanCursor& cursor) const;
+
+    // 最近的count条记录（从旧到新）
+    size_t recentChanges(size_t count, std::vector<LedgerEntry>& entries) const;
+    uint64_t changeCount() const { return m_logHead.load(std::memory_order_acquire); }
+
+    std::string buildJsonFields() const;
+
+private:
+    static constexpr double MOVE_COST_PER_METER = 0.5;
+    static constexpr int64_t MICROS = 1000000;
+
+    struct LogSlot {
+        std::atomic<uint64_t> seq;          // 写完后存入记录序号+1，写入中为0
+        std::atomic<int64_t> timestampUs;
+        std::atomic<uint32_t> kind;         // resource | change << 8 | detail << 16
+        std::atomic<int64_t> amountMicro;
+
+        LogSlot() : seq(0), timestampUs(0), kind(0), amountMicro(0) {}
+    };
+
+    double m_maxEnergy;
+    double m_regenPerSecond;
+    int64_t m_fullSpanUs;                   // 从0恢复到满的微秒数
+    std::chrono::steady_clock::time_point m_epoch;
+    bool m_farmClock;                       // 按农田时钟而不是steady_clock计时
+    double m_farmEpoch;
+
+    std::atomic<int64_t> m_energyZeroUs;    // 能量为0的时刻t0
+    std::atomic<int64_t> m_coins;
+    std::atomic<int32_t> m_seeds[PLANT_TYPE_COUNT];
+    std::atomic<int32_t> m_toolLevels[TOOL_COUNT];
+
+    // [任务类型][工具等级] 的能量消耗（微秒恢复时间）
+    int64_t m_costUs[TASK_TYPE_COUNT][MAX_TOOL_LEVEL + 1];
+
+    std::atomic<uint64_t> m_logHead;
+    LogSlot m_log[LOG_CAPACITY];
+
+    int64_t nowUs() const;
+    int64_t energyToUs(double energy) const;
+    bool consumeUs(int64_t costUs);
+    void addUs(int64_t gainUs);
+    int64_t taskCostUs(TaskType type) const;
+    int64_t taskCostUs(TaskType type, const int* toolLevels) const;
+    void buildCostTable();
+    void record(LedgerResource resource, LedgerChange change, uint8_t detail, double amount);
+
+    static ResourceTool taskTool(TaskType type, bool& hasTool);
+};
+
+const char* resourceToolToString(ResourceTool tool);
+bool stringToResourceTool(const std::string& name, ResourceTool& tool);
+const char* ledgerResourceToString(LedgerResource resource);
+const char* ledgerChangeToString(LedgerChange change);
+const char* planConstraintToString(PlanConstraint constraint);
+
+#endif // RESOURCE_LEDGER_H
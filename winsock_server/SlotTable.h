@@ -0,0 +1,105 @@
+#ifndef SLOT_TABLE_H
+#define SLOT_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * 槽位表
+ *
+ * 按下标存放记录，下标从0起连续分配。记录按块（CHUNK_SLOTS个）分配，分配后直到表销毁
+ * 才释放，地址不变，所以get不加锁：取块指针（acquire）再取下标。
+ * 释放的下标放进空闲链表（无锁栈，头部带版本号防ABA），acquire优先复用最近释放的，
+ * 链表为空时才在表尾新增（加锁，只在扩容时）。
+ * 记录本身的并发访问由调用方负责；表只保证同一下标同一时刻最多分给一个使用者。
+ */
+template <typename T>
+class SlotTable {
+public:
+    static const uint32_t CHUNK_SLOTS = 64;
+    static const uint32_t MAX_SLOTS = 65536;
+
+    SlotTable() : m_freeHead(0), m_size(0) {
+        for (auto& chunk : m_chunks) {
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SlotTable() {
+        for (auto& chunk : m_chunks) {
+            delete chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    // 分配一个下标，表满时返回-1
+    int acquire() {
+        uint64_t head = m_freeHead.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head) != 0) {
+            uint32_t index = static_cast<uint32_t>(head) - 1;
+            uint32_t next = chunkOf(index)->next[index % CHUNK_SLOTS].load(std::memory_order_relaxed);
+            uint64_t replacement = (((head >> 32) + 1) << 32) | next;
+            if (m_freeHead.compare_exchange_weak(head, replacement, std::memory_order_acquire,
+                                                 std::memory_order_acquire)) {
+                return static_cast<int>(index);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_growMutex);
+        uint32_t index = m_size.load(std::memory_order_relaxed);
+        if (index >= MAX_SLOTS) {
+            return -1;
+        }
+        std::atomic<Chunk*>& chunk = m_chunks[index / CHUNK_SLOTS];
+        if (!chunk.load(std::memory_order_relaxed)) {
+            chunk.store(new Chunk(), std::memory_order_release);
+        }
+        m_size.store(index + 1, std::memory_order_release);
+        return static_cast<int>(index);
+    }
+
+    // 归还下标，之后可能立即被其他线程的acquire取走
+    void release(int index) {
+        uint32_t slot = static_cast<uint32_t>(index);
+        std::atomic<uint32_t>& next = chunkOf(slot)->next[slot % CHUNK_SLOTS];
+        uint64_t head = m_freeHead.load(std::memory_order_relaxed);
+        uint64_t replacement;
+        do {
+            next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            replacement = (((head >> 32) + 1) << 32) | (slot + 1);
+        } while (!m_freeHead.compare_exchange_weak(head, replacement, std::memory_order_release,
+                                                   std::memory_order_relaxed));
+    }
+
+    // 不加锁；下标所在的块还没分配时返回nullptr
+    T* get(uint32_t index) const {
+        if (index >= MAX_SLOTS) {
+            return nullptr;
+        }
+        Chunk* chunk = m_chunks[index / CHUNK_SLOTS].load(std::memory_order_acquire);
+        return chunk ? &chunk->items[index % CHUNK_SLOTS] : nullptr;
+    }
+
+    // 分配过的最大下标+1，遍历时用；其中可能有空闲的
+    uint32_t size() const { return m_size.load(std::memory_order_acquire); }
+
+private:
+    struct Chunk {
+        T items[CHUNK_SLOTS];
+        std::atomic<uint32_t> next[CHUNK_SLOTS];   // 空闲链表中下一个的下标+1，0为结尾
+    };
+
+    std::atomic<Chunk*> m_chunks[MAX_SLOTS / CHUNK_SLOTS];
+    std::atomic<uint64_t> m_freeHead;   // 高32位版本号，低32位栈顶下标+1
+    std::atomic<uint32_t> m_size;
+    std::mutex m_growMutex;
+
+    Chunk* chunkOf(uint32_t index) const {
+        return m_chunks[index / CHUNK_SLOTS].load(std::memory_order_acquire);
+    }
+
+    SlotTable(const SlotTable&) = delete;
+    SlotTable& operator=(const SlotTable&) = delete;
+};
+
+#endif // SLOT_TABLE_H
@@ -0,0 +1,141 @@
+#include "SpanTracer.h"
+#include "json_util.h"
+#include "protocol.h"
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+std::atomic<uint64_t> g_nextTracerId(1);
+
+// 线程持有的缓冲；线程结束时把缓冲标记为空闲
+struct RingHolder {
+    uint64_t tracerId;
+    std::shared_ptr<SpanTracer::ThreadRing> ring;
+
+    RingHolder() : tracerId(0) {}
+    ~RingHolder() {
+        if (ring) {
+            ring->inUse.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local RingHolder t_ring;
+thread_local uint32_t t_sampleCounter = 0;
+
+}  // namespace
+
+SpanTracer::ThreadRing::ThreadRing(int id, size_t capacity)
+    : index(id), inUse(true), written(0), slots(capacity) {
+}
+
+SpanTracer::SpanTracer()
+    : m_id(g_nextTracerId.fetch_add(1)), m_epoch(std::chrono::steady_clock::now()),
+      m_sampleEvery(0), m_ringCapacity(1024), m_nextTraceId(1), m_spans(0) {
+}
+
+void SpanTracer::configure(uint32_t sampleEvery, size_t ringCapacity) {
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    m_ringCapacity = ringCapacity > 0 ? ringCapacity : 1024;
+    m_sampleEvery.store(sampleEvery, std::memory_order_relaxed);
+}
+
+uint64_t SpanTracer::sample() {
+    uint32_t every = m_sampleEvery.load(std::memory_order_relaxed);
+    if (every == 0 || ++t_sampleCounter < every) {
+        return 0;
+    }
+    t_sampleCounter = 0;
+    return m_nextTraceId.fetch_add(1, std::memory_order_relaxed);
+}
+
+SpanTracer::ThreadRing* SpanTracer::threadRing() {
+    if (t_ring.tracerId == m_id) {
+        return t_ring.ring.get();
+    }
+    if (t_ring.ring) {
+        t_ring.ring->inUse.store(false, std::memory_order_release);
+    }
+
+    // 优先复用已退出线程的缓冲
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    std::shared_ptr<ThreadRing> ring;
+    for (const auto& candidate : m_rings) {
+        bool idle = false;
+        if (candidate->inUse.compare_exchange_strong(idle, true, std::memory_order_acquire)) {
+            ring = candidate;
+            break;
+        }
+    }
+    if (!ring) {
+        ring = std::make_shared<ThreadRing>(static_cast<int>(m_rings.size()), m_ringCapacity);
+        m_rings.push_back(ring);
+    }
+    t_ring.tracerId = m_id;
+    t_ring.ring = ring;
+    return ring.get();
+}
+
+void SpanTracer::record(const char* name, const TraceContext& context, uint64_t startNs, uint64_t endNs) {
+    ThreadRing* ring = threadRing();
+    uint64_t seq = ring->written++;
+    Slot& slot = ring->slots[seq % ring->slots.size()];
+
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startNs.store(startNs, std::memory_order_relaxed);
+    slot.durationNs.store(endNs > startNs ? endNs - startNs : 0, std::memory_order_relaxed);
+    slot.traceId.store(context.traceId, std::memory_order_relaxed);
+    slot.clientId.store(context.clientId, std::memory_order_relaxed);
+    slot.requestId.store(context.requestId, std::memory_order_relaxed);
+    slot.command.store(context.command, std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_release);
+    m_spans.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string SpanTracer::dumpChromeTrace() const {
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        rings = m_rings;
+    }
+
+    std::ostringstream oss;
+    oss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char buffer[96];
+    for (const auto& ring : rings) {
+        // 线程名（缓冲可能先后属于多个线程）
+        oss << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << ring->index << ",\"args\":{\"name\":\"thread-slot-" << ring->index << "\"}}";
+        first = false;
+
+        for (const Slot& slot : ring->slots) {
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq == 0) {
+                continue;
+            }
+            const char* name = slot.name.load(std::memory_order_relaxed);
+            uint64_t startNs = slot.startNs.load(std::memory_order_relaxed);
+            uint64_t durationNs = slot.durationNs.load(std::memory_order_relaxed);
+            uint64_t traceId = slot.traceId.load(std::memory_order_relaxed);
+            int32_t clientId = slot.clientId.load(std::memory_order_relaxed);
+            uint32_t requestId = slot.requestId.load(std::memory_order_relaxed);
+            uint32_t command = slot.command.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq) {
+                continue;   // 读取期间被覆盖
+            }
+
+            snprintf(buffer, sizeof(buffer), "\"ts\":%.3f,\"dur\":%.3f", startNs / 1000.0, durationNs / 1000.0);
+            oss << ",{\"name\":\"" << name << "\",\"cat\":\"" << jsonEscape(commandToString(command))
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->index << "," << buffer
+                << ",\"args\":{\"trace\":" << traceId << ",\"client\":" << clientId
+                << ",\"request\":" << requestId << "}}";
+        }
+    }
+    oss << "]}";
+    return oss.str();
+}
@@ -0,0 +1,100 @@
+#ifndef SPAN_TRACER_H
+#define SPAN_TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * 请求生命周期追踪
+ *
+ * 读线程每读到一个包按采样率决定是否追踪（每个线程每sampleEvery个包追踪一个），
+ * 被追踪的包在各个阶段（读取、排队、处理、等锁、落盘、发送）记录一个带起止时间的span。
+ * 未采样的包只多一次线程局部计数，不读时钟。
+ *
+ * span写入当前线程的环形缓冲（单写者，不加锁），写满后覆盖最旧的；每个槽位带序号，
+ * 导出时按序号校验，跳过正在写的槽位。线程结束后它的缓冲交给之后的新线程复用，
+ * 内存上限为"同时记录过span的线程数 x 容量"。
+ * dumpChromeTrace输出Chrome trace-event JSON（chrome://tracing或Perfetto打开），
+ * 每个span是一个"X"事件，args带客户端ID、请求ID和追踪ID，同一请求的各阶段可以按trace过滤。
+ */
+
+// 被追踪的请求
+struct TraceContext {
+    uint64_t traceId;       // 0表示未采样
+    int clientId;
+    uint32_t requestId;
+    uint32_t command;
+    uint64_t startNs;       // 开始读取该包的时刻
+
+    TraceContext() : traceId(0), clientId(-1), requestId(0), command(0), startNs(0) {}
+};
+
+class SpanTracer {
+public:
+    SpanTracer();
+
+    // sampleEvery为0时关闭；ringCapacity为每个线程缓冲的span数
+    void configure(uint32_t sampleEvery, size_t ringCapacity);
+    bool enabled() const { return m_sampleEvery.load(std::memory_order_relaxed) != 0; }
+
+    // 决定当前线程读到的这个包是否追踪，追踪时返回新的追踪ID，否则返回0
+    uint64_t sample();
+
+    // 相对追踪器创建时刻的纳秒
+    uint64_t nowNs() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_epoch).count());
+    }
+
+    // name须是静态字符串
+    void record(const char* name, const TraceContext& context, uint64_t startNs, uint64_t endNs);
+
+    std::string dumpChromeTrace() const;
+    uint64_t spanCount() const { return m_spans.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;          // 写完后为写入序号+1，写入中为0
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> startNs;
+        std::atomic<uint64_t> durationNs;
+        std::atomic<uint64_t> traceId;
+        std::atomic<int32_t> clientId;
+        std::atomic<uint32_t> requestId;
+        std::atomic<uint32_t> command;
+    };
+
+public:
+    // 一个线程的环形缓冲（线程退出时inUse清零，交给新线程复用）
+    struct ThreadRing {
+        int index;
+        std::atomic<bool> inUse;
+        uint64_t written;                   // 只由所属线程修改
+        std::vector<Slot> slots;
+
+        explicit ThreadRing(int id, size_t capacity);
+    };
+
+private:
+    const uint64_t m_id;                    // 区分追踪器实例，线程局部缓存按它查找
+    std::chrono::steady_clock::time_point m_epoch;
+    std::atomic<uint32_t> m_sampleEvery;
+    size_t m_ringCapacity;
+    std::atomic<uint64_t> m_nextTraceId;
+    std::atomic<uint64_t> m_spans;
+    std::vector<std::shared_ptr<ThreadRing>> m_rings;
+    mutable std::mutex m_ringsMutex;        // 只在线程第一次记录和导出时加锁
+
+    ThreadRing* threadRing();
+
+    SpanTracer(const SpanTracer&) = delete;
+    SpanTracer& operator=(const SpanTracer&) = delete;
+};
+
+#endif // SPAN_TRACER_H
@@ -0,0 +1,115 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+
+SpatialIndex::SpatialIndex()
+    : m_rows(0), m_cols(0), m_bucketRows(0), m_bucketCols(0), m_size(0) {
+}
+
+void SpatialIndex::reset(int rows, int cols) {
+    m_rows = rows > 0 ? rows : 0;
+    m_cols = cols > 0 ? cols : 0;
+    m_bucketRows = (m_rows + BUCKET - 1) / BUCKET;
+    m_bucketCols = (m_cols + BUCKET - 1) / BUCKET;
+    m_buckets.assign(static_cast<size_t>(m_bucketRows) * m_bucketCols, std::vector<int32_t>());
+    m_slot.assign(static_cast<size_t>(m_rows) * m_cols, -1);
+    m_size = 0;
+}
+
+void SpatialIndex::insert(int cell) {
+    if (cell < 0 || cell >= static_cast<int>(m_slot.size()) || m_slot[cell] >= 0) {
+        return;
+    }
+    std::vector<int32_t>& bucket = m_buckets[bucketOf(cell)];
+    m_slot[cell] = static_cast<int32_t>(bucket.size());
+    bucket.push_back(cell);
+    m_size++;
+}
+
+void SpatialIndex::remove(int cell) {
+    if (cell < 0 || cell >= static_cast<int>(m_slot.size()) || m_slot[cell] < 0) {
+        return;
+    }
+    std::vector<int32_t>& bucket = m_buckets[bucketOf(cell)];
+    int32_t pos = m_slot[cell];
+    int32_t last = bucket.back();
+    bucket[pos] = last;
+    m_slot[last] = pos;
+    bucket.pop_back();
+    m_slot[cell] = -1;
+    m_size--;
+}
+
+bool SpatialIndex::contains(int cell) const {
+    return cell >= 0 && cell < static_cast<int>(m_slot.size()) && m_slot[cell] >= 0;
+}
+
+size_t SpatialIndex::nearest(int row, int col, size_t k, std::vector<int>& cells,
+                             const Filter& filter) const {
+    cells.clear();
+    if (k == 0 || m_size == 0) {
+        return 0;
+    }
+    row = std::max(0, std::min(row, m_rows - 1));
+    col = std::max(0, std::min(col, m_cols - 1));
+
+    // 最大堆保存当前最近的k个 (距离平方, 格子)
+    typedef std::pair<int, int> Candidate;
+    std::vector<Candidate> best;
+    best.reserve(k + 1);
+
+    int br = row / BUCKET;
+    int bc = col / BUCKET;
+    int maxRing = std::max(std::max(br, m_bucketRows - 1 - br),
+                           std::max(bc, m_bucketCols - 1 - bc));
+
+    for (int ring = 0; ring <= maxRing; ring++) {
+        // 第ring环（ring>=1）中任一格子与查询点的距离至少为 (ring-1)*BUCKET+1
+        if (ring > 0 && best.size() == k) {
+            int bound = (ring - 1) * BUCKET + 1;
+            if (best.front().first <= bound * bound) {
+                break;
+            }
+        }
+
+        for (int r = br - ring; r <= br + ring; r++) {
+            if (r < 0 || r >= m_bucketRows) {
+                continue;
+            }
+            // 环的上下两行全扫，中间各行只取左右两端
+            int step = (r == br - ring || r == br + ring) ? 1 : std::max(1, 2 * ring);
+            for (int c = bc - ring; c <= bc + ring; c += step) {
+                if (c < 0 || c >= m_bucketCols) {
+                    continue;
+                }
+                for (int32_t cell : m_buckets[r * m_bucketCols + c]) {
+                    int dr = cell / m_cols - row;
+                    int dc = cell % m_cols - col;
+                    int d2 = dr * dr + dc * dc;
+                    if (best.size() == k && d2 >= best.front().first) {
+                        continue;
+                    }
+                    if (filter && !filter(cell)) {
+                        continue;
+                    }
+                    best.push_back(Candidate(d2, cell));
+                    std::push_heap(best.begin(), best.end());
+                    if (best.size() > k) {
+                        std::pop_heap(best.begin(), best.end());
+                        best.pop_back();
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end());
+    for (const Candidate& candidate : best) {
+        cells.push_back(candidate.second);
+    }
+    return cells.size();
+}
+
+int SpatialIndex::nearest(int row, int col, const Filter& filter) const {
+    std::vector<int> cells;
+    return nearest(row, col, 1, cells, filter) > 0 ? cells[0] : -1;
+}
@@ -0,0 +1,56 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+/**
+ * 网格桶空间索引
+ *
+ * 把 rows x cols 的格子按 BUCKET x BUCKET 分桶，每个桶保存其中的格子索引。
+ *   - 插入、删除 O(1)（桶内与末尾交换）
+ *   - 最近邻从查询点所在的桶开始按切比雪夫环向外扩展，
+ *     当前第k近的距离不大于下一环的距离下界时停止，
+ *     目标分布较密时只需要检查常数个桶
+ */
+
+class SpatialIndex {
+public:
+    // 返回false的格子被跳过（例如已被其他小车认领）
+    using Filter = std::function<bool(int cell)>;
+
+    SpatialIndex();
+
+    // 按网格尺寸重置（清空）
+    void reset(int rows, int cols);
+
+    void insert(int cell);
+    void remove(int cell);
+    bool contains(int cell) const;
+    size_t size() const { return m_size; }
+
+    // 距(row, col)最近的k个格子，按距离升序写入cells，返回个数
+    size_t nearest(int row, int col, size_t k, std::vector<int>& cells,
+                   const Filter& filter = Filter()) const;
+
+    // 最近的一个，没有返回-1
+    int nearest(int row, int col, const Filter& filter = Filter()) const;
+
+private:
+    static const int BUCKET = 4;
+
+    int m_rows;
+    int m_cols;
+    int m_bucketRows;
+    int m_bucketCols;
+    size_t m_size;
+    std::vector<std::vector<int32_t>> m_buckets;
+    std::vector<int32_t> m_slot;        // 格子在所在桶中的位置，-1表示不在索引中
+
+    int bucketOf(int cell) const {
+        return (cell / m_cols) / BUCKET * m_bucketCols + (cell % m_cols) / BUCKET;
+    }
+};
+
+#endif // SPATIAL_INDEX_H
@@ -0,0 +1,49 @@
+#include "StreamSink.h"
+#include <cstring>
+
+LineStreamSink::LineStreamSink(size_t maxLine)
+    : m_maxLine(maxLine > 0 ? maxLine : MAX_PACKET_SIZE), m_lines(0) {
+}
+
+bool LineStreamSink::consume(const char* data, size_t size, std::string& error) {
+    const char* end = data + size;
+    while (data < end) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+        const char* stop = newline ? newline : end;
+        if (m_partial.size() + (stop - data) > m_maxLine) {
+            error = "Line " + std::to_string(m_lines + 1) + " exceeds " +
+                    std::to_string(m_maxLine) + " bytes";
+            return false;
+        }
+        m_partial.append(data, stop);
+        if (!newline) {
+            break;
+        }
+        if (!emitLine(error)) {
+            return false;
+        }
+        data = newline + 1;
+    }
+    return true;
+}
+
+bool LineStreamSink::finish(Packet& reply, std::string& error) {
+    // 最后一行可以没有换行
+    if (!emitLine(error)) {
+        return false;
+    }
+    return onFinish(reply, error);
+}
+
+bool LineStreamSink::emitLine(std::string& error) {
+    size_t last = m_partial.find_last_not_of(" \t\r");
+    if (last == std::string::npos) {
+        m_partial.clear();
+        return true;
+    }
+    m_partial.resize(last + 1);
+    m_lines++;
+    bool ok = onLine(m_partial, error);
+    m_partial.clear();     // 保留容量，后续行不再分配
+    return ok;
+}
@@ -0,0 +1,52 @@
+#ifndef STREAM_SINK_H
+#define STREAM_SINK_H
+
+#include "protocol.h"
+#include <cstddef>
+#include <string>
+
+/**
+ * 上传流的接收端
+ *
+ * STREAM_BEGIN打开一个流，随后的STREAM_CHUNK按到达顺序交给consume，
+ * STREAM_END时调用finish生成回复。接收端边收边处理，不缓存整条消息，
+ * 多兆字节的上传也只占用固定的内存。
+ *
+ * LineStreamSink按换行切分记录（每行一个JSON），只缓存最后一个不完整的行，
+ * 行长度超过上限时报错。
+ */
+
+class StreamSink {
+public:
+    virtual ~StreamSink() {}
+
+    virtual const char* kind() const = 0;
+    // 处理一块数据，出错时写入error，流随之关闭
+    virtual bool consume(const char* data, size_t size, std::string& error) = 0;
+    // 流结束，生成回复
+    virtual bool finish(Packet& reply, std::string& error) = 0;
+};
+
+class LineStreamSink : public StreamSink {
+public:
+    explicit LineStreamSink(size_t maxLine = MAX_PACKET_SIZE);
+
+    bool consume(const char* data, size_t size, std::string& error) override;
+    bool finish(Packet& reply, std::string& error) override;
+
+    size_t lineCount() const { return m_lines; }
+
+protected:
+    // 一行完整的记录（不含换行，已跳过空行）
+    virtual bool onLine(const std::string& line, std::string& error) = 0;
+    virtual bool onFinish(Packet& reply, std::string& error) = 0;
+
+private:
+    size_t m_maxLine;
+    size_t m_lines;
+    std::string m_partial;      // 上一块末尾不完整的行
+
+    bool emitLine(std::string& error);
+};
+
+#endif // STREAM_SINK_H
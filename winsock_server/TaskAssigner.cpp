@@ -0,0 +1,226 @@
+#include "TaskAssigner.h"
+#include <algorithm>
+#include <limits>
+
+static const int TWO_OPT_MAX_PASSES = 4;
+static const double INF = std::numeric_limits<double>::infinity();
+
+TaskAssigner::TaskAssigner(const PathPlanner& planner)
+    : m_planner(planner), m_cartCount(0) {
+}
+
+void TaskAssigner::resetNodes(const std::vector<AssignCart>& carts,
+                              const std::vector<AssignTask>& tasks) {
+    m_cartCount = carts.size();
+    m_nodes.clear();
+    m_nodes.reserve(carts.size() + tasks.size());
+    for (const AssignCart& cart : carts) {
+        m_nodes.push_back(cart.start);
+    }
+    for (const AssignTask& task : tasks) {
+        m_nodes.push_back(task.pos);
+    }
+    m_fields.assign(m_nodes.size(), std::vector<double>());
+}
+
+double TaskAssigner::distance(size_t from, size_t to) {
+    if (m_nodes[from] == m_nodes[to]) {
+        return 0.0;
+    }
+    // 距离对称，优先使用已算好的距离场
+    if (m_fields[from].empty() && !m_fields[to].empty()) {
+        std::swap(from, to);
+    }
+    if (m_fields[from].empty()) {
+        m_planner.distanceField(m_nodes[from], m_fields[from]);
+    }
+    const GridPos& target = m_nodes[to];
+    if (!m_planner.isValidPosition(target.row, target.col)) {
+        return INF;
+    }
+    return m_fields[from][static_cast<size_t>(target.row) * m_planner.cols() + target.col];
+}
+
+bool TaskAssigner::cheapestInsertion(size_t cartIndex, const AssignCart& cart,
+                                     const std::vector<AssignTask>& tasks, int task,
+                                     double& cost, size_t& position) {
+    int priority = static_cast<int>(tasks[task].priority);
+    const std::vector<int>& route = cart.route;
+
+    // 只能插在同优先级区间内，保证路线优先级不降序
+    size_t lo = 0;
+    while (lo < route.size() && static_cast<int>(tasks[route[lo]].priority) < priority) {
+        lo++;
+    }
+    size_t hi = lo;
+    while (hi < route.size() && static_cast<int>(tasks[route[hi]].priority) == priority) {
+        hi++;
+    }
+
+    size_t node = taskNode(task);
+    cost = INF;
+    for (size_t k = lo; k <= hi; k++) {
+        size_t previous = k == 0 ? cartIndex : taskNode(route[k - 1]);
+        double delta = distance(previous, node);
+        if (k < route.size()) {
+            size_t next = taskNode(route[k]);
+            delta += distance(node, next) - distance(previous, next);
+        }
+        if (delta < cost) {
+            cost = delta;
+            position = k;
+        }
+    }
+    return cost < INF;
+}
+
+void TaskAssigner::assign(std::vector<AssignCart>& carts, const std::vector<AssignTask>& tasks,
+                          const std::vector<int>& pending, const AssignOptions& options,
+                          std::vector<int>& unassigned) {
+    unassigned.clear();
+    resetNodes(carts, tasks);
+    if (carts.empty()) {
+        unassigned = pending;
+        return;
+    }
+
+    double meterEnergy = options.cellSize * options.moveEnergyPerMeter;
+
+    // 已有路线先占用预算
+    double budget = options.energyBudget;
+    for (size_t c = 0; c < carts.size(); c++) {
+        size_t previous = c;
+        for (int task : carts[c].route) {
+            budget -= tasks[task].energy + distance(previous, taskNode(task)) * meterEnergy;
+            previous = taskNode(task);
+        }
+    }
+
+    // 出价缓存：某辆车路线变化后只重算这一列
+    struct Bid {
+        bool valid;
+        bool feasible;
+        double cost;
+        size_t position;
+    };
+    std::vector<int> remaining = pending;
+    std::vector<std::vector<Bid>> bids(tasks.size());
+    for (int task : remaining) {
+        bids[task].assign(carts.size(), Bid{ false, false, INF, 0 });
+    }
+
+    while (!remaining.empty()) {
+        int topPriority = std::numeric_limits<int>::max();
+        for (int task : remaining) {
+            topPriority = std::min(topPriority, static_cast<int>(tasks[task].priority));
+        }
+
+        double bestCost = INF;
+        size_t bestSlot = 0;
+        size_t bestCart = 0;
+        bool found = false;
+        for (size_t slot = 0; slot < remaining.size();) {
+            int task = remaining[slot];
+            const AssignTask& info = tasks[task];
+            if (static_cast<int>(info.priority) != topPriority) {
+                slot++;
+                continue;
+            }
+
+            bool anyFeasible = false;
+            for (size_t c = 0; c < carts.size(); c++) {
+                const AssignCart& cart = carts[c];
+                Bid& bid = bids[task][c];
+                if (!bid.valid) {
+                    bid.valid = true;
+                    bid.feasible = (cart.taskMask & (1u << static_cast<int>(info.type))) &&
+                                   cart.route.size() < cart.capacity &&
+                                   cheapestInsertion(c, cart, tasks, task, bid.cost, bid.position);
+                }
+                if (!bid.feasible ||
+                    info.energy + bid.cost * meterEnergy > budget) {
+                    continue;
+                }
+                anyFeasible = true;
+                // 同价时交给任务较少的小车，分摊工作量
+                if (bid.cost < bestCost ||
+                    (bid.cost == bestCost && found && cart.route.size() < carts[bestCart].route.size())) {
+                    bestCost = bid.cost;
+                    bestSlot = slot;
+                    bestCart = c;
+                    found = true;
+                }
+            }
+
+            if (!anyFeasible) {
+                // 没有任何小车能接：出价只会随路线变长而变差，直接放弃
+                unassigned.push_back(task);
+                remaining[slot] = remaining.back();
+                remaining.pop_back();
+                if (found && bestSlot == remaining.size()) {
+                    bestSlot = slot;    // 最优项被交换到了当前位置
+                }
+                continue;
+            }
+            slot++;
+        }
+
+        if (!found) {
+            continue;   // 本优先级的任务全部无法分配，进入下一优先级
+        }
+
+        int task = remaining[bestSlot];
+        AssignCart& cart = carts[bestCart];
+        const Bid& bid = bids[task][bestCart];
+        cart.route.insert(cart.route.begin() + bid.position, task);
+        budget -= tasks[task].energy + bid.cost * meterEnergy;
+
+        remaining[bestSlot] = remaining.back();
+        remaining.pop_back();
+        for (int other : remaining) {
+            bids[other][bestCart].valid = false;
+        }
+    }
+
+    for (size_t c = 0; c < carts.size(); c++) {
+        refineRoute(c, carts[c], tasks);
+    }
+}
+
+// 同优先级区间内的2-opt（起点固定，终点开放）
+void TaskAssigner::refineRoute(size_t cartIndex, AssignCart& cart,
+                               const std::vector<AssignTask>& tasks) {
+    std::vector<int>& route = cart.route;
+    size_t n = route.size();
+    size_t begin = 0;
+    while (begin < n) {
+        size_t end = begin;
+        while (end < n && tasks[route[end]].priority == tasks[route[begin]].priority) {
+            end++;
+        }
+
+        for (int pass = 0; pass < TWO_OPT_MAX_PASSES && end - begin >= 2; pass++) {
+            bool improved = false;
+            for (size_t i = begin; i + 1 < end; i++) {
+                size_t before = i == 0 ? cartIndex : taskNode(route[i - 1]);
+                for (size_t j = i + 1; j < end; j++) {
+                    double removed = distance(before, taskNode(route[i]));
+                    double added = distance(before, taskNode(route[j]));
+                    if (j + 1 < n) {
+                        size_t after = taskNode(route[j + 1]);
+                        removed += distance(taskNode(route[j]), after);
+                        added += distance(taskNode(route[i]), after);
+                    }
+                    if (added + 1e-9 < removed) {
+                        std::reverse(route.begin() + i, route.begin() + j + 1);
+                        improved = true;
+                    }
+                }
+            }
+            if (!improved) {
+                break;
+            }
+        }
+        begin = end;
+    }
+}
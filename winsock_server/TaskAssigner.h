@@ -0,0 +1,79 @@
+#ifndef TASK_ASSIGNER_H
+#define TASK_ASSIGNER_H
+
+#include "protocol.h"
+#include "PathPlanner.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * 多小车任务分配
+ *
+ * 第一遍是顺序单项拍卖：每轮只拍卖剩余任务中优先级最高的一组，
+ * 每辆小车按"插入自己路线的最小增量距离"出价，全局最低价成交；
+ * 出价时检查装备（可执行的任务类型）、每车路线容量和共享能量预算。
+ * 第二遍对每辆小车的路线在同优先级区间内做2-opt。
+ *
+ * 距离来自PathPlanner的距离场（绕开障碍），每个起点/任务按需算一次。
+ * 已有路线可以作为输入，新任务到达时只做插入，不必整体重算。
+ */
+
+// 参与分配的小车
+struct AssignCart {
+    int id;                     // 调用方的小车编号
+    GridPos start;              // 路线起点（小车所在格子或正在前往的目标）
+    uint32_t taskMask;          // 可执行的任务类型，1 << TaskType
+    size_t capacity;            // 路线最多容纳的任务数
+    std::vector<int> route;     // 路线（tasks下标），优先级不降序
+
+    AssignCart() : id(-1), taskMask(0xFFFFFFFFu), capacity(16) {}
+};
+
+// 待分配/已分配的任务
+struct AssignTask {
+    GridPos pos;
+    TaskType type;
+    TaskPriority priority;
+    double energy;              // 执行消耗的能量
+
+    AssignTask() : type(TaskType::HARVEST), priority(TaskPriority::LOW), energy(0.0) {}
+};
+
+struct AssignOptions {
+    double cellSize;            // 米/格
+    double moveEnergyPerMeter;
+    double energyBudget;        // 所有小车路线共享的能量预算
+
+    AssignOptions() : cellSize(0.5), moveEnergyPerMeter(0.0), energyBudget(1e18) {}
+};
+
+class TaskAssigner {
+public:
+    explicit TaskAssigner(const PathPlanner& planner);
+
+    // 把pending中的任务插入各小车路线，无法分配的写入unassigned；
+    // 小车已有路线上的任务也必须在tasks中
+    void assign(std::vector<AssignCart>& carts, const std::vector<AssignTask>& tasks,
+                const std::vector<int>& pending, const AssignOptions& options,
+                std::vector<int>& unassigned);
+
+private:
+    const PathPlanner& m_planner;
+
+    // 节点：先是各小车起点，再是各任务；距离场按需计算
+    size_t m_cartCount;
+    std::vector<GridPos> m_nodes;
+    std::vector<std::vector<double>> m_fields;
+
+    void resetNodes(const std::vector<AssignCart>& carts, const std::vector<AssignTask>& tasks);
+    double distance(size_t from, size_t to);
+    size_t taskNode(int task) const { return m_cartCount + static_cast<size_t>(task); }
+
+    // 最便宜的插入位置，不可插入返回false
+    bool cheapestInsertion(size_t cartIndex, const AssignCart& cart,
+                           const std::vector<AssignTask>& tasks, int task,
+                           double& cost, size_t& position);
+    void refineRoute(size_t cartIndex, AssignCart& cart, const std::vector<AssignTask>& tasks);
+};
+
+#endif // TASK_ASSIGNER_H
@@ -0,0 +1,233 @@
+#include "TaskQueue.h"
+
+TaskQueue::TaskQueue()
+    : m_nextSeq(0), m_cellCount(0) {
+    for (int t = 0; t < TASK_TYPE_COUNT; t++) {
+        m_countByType[t] = 0;
+    }
+}
+
+void TaskQueue::reset(int cellCount) {
+    m_cellCount = cellCount > 0 ? cellCount : 0;
+    m_tasks.clear();
+    m_heap.clear();
+    m_heapPos.clear();
+    m_slotOf.assign(static_cast<size_t>(m_cellCount) * TASK_TYPE_COUNT, -1);
+    for (int t = 0; t < TASK_TYPE_COUNT; t++) {
+        m_countByType[t] = 0;
+    }
+    m_nextSeq = 0;
+}
+
+// a是否应排在b之前
+bool TaskQueue::before(int32_t a, int32_t b) const {
+    const QueuedTask& x = m_tasks[a];
+    const QueuedTask& y = m_tasks[b];
+    if (x.priority != y.priority) {
+        return static_cast<int>(x.priority) < static_cast<int>(y.priority);
+    }
+    if (x.urgency != y.urgency) {
+        return x.urgency > y.urgency;
+    }
+    return x.seq < y.seq;
+}
+
+void TaskQueue::place(size_t pos, int32_t task) {
+    m_heap[pos] = task;
+    m_heapPos[task] = static_cast<int32_t>(pos);
+}
+
+void TaskQueue::siftUp(size_t pos) {
+    int32_t task = m_heap[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / ARITY;
+        if (!before(task, m_heap[parent])) {
+            break;
+        }
+        place(pos, m_heap[parent]);
+        pos = parent;
+    }
+    place(pos, task);
+}
+
+void TaskQueue::siftDown(size_t pos) {
+    int32_t task = m_heap[pos];
+    size_t count = m_heap.size();
+    for (;;) {
+        size_t first = pos * ARITY + 1;
+        if (first >= count) {
+            break;
+        }
+        size_t last = first + ARITY < count ? first + ARITY : count;
+        size_t best = first;
+        for (size_t child = first + 1; child < last; child++) {
+            if (before(m_heap[child], m_heap[best])) {
+                best = child;
+            }
+        }
+        if (!before(m_heap[best], task)) {
+            break;
+        }
+        place(pos, m_heap[best]);
+        pos = best;
+    }
+    place(pos, task);
+}
+
+void TaskQueue::heapInsert(int32_t task) {
+    m_heap.push_back(task);
+    m_heapPos[task] = static_cast<int32_t>(m_heap.size() - 1);
+    siftUp(m_heap.size() - 1);
+}
+
+void TaskQueue::heapRemove(size_t pos) {
+    int32_t removed = m_heap[pos];
+    int32_t last = m_heap.back();
+    m_heap.pop_back();
+    m_heapPos[removed] = -1;
+    if (pos < m_heap.size()) {
+        place(pos, last);
+        siftDown(pos);
+        siftUp(m_heapPos[last]);
+    }
+}
+
+bool TaskQueue::upsert(int cell, TaskType type, TaskPriority priority, double urgency) {
+    if (!validKey(cell, type)) {
+        return false;
+    }
+
+    int32_t slot = m_slotOf[key(cell, type)];
+    if (slot >= 0) {
+        QueuedTask& task = m_tasks[slot];
+        if (task.priority == priority && task.urgency == urgency) {
+            return false;
+        }
+        task.priority = priority;
+        task.urgency = urgency;
+        int32_t pos = m_heapPos[slot];
+        if (pos >= 0) {
+            siftUp(pos);
+            siftDown(m_heapPos[slot]);
+        }
+        return false;
+    }
+
+    QueuedTask task;
+    task.cell = cell;
+    task.type = type;
+    task.priority = priority;
+    task.urgency = urgency;
+    task.seq = m_nextSeq++;
+    task.claimed = false;
+
+    slot = static_cast<int32_t>(m_tasks.size());
+    m_tasks.push_back(task);
+    m_heapPos.push_back(-1);
+    m_slotOf[key(cell, type)] = slot;
+    m_countByType[static_cast<int>(type)]++;
+    heapInsert(slot);
+    return true;
+}
+
+bool TaskQueue::remove(int cell, TaskType type) {
+    if (!validKey(cell, type)) {
+        return false;
+    }
+    int32_t slot = m_slotOf[key(cell, type)];
+    if (slot < 0) {
+        return false;
+    }
+
+    if (m_heapPos[slot] >= 0) {
+        heapRemove(m_heapPos[slot]);
+    }
+    m_slotOf[key(cell, type)] = -1;
+    m_countByType[static_cast<int>(type)]--;
+
+    // 与末尾交换删除，修正被移动任务的索引
+    int32_t last = static_cast<int32_t>(m_tasks.size() - 1);
+    if (slot != last) {
+        m_tasks[slot] = m_tasks[last];
+        m_heapPos[slot] = m_heapPos[last];
+        m_slotOf[key(m_tasks[slot].cell, m_tasks[slot].type)] = slot;
+        if (m_heapPos[slot] >= 0) {
+            m_heap[m_heapPos[slot]] = slot;
+        }
+    }
+    m_tasks.pop_back();
+    m_heapPos.pop_back();
+    return true;
+}
+
+const QueuedTask* TaskQueue::find(int cell, TaskType type) const {
+    if (!validKey(cell, type)) {
+        return nullptr;
+    }
+    int32_t slot = m_slotOf[key(cell, type)];
+    return slot >= 0 ? &m_tasks[slot] : nullptr;
+}
+
+const QueuedTask* TaskQueue::top() const {
+    return m_heap.empty() ? nullptr : &m_tasks[m_heap[0]];
+}
+
+bool TaskQueue::claim(int cell, TaskType type) {
+    if (!validKey(cell, type)) {
+        return false;
+    }
+    int32_t slot = m_slotOf[key(cell, type)];
+    if (slot < 0 || m_tasks[slot].claimed) {
+        return false;
+    }
+    heapRemove(m_heapPos[slot]);
+    m_tasks[slot].claimed = true;
+    return true;
+}
+
+bool TaskQueue::unclaim(int cell, TaskType type) {
+    if (!validKey(cell, type)) {
+        return false;
+    }
+    int32_t slot = m_slotOf[key(cell, type)];
+    if (slot < 0 || !m_tasks[slot].claimed) {
+        return false;
+    }
+    m_tasks[slot].claimed = false;
+    heapInsert(slot);
+    return true;
+}
+
+void TaskQueue::bulkLoad(const std::vector<QueuedTask>& tasks) {
+    reset(m_cellCount);
+
+    m_tasks.reserve(tasks.size());
+    for (const QueuedTask& source : tasks) {
+        if (!validKey(source.cell, source.type) || m_slotOf[key(source.cell, source.type)] >= 0) {
+            continue;   // 越界或重复
+        }
+        QueuedTask task = source;
+        task.seq = m_nextSeq++;
+        task.claimed = false;
+        m_slotOf[key(task.cell, task.type)] = static_cast<int32_t>(m_tasks.size());
+        m_countByType[static_cast<int>(task.type)]++;
+        m_tasks.push_back(task);
+    }
+
+    // 自底向上建堆
+    m_heap.resize(m_tasks.size());
+    m_heapPos.resize(m_tasks.size());
+    for (size_t i = 0; i < m_tasks.size(); i++) {
+        place(i, static_cast<int32_t>(i));
+    }
+    if (m_heap.size() > 1) {
+        for (size_t i = (m_heap.size() - 2) / ARITY + 1; i-- > 0;) {
+            siftDown(i);
+        }
+    }
+}
+
+size_t TaskQueue::countByType(TaskType type) const {
+    int t = static_cast<int>(type);
+    return (t >= 0 && t < TASK_TYPE_COUNT) ? m_countByType[t] : 0;
+}
@@ -0,0 +1,83 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+#include "protocol.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * 索引优先级任务队列
+ *
+ * 4叉堆，排序键为 (TaskPriority, urgency降序, 入队序号)。
+ * 每个 (格子, 任务类型) 在稠密数组中记录堆位置：
+ *   - 查找、去重 O(1)
+ *   - 插入、删除、紧急度变化 O(log n)
+ *   - 批量装载用自底向上建堆 O(n)
+ * 被认领（claim）的任务暂时移出堆但保留索引，释放后回到堆中。
+ */
+
+constexpr int TASK_TYPE_COUNT = static_cast<int>(TaskType::SOIL_PREPARATION) + 1;
+
+// 队列中的任务
+struct QueuedTask {
+    int cell;
+    TaskType type;
+    TaskPriority priority;
+    double urgency;     // 同优先级内越大越先执行
+    uint64_t seq;       // 入队序号，保证同级先进先出
+    bool claimed;
+};
+
+class TaskQueue {
+public:
+    TaskQueue();
+
+    // 按格子数重置（清空所有任务）
+    void reset(int cellCount);
+
+    // 插入或更新，已存在时只调整优先级/紧急度，返回是否新插入
+    bool upsert(int cell, TaskType type, TaskPriority priority, double urgency);
+    bool remove(int cell, TaskType type);
+    const QueuedTask* find(int cell, TaskType type) const;
+
+    // 堆顶（未被认领的最高优先级任务）
+    const QueuedTask* top() const;
+
+    // 认领：移出堆，保留索引；释放：放回堆
+    bool claim(int cell, TaskType type);
+    bool unclaim(int cell, TaskType type);
+
+    // 批量装载（替换现有内容）
+    void bulkLoad(const std::vector<QueuedTask>& tasks);
+
+    size_t size() const { return m_tasks.size(); }
+    size_t readyCount() const { return m_heap.size(); }
+    size_t countByType(TaskType type) const;
+
+private:
+    static const int ARITY = 4;
+
+    std::vector<QueuedTask> m_tasks;    // 任务存储（删除时与末尾交换）
+    std::vector<int32_t> m_heap;        // 堆，元素为m_tasks下标
+    std::vector<int32_t> m_slotOf;      // (cell, type) -> m_tasks下标，-1表示不存在
+    std::vector<int32_t> m_heapPos;     // m_tasks下标 -> 堆位置，-1表示已认领
+    size_t m_countByType[TASK_TYPE_COUNT];
+    uint64_t m_nextSeq;
+    int m_cellCount;
+
+    int key(int cell, TaskType type) const {
+        return cell * TASK_TYPE_COUNT + static_cast<int>(type);
+    }
+    bool validKey(int cell, TaskType type) const {
+        return cell >= 0 && cell < m_cellCount &&
+               static_cast<int>(type) >= 0 && static_cast<int>(type) < TASK_TYPE_COUNT;
+    }
+    bool before(int32_t a, int32_t b) const;
+    void place(size_t pos, int32_t task);
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+    void heapRemove(size_t pos);
+    void heapInsert(int32_t task);
+};
+
+#endif // TASK_QUEUE_H
@@ -0,0 +1,287 @@
+#include "TimerWheel.h"
+#include <limits>
+#include <algorithm>
+
+static const uint64_t NO_EVENT = std::numeric_limits<uint64_t>::max();
+static const uint64_t MAX_DELTA_TICKS = (1ULL << 32) - 1;
+
+TimerWheel::TimerWheel(uint32_t tickMs)
+    : m_tickMs(tickMs > 0 ? tickMs : 1),
+      m_currentTick(0),
+      m_pending(0),
+      m_epoch(std::chrono::steady_clock::now()),
+      m_plannedWakeTick(NO_EVENT),
+      m_wakeRequested(false) {
+    for (int level = 0; level < LEVELS; level++) {
+        m_levels[level].heads.assign(levelSize(level), -1);
+        m_levels[level].bitmap.assign((levelSize(level) + 63) / 64, 0);
+    }
+}
+
+uint64_t TimerWheel::nowMs() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - m_epoch).count());
+}
+
+size_t TimerWheel::pendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
+
+int32_t TimerWheel::allocNode() {
+    if (!m_freeNodes.empty()) {
+        int32_t index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+        return index;
+    }
+    m_nodes.emplace_back();
+    return static_cast<int32_t>(m_nodes.size() - 1);
+}
+
+void TimerWheel::freeNode(int32_t index) {
+    TimerNode& node = m_nodes[index];
+    node.generation++;      // 使旧的TimerId失效
+    node.callback = nullptr;
+    node.level = -1;
+    node.prev = node.next = -1;
+    m_freeNodes.push_back(index);
+}
+
+void TimerWheel::insertNode(int32_t index) {
+    TimerNode& node = m_nodes[index];
+    if (node.expires < m_currentTick) {
+        node.expires = m_currentTick;
+    }
+    uint64_t delta = node.expires - m_currentTick;
+    if (delta > MAX_DELTA_TICKS) {
+        delta = MAX_DELTA_TICKS;
+        node.expires = m_currentTick + delta;
+    }
+
+    // 选择能容纳该时间差的最低层
+    int level = 0;
+    while (level < LEVELS - 1 &&
+           delta >= (1ULL << (levelShift(level) + (level == 0 ? LEVEL0_BITS : LEVELN_BITS)))) {
+        level++;
+    }
+    int slot = static_cast<int>((node.expires >> levelShift(level)) & (levelSize(level) - 1));
+
+    Level& wheel = m_levels[level];
+    node.level = static_cast<int16_t>(level);
+    node.slot = static_cast<int16_t>(slot);
+    node.prev = -1;
+    node.next = wheel.heads[slot];
+    if (node.next >= 0) {
+        m_nodes[node.next].prev = index;
+    }
+    wheel.heads[slot] = index;
+    wheel.bitmap[slot / 64] |= (1ULL << (slot % 64));
+}
+
+void TimerWheel::unlinkNode(int32_t index) {
+    TimerNode& node = m_nodes[index];
+    if (node.level < 0) return;
+
+    Level& wheel = m_levels[node.level];
+    if (node.prev >= 0) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        wheel.heads[node.slot] = node.next;
+    }
+    if (node.next >= 0) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    if (wheel.heads[node.slot] < 0) {
+        wheel.bitmap[node.slot / 64] &= ~(1ULL << (node.slot % 64));
+    }
+    node.level = -1;
+    node.prev = node.next = -1;
+}
+
+TimerId TimerWheel::schedule(uint64_t delayMs, TimerCallback callback, uint64_t periodMs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    int32_t index = allocNode();
+    TimerNode& node = m_nodes[index];
+    // 向上取整，保证不早于请求时间触发
+    node.expires = (nowMs() + delayMs + m_tickMs - 1) / m_tickMs;
+    node.periodTicks = periodMs > 0 ? (periodMs + m_tickMs - 1) / m_tickMs : 0;
+    node.callback = std::move(callback);
+    insertNode(index);
+    m_pending++;
+
+    // 比调度线程计划的唤醒点更早，提前唤醒
+    if (node.expires < m_plannedWakeTick) {
+        m_wakeRequested = true;
+        m_wakeCv.notify_one();
+    }
+
+    return (static_cast<uint64_t>(node.generation) << 32) | static_cast<uint32_t>(index + 1);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    if (id == INVALID_TIMER) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int32_t index = static_cast<int32_t>(id & 0xFFFFFFFFu) - 1;
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (index < 0 || (size_t)index >= m_nodes.size()) return false;
+
+    TimerNode& node = m_nodes[index];
+    if (node.generation != generation || node.level < 0) return false;
+
+    unlinkNode(index);
+    freeNode(index);
+    m_pending--;
+    return true;
+}
+
+void TimerWheel::cascade(int level) {
+    int slot = static_cast<int>((m_currentTick >> levelShift(level)) & (levelSize(level) - 1));
+    Level& wheel = m_levels[level];
+
+    int32_t index = wheel.heads[slot];
+    wheel.heads[slot] = -1;
+    wheel.bitmap[slot / 64] &= ~(1ULL << (slot % 64));
+
+    // 重新插入到更低层
+    while (index >= 0) {
+        int32_t next = m_nodes[index].next;
+        m_nodes[index].level = -1;
+        insertNode(index);
+        index = next;
+    }
+}
+
+int TimerWheel::findNextSlot(int level, int fromSlot) const {
+    const Level& wheel = m_levels[level];
+    int size = levelSize(level);
+    for (int word = fromSlot / 64; word * 64 < size; word++) {
+        uint64_t bits = wheel.bitmap[word];
+        if (word == fromSlot / 64) {
+            bits &= ~0ULL << (fromSlot % 64);
+        }
+        if (bits) {
+            int bit = 0;
+            while (!(bits & 1ULL)) {
+                bits >>= 1;
+                bit++;
+            }
+            return word * 64 + bit;
+        }
+    }
+    return -1;
+}
+
+uint64_t TimerWheel::ticksUntilNextEvent() const {
+    if (m_pending == 0) {
+        return NO_EVENT;
+    }
+    int index = static_cast<int>(m_currentTick & (LEVEL0_SIZE - 1));
+    int slot = findNextSlot(0, index);
+    if (slot >= 0) {
+        return static_cast<uint64_t>(slot - index);
+    }
+    // 底层没有事件，下一次级联时再检查
+    return static_cast<uint64_t>(LEVEL0_SIZE - index);
+}
+
+size_t TimerWheel::advanceTo(uint64_t nowMs) {
+    std::vector<TimerCallback> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t targetTick = nowMs / m_tickMs;
+
+        while (m_currentTick <= targetTick) {
+            if (m_pending == 0) {
+                m_currentTick = targetTick + 1;
+                break;
+            }
+
+            int index = static_cast<int>(m_currentTick & (LEVEL0_SIZE - 1));
+            if (index != 0) {
+                // 跳过空槽，直接到下一个非空槽或级联边界
+                int slot = findNextSlot(0, index);
+                uint64_t skip = slot >= 0 ? static_cast<uint64_t>(slot - index)
+                                          : static_cast<uint64_t>(LEVEL0_SIZE - index);
+                skip = std::min(skip, targetTick + 1 - m_currentTick);
+                if (skip > 0) {
+                    m_currentTick += skip;
+                    continue;
+                }
+            } else {
+                // 逐层级联
+                for (int level = 1; level < LEVELS; level++) {
+                    cascade(level);
+                    if (((m_currentTick >> levelShift(level)) & (levelSize(level) - 1)) != 0) {
+                        break;
+                    }
+                }
+            }
+
+            // 触发当前槽的所有定时器
+            Level& wheel = m_levels[0];
+            int32_t node = wheel.heads[index];
+            wheel.heads[index] = -1;
+            wheel.bitmap[index / 64] &= ~(1ULL << (index % 64));
+
+            while (node >= 0) {
+                int32_t next = m_nodes[node].next;
+                TimerNode& timer = m_nodes[node];
+                timer.level = -1;
+                if (timer.periodTicks > 0) {
+                    expired.push_back(timer.callback);
+                    timer.expires = m_currentTick + timer.periodTicks;
+                    insertNode(node);
+                } else {
+                    expired.push_back(std::move(timer.callback));
+                    freeNode(node);
+                    m_pending--;
+                }
+                node = next;
+            }
+
+            m_currentTick++;
+        }
+    }
+
+    // 在锁外执行回调，回调中可以安全地调度或取消定时器
+    for (auto& callback : expired) {
+        if (callback) {
+            callback();
+        }
+    }
+    return expired.size();
+}
+
+void TimerWheel::waitForNext(uint64_t maxWaitMs) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_wakeRequested) {
+        m_wakeRequested = false;
+        return;
+    }
+
+    uint64_t waitMs = maxWaitMs;
+    uint64_t ticks = ticksUntilNextEvent();
+    if (ticks != NO_EVENT) {
+        uint64_t wakeMs = (m_currentTick + ticks) * m_tickMs;
+        uint64_t now = nowMs();
+        waitMs = wakeMs > now ? std::min(maxWaitMs, wakeMs - now) : 0;
+        m_plannedWakeTick = m_currentTick + ticks;
+    } else {
+        m_plannedWakeTick = NO_EVENT;
+    }
+
+    if (waitMs > 0) {
+        m_wakeCv.wait_for(lock, std::chrono::milliseconds(waitMs),
+                          [this]() { return m_wakeRequested; });
+    }
+    m_wakeRequested = false;
+    m_plannedWakeTick = NO_EVENT;
+}
+
+void TimerWheel::wakeUp() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wakeRequested = true;
+    m_wakeCv.notify_all();
+}
@@ -0,0 +1,107 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/**
+ * 分层时间轮
+ *
+ * 插入、取消、到期均为O(1)（级联时每个定时器最多移动4次）。
+ * 每层维护非空槽位图，空闲时调度线程直接睡到下一个到期点，
+ * 没有到期事件的客户端和植物不产生任何每tick开销。
+ *
+ * 层级：256 + 64 + 64 + 64 + 64 槽，共覆盖 2^32 个tick。
+ */
+
+using TimerId = uint64_t;
+using TimerCallback = std::function<void()>;
+
+constexpr TimerId INVALID_TIMER = 0;
+
+class TimerWheel {
+public:
+    explicit TimerWheel(uint32_t tickMs = 10);
+
+    // 调度定时器，delayMs后触发；periodMs > 0 时周期触发
+    TimerId schedule(uint64_t delayMs, TimerCallback callback, uint64_t periodMs = 0);
+
+    // 取消定时器，定时器已触发或不存在时返回false
+    bool cancel(TimerId id);
+
+    // 推进到指定时间并执行到期回调，返回执行的回调数
+    size_t advanceTo(uint64_t nowMs);
+
+    // 等待直到下一个到期点、有更早的定时器加入、或被唤醒
+    void waitForNext(uint64_t maxWaitMs);
+    void wakeUp();
+
+    // 时间轮自身的单调时钟（毫秒）
+    uint64_t nowMs() const;
+
+    uint32_t tickMs() const { return m_tickMs; }
+    size_t pendingCount() const;
+
+private:
+    static const int LEVELS = 5;
+    static const int LEVEL0_BITS = 8;
+    static const int LEVELN_BITS = 6;
+    static const int LEVEL0_SIZE = 1 << LEVEL0_BITS;
+    static const int LEVELN_SIZE = 1 << LEVELN_BITS;
+
+    // 定时器节点（侵入式双向链表）
+    struct TimerNode {
+        uint32_t generation;
+        int32_t prev;
+        int32_t next;
+        int16_t level;      // -1 表示未挂在任何槽上
+        int16_t slot;
+        uint64_t expires;   // 到期tick
+        uint64_t periodTicks;
+        TimerCallback callback;
+
+        TimerNode() : generation(1), prev(-1), next(-1), level(-1), slot(0),
+                      expires(0), periodTicks(0) {}
+    };
+
+    // 一层时间轮
+    struct Level {
+        std::vector<int32_t> heads;
+        std::vector<uint64_t> bitmap;   // 非空槽位图
+    };
+
+    uint32_t m_tickMs;
+    uint64_t m_currentTick;     // 下一个待处理的tick
+    size_t m_pending;
+    std::chrono::steady_clock::time_point m_epoch;
+
+    std::vector<TimerNode> m_nodes;
+    std::vector<int32_t> m_freeNodes;
+    Level m_levels[LEVELS];
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeCv;
+    uint64_t m_plannedWakeTick;
+    bool m_wakeRequested;
+
+    int32_t allocNode();
+    void freeNode(int32_t index);
+    void insertNode(int32_t index);
+    void unlinkNode(int32_t index);
+    void cascade(int level);
+    int findNextSlot(int level, int fromSlot) const;
+    uint64_t ticksUntilNextEvent() const;
+
+    static int levelShift(int level) {
+        return level == 0 ? 0 : LEVEL0_BITS + (level - 1) * LEVELN_BITS;
+    }
+    static int levelSize(int level) {
+        return level == 0 ? LEVEL0_SIZE : LEVELN_SIZE;
+    }
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,79 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool() : m_running(false) {
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start(size_t threadCount) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+        return;
+    }
+    if (threadCount == 0) threadCount = 1;
+    m_running = true;
+    for (size_t i = 0; i < threadCount; i++) {
+        m_threads.push_back(std::thread(&WorkerPool::workerLoop, this));
+    }
+}
+
+void WorkerPool::stop() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        threads.swap(m_threads);
+    }
+    m_cv.notify_all();
+    for (std::thread& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+bool WorkerPool::running() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+bool WorkerPool::submit(WorkerJob job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return false;
+        }
+        m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+    return true;
+}
+
+size_t WorkerPool::threadCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_threads.size();
+}
+
+size_t WorkerPool::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_jobs.size();
+}
+
+// 停止后仍把队列中的任务执行完，保证每个已接收的请求都有回复
+void WorkerPool::workerLoop() {
+    for (;;) {
+        WorkerJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]() { return !m_running || !m_jobs.empty(); });
+            if (m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+ * 固定大小的工作线程池
+ *
+ * 协议v2的连接把请求交给线程池并发处理，读线程继续读取下一个请求；
+ * 回复按处理完成的顺序发出。stop()会先执行完队列中剩余的任务再退出。
+ */
+
+using WorkerJob = std::function<void()>;
+
+class WorkerPool {
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    void start(size_t threadCount);
+    void stop();
+    bool running() const;
+
+    // 提交任务，线程池未运行时返回false（调用方自行同步执行）
+    bool submit(WorkerJob job);
+
+    size_t threadCount() const;
+    size_t pending() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<WorkerJob> m_jobs;
+    std::vector<std::thread> m_threads;
+    bool m_running;
+
+    void workerLoop();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,657 @@
+#include "FarmServer.h"
+#include "socket_compat.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+    #include <csignal>
+#endif
+
+/**
+ * 协议、收发和处理热路径的微基准测试
+ *
+ * 自带的计时框架：每个用例先把迭代次数加倍到耗时超过--min-time的十分之一，
+ * 再按估计的单次耗时跑满--min-time，重复--repetitions次，报告每次操作耗时的
+ * 中位数和最小值、吞吐（字节/秒或条/秒）。用例：
+ *   packet/serialize、packet/deserialize   v1/v2头部，不同数据长度
+ *   receive                                 receivePacket从回环TCP连接读取（另一线程持续写入），
+ *                                           含v2的LZ4压缩帧和超过MAX_PACKET_SIZE的分片消息
+ *   reply                                   sendSuccess/sendError构造JSON回复（目标客户端未连接，
+ *                                           不含send系统调用）
+ *   broadcast/state                         broadcastStateUpdate推送给n个回环连接（另一线程读走）
+ *   log                                     log()只输出到（被丢弃的）控制台、写日志文件、带客户端地址
+ * 私有方法通过FarmServer的友元FarmServerBench调用，服务器本身不启动。
+ *
+ * --format json的输出与Google Benchmark的JSON格式兼容（context + benchmarks，
+ * real_time为中位数，单位ns），可以直接用它的compare.py对比两次结果；--format csv每个用例一行。
+ *
+ * 用法: farm_bench [--filter substring] [--min-time s] [--repetitions n]
+ *                  [--format console|json|csv] [--out file]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+// 一个用例的计时函数：执行iterations次操作
+using BenchRun = std::function<void(uint64_t iterations)>;
+
+struct BenchCase {
+    std::string name;
+    std::function<BenchRun()> prepare;  // 建立夹具，返回的函数析构时释放夹具
+    double bytesPerOp;
+    double itemsPerOp;
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    int repetitions;
+    double medianNs;
+    double minNs;
+    double bytesPerSecond;
+    double itemsPerSecond;
+};
+
+// 防止被测结果被优化掉
+static volatile size_t g_sink = 0;
+
+// 丢弃服务器log()的控制台输出
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+// 访问FarmServer的私有热路径
+class FarmServerBench {
+public:
+    static bool receivePacket(FarmServer& server, socket_t socket, Packet& packet, uint32_t version) {
+        return server.receivePacket(socket, packet, version);
+    }
+    static void sendSuccess(FarmServer& server, int clientId, const std::string& message,
+                            const std::string& extraFields) {
+        server.sendSuccess(clientId, message, extraFields);
+    }
+    static void sendError(FarmServer& server, int clientId, uint32_t errorCode, const std::string& message) {
+        server.sendError(clientId, errorCode, message);
+    }
+    static void log(FarmServer& server, const std::string& message, int clientId) {
+        server.log(LogLevel::INFO, message, clientId);
+    }
+    static std::string buildStateJson(const FarmServer& server) {
+        return server.buildStateJson();
+    }
+
+    // 把一个socket登记为已连接的客户端（不启动读线程）
+    static int attachClient(FarmServer& server, socket_t socket, uint32_t version) {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(40000);
+        int clientId = server.registerClient(socket, addr);
+        server.findClient(clientId)->protocolVersion.store(version);
+        return clientId;
+    }
+    // socket归调用方，放回槽位时不关闭
+    static void detachClient(FarmServer& server, int clientId) {
+        FarmServer::ClientSlot* client = server.findClient(clientId);
+        {
+            std::lock_guard<ProfiledMutex> lock(client->mutex);
+            client->clientId.store(0);
+            client->socket = INVALID_SOCKET;
+        }
+        server.releaseClientSlot(clientId);
+    }
+
+    // path为空时只输出到控制台
+    static bool setLogFile(FarmServer& server, const std::string& path) {
+        if (server.m_logFile.is_open()) {
+            server.m_logFile.close();
+        }
+        server.m_config.enableLogging = !path.empty();
+        if (path.empty()) {
+            return true;
+        }
+        server.m_logFile.open(path, std::ios::out | std::ios::trunc);
+        return server.m_logFile.is_open();
+    }
+};
+
+// ========== 计时框架 ==========
+
+static double timeRun(const BenchRun& run, uint64_t iterations) {
+    Clock::time_point started = Clock::now();
+    run(iterations);
+    return std::chrono::duration<double>(Clock::now() - started).count();
+}
+
+static BenchResult measure(const BenchCase& bench, double minTime, int repetitions) {
+    BenchRun run = bench.prepare();
+
+    // 加倍到耗时足以估计单次操作，再按估计值跑满minTime
+    uint64_t iterations = 1;
+    double seconds = timeRun(run, iterations);
+    while (seconds < minTime / 10 && iterations < (1ull << 40)) {
+        iterations *= 2;
+        seconds = timeRun(run, iterations);
+    }
+    iterations = std::max<uint64_t>(1, static_cast<uint64_t>(minTime / (seconds / iterations)));
+
+    std::vector<double> samples;
+    for (int i = 0; i < repetitions; i++) {
+        samples.push_back(timeRun(run, iterations) * 1e9 / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.name = bench.name;
+    result.iterations = iterations;
+    result.repetitions = repetitions;
+    result.medianNs = samples[samples.size() / 2];
+    result.minNs = samples.front();
+    result.bytesPerSecond = bench.bytesPerOp * 1e9 / result.medianNs;
+    result.itemsPerSecond = bench.itemsPerOp * 1e9 / result.medianNs;
+    return result;
+}
+
+// ========== 夹具 ==========
+
+// 回环TCP连接的两端（Windows没有socketpair）
+static bool loopbackPair(socket_t& a, socket_t& b) {
+    a = b = INVALID_SOCKET;
+    socket_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!isValidSocket(listener)) {
+        return false;
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t length = sizeof(addr);
+    bool ok = bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+              listen(listener, 1) == 0 &&
+              getsockname(listener, (sockaddr*)&addr, &length) == 0;
+    if (ok) {
+        a = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        ok = isValidSocket(a) && connect(a, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+    if (ok) {
+        b = accept(listener, nullptr, nullptr);
+        ok = isValidSocket(b);
+    }
+    safeCloseSocket(listener);
+    if (!ok) {
+        safeCloseSocket(a);
+        safeCloseSocket(b);
+        return false;
+    }
+    setTcpNoDelay(a, true);
+    setTcpNoDelay(b, true);
+    return true;
+}
+
+// 与STATE_UPDATE/PLANT_DATA相似的JSON，重复到指定长度
+static std::string jsonPayload(size_t size) {
+    std::string out = "{\"plants\":[";
+    int index = 0;
+    while (out.size() + 64 < size) {
+        if (index > 0) out += ",";
+        out += "{\"row\":" + std::to_string(index / 16) + ",\"col\":" + std::to_string(index % 16) +
+               ",\"type\":\"wheat\",\"stage\":2,\"water\":0.75}";
+        index++;
+    }
+    out += "]}";
+    if (out.size() + 9 < size) {
+        out.insert(out.size() - 1, ",\"pad\":\"" + std::string(size - out.size() - 9, 'x') + "\"");
+    }
+    return out;
+}
+
+// 按协议v2编码一条消息：超过MAX_PACKET_SIZE的分片，compressor非空时压缩每一片
+static void appendFrames(std::string& out, const Packet& packet, FrameCompressor* compressor) {
+    const size_t headerSize = packetHeaderSize(PROTOCOL_VERSION_2);
+    size_t offset = 0;
+    do {
+        size_t take = std::min(packet.data.size() - offset, static_cast<size_t>(MAX_PACKET_SIZE));
+        PacketHeader header;
+        header.command = packet.header.command;
+        PacketHeaderExt ext;
+        ext.requestId = packet.ext.requestId;
+        std::string frame(headerSize, '\0');
+        if (compressor && compressor->compress(packet.data.data() + offset, take, frame)) {
+            ext.flags |= PacketFlag::COMPRESSED;
+        } else {
+            frame.append(packet.data, offset, take);
+        }
+        offset += take;
+        if (offset < packet.data.size()) {
+            ext.flags |= PacketFlag::MORE;
+        }
+        header.length = static_cast<uint32_t>(frame.size() - headerSize);
+        std::memcpy(&frame[0], &header, sizeof(header));
+        std::memcpy(&frame[sizeof(header)], &ext, sizeof(ext));
+        out += frame;
+    } while (offset < packet.data.size());
+}
+
+// receivePacket：写线程把同一段编码好的消息反复写入连接的一端，被测线程从另一端读
+struct ReceiveFixture {
+    FarmServer& server;
+    socket_t reader;
+    socket_t writer;
+    uint32_t version;
+    std::string block;
+    std::atomic<bool> stop;
+    std::thread thread;
+
+    ReceiveFixture(FarmServer& owner, uint32_t protocolVersion, const std::string& message)
+        : server(owner), reader(INVALID_SOCKET), writer(INVALID_SOCKET),
+          version(protocolVersion), stop(false) {
+        // 一次写入至少256KB，减少写线程的系统调用
+        do {
+            block += message;
+        } while (block.size() < 256 * 1024);
+        if (!loopbackPair(reader, writer)) {
+            std::fprintf(stderr, "loopback connection failed: %s\n", getSocketError());
+            std::exit(1);
+        }
+        thread = std::thread([this]() {
+            while (!stop) {
+                size_t offset = 0;
+                while (offset < block.size()) {
+                    int sent = send(writer, block.data() + offset,
+                                    static_cast<int>(block.size() - offset), 0);
+                    if (sent <= 0) {
+                        return;
+                    }
+                    offset += static_cast<size_t>(sent);
+                }
+            }
+        });
+    }
+
+    ~ReceiveFixture() {
+        stop = true;
+        shutdown(reader, SD_BOTH);
+        shutdown(writer, SD_BOTH);
+        thread.join();
+        safeCloseSocket(reader);
+        safeCloseSocket(writer);
+    }
+
+    void run(uint64_t iterations) {
+        Packet packet;
+        for (uint64_t i = 0; i < iterations; i++) {
+            if (!FarmServerBench::receivePacket(server, reader, packet, version)) {
+                std::fprintf(stderr, "receivePacket failed\n");
+                std::exit(1);
+            }
+            g_sink += packet.data.size();
+        }
+    }
+};
+
+// broadcastStateUpdate：clients个已登记的回环连接，读线程用poll读走所有推送
+struct BroadcastFixture {
+    FarmServer& server;
+    std::vector<socket_t> serverSides;
+    std::vector<socket_t> clientSides;
+    std::vector<int> clientIds;
+    std::atomic<bool> stop;
+    std::thread thread;
+
+    BroadcastFixture(FarmServer& owner, int clients) : server(owner), stop(false) {
+        for (int i = 0; i < clients; i++) {
+            socket_t a, b;
+            if (!loopbackPair(a, b)) {
+                std::fprintf(stderr, "loopback connection failed: %s\n", getSocketError());
+                std::exit(1);
+            }
+            serverSides.push_back(a);
+            clientSides.push_back(b);
+            clientIds.push_back(FarmServerBench::attachClient(server, a, PROTOCOL_VERSION_2));
+        }
+        thread = std::thread([this]() {
+            std::vector<pollfd> fds(clientSides.size());
+            for (size_t i = 0; i < fds.size(); i++) {
+                fds[i].fd = clientSides[i];
+                fds[i].events = POLLIN;
+            }
+            std::vector<char> buffer(256 * 1024);
+            while (!stop) {
+                if (pollSockets(fds.data(), fds.size(), 10) <= 0) {
+                    continue;
+                }
+                for (auto& fd : fds) {
+                    if (fd.revents & (POLLIN | POLLERR | POLLHUP)) {
+                        if (recv(fd.fd, buffer.data(), static_cast<int>(buffer.size()), 0) <= 0) {
+                            return;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    ~BroadcastFixture() {
+        for (int clientId : clientIds) {
+            FarmServerBench::detachClient(server, clientId);
+        }
+        stop = true;
+        thread.join();
+        for (size_t i = 0; i < serverSides.size(); i++) {
+            safeCloseSocket(serverSides[i]);
+            safeCloseSocket(clientSides[i]);
+        }
+    }
+};
+
+// ========== 用例 ==========
+
+static void addPacketCases(std::vector<BenchCase>& cases) {
+    const size_t sizes[] = { 64, 1024, 65536 };
+    const uint32_t versions[] = { PROTOCOL_VERSION_1, PROTOCOL_VERSION_2 };
+    for (uint32_t version : versions) {
+        for (size_t size : sizes) {
+            std::string suffix = "/v" + std::to_string(version) + "/" + std::to_string(size);
+            auto packet = std::make_shared<Packet>(Response::STATE_UPDATE, jsonPayload(size));
+            packet->ext.requestId = 7;
+            double bytes = static_cast<double>(packetHeaderSize(version) + size);
+
+            cases.push_back({ "packet/serialize" + suffix, [packet, version]() -> BenchRun {
+                return [packet, version](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        g_sink += packet->serialize(version).size();
+                    }
+                };
+            }, bytes, 1 });
+
+            auto wire = std::make_shared<std::string>(packet->serialize(version));
+            cases.push_back({ "packet/deserialize" + suffix, [wire, version]() -> BenchRun {
+                return [wire, version](uint64_t iterations) {
+                    Packet out;
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        if (Packet::deserialize(wire->data(), wire->size(), out, version)) {
+                            g_sink += out.data.size();
+                        }
+                    }
+                };
+            }, bytes, 1 });
+        }
+    }
+}
+
+static void addReceiveCases(std::vector<BenchCase>& cases, FarmServer& server) {
+    struct ReceiveSpec {
+        const char* name;
+        uint32_t version;
+        size_t size;
+        bool compress;
+    };
+    const ReceiveSpec specs[] = {
+        { "receive/v1/64", PROTOCOL_VERSION_1, 64, false },
+        { "receive/v1/4096", PROTOCOL_VERSION_1, 4096, false },
+        { "receive/v2/64", PROTOCOL_VERSION_2, 64, false },
+        { "receive/v2/4096", PROTOCOL_VERSION_2, 4096, false },
+        { "receive/v2_lz4/16384", PROTOCOL_VERSION_2, 16384, true },
+        { "receive/v2_fragmented/262144", PROTOCOL_VERSION_2, 262144, false },
+    };
+    for (const ReceiveSpec& spec : specs) {
+        Packet packet(Command::BATCH_OPERATION, jsonPayload(spec.size));
+        std::string message;
+        if (spec.version >= PROTOCOL_VERSION_2) {
+            FrameCompressor compressor;
+            appendFrames(message, packet, spec.compress ? &compressor : nullptr);
+        } else {
+            message = packet.serialize(spec.version);
+        }
+        uint32_t version = spec.version;
+        FarmServer* owner = &server;
+        cases.push_back({ spec.name, [owner, version, message]() -> BenchRun {
+            auto fixture = std::make_shared<ReceiveFixture>(*owner, version, message);
+            return [fixture](uint64_t iterations) { fixture->run(iterations); };
+        }, static_cast<double>(spec.size), 1 });
+    }
+}
+
+static void addReplyCases(std::vector<BenchCase>& cases, FarmServer& server) {
+    // 未登记的客户端ID：构造JSON和Packet后在sendToClient的查找处返回
+    const int nobody = 999999;
+    FarmServer* owner = &server;
+    cases.push_back({ "reply/sendSuccess", [owner]() -> BenchRun {
+        return [owner](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                FarmServerBench::sendSuccess(*owner, nobody, "Plant watered", "");
+            }
+        };
+    }, 0, 1 });
+    cases.push_back({ "reply/sendSuccess_extra", [owner]() -> BenchRun {
+        const std::string extra = "\"row\":3,\"col\":5,\"coins\":120,\"energy\":87.500";
+        return [owner, extra](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                FarmServerBench::sendSuccess(*owner, nobody, "Harvested", extra);
+            }
+        };
+    }, 0, 1 });
+    cases.push_back({ "reply/sendError", [owner]() -> BenchRun {
+        return [owner](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                FarmServerBench::sendError(*owner, nobody, ErrorCode::INVALID_POSITION,
+                                           "Position out of field");
+            }
+        };
+    }, 0, 1 });
+}
+
+static void addBroadcastCases(std::vector<BenchCase>& cases, FarmServer& server) {
+    const int clientCounts[] = { 1, 8, 64 };
+    std::string state = FarmServerBench::buildStateJson(server);
+    for (int clients : clientCounts) {
+        FarmServer* owner = &server;
+        cases.push_back({ "broadcast/state/" + std::to_string(clients), [owner, clients, state]() -> BenchRun {
+            auto fixture = std::make_shared<BroadcastFixture>(*owner, clients);
+            return [fixture, state](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    fixture->server.broadcastStateUpdate(state);
+                }
+            };
+        }, static_cast<double>((packetHeaderSize(PROTOCOL_VERSION_2) + state.size()) * clients),
+           static_cast<double>(clients) });
+    }
+}
+
+static void addLogCases(std::vector<BenchCase>& cases, FarmServer& server) {
+    const std::string message = "Received command: 0x" + std::to_string(Command::MOVE_CART);
+    FarmServer* owner = &server;
+    cases.push_back({ "log/console", [owner, message]() -> BenchRun {
+        FarmServerBench::setLogFile(*owner, "");
+        return [owner, message](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                FarmServerBench::log(*owner, message, -1);
+            }
+        };
+    }, 0, 1 });
+    cases.push_back({ "log/client", [owner, message]() -> BenchRun {
+        FarmServerBench::setLogFile(*owner, "");
+        socket_t none = INVALID_SOCKET;
+        int clientId = FarmServerBench::attachClient(*owner, none, PROTOCOL_VERSION_2);
+        auto detach = std::shared_ptr<void>(nullptr, [owner, clientId](void*) {
+            FarmServerBench::detachClient(*owner, clientId);
+        });
+        return [owner, message, clientId, detach](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                FarmServerBench::log(*owner, message, clientId);
+            }
+        };
+    }, 0, 1 });
+    cases.push_back({ "log/file", [owner, message]() -> BenchRun {
+        const std::string path = "farm_bench_log.tmp";
+        if (!FarmServerBench::setLogFile(*owner, path)) {
+            std::fprintf(stderr, "cannot open %s\n", path.c_str());
+            std::exit(1);
+        }
+        auto close = std::shared_ptr<void>(nullptr, [owner, path](void*) {
+            FarmServerBench::setLogFile(*owner, "");
+            std::remove(path.c_str());
+        });
+        return [owner, message, close](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                FarmServerBench::log(*owner, message, -1);
+            }
+        };
+    }, 0, 1 });
+}
+
+// ========== 输出 ==========
+
+static void printConsole(FILE* out, const std::vector<BenchResult>& results) {
+    std::fprintf(out, "%-32s %14s %12s %12s %14s %14s\n", "benchmark", "iterations", "median ns",
+                 "min ns", "MB/s", "items/s");
+    for (const BenchResult& r : results) {
+        std::fprintf(out, "%-32s %14llu %12.1f %12.1f ", r.name.c_str(),
+                     static_cast<unsigned long long>(r.iterations), r.medianNs, r.minNs);
+        if (r.bytesPerSecond > 0) {
+            std::fprintf(out, "%14.1f ", r.bytesPerSecond / 1e6);
+        } else {
+            std::fprintf(out, "%14s ", "-");
+        }
+        std::fprintf(out, "%14.0f\n", r.itemsPerSecond);
+    }
+}
+
+static void printCsv(FILE* out, const std::vector<BenchResult>& results) {
+    std::fprintf(out, "name,iterations,repetitions,real_time_ns,min_real_time_ns,bytes_per_second,items_per_second\n");
+    for (const BenchResult& r : results) {
+        std::fprintf(out, "%s,%llu,%d,%.3f,%.3f,%.1f,%.1f\n", r.name.c_str(),
+                     static_cast<unsigned long long>(r.iterations), r.repetitions, r.medianNs,
+                     r.minNs, r.bytesPerSecond, r.itemsPerSecond);
+    }
+}
+
+static void printJson(FILE* out, const std::vector<BenchResult>& results) {
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+#ifdef NDEBUG
+    const char* buildType = "release";
+#else
+    const char* buildType = "debug";
+#endif
+    std::fprintf(out, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": \"farm_bench\",\n"
+                 "    \"platform\": \"%s\",\n    \"num_cpus\": %u,\n    \"library_build_type\": \"%s\"\n  },\n"
+                 "  \"benchmarks\": [\n", date, getPlatformName(),
+                 std::thread::hardware_concurrency(), buildType);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        std::fprintf(out, "    {\"name\": \"%s\", \"run_type\": \"iteration\", \"iterations\": %llu, "
+                     "\"repetitions\": %d, \"real_time\": %.3f, \"cpu_time\": %.3f, "
+                     "\"min_real_time\": %.3f, \"time_unit\": \"ns\"",
+                     jsonEscape(r.name).c_str(), static_cast<unsigned long long>(r.iterations),
+                     r.repetitions, r.medianNs, r.medianNs, r.minNs);
+        if (r.bytesPerSecond > 0) {
+            std::fprintf(out, ", \"bytes_per_second\": %.1f", r.bytesPerSecond);
+        }
+        std::fprintf(out, ", \"items_per_second\": %.1f}%s\n", r.itemsPerSecond,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+static void printUsage() {
+    std::fprintf(stderr,
+                 "usage: farm_bench [--filter substring] [--min-time s] [--repetitions n]\n"
+                 "                  [--format console|json|csv] [--out file]\n");
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string format = "console";
+    std::string outPath;
+    double minTime = 0.2;
+    int repetitions = 3;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--filter") filter = value;
+        else if (arg == "--min-time") minTime = std::atof(value);
+        else if (arg == "--repetitions") repetitions = std::atoi(value);
+        else if (arg == "--format") format = value;
+        else if (arg == "--out") outPath = value;
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (minTime <= 0 || repetitions <= 0 ||
+        (format != "console" && format != "json" && format != "csv")) {
+        printUsage();
+        return 1;
+    }
+
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    initializeNetwork();
+
+    // log()每条都写控制台，测量期间丢弃
+    NullBuffer nullBuffer;
+    std::streambuf* console = std::cout.rdbuf(&nullBuffer);
+
+    {
+        FarmServer server;
+        std::vector<BenchCase> cases;
+        addPacketCases(cases);
+        addReceiveCases(cases, server);
+        addReplyCases(cases, server);
+        addBroadcastCases(cases, server);
+        addLogCases(cases, server);
+
+        std::vector<BenchResult> results;
+        for (const BenchCase& bench : cases) {
+            if (!filter.empty() && bench.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            results.push_back(measure(bench, minTime, repetitions));
+        }
+
+        FILE* out = stdout;
+        if (!outPath.empty()) {
+            out = std::fopen(outPath.c_str(), "w");
+            if (!out) {
+                std::cout.rdbuf(console);
+                std::fprintf(stderr, "cannot write %s\n", outPath.c_str());
+                return 1;
+            }
+        }
+        if (format == "json") {
+            printJson(out, results);
+        } else if (format == "csv") {
+            printCsv(out, results);
+        } else {
+            printConsole(out, results);
+        }
+        if (out != stdout) {
+            std::fclose(out);
+        }
+    }
+
+    std::cout.rdbuf(console);
+    cleanupNetwork();
+    return 0;
+}
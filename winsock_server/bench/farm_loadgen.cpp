@@ -0,0 +1,834 @@
+#include "FarmServer.h"
+#include "socket_compat.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <csignal>
+    #include <ctime>
+    #include <fstream>
+    #include <sys/resource.h>
+#endif
+
+/**
+ * 端到端负载生成器
+ *
+ * 每个生成线程用poll驱动一组非阻塞连接：建立连接、用CONNECT协商协议v2，
+ * 之后每个连接保持depth个在途请求（收到回复后按命令比例发出下一个，可加思考时间）。
+ * 命令比例由--mix给出：
+ *   move   MOVE_CART，每个连接控制一辆小车，目标点在农田内依次变化（移动流）
+ *   state  GET_STATE轮询
+ *   water  BATCH_OPERATION，一次浇batch个格子
+ * 连接全部就绪后开始计时，统计窗口内收到的回复：吞吐、各命令的p50/p99/p999延迟
+ * （从发出到收到FINAL回复）、错误数和服务器推送数。浇水批次中有任何一条失败即记为错误。
+ *
+ * 默认在本进程内启动一个FarmServer（不写日志/快照，控制台日志关闭，能量和种子
+ * 近似无限），服务器CPU为窗口内进程CPU减去生成线程自己的CPU；--port连接已在运行的
+ * 服务器，Linux上可用--server-pid从/proc读取它的CPU。进程内的服务器还输出窗口内
+ * 等待时间最多的加锁处（ProfiledMutex的统计之差）。
+ * 开始前在每个格子上播种，浇水才会成功；小麦约3分钟成熟，更长的运行中浇水会开始失败。
+ * 错误占回复的比例超过--max-error-ratio（默认0.01）时报告警告并以状态2退出，
+ * 这时的数字测的是错误回复的路径。
+ *
+ * 用法: farm_loadgen [--connections n] [--threads n] [--duration s] [--depth n]
+ *                    [--mix move=40,state=40,water=20] [--batch n] [--think-ms n]
+ *                    [--grid n] [--workers n] [--host addr] [--port p] [--server-pid pid]
+ *                    [--max-error-ratio r]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+enum LoadOp {
+    OP_MOVE,
+    OP_STATE,
+    OP_WATER,
+    OP_COUNT
+};
+
+static const char* const OP_NAMES[OP_COUNT] = { "move", "state", "water" };
+static const uint32_t OP_COMMANDS[OP_COUNT] = {
+    Command::MOVE_CART, Command::GET_STATE, Command::BATCH_OPERATION
+};
+
+struct LoadOptions {
+    int connections;
+    int threads;
+    double duration;
+    int depth;
+    int mix[OP_COUNT];
+    int batch;
+    int thinkMs;
+    int grid;
+    int workers;
+    std::string host;
+    int port;               // 0：在本进程内启动服务器
+    int serverPid;
+    double maxErrorRatio;   // 错误占回复的比例超过它时结果无效
+
+    LoadOptions()
+        : connections(1000), threads(4), duration(10.0), depth(1), batch(32), thinkMs(0),
+          grid(100), workers(4), host("127.0.0.1"), port(0), serverPid(0), maxErrorRatio(0.01) {
+        mix[OP_MOVE] = 40;
+        mix[OP_STATE] = 40;
+        mix[OP_WATER] = 20;
+    }
+};
+
+// 生成线程之间共享的阶段标志
+struct LoadControl {
+    std::atomic<int> connected;
+    std::atomic<int> failed;
+    std::atomic<bool> measuring;
+    std::atomic<bool> stop;
+
+    LoadControl() : connected(0), failed(0), measuring(false), stop(false) {}
+};
+
+struct ThreadStats {
+    std::vector<double> latency[OP_COUNT];     // 微秒
+    uint64_t errors[OP_COUNT];
+    uint64_t pushes;
+    double cpuSeconds;                          // 窗口内本线程的CPU时间
+
+    ThreadStats() : pushes(0), cpuSeconds(0.0) {
+        std::fill(errors, errors + OP_COUNT, 0);
+    }
+};
+
+// ========== CPU时间 ==========
+
+static double threadCpuSeconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e7;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+static double processCpuSeconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e7;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+// 其他进程的CPU时间（只支持Linux），读取失败返回负数
+static double externalCpuSeconds(int pid) {
+#if defined(__linux__)
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string content;
+    if (!std::getline(file, content)) {
+        return -1.0;
+    }
+    // 第2项是带括号的进程名，可能含空格，从最后一个')'之后开始数
+    size_t pos = content.rfind(')');
+    if (pos == std::string::npos) {
+        return -1.0;
+    }
+    std::istringstream fields(content.substr(pos + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    for (int i = 3; i <= 15 && fields >> field; i++) {
+        if (i == 14) utime = std::strtoull(field.c_str(), nullptr, 10);
+        if (i == 15) stime = std::strtoull(field.c_str(), nullptr, 10);
+    }
+    return static_cast<double>(utime + stime) / sysconf(_SC_CLK_TCK);
+#else
+    (void)pid;
+    return -1.0;
+#endif
+}
+
+// ========== 连接 ==========
+
+enum class ConnPhase {
+    CONNECTING,
+    HANDSHAKE,      // 已发出CONNECT（v1帧），等待回复
+    RUNNING,
+    CLOSED
+};
+
+struct PendingRequest {
+    uint32_t requestId;
+    LoadOp op;
+    Clock::time_point sentAt;
+};
+
+struct LoadConnection {
+    socket_t socket;
+    int index;
+    ConnPhase phase;
+    std::string out;
+    size_t outOffset;
+    std::string in;
+    uint32_t nextRequestId;
+    std::vector<PendingRequest> pending;
+    Clock::time_point nextSend;
+    uint32_t rng;
+    int moveStep;
+
+    LoadConnection()
+        : socket(INVALID_SOCKET), index(0), phase(ConnPhase::CLOSED), outOffset(0),
+          nextRequestId(1), rng(1), moveStep(0) {}
+};
+
+static uint32_t nextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void appendFrame(std::string& out, uint32_t command, const std::string& data,
+                        uint32_t requestId, bool v2) {
+    PacketHeader header(command, static_cast<uint32_t>(data.size()));
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (v2) {
+        PacketHeaderExt ext;
+        ext.requestId = requestId;
+        out.append(reinterpret_cast<const char*>(&ext), sizeof(ext));
+    }
+    out.append(data);
+}
+
+static LoadOp chooseOp(const LoadOptions& options, uint32_t& rng) {
+    int total = options.mix[OP_MOVE] + options.mix[OP_STATE] + options.mix[OP_WATER];
+    int pick = static_cast<int>(nextRandom(rng) % static_cast<uint32_t>(total));
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (pick < options.mix[op]) {
+            return static_cast<LoadOp>(op);
+        }
+        pick -= options.mix[op];
+    }
+    return OP_STATE;
+}
+
+static std::string buildRequest(const LoadOptions& options, LoadConnection& conn, LoadOp op) {
+    std::ostringstream oss;
+    if (op == OP_MOVE) {
+        // 每个连接一辆小车，目标在农田内沿8个点循环
+        double extent = options.grid * 0.5 * 0.8;
+        int step = conn.moveStep++ % 8;
+        double x = extent * ((step & 1) ? 0.9 : 0.1) + (conn.index % 7);
+        double z = extent * (step / 2) / 4.0 + (conn.index % 5);
+        oss << "{\"cart_id\":" << (conn.index % 4096) << ",\"target_x\":" << x
+            << ",\"target_z\":" << z << "}";
+    } else if (op == OP_WATER) {
+        oss << "{\"ops\":[";
+        for (int i = 0; i < options.batch; i++) {
+            uint32_t cell = nextRandom(conn.rng) % static_cast<uint32_t>(options.grid * options.grid);
+            oss << (i ? "," : "") << "[\"water\"," << cell / options.grid << "," << cell % options.grid << "]";
+        }
+        oss << "]}";
+    } else {
+        oss << "{}";
+    }
+    return oss.str();
+}
+
+// 阻塞地收一个v1回复，返回它的数据部分；连接出错返回false
+static bool receiveReply(socket_t socket, PacketHeader& header, std::string& data) {
+    char* out = reinterpret_cast<char*>(&header);
+    for (size_t got = 0; got < sizeof(header);) {
+        int n = recv(socket, out + got, static_cast<int>(sizeof(header) - got), 0);
+        if (n <= 0) return false;
+        got += static_cast<size_t>(n);
+    }
+    if (header.magic != PROTOCOL_MAGIC || header.length > MAX_PACKET_SIZE) {
+        return false;
+    }
+    data.resize(header.length);
+    for (size_t got = 0; got < data.size();) {
+        int n = recv(socket, &data[got], static_cast<int>(data.size() - got), 0);
+        if (n <= 0) return false;
+        got += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 压测前在每个格子上播种（小麦），浇水才有植物可浇；返回播种成功的格子数，连接失败返回-1
+static int plantField(const LoadOptions& options) {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr);
+    socket_t sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!isValidSocket(sock) ||
+        connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        safeCloseSocket(sock);
+        return -1;
+    }
+
+    const int BLOCK = 1024;     // 一次批量的条数，回复不超过v1的包长
+    PacketHeader header;
+    std::string out;
+    std::string reply;
+    appendFrame(out, Command::CONNECT, "{\"client_name\":\"farm_loadgen\"}", 0, false);
+    bool ok = send(sock, out.data(), static_cast<int>(out.size()), 0) == static_cast<int>(out.size()) &&
+              receiveReply(sock, header, reply);
+    int cells = options.grid * options.grid;
+    int planted = 0;
+    for (int first = 0; ok && first < cells; first += BLOCK) {
+        std::ostringstream oss;
+        oss << "{\"ops\":[";
+        for (int cell = first; cell < std::min(cells, first + BLOCK); cell++) {
+            oss << (cell > first ? "," : "") << "[\"sow\"," << cell / options.grid << "," << cell % options.grid << "]";
+        }
+        oss << "]}";
+        out.clear();
+        appendFrame(out, Command::BATCH_OPERATION, oss.str(), 0, false);
+        ok = send(sock, out.data(), static_cast<int>(out.size()), 0) == static_cast<int>(out.size()) &&
+             receiveReply(sock, header, reply);
+        if (ok && header.command == Response::SUCCESS) {
+            std::string::size_type pos = reply.find("\"succeeded\":");
+            if (pos != std::string::npos) {
+                planted += std::atoi(reply.c_str() + pos + 12);
+            }
+        }
+    }
+    safeCloseSocket(sock);
+    return ok ? planted : -1;
+}
+
+static void closeConnection(LoadConnection& conn) {
+    if (conn.phase != ConnPhase::CLOSED) {
+        safeCloseSocket(conn.socket);
+        conn.phase = ConnPhase::CLOSED;
+    }
+}
+
+static bool flushOutput(LoadConnection& conn) {
+    while (conn.outOffset < conn.out.size()) {
+        int sent = send(conn.socket, conn.out.data() + conn.outOffset,
+                        static_cast<int>(conn.out.size() - conn.outOffset), 0);
+        if (sent <= 0) {
+            return sent < 0 && isWouldBlock(SOCKET_ERROR_CODE);
+        }
+        conn.outOffset += static_cast<size_t>(sent);
+    }
+    conn.out.clear();
+    conn.outOffset = 0;
+    return true;
+}
+
+// 批量操作的SUCCESS回复中"failed"不为0（只有批量回复带这个字段）
+static bool batchHadFailures(const std::string& in, size_t offset, size_t length) {
+    static const char KEY[] = "\"failed\":";
+    std::string::size_type pos = in.find(KEY, offset);
+    if (pos == std::string::npos || pos >= offset + length) {
+        return false;
+    }
+    return std::atoi(in.c_str() + pos + sizeof(KEY) - 1) > 0;
+}
+
+// 解析收到的完整帧；返回false表示连接出错
+static bool processInput(LoadConnection& conn, LoadControl& control, ThreadStats& stats) {
+    size_t offset = 0;
+    bool ok = true;
+    while (ok) {
+        bool v2 = conn.phase == ConnPhase::RUNNING;
+        size_t headerSize = packetHeaderSize(v2 ? PROTOCOL_VERSION_2 : PROTOCOL_VERSION_1);
+        if (conn.in.size() - offset < headerSize) {
+            break;
+        }
+        PacketHeader header;
+        std::memcpy(&header, conn.in.data() + offset, sizeof(header));
+        if (header.magic != PROTOCOL_MAGIC || header.length > MAX_PACKET_SIZE) {
+            ok = false;
+            break;
+        }
+        if (conn.in.size() - offset < headerSize + header.length) {
+            break;
+        }
+        PacketHeaderExt ext;
+        if (v2) {
+            std::memcpy(&ext, conn.in.data() + offset + sizeof(header), sizeof(ext));
+        }
+        offset += headerSize + header.length;
+
+        if (conn.phase == ConnPhase::HANDSHAKE) {
+            if (header.command == Response::SUCCESS) {
+                conn.phase = ConnPhase::RUNNING;     // 之后的帧都是v2
+                control.connected++;
+            } else if (header.command == Response::ERROR) {
+                ok = false;
+            }
+            continue;
+        }
+        if (!(ext.flags & PacketFlag::RESPONSE)) {
+            if (control.measuring.load(std::memory_order_relaxed)) {
+                stats.pushes++;
+            }
+            continue;
+        }
+        if (!(ext.flags & PacketFlag::FINAL) || (ext.flags & PacketFlag::MORE)) {
+            continue;
+        }
+        auto it = std::find_if(conn.pending.begin(), conn.pending.end(),
+                               [&](const PendingRequest& p) { return p.requestId == ext.requestId; });
+        if (it == conn.pending.end()) {
+            continue;
+        }
+        if (control.measuring.load(std::memory_order_relaxed)) {
+            double micros = std::chrono::duration<double, std::micro>(Clock::now() - it->sentAt).count();
+            stats.latency[it->op].push_back(micros);
+            if (header.command == Response::ERROR || batchHadFailures(conn.in, offset - header.length, header.length)) {
+                stats.errors[it->op]++;
+            }
+        }
+        conn.pending.erase(it);
+    }
+    conn.in.erase(0, offset);
+    return ok;
+}
+
+static void loadThread(const LoadOptions& options, int first, int count, LoadControl& control,
+                       ThreadStats& stats) {
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr);
+
+    std::vector<LoadConnection> conns(count);
+    for (int i = 0; i < count; i++) {
+        LoadConnection& conn = conns[i];
+        conn.index = first + i;
+        conn.rng = 2463534242u ^ static_cast<uint32_t>(conn.index * 2654435761u);
+        if (conn.rng == 0) conn.rng = 1;
+        conn.socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (!isValidSocket(conn.socket) || !setNonBlocking(conn.socket)) {
+            safeCloseSocket(conn.socket);
+            control.failed++;
+            continue;
+        }
+        setTcpNoDelay(conn.socket, true);
+        conn.phase = ConnPhase::CONNECTING;
+        if (connect(conn.socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR &&
+            !isWouldBlock(SOCKET_ERROR_CODE)) {
+            closeConnection(conn);
+            control.failed++;
+        }
+    }
+
+    std::vector<pollfd> fds(count);
+    std::vector<char> buffer(65536);
+    bool measuring = false;
+    double cpuStart = 0.0;
+
+    while (!control.stop.load(std::memory_order_relaxed)) {
+        bool nowMeasuring = control.measuring.load(std::memory_order_relaxed);
+        if (nowMeasuring != measuring) {
+            if (nowMeasuring) {
+                cpuStart = threadCpuSeconds();
+            } else {
+                stats.cpuSeconds = threadCpuSeconds() - cpuStart;
+            }
+            measuring = nowMeasuring;
+        }
+
+        // 补足在途请求
+        Clock::time_point now = Clock::now();
+        for (LoadConnection& conn : conns) {
+            if (conn.phase != ConnPhase::RUNNING) {
+                continue;
+            }
+            bool queued = false;
+            while (static_cast<int>(conn.pending.size()) < options.depth && now >= conn.nextSend) {
+                LoadOp op = chooseOp(options, conn.rng);
+                uint32_t requestId = conn.nextRequestId++;
+                appendFrame(conn.out, OP_COMMANDS[op], buildRequest(options, conn, op), requestId, true);
+                conn.pending.push_back(PendingRequest{requestId, op, now});
+                if (options.thinkMs > 0) {
+                    conn.nextSend = now + std::chrono::milliseconds(options.thinkMs);
+                }
+                queued = true;
+            }
+            if (queued && !flushOutput(conn)) {
+                closeConnection(conn);
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            const LoadConnection& conn = conns[i];
+            fds[i].fd = conn.socket;
+            fds[i].revents = 0;
+            if (conn.phase == ConnPhase::CLOSED) {
+                fds[i].fd = INVALID_SOCKET;     // poll忽略负的描述符
+                fds[i].events = 0;
+            } else if (conn.phase == ConnPhase::CONNECTING) {
+                fds[i].events = POLLOUT;
+            } else {
+                fds[i].events = static_cast<short>(POLLIN | (conn.out.empty() ? 0 : POLLOUT));
+            }
+        }
+        int timeoutMs = options.thinkMs > 0 ? 1 : 10;
+        if (pollSockets(fds.data(), fds.size(), timeoutMs) <= 0) {
+            continue;
+        }
+
+        for (int i = 0; i < count; i++) {
+            LoadConnection& conn = conns[i];
+            short revents = fds[i].revents;
+            if (revents == 0 || conn.phase == ConnPhase::CLOSED) {
+                continue;
+            }
+            if (conn.phase == ConnPhase::CONNECTING) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(conn.socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length);
+                if (error != 0 || (revents & (POLLERR | POLLHUP))) {
+                    closeConnection(conn);
+                    control.failed++;
+                    continue;
+                }
+                conn.phase = ConnPhase::HANDSHAKE;
+                std::string hello = "{\"client_name\":\"loadgen-" + std::to_string(conn.index) +
+                                    "\",\"version\":\"1.0\",\"protocol_version\":2}";
+                appendFrame(conn.out, Command::CONNECT, hello, 0, false);
+                if (!flushOutput(conn)) {
+                    closeConnection(conn);
+                    control.failed++;
+                }
+                continue;
+            }
+            if (revents & POLLIN) {
+                bool alive = true;
+                while (alive) {
+                    int received = recv(conn.socket, buffer.data(), static_cast<int>(buffer.size()), 0);
+                    if (received > 0) {
+                        conn.in.append(buffer.data(), static_cast<size_t>(received));
+                        continue;
+                    }
+                    alive = received < 0 && isWouldBlock(SOCKET_ERROR_CODE);
+                    break;
+                }
+                if (!processInput(conn, control, stats) || !alive) {
+                    if (conn.phase == ConnPhase::HANDSHAKE) {
+                        control.failed++;
+                    }
+                    closeConnection(conn);
+                    continue;
+                }
+            } else if (revents & (POLLERR | POLLHUP)) {
+                closeConnection(conn);
+                continue;
+            }
+            if ((revents & POLLOUT) && !flushOutput(conn)) {
+                closeConnection(conn);
+            }
+        }
+    }
+
+    if (measuring) {
+        stats.cpuSeconds = threadCpuSeconds() - cpuStart;
+    }
+    for (LoadConnection& conn : conns) {
+        closeConnection(conn);
+    }
+}
+
+// ========== 报告 ==========
+
+static double percentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void printRow(const char* name, std::vector<double>& micros, uint64_t errors, double seconds) {
+    if (micros.empty()) {
+        return;
+    }
+    double maxValue = *std::max_element(micros.begin(), micros.end());
+    std::printf("%-8s %10zu %11.0f %8llu %9.1f %9.1f %9.1f %10.1f\n", name, micros.size(),
+                micros.size() / seconds, static_cast<unsigned long long>(errors),
+                percentile(micros, 0.50), percentile(micros, 0.99), percentile(micros, 0.999), maxValue);
+}
+
+static bool parseMix(const std::string& text, int mix[OP_COUNT]) {
+    std::fill(mix, mix + OP_COUNT, 0);
+    std::istringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            return false;
+        }
+        std::string name = item.substr(0, eq);
+        int weight = std::atoi(item.c_str() + eq + 1);
+        auto it = std::find_if(OP_NAMES, OP_NAMES + OP_COUNT,
+                               [&](const char* n) { return name == n; });
+        if (it == OP_NAMES + OP_COUNT || weight < 0) {
+            return false;
+        }
+        mix[it - OP_NAMES] = weight;
+    }
+    return mix[OP_MOVE] + mix[OP_STATE] + mix[OP_WATER] > 0;
+}
+
+static void printUsage() {
+    std::fprintf(stderr,
+                 "usage: farm_loadgen [--connections n] [--threads n] [--duration s] [--depth n]\n"
+                 "                    [--mix move=40,state=40,water=20] [--batch n] [--think-ms n]\n"
+                 "                    [--grid n] [--workers n] [--host addr] [--port p] [--server-pid pid]\n"
+                 "                    [--max-error-ratio r]\n");
+}
+
+// 丢弃所有输出（关闭进程内服务器的控制台日志）
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    std::string mixText = "move=40,state=40,water=20";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--connections") options.connections = std::atoi(value);
+        else if (arg == "--threads") options.threads = std::atoi(value);
+        else if (arg == "--duration") options.duration = std::atof(value);
+        else if (arg == "--depth") options.depth = std::atoi(value);
+        else if (arg == "--mix") mixText = value;
+        else if (arg == "--batch") options.batch = std::atoi(value);
+        else if (arg == "--think-ms") options.thinkMs = std::atoi(value);
+        else if (arg == "--grid") options.grid = std::atoi(value);
+        else if (arg == "--workers") options.workers = std::atoi(value);
+        else if (arg == "--host") options.host = value;
+        else if (arg == "--port") options.port = std::atoi(value);
+        else if (arg == "--server-pid") options.serverPid = std::atoi(value);
+        else if (arg == "--max-error-ratio") options.maxErrorRatio = std::atof(value);
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (!parseMix(mixText, options.mix) || options.connections <= 0 || options.threads <= 0 ||
+        options.depth <= 0 || options.batch <= 0 || options.grid <= 0 || options.duration <= 0) {
+        printUsage();
+        return 1;
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+    // 每个连接在进程内服务器模式下占两个描述符
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+    initializeNetwork();
+
+    NullBuffer nullBuffer;
+    std::streambuf* console = nullptr;
+    std::unique_ptr<FarmServer> server;
+    if (options.port == 0) {
+        // 本进程内的服务器，只用于压测
+        ServerConfig config;
+        config.port = 18888;
+        config.maxClients = options.connections + 16;
+        config.enableLogging = false;
+        config.journalPath = "";
+        config.snapshotPath = "";
+        config.gridSize = options.grid;
+        config.workerThreads = options.workers;
+        config.maxInFlight = std::max(config.maxInFlight, options.depth);
+        // 能量和种子近似无限，测的是命令本身而不是"能量不足"的错误回复
+        config.initialEnergy = 1e9;
+        config.maxEnergy = 1e9;
+        config.energyRegen = 1e6;
+        config.initialSeeds = options.grid * options.grid;
+        console = std::cout.rdbuf(&nullBuffer);
+        server.reset(new FarmServer());
+        if (!server->start(config)) {
+            std::cout.rdbuf(console);
+            std::fprintf(stderr, "Failed to start the in-process server on port %d\n", config.port);
+            return 1;
+        }
+        options.port = config.port;
+        options.host = "127.0.0.1";
+    }
+
+    std::printf("%d connections to %s:%d%s, %d threads, depth %d, mix %s, batch %d, think %d ms\n",
+                options.connections, options.host.c_str(), options.port,
+                server ? " (in-process server)" : "", options.threads, options.depth, mixText.c_str(),
+                options.batch, options.thinkMs);
+
+    if (options.mix[OP_WATER] > 0) {
+        int planted = plantField(options);
+        if (planted < 0) {
+            std::fprintf(stderr, "Failed to plant the field before the run\n");
+        } else {
+            std::printf("planted %d of %d cells\n", planted, options.grid * options.grid);
+        }
+    }
+
+    LoadControl control;
+    std::vector<ThreadStats> stats(options.threads);
+    std::vector<std::thread> threads;
+    int perThread = options.connections / options.threads;
+    int extra = options.connections % options.threads;
+    int first = 0;
+    Clock::time_point connectStarted = Clock::now();
+    for (int t = 0; t < options.threads; t++) {
+        int count = perThread + (t < extra ? 1 : 0);
+        threads.emplace_back(loadThread, std::cref(options), first, count, std::ref(control),
+                             std::ref(stats[t]));
+        first += count;
+    }
+
+    // 等所有连接完成握手（最多30秒）
+    while (control.connected + control.failed < options.connections &&
+           Clock::now() - connectStarted < std::chrono::seconds(30)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double connectSeconds = std::chrono::duration<double>(Clock::now() - connectStarted).count();
+    std::printf("connected %d, failed %d in %.2f s\n", control.connected.load(), control.failed.load(),
+                connectSeconds);
+    if (control.connected == 0) {
+        control.stop = true;
+        for (auto& thread : threads) thread.join();
+        if (server) {
+            server->stop();
+            std::cout.rdbuf(console);
+        }
+        return 1;
+    }
+
+    std::map<std::string, LockSiteStats> locksBefore;
+    for (const LockSiteStats& site : lockProfile()) {
+        locksBefore[site.lock + " " + site.site] = site;
+    }
+    double serverCpuStart = server ? processCpuSeconds() : externalCpuSeconds(options.serverPid);
+    Clock::time_point windowStarted = Clock::now();
+    control.measuring = true;
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    control.measuring = false;
+    double seconds = std::chrono::duration<double>(Clock::now() - windowStarted).count();
+    double serverCpuEnd = server ? processCpuSeconds() : externalCpuSeconds(options.serverPid);
+    std::vector<LockSiteStats> locks = lockProfile();
+
+    // 让生成线程记下窗口结束时的CPU时间
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    control.stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (server) {
+        server->stop();
+        std::cout.rdbuf(console);
+    }
+
+    std::vector<double> all;
+    std::vector<double> byOp[OP_COUNT];
+    uint64_t errors[OP_COUNT] = {};
+    uint64_t pushes = 0;
+    double clientCpu = 0.0;
+    for (ThreadStats& s : stats) {
+        for (int op = 0; op < OP_COUNT; op++) {
+            byOp[op].insert(byOp[op].end(), s.latency[op].begin(), s.latency[op].end());
+            errors[op] += s.errors[op];
+        }
+        pushes += s.pushes;
+        clientCpu += s.cpuSeconds;
+    }
+    uint64_t totalErrors = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        all.insert(all.end(), byOp[op].begin(), byOp[op].end());
+        totalErrors += errors[op];
+    }
+
+    std::printf("\nwindow %.2f s: %zu responses, %.0f responses/s, %.0f pushes/s\n", seconds, all.size(),
+                all.size() / seconds, pushes / seconds);
+    std::printf("%-8s %10s %11s %8s %9s %9s %9s %10s\n", "op (us)", "count", "per second", "errors",
+                "p50", "p99", "p999", "max");
+    for (int op = 0; op < OP_COUNT; op++) {
+        printRow(OP_NAMES[op], byOp[op], errors[op], seconds);
+    }
+    printRow("all", all, totalErrors, seconds);
+
+    if (serverCpuStart >= 0.0 && serverCpuEnd >= 0.0) {
+        double serverCpu = serverCpuEnd - serverCpuStart - (server ? clientCpu : 0.0);
+        std::printf("\nserver CPU: %.2f s (%.0f%% of one core)", serverCpu, 100.0 * serverCpu / seconds);
+    } else {
+        std::printf("\nserver CPU: n/a (pass --server-pid on Linux)");
+    }
+    std::printf(", load generator CPU: %.2f s\n", clientCpu);
+
+    // 窗口内的锁统计（最大值是整个运行的）
+    if (server) {
+        for (LockSiteStats& site : locks) {
+            auto it = locksBefore.find(site.lock + " " + site.site);
+            if (it != locksBefore.end()) {
+                site.acquisitions -= it->second.acquisitions;
+                site.contended -= it->second.contended;
+                site.waitNs -= it->second.waitNs;
+                site.holdNs -= it->second.holdNs;
+            }
+        }
+        std::sort(locks.begin(), locks.end(), [](const LockSiteStats& a, const LockSiteStats& b) {
+            return a.waitNs > b.waitNs;
+        });
+        std::printf("\n%-14s %-28s %10s %10s %9s %9s\n", "lock", "site", "acquired", "contended",
+                    "wait ms", "hold ms");
+        for (size_t i = 0; i < locks.size() && i < 8; i++) {
+            const LockSiteStats& site = locks[i];
+            std::printf("%-14s %-28s %10llu %10llu %9.1f %9.1f\n", site.lock.c_str(), site.site.c_str(),
+                        static_cast<unsigned long long>(site.acquisitions),
+                        static_cast<unsigned long long>(site.contended), site.waitNs / 1e6,
+                        site.holdNs / 1e6);
+        }
+    }
+    cleanupNetwork();
+
+    double errorRatio = all.empty() ? 0.0 : static_cast<double>(totalErrors) / all.size();
+    if (errorRatio > options.maxErrorRatio) {
+        std::fprintf(stderr, "\nwarning: %.1f%% of the responses were errors (limit %.1f%%), "
+                     "the numbers above mostly measure error replies\n",
+                     100.0 * errorRatio, 100.0 * options.maxErrorRatio);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "FarmServer.h"
+#include "CaptureFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 抓包回放（录制-回放回归基准）
+ *
+ * 读取服务器用--capture录制的文件，在进程内启动一个FarmServer（农田尺寸取自
+ * 抓包，不写日志/抓包），把每个包交给replayPacket，走与读线程相同的
+ * handleCommand路径。每一遍先恢复录制开始时写下的起始快照（<capture>.snapshot），
+ * 账本能量取自文件头；农田时钟固定在录制开始的时刻，每个包之前推进到它的
+ * 录制时间戳，生长、缺水和能量恢复都按录制时的时间计算，与回放快慢无关。
+ * 小车移动和自动耕作会话仍按真实时间推进。
+ *
+ * 客户端按ID分到各回放线程，同一客户端的包保持原来的顺序；多个线程共用一个
+ * 农田时钟，不同客户端之间的交错取决于调度，--threads 1 的回放完全确定。
+ *   --speed 1    按录制时的节奏发出（2为两倍速）；0为尽快回放（默认）
+ * 输出总吞吐、每个命令的处理时间分位数（p50/p90/p99/p999/max），以及按命令
+ * 类型的分解。回复发往不存在的连接，被直接丢弃，不计网络开销；服务器的控制台
+ * 日志（std::cout）被关掉，报告用printf输出。
+ *
+ * 用法: farm_replay <capture> [--speed x] [--threads n] [--repeat n]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+// 丢弃所有输出
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+struct Sample {
+    uint32_t command;
+    double micros;      // 处理时间
+    double lagMicros;   // 定速回放时实际发出比计划晚多少
+};
+
+static double percentile(std::vector<double>& values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void printRow(const std::string& name, std::vector<double>& micros, double seconds) {
+    if (micros.empty()) {
+        return;
+    }
+    double total = 0.0;
+    for (double value : micros) {
+        total += value;
+    }
+    double maxValue = *std::max_element(micros.begin(), micros.end());
+    std::printf("%-18s %9zu %11.0f %8.1f %8.1f %8.1f %8.1f %8.1f %9.1f\n", name.c_str(),
+                micros.size(), micros.size() / seconds, total / micros.size(),
+                percentile(micros, 0.50), percentile(micros, 0.90), percentile(micros, 0.99),
+                percentile(micros, 0.999), maxValue);
+}
+
+static void replayShard(FarmServer& server, const std::vector<const CaptureRecord*>& records,
+                        double speed, double farmStart, Clock::time_point started,
+                        std::vector<Sample>& samples) {
+    std::map<int, std::unique_ptr<StreamSink>> uploads;
+    samples.reserve(records.size());
+    for (const CaptureRecord* record : records) {
+        double lag = 0.0;
+        if (speed > 0.0) {
+            Clock::time_point due = started + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::micro>(record->offsetUs / speed));
+            std::this_thread::sleep_until(due);
+            lag = std::chrono::duration<double, std::micro>(Clock::now() - due).count();
+        }
+
+        Packet packet(record->command, record->data);
+        packet.ext.requestId = record->requestId;
+        packet.ext.flags = record->flags;
+
+        advanceFarmClock(farmStart + record->offsetUs / 1e6);
+        Clock::time_point begin = Clock::now();
+        server.replayPacket(record->clientId, packet, uploads[record->clientId]);
+        double micros = std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+        samples.push_back(Sample{record->command, micros, lag});
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: farm_replay <capture> [--speed x] [--threads n] [--repeat n]\n");
+        return 1;
+    }
+    std::string path = argv[1];
+    double speed = 0.0;
+    int threads = 4;
+    int repeat = 1;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--speed") == 0) {
+            speed = std::atof(argv[i + 1]);
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            threads = std::max(1, std::atoi(argv[i + 1]));
+        } else if (std::strcmp(argv[i], "--repeat") == 0) {
+            repeat = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
+
+    CaptureReader reader;
+    std::string error;
+    if (!reader.open(path, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::vector<CaptureRecord> records;
+    CaptureRecord record;
+    while (reader.next(record)) {
+        records.push_back(record);
+    }
+    reader.close();
+    if (records.empty()) {
+        std::fprintf(stderr, "%s contains no requests\n", path.c_str());
+        return 1;
+    }
+
+    // 同一客户端的包落在同一个线程上
+    std::vector<std::vector<const CaptureRecord*>> shards(threads);
+    std::map<int, int> clients;
+    for (const CaptureRecord& r : records) {
+        auto it = clients.find(r.clientId);
+        if (it == clients.end()) {
+            it = clients.emplace(r.clientId, static_cast<int>(clients.size()) % threads).first;
+        }
+        shards[it->second].push_back(&r);
+    }
+
+    double recordedSeconds = records.back().offsetUs / 1e6;
+    std::printf("%s: %zu requests from %zu clients over %.1f s, field %dx%d\n", path.c_str(),
+                records.size(), clients.size(), recordedSeconds, reader.rows(), reader.cols());
+    if (speed > 0.0) {
+        std::printf("replay: %gx recorded speed, %d threads, %d pass(es)\n\n", speed, threads, repeat);
+    } else {
+        std::printf("replay: as fast as possible, %d threads, %d pass(es)\n\n", threads, repeat);
+    }
+
+    // 起始快照每一遍拷贝一份再恢复，服务器停止时会覆盖它
+    std::string startSnapshot = captureSnapshotPath(path);
+    std::string passSnapshot = startSnapshot + ".replay";
+    if (!std::ifstream(startSnapshot, std::ios::binary)) {
+        std::fprintf(stderr, "%s is missing, the replay cannot restore the recorded start state\n",
+                     startSnapshot.c_str());
+        return 1;
+    }
+    const CaptureOrigin& origin = reader.origin();
+
+    NullBuffer nullBuffer;
+    std::streambuf* console = std::cout.rdbuf(&nullBuffer);
+
+    for (int pass = 0; pass < repeat; pass++) {
+        // 每一遍都从录制开始时的农田开始
+        {
+            std::ifstream in(startSnapshot, std::ios::binary);
+            std::ofstream out(passSnapshot, std::ios::binary | std::ios::trunc);
+            out << in.rdbuf();
+        }
+        ServerConfig config;
+        config.port = 0;                // 不接受连接，绑定任意端口
+        config.enableLogging = false;
+        config.heartbeatInterval = 0;
+        config.journalPath = "";
+        config.snapshotPath = passSnapshot;
+        config.snapshotInterval = 0;
+        config.capturePath = "";
+        config.gridSize = reader.rows() > 0 ? reader.rows() : config.gridSize;
+        config.initialEnergy = origin.energy;
+        config.maxEnergy = origin.maxEnergy;
+        config.energyRegen = origin.energyRegen;
+        resetFarmClock();
+        advanceFarmClock(origin.farmClock);
+        FarmServer server;
+        if (!server.start(config)) {
+            std::cout.rdbuf(console);
+            resetFarmClock();
+            std::remove(passSnapshot.c_str());
+            std::fprintf(stderr, "Failed to start the replay server\n");
+            return 1;
+        }
+
+        std::vector<std::vector<Sample>> samples(threads);
+        std::vector<std::thread> workers;
+        Clock::time_point started = Clock::now();
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back(replayShard, std::ref(server), std::cref(shards[t]), speed,
+                                 origin.farmClock, started, std::ref(samples[t]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        server.stop();
+        resetFarmClock();
+        std::remove(passSnapshot.c_str());
+
+        std::vector<double> all;
+        std::vector<double> lags;
+        std::map<uint32_t, std::vector<double>> byCommand;
+        for (auto& shard : samples) {
+            for (const Sample& sample : shard) {
+                all.push_back(sample.micros);
+                lags.push_back(sample.lagMicros);
+                byCommand[sample.command].push_back(sample.micros);
+            }
+        }
+
+        std::printf("pass %d: %.3f s, %.0f requests/s\n", pass + 1, seconds, all.size() / seconds);
+        std::printf("%-18s %9s %11s %8s %8s %8s %8s %8s %9s\n", "command (us)", "count", "per second",
+                    "mean", "p50", "p90", "p99", "p999", "max");
+        printRow("all", all, seconds);
+        for (auto& entry : byCommand) {
+            printRow(commandToString(entry.first), entry.second, seconds);
+        }
+        if (speed > 0.0) {
+            std::printf("schedule lag: p50 %.1f us, p99 %.1f us\n", percentile(lags, 0.50),
+                        percentile(lags, 0.99));
+        }
+        std::printf("\n");
+    }
+    std::cout.rdbuf(console);
+    return 0;
+}
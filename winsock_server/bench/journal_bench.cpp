@@ -0,0 +1,109 @@
+#include "Journal.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 预写日志基准测试
+ *
+ * 多个线程模拟并发的命令处理：每条命令append一条记录，再像服务器回复前那样
+ * waitDurable。分别在三种持久性设置下输出每秒命令数、fdatasync次数和
+ * 平均每次同步提交的记录数（组提交的效果），最后测一次启动回放的速度。
+ * 日志写在当前目录的临时文件里，结束后删除。
+ *
+ * 用法: journal_bench [commands_per_thread] [threads] [interval_ms]
+ */
+
+static const int ROWS = 300;
+static const int COLS = 300;
+
+struct BenchResult {
+    double seconds;
+    JournalStats stats;
+};
+
+static bool runMode(const std::string& path, JournalDurability durability, int threads,
+                    int perThread, int intervalMs, BenchResult& result) {
+    std::remove(path.c_str());
+    Journal journal;
+    std::string error;
+    if (!journal.open(path, ROWS, COLS, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+    journal.start(durability, intervalMs);
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&journal, t, perThread] {
+            for (int i = 0; i < perThread; i++) {
+                int cell = (t * perThread + i) % (ROWS * COLS);
+                JournalRecord record(JournalRecordType::WATER, 0, cell / COLS, cell % COLS,
+                                     static_cast<double>(i));
+                journal.waitDurable(journal.append(record));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    journal.close();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    result.stats = journal.stats();
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int perThread = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 8;
+    int intervalMs = argc > 3 ? std::atoi(argv[3]) : 10;
+    if (perThread <= 0 || threads <= 0) {
+        std::fprintf(stderr, "usage: journal_bench [commands_per_thread] [threads] [interval_ms]\n");
+        return 1;
+    }
+    const std::string path = "journal_bench.tmp";
+
+    std::printf("%d threads x %d commands, interval %d ms\n\n", threads, perThread, intervalMs);
+    std::printf("%-10s %12s %10s %10s %14s\n", "durability", "commands/s", "batches", "syncs",
+                "records/sync");
+
+    const JournalDurability modes[] = {
+        JournalDurability::NONE, JournalDurability::INTERVAL, JournalDurability::SYNC
+    };
+    for (JournalDurability mode : modes) {
+        BenchResult result;
+        if (!runMode(path, mode, threads, perThread, intervalMs, result)) {
+            return 1;
+        }
+        double perSync = result.stats.syncs > 0
+            ? static_cast<double>(result.stats.records) / result.stats.syncs : 0.0;
+        std::printf("%-10s %12.0f %10llu %10llu %14.1f\n", journalDurabilityToString(mode),
+                    result.stats.records / result.seconds,
+                    static_cast<unsigned long long>(result.stats.batches),
+                    static_cast<unsigned long long>(result.stats.syncs), perSync);
+    }
+
+    // 回放最后一次（SYNC）写下的日志
+    Journal journal;
+    std::string error;
+    if (!journal.open(path, ROWS, COLS, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    size_t checksum = 0;
+    auto started = std::chrono::steady_clock::now();
+    size_t replayed = journal.replay([&checksum](const JournalRecord& record) {
+        checksum += static_cast<size_t>(record.row * COLS + record.col);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    journal.close();
+    std::remove(path.c_str());
+
+    std::printf("\nreplay: %zu records in %.1f ms (%.0f records/s, checksum %zu)\n",
+                replayed, seconds * 1000.0, replayed / seconds, checksum);
+    return 0;
+}
@@ -0,0 +1,241 @@
+#include "json_util.h"
+#include <cstdlib>
+#include <cstdio>
+
+// 递归下降解析器
+class JsonParser {
+public:
+    JsonParser(const std::string& text) : m_text(text), m_pos(0), m_depth(0) {}
+
+    bool parseDocument(JsonValue& out) {
+        if (!parseValue(out)) return false;
+        skipSpace();
+        return m_pos == m_text.size();
+    }
+
+private:
+    const std::string& m_text;
+    size_t m_pos;
+    int m_depth;
+
+    static const int MAX_DEPTH = 64;
+
+    void skipSpace() {
+        while (m_pos < m_text.size()) {
+            char c = m_text[m_pos];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+            m_pos++;
+        }
+    }
+
+    bool match(const char* literal) {
+        size_t i = 0;
+        while (literal[i]) {
+            if (m_pos + i >= m_text.size() || m_text[m_pos + i] != literal[i]) return false;
+            i++;
+        }
+        m_pos += i;
+        return true;
+    }
+
+    bool parseValue(JsonValue& out) {
+        skipSpace();
+        if (m_pos >= m_text.size()) return false;
+
+        char c = m_text[m_pos];
+        switch (c) {
+            case '{': return parseObject(out);
+            case '[': return parseArray(out);
+            case '"':
+                out.m_type = JsonValue::Type::STRING;
+                return parseString(out.m_string);
+            case 't':
+                if (!match("true")) return false;
+                out.m_type = JsonValue::Type::BOOLEAN;
+                out.m_bool = true;
+                return true;
+            case 'f':
+                if (!match("false")) return false;
+                out.m_type = JsonValue::Type::BOOLEAN;
+                out.m_bool = false;
+                return true;
+            case 'n':
+                if (!match("null")) return false;
+                out.m_type = JsonValue::Type::NUL;
+                return true;
+            default:
+                return parseNumber(out);
+        }
+    }
+
+    bool parseNumber(JsonValue& out) {
+        const char* begin = m_text.c_str() + m_pos;
+        char* end = nullptr;
+        double value = strtod(begin, &end);
+        if (end == begin) return false;
+        m_pos += static_cast<size_t>(end - begin);
+        out.m_type = JsonValue::Type::NUMBER;
+        out.m_number = value;
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        m_pos++;  // 跳过起始引号
+        out.clear();
+        while (m_pos < m_text.size()) {
+            char c = m_text[m_pos++];
+            if (c == '"') return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (m_pos >= m_text.size()) return false;
+            char esc = m_text[m_pos++];
+            switch (esc) {
+                case '"':  out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/':  out += '/'; break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+                case 'u': {
+                    if (m_pos + 4 > m_text.size()) return false;
+                    unsigned code = static_cast<unsigned>(
+                        strtoul(m_text.substr(m_pos, 4).c_str(), nullptr, 16));
+                    m_pos += 4;
+                    // 编码为UTF-8（不处理代理对）
+                    if (code < 0x80) {
+                        out += static_cast<char>(code);
+                    } else if (code < 0x800) {
+                        out += static_cast<char>(0xC0 | (code >> 6));
+                        out += static_cast<char>(0x80 | (code & 0x3F));
+                    } else {
+                        out += static_cast<char>(0xE0 | (code >> 12));
+                        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;  // 缺少结束引号
+    }
+
+    bool parseArray(JsonValue& out) {
+        if (++m_depth > MAX_DEPTH) return false;
+        m_pos++;  // '['
+        out.m_type = JsonValue::Type::ARRAY;
+        skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == ']') {
+            m_pos++;
+            m_depth--;
+            return true;
+        }
+        while (true) {
+            out.m_items.emplace_back();
+            if (!parseValue(out.m_items.back())) return false;
+            skipSpace();
+            if (m_pos >= m_text.size()) return false;
+            char c = m_text[m_pos++];
+            if (c == ']') break;
+            if (c != ',') return false;
+        }
+        m_depth--;
+        return true;
+    }
+
+    bool parseObject(JsonValue& out) {
+        if (++m_depth > MAX_DEPTH) return false;
+        m_pos++;  // '{'
+        out.m_type = JsonValue::Type::OBJECT;
+        skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == '}') {
+            m_pos++;
+            m_depth--;
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            if (m_pos >= m_text.size() || m_text[m_pos] != '"') return false;
+            std::string key;
+            if (!parseString(key)) return false;
+            skipSpace();
+            if (m_pos >= m_text.size() || m_text[m_pos] != ':') return false;
+            m_pos++;
+            out.m_members.emplace_back(key, JsonValue());
+            if (!parseValue(out.m_members.back().second)) return false;
+            skipSpace();
+            if (m_pos >= m_text.size()) return false;
+            char c = m_text[m_pos++];
+            if (c == '}') break;
+            if (c != ',') return false;
+        }
+        m_depth--;
+        return true;
+    }
+};
+
+bool JsonValue::parse(const std::string& text, JsonValue& out) {
+    out = JsonValue();
+    JsonParser parser(text);
+    return parser.parseDocument(out);
+}
+
+const JsonValue* JsonValue::find(const std::string& key) const {
+    for (const auto& member : m_members) {
+        if (member.first == key) {
+            return &member.second;
+        }
+    }
+    return nullptr;
+}
+
+double JsonValue::getNumber(const std::string& key, double defaultValue) const {
+    const JsonValue* value = find(key);
+    return (value && value->isNumber()) ? value->m_number : defaultValue;
+}
+
+int JsonValue::getInt(const std::string& key, int defaultValue) const {
+    const JsonValue* value = find(key);
+    return (value && value->isNumber()) ? static_cast<int>(value->m_number) : defaultValue;
+}
+
+bool JsonValue::getBool(const std::string& key, bool defaultValue) const {
+    const JsonValue* value = find(key);
+    if (!value || value->isNull() || value->isString()) return defaultValue;
+    return value->asBool();
+}
+
+std::string JsonValue::getString(const std::string& key, const std::string& defaultValue) const {
+    const JsonValue* value = find(key);
+    return (value && value->isString()) ? value->m_string : defaultValue;
+}
+
+// 转义字符串
+std::string jsonEscape(const std::string& str) {
+    std::string result;
+    result.reserve(str.size() + 8);
+    for (char c : str) {
+        switch (c) {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    result += buf;
+                } else {
+                    result += c;
+                }
+                break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,68 @@
+#ifndef JSON_UTIL_H
+#define JSON_UTIL_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+ * 轻量JSON解析 - 服务器内部使用
+ *
+ * 命令数据都是小型JSON对象，这里只实现处理命令所需的子集：
+ * 对象、数组、字符串、数字、布尔和null。
+ */
+class JsonValue {
+public:
+    enum class Type {
+        NUL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    JsonValue() : m_type(Type::NUL), m_bool(false), m_number(0.0) {}
+
+    // 解析JSON文本，失败返回false
+    static bool parse(const std::string& text, JsonValue& out);
+
+    Type type() const { return m_type; }
+    bool isNull() const { return m_type == Type::NUL; }
+    bool isNumber() const { return m_type == Type::NUMBER; }
+    bool isString() const { return m_type == Type::STRING; }
+    bool isArray() const { return m_type == Type::ARRAY; }
+    bool isObject() const { return m_type == Type::OBJECT; }
+
+    bool asBool() const { return m_type == Type::BOOLEAN ? m_bool : m_number != 0.0; }
+    double asNumber() const { return m_number; }
+    const std::string& asString() const { return m_string; }
+
+    // 数组元素
+    const std::vector<JsonValue>& items() const { return m_items; }
+
+    // 对象成员查找，不存在返回nullptr
+    const JsonValue* find(const std::string& key) const;
+    bool has(const std::string& key) const { return find(key) != nullptr; }
+
+    // 带默认值的成员读取
+    double getNumber(const std::string& key, double defaultValue) const;
+    int getInt(const std::string& key, int defaultValue) const;
+    bool getBool(const std::string& key, bool defaultValue) const;
+    std::string getString(const std::string& key, const std::string& defaultValue) const;
+
+private:
+    Type m_type;
+    bool m_bool;
+    double m_number;
+    std::string m_string;
+    std::vector<JsonValue> m_items;
+    std::vector<std::pair<std::string, JsonValue>> m_members;
+
+    friend class JsonParser;
+};
+
+// 转义字符串以嵌入JSON
+std::string jsonEscape(const std::string& str);
+
+#endif // JSON_UTIL_H
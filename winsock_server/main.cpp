@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 #include <signal.h>
 
 // 全局服务器实例（用于信号处理）
@@ -57,8 +58,56 @@ bool loadConfig(const std::string& filename, ServerConfig& config) {
                 config.clientTimeout = std::stoi(value);
             } else if (key == "enable_logging") {
                 config.enableLogging = (value == "true" || value == "1");
+            } else if (key == "log_level") {
+                config.debugLogging = (value == "DEBUG" || value == "debug");
             } else if (key == "log_file_path") {
                 config.logFilePath = value;
+            } else if (key == "motion_tick_rate") {
+                config.motionTickRate = std::stoi(value);
+            } else if (key == "cart_update_rate") {
+                config.cartUpdateRate = std::stoi(value);
+            } else if (key == "max_carts") {
+                config.maxCarts = std::stoi(value);
+            } else if (key == "grid_size") {
+                config.gridSize = std::stoi(value);
+            } else if (key == "cell_size") {
+                config.cellSize = std::stod(value);
+            } else if (key == "worker_threads") {
+                config.workerThreads = std::stoi(value);
+            } else if (key == "max_in_flight") {
+                config.maxInFlight = std::stoi(value);
+            } else if (key == "compress_threshold") {
+                config.compressThreshold = std::stoi(value);
+            } else if (key == "journal_path") {
+                config.journalPath = value;
+            } else if (key == "journal_durability") {
+                if (!stringToJournalDurability(value, config.journalDurability)) {
+                    std::cerr << "Warning: journal_durability must be none, interval or sync" << std::endl;
+                }
+            } else if (key == "journal_interval_ms") {
+                config.journalIntervalMs = std::stoi(value);
+            } else if (key == "snapshot_path") {
+                config.snapshotPath = value;
+            } else if (key == "snapshot_interval") {
+                config.snapshotInterval = std::stoi(value);
+            } else if (key == "capture_path") {
+                config.capturePath = value;
+            } else if (key == "metrics_port") {
+                config.metricsPort = std::stoi(value);
+            } else if (key == "trace_sample_every") {
+                config.traceSampleEvery = std::stoi(value);
+            } else if (key == "trace_buffer_spans") {
+                config.traceBufferSpans = std::stoi(value);
+            } else if (key == "initial_energy") {
+                config.initialEnergy = std::stod(value);
+            } else if (key == "max_energy") {
+                config.maxEnergy = std::stod(value);
+            } else if (key == "energy_regen") {
+                config.energyRegen = std::stod(value);
+            } else if (key == "initial_coins") {
+                config.initialCoins = std::stoll(value);
+            } else if (key == "initial_seeds") {
+                config.initialSeeds = std::stoi(value);
             }
         }
     }
@@ -75,11 +124,21 @@ void printHelp() {
     std::cout << "  --port <port>        Server port (default: 8888)" << std::endl;
     std::cout << "  --config <file>      Configuration file path" << std::endl;
     std::cout << "  --max-clients <n>    Maximum number of clients (default: 10)" << std::endl;
+    std::cout << "  --workers <n>        Request worker threads (default: 4)" << std::endl;
+    std::cout << "  --max-in-flight <n>  Pipelined requests per connection (default: 32)" << std::endl;
+    std::cout << "  --journal <file>     Write-ahead journal, \"\" to disable (default: farm.journal)" << std::endl;
+    std::cout << "  --snapshot <file>    Farm snapshot, \"\" to disable (default: farm.snapshot)" << std::endl;
+    std::cout << "  --capture <file>     Record received requests for farm_replay" << std::endl;
+    std::cout << "  --metrics-port <p>   Serve /metrics on 127.0.0.1:<p> (default: off)" << std::endl;
+    std::cout << "  --trace-sample <n>   Trace 1 of every n packets per connection (default: off)" << std::endl;
     std::cout << "  --debug              Enable debug logging" << std::endl;
     std::cout << "  --help               Show this help message" << std::endl;
     std::cout << "\nCommands (while running):" << std::endl;
     std::cout << "  status               Show server status" << std::endl;
     std::cout << "  clients              List connected clients" << std::endl;
+    std::cout << "  snapshot             Write a farm snapshot now" << std::endl;
+    std::cout << "  metrics              Print all metrics (Prometheus text format)" << std::endl;
+    std::cout << "  trace [file]         Dump recent spans as Chrome trace JSON (default: farm_trace.json)" << std::endl;
     std::cout << "  logs [n]             Show last n log entries (default: 10)" << std::endl;
     std::cout << "  broadcast <msg>      Broadcast message to all clients" << std::endl;
     std::cout << "  quit                 Stop server and exit" << std::endl;
@@ -101,6 +160,24 @@ void printStatus(FarmServer& server) {
     int seconds = uptime % 60;
     std::cout << "Uptime: " << hours << "h " << minutes << "m " << seconds << "s" << std::endl;
     std::cout << "Python Status: " << status.pythonStatus << std::endl;
+
+    // 等待时间最多的加锁处
+    std::vector<LockSiteStats> locks = server.getLockProfile();
+    if (!locks.empty()) {
+        std::cout << "\nLock contention (top by wait):" << std::endl;
+        std::cout << "Lock\tSite\t\t\t\tAcquired\tContended\tWait ms\tMax wait us\tHold ms\tMax hold us"
+                  << std::endl;
+        for (size_t i = 0; i < locks.size() && i < 8; i++) {
+            const LockSiteStats& lock = locks[i];
+            char line[256];
+            snprintf(line, sizeof(line), "%s\t%-30s\t%llu\t\t%llu\t\t%.3f\t%.1f\t\t%.3f\t%.1f",
+                     lock.lock.c_str(), lock.site.c_str(),
+                     static_cast<unsigned long long>(lock.acquisitions),
+                     static_cast<unsigned long long>(lock.contended),
+                     lock.waitNs / 1e6, lock.maxWaitNs / 1e3, lock.holdNs / 1e6, lock.maxHoldNs / 1e3);
+            std::cout << line << std::endl;
+        }
+    }
     std::cout << "=====================\n" << std::endl;
 }
 
@@ -188,6 +265,20 @@ int main(int argc, char* argv[]) {
             configFile = argv[++i];
         } else if (arg == "--max-clients" && i + 1 < argc) {
             config.maxClients = std::stoi(argv[++i]);
+        } else if (arg == "--workers" && i + 1 < argc) {
+            config.workerThreads = std::stoi(argv[++i]);
+        } else if (arg == "--max-in-flight" && i + 1 < argc) {
+            config.maxInFlight = std::stoi(argv[++i]);
+        } else if (arg == "--journal" && i + 1 < argc) {
+            config.journalPath = argv[++i];
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            config.snapshotPath = argv[++i];
+        } else if (arg == "--capture" && i + 1 < argc) {
+            config.capturePath = argv[++i];
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            config.metricsPort = std::stoi(argv[++i]);
+        } else if (arg == "--trace-sample" && i + 1 < argc) {
+            config.traceSampleEvery = std::stoi(argv[++i]);
         } else if (arg == "--debug") {
             debugMode = true;
         }
@@ -199,6 +290,9 @@ int main(int argc, char* argv[]) {
             std::cerr << "Warning: Failed to load config file, using defaults" << std::endl;
         }
     }
+    if (debugMode) {
+        config.debugLogging = true;
+    }
     
     // 创建服务器实例
     FarmServer server;
@@ -253,6 +347,28 @@ int main(int argc, char* argv[]) {
             printStatus(server);
         } else if (cmd == "clients") {
             printClients(server);
+        } else if (cmd == "snapshot") {
+            if (server.saveSnapshot()) {
+                std::cout << "Snapshot started." << std::endl;
+            } else {
+                std::cout << "Snapshot disabled or already in progress." << std::endl;
+            }
+        } else if (cmd == "metrics") {
+            std::cout << server.exportMetrics();
+        } else if (cmd == "trace") {
+            std::string path = "farm_trace.json";
+            iss >> path;
+            if (!server.tracingEnabled()) {
+                std::cout << "Tracing is off (set trace_sample_every or --trace-sample)." << std::endl;
+            } else {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out << server.exportTrace();
+                if (out) {
+                    std::cout << "Trace written to " << path << std::endl;
+                } else {
+                    std::cout << "Failed to write " << path << std::endl;
+                }
+            }
         } else if (cmd == "logs") {
             int count = 10;
             if (iss >> count) {
@@ -3,30 +3,41 @@
 #include <sstream>
 
 // 序列化数据包为字节流
-std::string Packet::serialize() const {
+std::string Packet::serialize(uint32_t version) const {
+    size_t headerSize = packetHeaderSize(version);
     std::string buffer;
-    buffer.resize(sizeof(PacketHeader) + data.length());
+    buffer.resize(headerSize + data.length());
     
     // 复制头部
     memcpy(&buffer[0], &header, sizeof(PacketHeader));
+    if (version >= PROTOCOL_VERSION_2) {
+        memcpy(&buffer[sizeof(PacketHeader)], &ext, sizeof(PacketHeaderExt));
+    }
     
     // 复制数据
     if (!data.empty()) {
-        memcpy(&buffer[sizeof(PacketHeader)], data.c_str(), data.length());
+        memcpy(&buffer[headerSize], data.c_str(), data.length());
     }
     
     return buffer;
 }
 
 // 从字节流反序列化数据包
-bool Packet::deserialize(const char* buffer, size_t bufferSize, Packet& packet) {
+bool Packet::deserialize(const char* buffer, size_t bufferSize, Packet& packet, uint32_t version) {
+    size_t headerSize = packetHeaderSize(version);
+    
     // 检查缓冲区大小
-    if (bufferSize < sizeof(PacketHeader)) {
+    if (bufferSize < headerSize) {
         return false;
     }
     
     // 读取头部
     memcpy(&packet.header, buffer, sizeof(PacketHeader));
+    if (version >= PROTOCOL_VERSION_2) {
+        memcpy(&packet.ext, buffer + sizeof(PacketHeader), sizeof(PacketHeaderExt));
+    } else {
+        packet.ext = PacketHeaderExt();
+    }
     
     // 验证魔数
     if (packet.header.magic != PROTOCOL_MAGIC) {
@@ -39,13 +50,13 @@ bool Packet::deserialize(const char* buffer, size_t bufferSize, Packet& packet)
     }
     
     // 检查缓冲区是否包含完整数据
-    if (bufferSize < sizeof(PacketHeader) + packet.header.length) {
+    if (bufferSize < headerSize + packet.header.length) {
         return false;
     }
     
     // 读取数据
     if (packet.header.length > 0) {
-        packet.data.assign(buffer + sizeof(PacketHeader), packet.header.length);
+        packet.data.assign(buffer + headerSize, packet.header.length);
     } else {
         packet.data.clear();
     }
@@ -90,6 +101,38 @@ std::string taskTypeToString(TaskType type) {
     }
 }
 
+// 命令类型转字符串（基准测试和统计输出用）
+std::string commandToString(uint32_t command) {
+    switch (command) {
+        case Command::CONNECT:              return "CONNECT";
+        case Command::DISCONNECT:           return "DISCONNECT";
+        case Command::GET_STATE:            return "GET_STATE";
+        case Command::GET_PLANTS:           return "GET_PLANTS";
+        case Command::QUERY_CONDITION:      return "QUERY_CONDITION";
+        case Command::FIND_NEAREST:         return "FIND_NEAREST";
+        case Command::EVALUATE_PLAN:        return "EVALUATE_PLAN";
+        case Command::PLAN_COVERAGE:        return "PLAN_COVERAGE";
+        case Command::GET_METRICS:          return "GET_METRICS";
+        case Command::MOVE_CART:            return "MOVE_CART";
+        case Command::ROTATE_CART:          return "ROTATE_CART";
+        case Command::PLANT_SEED:           return "PLANT_SEED";
+        case Command::WATER_PLANT:          return "WATER_PLANT";
+        case Command::HARVEST:              return "HARVEST";
+        case Command::REMOVE_WEED:          return "REMOVE_WEED";
+        case Command::BATCH_OPERATION:      return "BATCH_OPERATION";
+        case Command::AUTO_FARM_START:      return "AUTO_FARM_START";
+        case Command::AUTO_FARM_STOP:       return "AUTO_FARM_STOP";
+        case Command::AUTO_FARM_STATUS:     return "AUTO_FARM_STATUS";
+        case Command::SWITCH_EQUIPMENT:     return "SWITCH_EQUIPMENT";
+        case Command::SWITCH_CAMERA:        return "SWITCH_CAMERA";
+        case Command::UPGRADE_TOOL:         return "UPGRADE_TOOL";
+        case Command::STREAM_BEGIN:         return "STREAM_BEGIN";
+        case Command::STREAM_CHUNK:         return "STREAM_CHUNK";
+        case Command::STREAM_END:           return "STREAM_END";
+        default:                            return "unknown";
+    }
+}
+
 // 任务优先级转字符串
 std::string taskPriorityToString(TaskPriority priority) {
     switch (priority) {
@@ -120,3 +163,14 @@ CameraMode stringToCameraMode(const std::string& str) {
     if (str == "free")          return CameraMode::FREE;
     return CameraMode::THIRD_PERSON;  // 默认
 }
+
+// 字符串转任务类型
+bool stringToTaskType(const std::string& str, TaskType& type) {
+    if (str == "weed_removal" || str == "weed")     { type = TaskType::WEED_REMOVAL; return true; }
+    if (str == "harvest")                           { type = TaskType::HARVEST; return true; }
+    if (str == "watering" || str == "water")        { type = TaskType::WATERING; return true; }
+    if (str == "fertilizing")                       { type = TaskType::FERTILIZING; return true; }
+    if (str == "planting" || str == "sow")          { type = TaskType::PLANTING; return true; }
+    if (str == "soil_preparation")                  { type = TaskType::SOIL_PREPARATION; return true; }
+    return false;
+}
@@ -10,23 +10,40 @@
 // 最大数据包大小
 #define MAX_PACKET_SIZE 65536
 
+// 协议v2分片重组后的最大消息长度
+#define MAX_MESSAGE_SIZE (16 * 1024 * 1024)
+
+// 协议版本：v1为12字节头；v2在头部增加请求ID和标志位，CONNECT时协商
+#define PROTOCOL_VERSION_1 1
+#define PROTOCOL_VERSION_2 2
+
 // 命令类型定义 - 客户端到服务器
 namespace Command {
     constexpr uint32_t CONNECT              = 0x0001;
     constexpr uint32_t DISCONNECT           = 0x0002;
     constexpr uint32_t GET_STATE            = 0x0010;
     constexpr uint32_t GET_PLANTS           = 0x0011;
+    constexpr uint32_t QUERY_CONDITION      = 0x0012;
+    constexpr uint32_t FIND_NEAREST         = 0x0013;
+    constexpr uint32_t EVALUATE_PLAN        = 0x0014;
+    constexpr uint32_t PLAN_COVERAGE        = 0x0015;
+    constexpr uint32_t GET_METRICS          = 0x0016;
     constexpr uint32_t MOVE_CART            = 0x0020;
     constexpr uint32_t ROTATE_CART          = 0x0021;
     constexpr uint32_t PLANT_SEED           = 0x0030;
     constexpr uint32_t WATER_PLANT          = 0x0031;
     constexpr uint32_t HARVEST              = 0x0032;
     constexpr uint32_t REMOVE_WEED          = 0x0033;
+    constexpr uint32_t BATCH_OPERATION      = 0x0034;
     constexpr uint32_t AUTO_FARM_START      = 0x0040;
     constexpr uint32_t AUTO_FARM_STOP       = 0x0041;
     constexpr uint32_t AUTO_FARM_STATUS     = 0x0042;
     constexpr uint32_t SWITCH_EQUIPMENT     = 0x0050;
     constexpr uint32_t SWITCH_CAMERA        = 0x0051;
+    constexpr uint32_t UPGRADE_TOOL         = 0x0052;
+    constexpr uint32_t STREAM_BEGIN         = 0x0060;
+    constexpr uint32_t STREAM_CHUNK         = 0x0061;
+    constexpr uint32_t STREAM_END           = 0x0062;
 }
 
 // 响应类型定义 - 服务器到客户端
@@ -35,10 +52,18 @@ namespace Response {
     constexpr uint32_t ERROR                = 0x1002;
     constexpr uint32_t STATE_UPDATE         = 0x1010;
     constexpr uint32_t PLANT_DATA           = 0x1011;
+    constexpr uint32_t CONDITION_DATA       = 0x1012;
+    constexpr uint32_t NEAREST_DATA         = 0x1013;
+    constexpr uint32_t PLAN_RESULT          = 0x1014;
+    constexpr uint32_t COVERAGE_DATA        = 0x1015;
+    constexpr uint32_t METRICS_DATA         = 0x1016;
     constexpr uint32_t CART_MOVED           = 0x1020;
     constexpr uint32_t ACTION_COMPLETE      = 0x1030;
     constexpr uint32_t AUTO_STATUS          = 0x1040;
     constexpr uint32_t LOG_MESSAGE          = 0x1050;
+    constexpr uint32_t STREAM_BEGIN         = 0x1060;
+    constexpr uint32_t STREAM_CHUNK         = 0x1061;
+    constexpr uint32_t STREAM_END           = 0x1062;
 }
 
 // 错误代码定义
@@ -54,6 +79,14 @@ namespace ErrorCode {
     constexpr uint32_t OPERATION_FAILED     = 0xE009;
 }
 
+// 数据包标志位（协议v2）
+namespace PacketFlag {
+    constexpr uint32_t RESPONSE             = 0x0001;  // 对请求的回复，requestId有效
+    constexpr uint32_t FINAL                = 0x0002;  // 该请求的最后一个回复
+    constexpr uint32_t COMPRESSED           = 0x0004;  // 数据部分为LZ4压缩帧（CONNECT时协商）
+    constexpr uint32_t MORE                 = 0x0008;  // 消息被分片，后面还有分片
+}
+
 // 数据包头结构
 #pragma pack(push, 1)
 struct PacketHeader {
@@ -65,11 +98,25 @@ struct PacketHeader {
     PacketHeader(uint32_t cmd, uint32_t len) 
         : magic(PROTOCOL_MAGIC), command(cmd), length(len) {}
 };
+
+// v2头部在v1头部之后追加的字段
+struct PacketHeaderExt {
+    uint32_t requestId;  // 客户端分配，回复原样带回；服务器主动推送为0
+    uint32_t flags;      // PacketFlag
+    
+    PacketHeaderExt() : requestId(0), flags(0) {}
+};
 #pragma pack(pop)
 
+// 指定协议版本的头部长度
+inline size_t packetHeaderSize(uint32_t version) {
+    return sizeof(PacketHeader) + (version >= PROTOCOL_VERSION_2 ? sizeof(PacketHeaderExt) : 0);
+}
+
 // 数据包结构
 struct Packet {
     PacketHeader header;
+    PacketHeaderExt ext;    // 仅v2连接上传输
     std::string data;  // JSON格式数据
     
     Packet() {}
@@ -77,10 +124,11 @@ struct Packet {
         : header(command, static_cast<uint32_t>(jsonData.length())), data(jsonData) {}
     
     // 序列化为字节流
-    std::string serialize() const;
+    std::string serialize(uint32_t version = PROTOCOL_VERSION_1) const;
     
     // 从字节流反序列化
-    static bool deserialize(const char* buffer, size_t bufferSize, Packet& packet);
+    static bool deserialize(const char* buffer, size_t bufferSize, Packet& packet,
+                            uint32_t version = PROTOCOL_VERSION_1);
     
     // 验证数据包
     bool isValid() const {
@@ -97,9 +145,11 @@ struct ClientInfo {
     time_t connectTime;
     time_t lastActivityTime;
     bool isAuthorized;
+    uint32_t protocolVersion;
     
     ClientInfo() : clientId(-1), port(0), connectTime(0), 
-                   lastActivityTime(0), isAuthorized(false) {}
+                   lastActivityTime(0), isAuthorized(false),
+                   protocolVersion(PROTOCOL_VERSION_1) {}
 };
 
 // 装备类型
@@ -143,8 +193,11 @@ std::string equipmentTypeToString(EquipmentType type);
 std::string cameraModeToString(CameraMode mode);
 std::string taskTypeToString(TaskType type);
 std::string taskPriorityToString(TaskPriority priority);
+std::string commandToString(uint32_t command);
 
 EquipmentType stringToEquipmentType(const std::string& str);
 CameraMode stringToCameraMode(const std::string& str);
+// 同时接受resource_manager.py中的名称（sow / water / weed）
+bool stringToTaskType(const std::string& str, TaskType& type);
 
 #endif // PROTOCOL_H
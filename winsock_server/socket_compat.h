@@ -41,6 +41,7 @@
     #include <fcntl.h>
     #include <errno.h>
     #include <netdb.h>
+    #include <poll.h>
     #include <string.h>
     
     // 类型定义
@@ -134,6 +135,28 @@ inline bool setTcpNoDelay(socket_t sock, bool enable) {
                      (const char*)&optval, sizeof(optval)) == 0;
 }
 
+/**
+ * 等待多个socket就绪（Windows上为WSAPoll）
+ */
+inline int pollSockets(pollfd* fds, size_t count, int timeoutMs) {
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+#else
+    return poll(fds, static_cast<nfds_t>(count), timeoutMs);
+#endif
+}
+
+/**
+ * 非阻塞socket的操作是否只是暂时不能完成（等可读/可写后重试）
+ */
+inline bool isWouldBlock(int error) {
+#ifdef _WIN32
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#else
+    return error == EWOULDBLOCK || error == EAGAIN || error == EINPROGRESS;
+#endif
+}
+
 /**
  * 获取socket错误信息
  */